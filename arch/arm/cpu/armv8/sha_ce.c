@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <u-boot/sha_backend.h>
+
+/* Fields of ID_AA64ISAR0_EL1 */
+#define ID_AA64ISAR0_SHA1_SHIFT		8
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_FIELD_MASK		0xf
+
+void sha1_ce_blocks(u32 *state, const u8 *data, uint blocks);
+void sha256_ce_blocks(u32 *state, const u8 *data, uint blocks);
+
+static uint sha_ce_isar0_field(uint shift)
+{
+	ulong isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> shift) & ID_AA64ISAR0_FIELD_MASK;
+}
+
+#ifdef CONFIG_SHA1
+static bool sha1_ce_probe(void)
+{
+	return sha_ce_isar0_field(ID_AA64ISAR0_SHA1_SHIFT) != 0;
+}
+
+U_BOOT_SHA1_BACKEND(armv8_ce) = {
+	.name		= "armv8-ce",
+	.priority	= 20,
+	.probe		= sha1_ce_probe,
+	.blocks		= sha1_ce_blocks,
+};
+#endif
+
+#if defined(CONFIG_SHA256) || defined(CONFIG_SUPPORT_EMMC_RPMB)
+static bool sha256_ce_probe(void)
+{
+	return sha_ce_isar0_field(ID_AA64ISAR0_SHA2_SHIFT) != 0;
+}
+
+U_BOOT_SHA256_BACKEND(armv8_ce) = {
+	.name		= "armv8-ce",
+	.priority	= 20,
+	.probe		= sha256_ce_probe,
+	.blocks		= sha256_ce_blocks,
+};
+#endif
@@ -8,6 +8,7 @@
 #include <dm.h>
 #include <errno.h>
 #include <linux/libfdt.h>
+#include <job_queue.h>
 #include <os.h>
 #include <asm/io.h>
 #include <asm/setjmp.h>
@@ -340,3 +341,37 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#if CONFIG_IS_ENABLED(JOB_QUEUE)
+/*
+ * Host threads stand in for secondary CPUs. Sandbox has as many CPUs as the
+ * job queue can use, whatever the host has, so jobs are shared out the same
+ * way on every host.
+ */
+static void *job_threads[CONFIG_JOB_QUEUE_MAX_CPUS];
+
+int arch_job_cpus(void)
+{
+	return ARRAY_SIZE(job_threads);
+}
+
+int arch_job_start(int cpu, void (*func)(void *arg), void *arg)
+{
+	if (cpu < 1 || cpu >= ARRAY_SIZE(job_threads))
+		return -EINVAL;
+
+	return os_thread_create(&job_threads[cpu], func, arg);
+}
+
+int arch_job_wait(int cpu)
+{
+	int ret;
+
+	if (cpu < 1 || cpu >= ARRAY_SIZE(job_threads) || !job_threads[cpu])
+		return -EINVAL;
+	ret = os_thread_join(job_threads[cpu]);
+	job_threads[cpu] = NULL;
+
+	return ret;
+}
+#endif
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -827,3 +828,54 @@ void *os_find_text_base(void)
 
 	return base;
 }
+
+/**
+ * struct os_thread - a host thread started by os_thread_create()
+ *
+ * @thread:	Host thread
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ */
+struct os_thread {
+	pthread_t thread;
+	void (*func)(void *arg);
+	void *arg;
+};
+
+static void *os_thread_entry(void *data)
+{
+	struct os_thread *thread = data;
+
+	thread->func(thread->arg);
+
+	return NULL;
+}
+
+int os_thread_create(void **threadp, void (*func)(void *arg), void *arg)
+{
+	struct os_thread *thread;
+
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return -ENOMEM;
+	thread->func = func;
+	thread->arg = arg;
+	if (pthread_create(&thread->thread, NULL, os_thread_entry, thread)) {
+		os_free(thread);
+		return -EAGAIN;
+	}
+	*threadp = thread;
+
+	return 0;
+}
+
+int os_thread_join(void *ptr)
+{
+	struct os_thread *thread = ptr;
+	int ret;
+
+	ret = pthread_join(thread->thread, NULL);
+	os_free(thread);
+
+	return ret ? -EINVAL : 0;
+}
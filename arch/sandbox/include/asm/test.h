@@ -224,4 +224,30 @@ uint sandbox_pci_read_bar(u32 barval, int type, uint size);
  */
 void sandbox_set_enable_memio(bool enable);
 
+/**
+ * sandbox_virtio_blk_get_stats() - Get statistics from a virtio block device
+ *
+ * @dev: virtio transport device
+ * @notifiesp: Returns the number of notifications received
+ * @reqsp: Returns the number of requests carried out
+ * @indirectp: Returns the number of those which used an indirect descriptor
+ *	table
+ */
+void sandbox_virtio_blk_get_stats(struct udevice *dev, uint *notifiesp,
+				  uint *reqsp, uint *indirectp);
+
+/**
+ * sandbox_mmc_get_cqe_log() - Get the order in which queued tasks were run
+ *
+ * This empties the log, ready for the next transfer
+ *
+ * @dev: sandbox eMMC device
+ * @tags: Returns the tag of each task, in the order they completed
+ * @starts: Returns the first block of each task
+ * @max: Number of entries available in @tags and @starts
+ * @return number of entries returned
+ */
+uint sandbox_mmc_get_cqe_log(struct udevice *dev, uint *tags, uint *starts,
+			     uint max);
+
 #endif
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the Intel SHA extensions
+ *
+ * This is used by 64-bit x86 U-Boot and also by sandbox when it runs on a
+ * 64-bit x86 host, so it does not use the x86 CPU headers.
+ */
+
+#include <common.h>
+#include <u-boot/sha_backend.h>
+
+/* CPUID leaf 1, ECX */
+#define CPUID1_ECX_SSSE3	BIT(9)
+#define CPUID1_ECX_SSE4_1	BIT(19)
+/* CPUID leaf 7, EBX */
+#define CPUID7_EBX_SHA		BIT(29)
+/* CR4 bit which allows SSE instructions */
+#define CR4_OSFXSR		BIT(9)
+
+void sha1_ni_blocks(u32 *digest, const u8 *data, ulong blocks);
+void sha256_ni_blocks(u32 *digest, const u8 *data, ulong blocks);
+
+/* Returns EAX from the given CPUID leaf (sub-leaf 0) */
+static u32 sha_ni_cpuid(u32 leaf, u32 *ebx, u32 *ecx)
+{
+	u32 eax = leaf, edx;
+
+	asm volatile("cpuid"
+		     : "+a" (eax), "=b" (*ebx), "=c" (*ecx), "=d" (edx)
+		     : "c" (0));
+
+	return eax;
+}
+
+static bool sha_ni_probe(void)
+{
+	/* 0 if not checked yet, 1 if supported, -1 if not */
+	static int supported;
+	u32 max, ebx, ecx;
+
+	if (supported)
+		return supported > 0;
+
+	supported = -1;
+	max = sha_ni_cpuid(0, &ebx, &ecx);
+	if (max < 7)
+		return false;
+	sha_ni_cpuid(1, &ebx, &ecx);
+	if ((ecx & (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1)) !=
+	    (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1))
+		return false;
+	sha_ni_cpuid(7, &ebx, &ecx);
+	if (!(ebx & CPUID7_EBX_SHA))
+		return false;
+#ifndef CONFIG_SANDBOX
+	{
+		ulong cr4;
+
+		/* U-Boot does not enable SSE itself, but firmware may have */
+		asm volatile("mov %%cr4, %0" : "=r" (cr4));
+		if (!(cr4 & CR4_OSFXSR))
+			return false;
+	}
+#endif
+	supported = 1;
+
+	return true;
+}
+
+/* The assembler takes a 64-bit block count, so widen it here */
+#ifdef CONFIG_SHA1
+static void sha1_ni(u32 *state, const u8 *data, uint count)
+{
+	sha1_ni_blocks(state, data, count);
+}
+
+U_BOOT_SHA1_BACKEND(x86_sha_ni) = {
+	.name		= "x86-sha-ni",
+	.priority	= 20,
+	.probe		= sha_ni_probe,
+	.blocks		= sha1_ni,
+};
+#endif
+
+#if defined(CONFIG_SHA256) || defined(CONFIG_SUPPORT_EMMC_RPMB)
+static void sha256_ni(u32 *state, const u8 *data, uint count)
+{
+	sha256_ni_blocks(state, data, count);
+}
+
+U_BOOT_SHA256_BACKEND(x86_sha_ni) = {
+	.name		= "x86-sha-ni",
+	.priority	= 20,
+	.probe		= sha_ni_probe,
+	.blocks		= sha256_ni,
+};
+#endif
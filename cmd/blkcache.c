@@ -12,37 +12,61 @@
 static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
+	struct block_cache_dev_stats dev_stats;
 	struct block_cache_stats stats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
+	       "max cache entries: %u\n"
+	       "read-ahead blocks: %u\n",
 	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.readahead);
+
+	for (i = 0; !blkcache_dev_stats(i, &dev_stats); i++) {
+		printf("%s %d: hits %u, misses %u, read ahead %u, written %u\n",
+		       blk_get_if_type_name(dev_stats.iftype),
+		       dev_stats.devnum, dev_stats.hits, dev_stats.misses,
+		       dev_stats.readahead, dev_stats.writes);
+	}
+
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, max_entries, readahead;
+	struct block_cache_stats stats;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	if (argc == 4) {
+		readahead = simple_strtoul(argv[3], 0, 0);
+	} else {
+		blkcache_stats(&stats);
+		readahead = stats.readahead;
+	}
+	if (blkcache_configure(blocks_per_entry, max_entries, readahead)) {
+		printf("blocks per entry must be non-zero\n");
+		return CMD_RET_FAILURE;
+	}
+	printf("changed to max of %u entries of %u blocks each, read ahead %u\n",
+	       max_entries, blocks_per_entry, readahead);
 	return 0;
 }
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -79,8 +103,8 @@ static int do_blkcache(cmd_tbl_t *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure blocks entries [readahead]\n"
 );
@@ -29,8 +29,11 @@ static int do_load_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	load,	7,	0,	do_load_wrapper,
+	load,	9,	0,	do_load_wrapper,
 	"load binary file from a filesystem",
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"[-d <comp>] "
+#endif
 	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [pos]]]]]\n"
 	"    - Load binary file 'filename' from partition 'part' on device\n"
 	"       type 'interface' instance 'dev' to address 'addr' in memory.\n"
@@ -38,6 +41,12 @@ U_BOOT_CMD(
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
 	"      If 'pos' is 0 or omitted, the file is read from the start."
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"\n"
+	"      With -d, the file is decompressed with 'comp' (e.g. gzip,\n"
+	"      lz4, zstd) while it is read, and 'filesize' is set to its\n"
+	"      uncompressed size."
+#endif
 )
 
 static int do_save_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -19,6 +19,18 @@ static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+#ifdef CONFIG_CMD_HASH_BENCH
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		ulong size = HASH_BENCH_SIZE;
+
+		if (argc > 2)
+			size = simple_strtoul(argv[2], NULL, 16);
+		if (!size)
+			return CMD_RET_USAGE;
+
+		return hash_bench(size) ? CMD_RET_FAILURE : 0;
+	}
+#endif
 #ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
@@ -52,4 +64,9 @@ U_BOOT_CMD(
 		"    - verify message digest of memory area to immediate value, \n"
 		"      env var or *address"
 #endif
+#ifdef CONFIG_CMD_HASH_BENCH
+	"\nhash bench [size]\n"
+		"    - show the speed of each algorithm and backend, hashing\n"
+		"      'size' bytes (hex, default 10000) at a time"
+#endif
 );
@@ -91,6 +91,10 @@ static void print_mmcinfo(struct mmc *mmc)
 			}
 		}
 	}
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	if (mmc->cmdq_depth)
+		mmc_cmdq_print_stats(mmc);
+#endif
 }
 static struct mmc *init_mmc_device(int dev, bool force_init)
 {
@@ -32,16 +32,33 @@ int do_tftpb(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	int ret;
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	ret = image_decomp_stream_opt(argc, argv, &net_boot_file_comp);
+	if (ret < 0)
+		return CMD_RET_USAGE;
+	argc -= ret;
+	argv += ret;
+#endif
 	bootstage_mark_name(BOOTSTAGE_KERNELREAD_START, "tftp_start");
 	ret = netboot_common(TFTPGET, cmdtp, argc, argv);
 	bootstage_mark_name(BOOTSTAGE_KERNELREAD_STOP, "tftp_done");
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	net_boot_file_comp = IH_COMP_NONE;
+#endif
 	return ret;
 }
 
 U_BOOT_CMD(
-	tftpboot,	3,	1,	do_tftpb,
+	tftpboot,	5,	1,	do_tftpb,
 	"boot image via network using TFTP protocol",
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"[-d <comp>] "
+#endif
 	"[loadAddress] [[hostIPaddr:]bootfilename]"
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	"\n    - with -d, decompress the file with 'comp' (e.g. gzip, lz4,\n"
+	"      zstd) as it arrives, setting 'filesize' to its uncompressed size"
+#endif
 );
 #endif
 
@@ -33,6 +33,21 @@ static int do_nvme(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 			nvme_print_info(udev);
 
+			return ret;
+		}
+		if (strncmp(argv[1], "info", 4) == 0) {
+			struct udevice *udev;
+			struct uclass *uc;
+
+			ret = blk_common_cmd(argc, argv, IF_TYPE_NVME,
+					     &nvme_curr_dev);
+			if (uclass_get(UCLASS_NVME, &uc))
+				return ret;
+			uclass_foreach_dev(udev, uc) {
+				if (device_active(udev))
+					nvme_print_stats(udev);
+			}
+
 			return ret;
 		}
 	}
@@ -45,7 +60,7 @@ U_BOOT_CMD(
 	"NVM Express sub-system",
 	"scan - scan NVMe devices\n"
 	"nvme detail - show details of current NVMe device\n"
-	"nvme info - show all available NVMe devices\n"
+	"nvme info - show all available NVMe devices and I/O statistics\n"
 	"nvme device [dev] - show or set current NVMe device\n"
 	"nvme part [dev] - print partition table of one or all NVMe devices\n"
 	"nvme read addr blk# cnt - read `cnt' blocks starting at block\n"
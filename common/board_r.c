@@ -163,6 +163,10 @@ static int initr_reloc_global_data(void)
 	 */
 	gd->fdt_blob += gd->reloc_off;
 #endif
+#if CONFIG_IS_ENABLED(OF_FLAT_INDEX)
+	/* The tables are in pre-relocation memory which may have gone */
+	gd->fdt_index = NULL;
+#endif
 #ifdef CONFIG_EFI_LOADER
 	/*
 	 * On the ARM architecture gd is mapped to a fixed register (r9 or x18).
@@ -0,0 +1,668 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Making many property changes to a device tree in a single pass
+ */
+
+#include <common.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <sort.h>
+#include <linux/libfdt.h>
+
+/* Space to allocate for the node path at first */
+#define FDT_BATCH_PATH_SIZE	256
+
+/**
+ * struct fdt_batch_prop - A recorded change to a property
+ *
+ * @path: Path of the node holding the property
+ * @name: Name of the property (in the same allocation as @path)
+ * @val: New value, NULL if @len is 0 or @deleted is true
+ * @len: Length of the new value
+ * @seq: Order in which the property was added, see @moved
+ * @deleted: true to remove the property
+ * @moved: true if the property was removed and then set again. Like a new
+ *	property, it goes at the start of the node, with the most recently added
+ *	first, as fdt_setprop() does
+ * @present: true if the property is in the tree (set while committing)
+ */
+struct fdt_batch_prop {
+	char *path;
+	const char *name;
+	void *val;
+	int len;
+	int seq;
+	bool deleted;
+	bool moved;
+	bool present;
+};
+
+/**
+ * struct fdt_batch_out - Buffer to write the new structure block into
+ *
+ * @buf: Buffer
+ * @len: Number of bytes written
+ * @size: Size of the buffer
+ */
+struct fdt_batch_out {
+	void *buf;
+	int len;
+	int size;
+};
+
+/**
+ * struct fdt_batch_walk - Position in a walk through the structure block
+ *
+ * @offset: Offset of the next tag
+ * @node: Offset of the last node started
+ * @depth: Number of nodes started but not finished
+ * @size_struct: Size of the structure block when the walk started
+ * @pathlen: Length of the path of each node started but not finished
+ * @max_depth: Number of entries allocated for @pathlen
+ * @path: Path of the last node started and not finished
+ * @path_size: Number of bytes allocated for @path
+ */
+struct fdt_batch_walk {
+	int offset;
+	int node;
+	int depth;
+	u32 size_struct;
+	int *pathlen;
+	int max_depth;
+	char *path;
+	int path_size;
+};
+
+/* Batch which fdt_support fixups add to, NULL if none */
+static struct fdt_batch *fdt_batch_current;
+
+static void fdt_batch_walk_start(const void *blob,
+				 struct fdt_batch_walk *walk)
+{
+	walk->offset = 0;
+	walk->node = -1;
+	walk->depth = 0;
+	walk->size_struct = fdt_size_dt_struct(blob);
+	if (walk->path)
+		walk->path[0] = '\0';
+}
+
+/* Make room in @walk for @depth nodes, the last with a path of @size bytes */
+static int fdt_batch_walk_grow(struct fdt_batch_walk *walk, int depth,
+			       int size)
+{
+	void *ptr;
+
+	if (depth > walk->max_depth) {
+		ptr = realloc(walk->pathlen, depth * 2 * sizeof(int));
+		if (!ptr)
+			return -FDT_ERR_NOSPACE;
+		walk->pathlen = ptr;
+		walk->max_depth = depth * 2;
+	}
+	if (size > walk->path_size) {
+		size = max(size, max(walk->path_size * 2,
+				     FDT_BATCH_PATH_SIZE));
+		ptr = realloc(walk->path, size);
+		if (!ptr)
+			return -FDT_ERR_NOSPACE;
+		walk->path = ptr;
+		walk->path_size = size;
+	}
+
+	return 0;
+}
+
+/**
+ * fdt_batch_walk_next() - Move past the next tag, keeping track of the path
+ *
+ * @blob: Tree to walk through
+ * @walk: Position in the walk
+ * @offsetp: Returns the offset of the tag
+ * @return the tag (FDT_BEGIN_NODE, etc.), or -FDT_ERR_... on error
+ */
+static int fdt_batch_walk_next(const void *blob, struct fdt_batch_walk *walk,
+			       int *offsetp)
+{
+	int offset = walk->offset, next, len, pos, ret;
+	const char *name;
+	u32 tag;
+
+	tag = fdt_next_tag(blob, offset, &next);
+	if (next < 0)
+		return next;
+
+	switch (tag) {
+	case FDT_BEGIN_NODE:
+		name = fdt_get_name(blob, offset, &len);
+		if (!name)
+			return len;
+		pos = walk->depth ? walk->pathlen[walk->depth - 1] : 0;
+		ret = fdt_batch_walk_grow(walk, walk->depth + 1, pos + len + 2);
+		if (ret)
+			return ret;
+		/* The root node is "/" and has no name */
+		if (pos != 1)
+			walk->path[pos++] = '/';
+		strcpy(walk->path + pos, name);
+		walk->pathlen[walk->depth++] = pos + len;
+		walk->node = offset;
+		break;
+	case FDT_END_NODE:
+		if (!walk->depth)
+			return -FDT_ERR_BADSTRUCTURE;
+		walk->depth--;
+		walk->path[walk->depth ? walk->pathlen[walk->depth - 1] : 0] =
+			'\0';
+		break;
+	}
+	*offsetp = offset;
+	walk->offset = next;
+
+	return tag;
+}
+
+/**
+ * fdt_batch_path() - Get the path of a node
+ *
+ * Fixups often work through the tree in order, so this carries on from the
+ * previous node where it can, rather than starting at the top each time.
+ *
+ * @batch: Batch being recorded
+ * @nodeoffset: Offset of node to look up
+ * @pathp: Returns the path of the node, valid until the next call
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int fdt_batch_path(struct fdt_batch *batch, int nodeoffset,
+			  const char **pathp)
+{
+	struct fdt_batch_walk *walk = batch->walk;
+	const void *blob = batch->blob;
+	int offset, tag;
+
+	if (!walk) {
+		walk = calloc(1, sizeof(*walk));
+		if (!walk)
+			return -FDT_ERR_NOSPACE;
+		batch->walk = walk;
+		fdt_batch_walk_start(blob, walk);
+	}
+
+	/* If the tree has changed size, offsets may have moved */
+	if (walk->size_struct != fdt_size_dt_struct(blob) ||
+	    (nodeoffset < walk->offset && nodeoffset != walk->node))
+		fdt_batch_walk_start(blob, walk);
+	while (walk->node != nodeoffset) {
+		tag = fdt_batch_walk_next(blob, walk, &offset);
+		if (tag < 0)
+			return tag;
+		if (offset >= nodeoffset && offset != walk->node)
+			return -FDT_ERR_BADOFFSET;
+	}
+	*pathp = walk->path;
+
+	return 0;
+}
+
+void fdt_batch_begin(struct fdt_batch *batch, void *blob)
+{
+	memset(batch, '\0', sizeof(*batch));
+	batch->blob = blob;
+	fdt_batch_current = batch;
+}
+
+struct fdt_batch *fdt_batch_active(const void *blob)
+{
+	if (fdt_batch_current && fdt_batch_current->blob == blob)
+		return fdt_batch_current;
+
+	return NULL;
+}
+
+static uint fdt_batch_hash(const char *path, const char *name)
+{
+	uint hash = 5381;
+
+	while (*path)
+		hash = hash * 33 + *path++;
+	while (*name)
+		hash = hash * 33 + *name++;
+
+	return hash;
+}
+
+/**
+ * fdt_batch_find() - Find the recorded change for a property
+ *
+ * @batch: Batch to search
+ * @path: Path of the node holding the property
+ * @name: Name of the property
+ * @slotp: Returns the hash-table slot holding the change, or the empty slot
+ *	where it would go
+ * @return the change, or NULL if none
+ */
+static struct fdt_batch_prop *fdt_batch_find(struct fdt_batch *batch,
+					     const char *path,
+					     const char *name, int **slotp)
+{
+	uint mask = batch->size * 2 - 1;
+	struct fdt_batch_prop *prop;
+	uint i;
+
+	/* The table always has empty slots, so this stops */
+	for (i = fdt_batch_hash(path, name) & mask; batch->hash[i];
+	     i = (i + 1) & mask) {
+		prop = &batch->props[batch->hash[i] - 1];
+		if (!strcmp(prop->name, name) && !strcmp(prop->path, path)) {
+			*slotp = &batch->hash[i];
+			return prop;
+		}
+	}
+	*slotp = &batch->hash[i];
+
+	return NULL;
+}
+
+/* Make room for more changes, with a new hash table to find them */
+static int fdt_batch_grow(struct fdt_batch *batch)
+{
+	struct fdt_batch_prop *props;
+	int size, i, *hash, *slot;
+
+	size = batch->size ? batch->size * 2 : 16;
+	hash = calloc(size * 2, sizeof(int));
+	if (!hash)
+		return -FDT_ERR_NOSPACE;
+	props = realloc(batch->props, size * sizeof(*props));
+	if (!props) {
+		free(hash);
+		return -FDT_ERR_NOSPACE;
+	}
+	free(batch->hash);
+	batch->props = props;
+	batch->hash = hash;
+	batch->size = size;
+	for (i = 0; i < batch->count; i++) {
+		fdt_batch_find(batch, props[i].path, props[i].name, &slot);
+		*slot = i + 1;
+	}
+
+	return 0;
+}
+
+/* Returns the recorded change for a property, adding one if @create */
+static int fdt_batch_lookup(struct fdt_batch *batch, int nodeoffset,
+			    const char *name, bool create,
+			    struct fdt_batch_prop **propp)
+{
+	struct fdt_batch_prop *prop = NULL;
+	const char *path;
+	int ret, len, *slot;
+
+	ret = fdt_batch_path(batch, nodeoffset, &path);
+	if (ret)
+		return ret;
+	if (batch->hash)
+		prop = fdt_batch_find(batch, path, name, &slot);
+	if (prop || !create) {
+		*propp = prop;
+		return 0;
+	}
+
+	if (batch->count == batch->size) {
+		ret = fdt_batch_grow(batch);
+		if (ret)
+			return ret;
+		fdt_batch_find(batch, path, name, &slot);
+	}
+	prop = &batch->props[batch->count];
+	memset(prop, '\0', sizeof(*prop));
+	len = strlen(path) + 1;
+	prop->path = malloc(len + strlen(name) + 1);
+	if (!prop->path)
+		return -FDT_ERR_NOSPACE;
+	strcpy(prop->path, path);
+	prop->name = strcpy(prop->path + len, name);
+	prop->seq = ++batch->seq;
+	*slot = ++batch->count;
+	*propp = prop;
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len)
+{
+	struct fdt_batch_prop *prop;
+	void *copy = NULL;
+	int ret;
+
+	if (len < 0)
+		return -FDT_ERR_BADVALUE;
+	if (len) {
+		copy = malloc(len);
+		if (!copy)
+			return -FDT_ERR_NOSPACE;
+		memcpy(copy, val, len);
+	}
+	ret = fdt_batch_lookup(batch, nodeoffset, name, true, &prop);
+	if (ret) {
+		free(copy);
+		return ret;
+	}
+
+	if (prop->deleted) {
+		/* Setting a removed property adds it again, at the start */
+		prop->moved = fdt_get_property(batch->blob, nodeoffset, name,
+					       NULL) != NULL;
+		prop->seq = ++batch->seq;
+		prop->deleted = false;
+	}
+	free(prop->val);
+	prop->val = copy;
+	prop->len = len;
+
+	return 0;
+}
+
+int fdt_batch_delprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name)
+{
+	struct fdt_batch_prop *prop;
+	int ret;
+
+	ret = fdt_batch_lookup(batch, nodeoffset, name, false, &prop);
+	if (ret)
+		return ret;
+	if (prop ? prop->deleted :
+	    !fdt_get_property(batch->blob, nodeoffset, name, NULL))
+		return -FDT_ERR_NOTFOUND;
+	if (!prop) {
+		ret = fdt_batch_lookup(batch, nodeoffset, name, true, &prop);
+		if (ret)
+			return ret;
+	}
+	free(prop->val);
+	prop->val = NULL;
+	prop->len = 0;
+	prop->deleted = true;
+	prop->moved = false;
+
+	return 0;
+}
+
+const void *fdt_batch_getprop(struct fdt_batch *batch, int nodeoffset,
+			      const char *name, int *lenp)
+{
+	struct fdt_batch_prop *prop;
+	int ret;
+
+	ret = fdt_batch_lookup(batch, nodeoffset, name, false, &prop);
+	if (ret || !prop)
+		return fdt_getprop(batch->blob, nodeoffset, name, lenp);
+	if (prop->deleted) {
+		if (lenp)
+			*lenp = -FDT_ERR_NOTFOUND;
+		return NULL;
+	}
+	if (lenp)
+		*lenp = prop->len;
+
+	/* An empty property still needs a non-NULL value */
+	return prop->val ? prop->val : prop->name;
+}
+
+void fdt_batch_abort(struct fdt_batch *batch)
+{
+	struct fdt_batch_prop *prop;
+
+	for (prop = batch->props; prop < batch->props + batch->count; prop++) {
+		free(prop->path);
+		free(prop->val);
+	}
+	free(batch->props);
+	free(batch->hash);
+	if (batch->walk) {
+		free(batch->walk->pathlen);
+		free(batch->walk->path);
+		free(batch->walk);
+	}
+	batch->props = NULL;
+	batch->hash = NULL;
+	batch->walk = NULL;
+	batch->count = 0;
+	batch->size = 0;
+	if (fdt_batch_current == batch)
+		fdt_batch_current = NULL;
+}
+
+static int fdt_batch_compare(const void *a, const void *b)
+{
+	const struct fdt_batch_prop *pa = a, *pb = b;
+	int ret;
+
+	ret = strcmp(pa->path, pb->path);
+
+	return ret ? ret : pa->seq - pb->seq;
+}
+
+static int fdt_batch_put(struct fdt_batch_out *out, const void *data, int len)
+{
+	if (out->len + len > out->size)
+		return -FDT_ERR_NOSPACE;
+	memcpy(out->buf + out->len, data, len);
+	out->len += len;
+
+	return 0;
+}
+
+static int fdt_batch_put_prop(struct fdt_batch_out *out, int nameoff,
+			      const void *val, int len)
+{
+	struct fdt_property hdr;
+	int ret, pad;
+
+	hdr.tag = cpu_to_fdt32(FDT_PROP);
+	hdr.len = cpu_to_fdt32(len);
+	hdr.nameoff = cpu_to_fdt32(nameoff);
+	ret = fdt_batch_put(out, &hdr, sizeof(hdr));
+	if (!ret)
+		ret = fdt_batch_put(out, val, len);
+	pad = ALIGN(len, FDT_TAGSIZE) - len;
+	if (!ret && pad)
+		ret = fdt_batch_put(out, "\0\0\0", pad);
+
+	return ret;
+}
+
+/**
+ * fdt_batch_nameoff() - Get the string offset to use for a property name
+ *
+ * This looks in the existing strings and those already added, and adds the
+ * name to @strs if it is not there.
+ *
+ * @blob: Tree being written
+ * @strs: Strings added to the end of the strings block
+ * @name: Name to look up
+ * @return offset of the name in the new strings block
+ */
+static int fdt_batch_nameoff(const void *blob, struct fdt_batch_out *strs,
+			     const char *name)
+{
+	const char *tab = blob + fdt_off_dt_strings(blob);
+	int size = fdt_size_dt_strings(blob);
+	int len = strlen(name) + 1;
+	const char *p;
+
+	for (p = tab; p < tab + size; p += strlen(p) + 1) {
+		if (!strcmp(p, name))
+			return p - tab;
+	}
+	for (p = strs->buf; p < (char *)strs->buf + strs->len;
+	     p += strlen(p) + 1) {
+		if (!strcmp(p, name))
+			return size + p - (char *)strs->buf;
+	}
+	memcpy(strs->buf + strs->len, name, len);
+	strs->len += len;
+
+	return size + strs->len - len;
+}
+
+/* Handle the start of a node, writing any properties added to it */
+static int fdt_batch_node(struct fdt_batch *batch, int node, const char *path,
+			  struct fdt_batch_out *out, struct fdt_batch_out *strs,
+			  struct fdt_batch_prop **firstp,
+			  struct fdt_batch_prop **endp)
+{
+	struct fdt_batch_prop *first, *end, *prop;
+	const void *blob = batch->blob;
+	int low, high, mid, ret;
+
+	/* Find the changes to this node */
+	low = 0;
+	high = batch->count;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (strcmp(batch->props[mid].path, path) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	first = &batch->props[low];
+	for (end = first; end < batch->props + batch->count &&
+	     !strcmp(end->path, path); end++)
+		end->present = fdt_get_property(blob, node, end->name,
+						NULL) != NULL;
+	*firstp = first;
+	*endp = end;
+
+	/* Like fdt_setprop(), put the newest new property first */
+	for (prop = end - 1; prop >= first; prop--) {
+		if (prop->deleted || (prop->present && !prop->moved))
+			continue;
+		ret = fdt_batch_put_prop(out, fdt_batch_nameoff(blob, strs,
+								prop->name),
+					 prop->val, prop->len);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Write the new structure block, with new strings in @strs */
+static int fdt_batch_write(struct fdt_batch *batch, struct fdt_batch_out *out,
+			   struct fdt_batch_out *strs)
+{
+	struct fdt_batch_prop *first = NULL, *end = NULL, *prop;
+	struct fdt_batch_walk *walk = batch->walk;
+	const void *blob = batch->blob;
+	const struct fdt_property *fp;
+	int offset, ret, tag, len, nameoff;
+	const void *tagp;
+	const char *name;
+
+	/* Every change was recorded using the walk, so it has been set up */
+	fdt_batch_walk_start(blob, walk);
+	do {
+		tag = fdt_batch_walk_next(blob, walk, &offset);
+		if (tag < 0)
+			return tag;
+		tagp = blob + fdt_off_dt_struct(blob) + offset;
+		len = walk->offset - offset;
+		if (tag != FDT_PROP) {
+			ret = fdt_batch_put(out, tagp, len);
+			if (ret)
+				return ret;
+		}
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			ret = fdt_batch_node(batch, offset, walk->path, out,
+					     strs, &first, &end);
+			if (ret)
+				return ret;
+			break;
+		case FDT_PROP:
+			fp = tagp;
+			nameoff = fdt32_to_cpu(fp->nameoff);
+			name = fdt_string(blob, nameoff);
+			for (prop = first; prop < end; prop++) {
+				if (!strcmp(prop->name, name))
+					break;
+			}
+			if (prop == end)
+				ret = fdt_batch_put(out, fp, len);
+			else if (prop->deleted || prop->moved)
+				ret = 0;
+			else
+				ret = fdt_batch_put_prop(out, nameoff,
+							 prop->val, prop->len);
+			if (ret)
+				return ret;
+			break;
+		case FDT_END_NODE:
+			/* Properties come before subnodes, so no more here */
+			first = NULL;
+			end = NULL;
+			break;
+		}
+	} while (tag != FDT_END);
+
+	return 0;
+}
+
+int fdt_batch_commit(struct fdt_batch *batch)
+{
+	struct fdt_batch_out out = { }, strs = { };
+	void *blob = batch->blob;
+	struct fdt_batch_prop *prop;
+	int ret = 0, space, struct_off, strings_size;
+
+	if (!batch->count)
+		goto err;
+
+	/* Put the blocks in the usual order, with the free space at the end */
+	ret = fdt_open_into(blob, blob, fdt_totalsize(blob));
+	if (ret)
+		goto err;
+	struct_off = fdt_off_dt_struct(blob);
+	strings_size = fdt_size_dt_strings(blob);
+	space = fdt_totalsize(blob) - struct_off - strings_size;
+
+	qsort(batch->props, batch->count, sizeof(*batch->props),
+	      fdt_batch_compare);
+	for (prop = batch->props; prop < batch->props + batch->count; prop++)
+		strs.size += strlen(prop->name) + 1;
+	strs.buf = malloc(strs.size);
+	out.size = space;
+	out.buf = malloc(out.size);
+	if (!strs.buf || !out.buf) {
+		ret = -FDT_ERR_NOSPACE;
+		goto err;
+	}
+	ret = fdt_batch_write(batch, &out, &strs);
+	if (!ret && out.len + strs.len > space)
+		ret = -FDT_ERR_NOSPACE;
+	if (ret)
+		goto err;
+
+	/* Nothing has been changed so far, so now put the new blocks in */
+	memmove(blob + struct_off + out.len, blob + fdt_off_dt_strings(blob),
+		strings_size);
+	memcpy(blob + struct_off + out.len + strings_size, strs.buf,
+	       strs.len);
+	memcpy(blob + struct_off, out.buf, out.len);
+	fdt_set_size_dt_struct(blob, out.len);
+	fdt_set_off_dt_strings(blob, struct_off + out.len);
+	fdt_set_size_dt_strings(blob, strings_size + strs.len);
+	debug("%s: %d changes, structure block now %x bytes\n", __func__,
+	      batch->count, out.len);
+err:
+	free(out.buf);
+	free(strs.buf);
+	fdt_batch_abort(batch);
+
+	return ret;
+}
@@ -0,0 +1,768 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Applying a stack of device-tree overlays to one base tree
+ *
+ * This follows the steps of fdt_overlay_apply() in libfdt, but looks up
+ * phandles and symbols in the base tree in tables built once, rather than
+ * scanning the tree each time.
+ */
+
+#include <common.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
+
+/* Space to allocate for a node path at first */
+#define FDT_OVERLAY_PATH_SIZE	256
+
+/* Do not use a table indexed by phandle if it would be mostly empty */
+#define FDT_OVERLAY_MAX_SPARSE	4
+
+/**
+ * struct fdt_overlay_entry - A node with a phandle, or a symbol
+ *
+ * @name: Path of the node, or name of the symbol
+ * @path: Path which the symbol refers to, NULL for a node (in the same
+ *	allocation as @name)
+ * @phandle: phandle of the node, 0 for a symbol
+ */
+struct fdt_overlay_entry {
+	char *name;
+	char *path;
+	u32 phandle;
+};
+
+/**
+ * struct fdt_overlay_table - Entries which can be looked up by name
+ *
+ * @entries: Entries
+ * @count: Number of entries
+ * @size: Number of entries allocated
+ * @hash: Hash table with twice @size slots, each holding the index in
+ *	@entries plus one, or 0 if empty
+ */
+struct fdt_overlay_table {
+	struct fdt_overlay_entry *entries;
+	int count;
+	int size;
+	int *hash;
+};
+
+/**
+ * struct fdt_overlay_stack - What is known about the base tree
+ *
+ * @max_phandle: Highest phandle in the tree
+ * @has_symbols: true if the tree has a /__symbols__ node
+ * @nodes: Each node with a phandle, by path
+ * @symbols: Each property in /__symbols__, by name
+ * @phandles: Index in @nodes of the node with each phandle plus one, or 0 if
+ *	none. NULL if the phandles are too spread out for this to be useful
+ * @phandle_count: Number of entries in @phandles
+ * @path: Path of the node being recorded by fdt_overlay_add_nodes()
+ * @path_size: Number of bytes allocated for @path
+ * @pathlen: Length of the path of each node above it, and its own
+ * @max_depth: Number of entries allocated for @pathlen
+ * @target: Path of a fragment's target, if looked up with fdt_get_path()
+ * @target_size: Number of bytes allocated for @target
+ */
+struct fdt_overlay_stack {
+	u32 max_phandle;
+	bool has_symbols;
+	struct fdt_overlay_table nodes;
+	struct fdt_overlay_table symbols;
+	int *phandles;
+	uint phandle_count;
+	char *path;
+	int path_size;
+	int *pathlen;
+	int max_depth;
+	char *target;
+	int target_size;
+};
+
+static uint fdt_overlay_hash(const char *name)
+{
+	uint hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + *name++;
+
+	return hash;
+}
+
+/**
+ * fdt_overlay_find() - Find an entry in a table
+ *
+ * @tab: Table to search
+ * @name: Name to look for
+ * @slotp: Returns the hash-table slot holding the entry, or the empty slot
+ *	where it would go (may be NULL)
+ * @return the entry, or NULL if none
+ */
+static struct fdt_overlay_entry *fdt_overlay_find(struct fdt_overlay_table *tab,
+						  const char *name,
+						  int **slotp)
+{
+	struct fdt_overlay_entry *entry;
+	uint mask = tab->size * 2 - 1;
+	uint i;
+
+	if (!tab->hash)
+		return NULL;
+
+	/* The table always has empty slots, so this stops */
+	for (i = fdt_overlay_hash(name) & mask; tab->hash[i];
+	     i = (i + 1) & mask) {
+		entry = &tab->entries[tab->hash[i] - 1];
+		if (!strcmp(entry->name, name))
+			break;
+	}
+	if (slotp)
+		*slotp = &tab->hash[i];
+
+	return tab->hash[i] ? &tab->entries[tab->hash[i] - 1] : NULL;
+}
+
+/* Make room for more entries, with a new hash table to find them */
+static int fdt_overlay_grow(struct fdt_overlay_table *tab)
+{
+	struct fdt_overlay_entry *entries;
+	int size, i, *hash, *slot;
+
+	size = tab->size ? tab->size * 2 : 64;
+	hash = calloc(size * 2, sizeof(int));
+	if (!hash)
+		return -FDT_ERR_NOSPACE;
+	entries = realloc(tab->entries, size * sizeof(*entries));
+	if (!entries) {
+		free(hash);
+		return -FDT_ERR_NOSPACE;
+	}
+	free(tab->hash);
+	tab->entries = entries;
+	tab->hash = hash;
+	tab->size = size;
+	for (i = 0; i < tab->count; i++) {
+		fdt_overlay_find(tab, entries[i].name, &slot);
+		*slot = i + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * fdt_overlay_add() - Add an entry to a table, or update an existing one
+ *
+ * @tab: Table to update
+ * @name: Name of the entry
+ * @path: Path for a symbol, or NULL for a node
+ * @path_len: Length of @path, not including any nul terminator
+ * @phandle: phandle for a node, or 0 for a symbol
+ * @return index of the entry, or -FDT_ERR_NOSPACE if out of memory
+ */
+static int fdt_overlay_add(struct fdt_overlay_table *tab, const char *name,
+			   const char *path, int path_len, u32 phandle)
+{
+	struct fdt_overlay_entry *entry;
+	int len, ret, *slot;
+	char *buf;
+
+	len = strlen(name) + 1;
+	buf = malloc(len + (path ? path_len + 1 : 0));
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+
+	entry = fdt_overlay_find(tab, name, &slot);
+	if (!entry) {
+		if (tab->count == tab->size) {
+			ret = fdt_overlay_grow(tab);
+			if (ret) {
+				free(buf);
+				return ret;
+			}
+			fdt_overlay_find(tab, name, &slot);
+		}
+		entry = &tab->entries[tab->count];
+		*slot = ++tab->count;
+	} else {
+		free(entry->name);
+	}
+	entry->name = strcpy(buf, name);
+	entry->path = NULL;
+	if (path) {
+		entry->path = memcpy(buf + len, path, path_len);
+		entry->path[path_len] = '\0';
+	}
+	entry->phandle = phandle;
+
+	return entry - tab->entries;
+}
+
+static void fdt_overlay_free_table(struct fdt_overlay_table *tab)
+{
+	int i;
+
+	for (i = 0; i < tab->count; i++)
+		free(tab->entries[i].name);
+	free(tab->entries);
+	free(tab->hash);
+}
+
+/* Record that a node has a phandle */
+static int fdt_overlay_add_phandle(struct fdt_overlay_stack *stack,
+				   const char *path, u32 phandle)
+{
+	uint count;
+	int index, *phandles;
+
+	index = fdt_overlay_add(&stack->nodes, path, NULL, 0, phandle);
+	if (index < 0)
+		return index;
+	stack->max_phandle = max(stack->max_phandle, phandle);
+	if (!stack->phandles)
+		return 0;
+
+	if (phandle >= stack->phandle_count) {
+		count = max(phandle + 1, stack->phandle_count * 2);
+
+		/* Fall back to scanning the tree if most would be empty */
+		if (count > stack->nodes.count * FDT_OVERLAY_MAX_SPARSE + 64) {
+			free(stack->phandles);
+			stack->phandles = NULL;
+			return 0;
+		}
+		phandles = realloc(stack->phandles, count * sizeof(int));
+		if (!phandles)
+			return -FDT_ERR_NOSPACE;
+		memset(phandles + stack->phandle_count, '\0',
+		       (count - stack->phandle_count) * sizeof(int));
+		stack->phandles = phandles;
+		stack->phandle_count = count;
+	}
+	stack->phandles[phandle] = index + 1;
+
+	return 0;
+}
+
+/* Returns the recorded node with a phandle, or NULL if not known */
+static struct fdt_overlay_entry *
+fdt_overlay_by_phandle(struct fdt_overlay_stack *stack, u32 phandle)
+{
+	struct fdt_overlay_entry *entry;
+
+	if (!stack->phandles || phandle >= stack->phandle_count ||
+	    !stack->phandles[phandle])
+		return NULL;
+	entry = &stack->nodes.entries[stack->phandles[phandle] - 1];
+
+	/* The node's phandle may since have been changed by an overlay */
+	return entry->phandle == phandle ? entry : NULL;
+}
+
+/* Make room in @stack for a path @depth nodes deep, and @size bytes long */
+static int fdt_overlay_path_grow(struct fdt_overlay_stack *stack, int depth,
+				 int size)
+{
+	void *ptr;
+
+	if (depth > stack->max_depth) {
+		ptr = realloc(stack->pathlen, depth * 2 * sizeof(int));
+		if (!ptr)
+			return -FDT_ERR_NOSPACE;
+		stack->pathlen = ptr;
+		stack->max_depth = depth * 2;
+	}
+	if (size > stack->path_size) {
+		size = max(size, max(stack->path_size * 2,
+				     FDT_OVERLAY_PATH_SIZE));
+		ptr = realloc(stack->path, size);
+		if (!ptr)
+			return -FDT_ERR_NOSPACE;
+		stack->path = ptr;
+		stack->path_size = size;
+	}
+
+	return 0;
+}
+
+/**
+ * fdt_overlay_get_path() - Get the path of a node, however long it is
+ *
+ * @stack: Stack to hold the path
+ * @fdt: Tree holding the node
+ * @node: Offset of the node
+ * @pathp: Returns the path, in @stack->target until the next call
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int fdt_overlay_get_path(struct fdt_overlay_stack *stack,
+				const void *fdt, int node, const char **pathp)
+{
+	int ret, size;
+	char *ptr;
+
+	for (;;) {
+		ret = stack->target ? fdt_get_path(fdt, node, stack->target,
+						   stack->target_size) :
+			-FDT_ERR_NOSPACE;
+		if (ret != -FDT_ERR_NOSPACE)
+			break;
+		size = max(stack->target_size * 2, FDT_OVERLAY_PATH_SIZE);
+		ptr = realloc(stack->target, size);
+		if (!ptr)
+			return -FDT_ERR_NOSPACE;
+		stack->target = ptr;
+		stack->target_size = size;
+	}
+	if (ret)
+		return ret;
+	*pathp = stack->target;
+
+	return 0;
+}
+
+/**
+ * fdt_overlay_add_nodes() - Record the nodes with a phandle in a subtree
+ *
+ * @stack: Stack to update
+ * @blob: Tree holding the nodes
+ * @start: Offset of the subtree
+ * @prefix: Path which the subtree has (or will have) in the base tree. This
+ *	must not be @stack->path
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int fdt_overlay_add_nodes(struct fdt_overlay_stack *stack,
+				 const void *blob, int start,
+				 const char *prefix)
+{
+	int node, depth, len, pos, ret;
+	const char *name;
+	u32 phandle;
+
+	len = strlen(prefix);
+	ret = fdt_overlay_path_grow(stack, 1, len + 1);
+	if (ret)
+		return ret;
+	strcpy(stack->path, prefix);
+	stack->pathlen[0] = len;
+	for (node = start, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(blob, node, &depth)) {
+		if (depth) {
+			name = fdt_get_name(blob, node, &len);
+			if (!name)
+				return len;
+			pos = stack->pathlen[depth - 1];
+			ret = fdt_overlay_path_grow(stack, depth + 1,
+						    pos + len + 2);
+			if (ret)
+				return ret;
+
+			/* Only the root node's path ends in '/' */
+			if (pos != 1)
+				stack->path[pos++] = '/';
+			memcpy(stack->path + pos, name, len + 1);
+			stack->pathlen[depth] = pos + len;
+		}
+
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle && phandle != (u32)-1) {
+			ret = fdt_overlay_add_phandle(stack, stack->path,
+						      phandle);
+			if (ret)
+				return ret;
+		}
+	}
+	if (node < 0 && node != -FDT_ERR_NOTFOUND)
+		return node;
+
+	return 0;
+}
+
+struct fdt_overlay_stack *fdt_overlay_stack_create(const void *fdt)
+{
+	struct fdt_overlay_stack *stack;
+	const char *path, *name;
+	int symbols, prop, len;
+
+	if (fdt_check_header(fdt))
+		return NULL;
+	stack = calloc(1, sizeof(*stack));
+	if (!stack)
+		return NULL;
+
+	/* The phandle table grows as nodes are added */
+	stack->phandles = calloc(1, sizeof(int));
+	stack->phandle_count = 1;
+	if (!stack->phandles || fdt_overlay_add_nodes(stack, fdt, 0, "/"))
+		goto err;
+
+	symbols = fdt_subnode_offset(fdt, 0, "__symbols__");
+	stack->has_symbols = symbols >= 0;
+	fdt_for_each_property_offset(prop, fdt, symbols) {
+		path = fdt_getprop_by_offset(fdt, prop, &name, &len);
+		if (!path)
+			goto err;
+		len = strnlen(path, len);
+		if (fdt_overlay_add(&stack->symbols, name, path, len, 0) < 0)
+			goto err;
+	}
+	debug("%s: %d nodes with phandles (max %u), %d symbols\n", __func__,
+	      stack->nodes.count, stack->max_phandle, stack->symbols.count);
+
+	return stack;
+err:
+	fdt_overlay_stack_free(stack);
+
+	return NULL;
+}
+
+void fdt_overlay_stack_free(struct fdt_overlay_stack *stack)
+{
+	if (!stack)
+		return;
+	fdt_overlay_free_table(&stack->nodes);
+	fdt_overlay_free_table(&stack->symbols);
+	free(stack->phandles);
+	free(stack->path);
+	free(stack->pathlen);
+	free(stack->target);
+	free(stack);
+}
+
+/* Find the phandle of the node a symbol refers to */
+static int fdt_overlay_symbol_phandle(struct fdt_overlay_stack *stack,
+				      const void *fdt, const char *label,
+				      u32 *phandlep)
+{
+	struct fdt_overlay_entry *symbol, *node;
+	int offset;
+
+	symbol = fdt_overlay_find(&stack->symbols, label, NULL);
+	if (!symbol)
+		return -FDT_ERR_NOTFOUND;
+	node = fdt_overlay_find(&stack->nodes, symbol->path, NULL);
+	if (node) {
+		*phandlep = node->phandle;
+		return 0;
+	}
+
+	/* Perhaps an alias or an abbreviated path, so look it up */
+	offset = fdt_path_offset(fdt, symbol->path);
+	if (offset < 0)
+		return offset;
+	*phandlep = fdt_get_phandle(fdt, offset);
+
+	return *phandlep ? 0 : -FDT_ERR_NOTFOUND;
+}
+
+/**
+ * fdt_overlay_fixup_phandle() - Point an overlay's references at a base node
+ *
+ * This handles one property in /__fixups__, like overlay_fixup_phandle()
+ *
+ * @stack: Stack for the base tree
+ * @fdt: Base tree
+ * @fdto: Overlay
+ * @property: Offset of the property in /__fixups__
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int fdt_overlay_fixup_phandle(struct fdt_overlay_stack *stack,
+				     const void *fdt, void *fdto, int property)
+{
+	const char *value, *label, *path, *name, *fixup_end;
+	char *sep, *endptr;
+	int len, fixup_len, path_len, name_len, poffset, node, ret;
+	fdt32_t phandle_prop;
+	u32 phandle = 0;
+
+	value = fdt_getprop_by_offset(fdto, property, &label, &len);
+	if (!value)
+		return len == -FDT_ERR_NOTFOUND ? -FDT_ERR_INTERNAL : len;
+
+	/* Each fixup is "<path>:<property>:<offset>" */
+	do {
+		fixup_end = memchr(value, '\0', len);
+		if (!fixup_end)
+			return -FDT_ERR_BADOVERLAY;
+		path = value;
+		fixup_len = fixup_end - path;
+		len -= fixup_len + 1;
+		value += fixup_len + 1;
+
+		sep = memchr(path, ':', fixup_len);
+		if (!sep)
+			return -FDT_ERR_BADOVERLAY;
+		path_len = sep - path;
+		if (path_len == fixup_len - 1)
+			return -FDT_ERR_BADOVERLAY;
+		fixup_len -= path_len + 1;
+		name = sep + 1;
+		sep = memchr(name, ':', fixup_len);
+		if (!sep)
+			return -FDT_ERR_BADOVERLAY;
+		name_len = sep - name;
+		if (!name_len)
+			return -FDT_ERR_BADOVERLAY;
+		poffset = simple_strtoul(sep + 1, &endptr, 10);
+		if (*endptr || endptr <= sep + 1)
+			return -FDT_ERR_BADOVERLAY;
+
+		if (!phandle) {
+			ret = fdt_overlay_symbol_phandle(stack, fdt, label,
+							 &phandle);
+			if (ret)
+				return ret;
+		}
+		node = fdt_path_offset_namelen(fdto, path, path_len);
+		if (node == -FDT_ERR_NOTFOUND)
+			return -FDT_ERR_BADOVERLAY;
+		if (node < 0)
+			return node;
+		phandle_prop = cpu_to_fdt32(phandle);
+		ret = fdt_setprop_inplace_namelen_partial(fdto, node, name,
+							  name_len, poffset,
+							  &phandle_prop,
+							  sizeof(phandle_prop));
+		if (ret)
+			return ret;
+	} while (len > 0);
+
+	return 0;
+}
+
+static int fdt_overlay_fixup_phandles(struct fdt_overlay_stack *stack,
+				      const void *fdt, void *fdto)
+{
+	int fixups, property, ret;
+
+	fixups = fdt_subnode_offset(fdto, 0, "__fixups__");
+	if (fixups == -FDT_ERR_NOTFOUND)
+		return 0;
+	if (fixups < 0)
+		return fixups;
+
+	fdt_for_each_property_offset(property, fdto, fixups) {
+		ret = fdt_overlay_fixup_phandle(stack, fdt, fdto, property);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * fdt_overlay_target() - Find the node which a fragment applies to
+ *
+ * @stack: Stack for the base tree
+ * @fdt: Base tree
+ * @fdto: Overlay
+ * @fragment: Offset of fragment in the overlay
+ * @pathp: Returns the path of the node. If the fragment has a target-path
+ *	this is that, which may be an alias. This may be in @stack->target
+ * @return offset of the node, or -FDT_ERR_... on error
+ */
+static int fdt_overlay_target(struct fdt_overlay_stack *stack,
+			      const void *fdt, const void *fdto, int fragment,
+			      const char **pathp)
+{
+	struct fdt_overlay_entry *entry;
+	const fdt32_t *val;
+	int node, len, ret;
+	u32 phandle = 0;
+
+	val = fdt_getprop(fdto, fragment, "target", &len);
+	if (val) {
+		phandle = fdt32_to_cpu(*val);
+		if (len != sizeof(*val) || phandle == (u32)-1)
+			return -FDT_ERR_BADPHANDLE;
+	}
+	if (!phandle) {
+		*pathp = fdt_getprop(fdto, fragment, "target-path", &len);
+		if (!*pathp)
+			return len == -FDT_ERR_NOTFOUND ?
+				-FDT_ERR_BADOVERLAY : len;
+
+		return fdt_path_offset(fdt, *pathp);
+	}
+
+	entry = fdt_overlay_by_phandle(stack, phandle);
+	if (entry) {
+		node = fdt_path_offset(fdt, entry->name);
+		if (node >= 0 && fdt_get_phandle(fdt, node) == phandle) {
+			*pathp = entry->name;
+			return node;
+		}
+	}
+
+	/* Not recorded, so do what fdt_overlay_apply() does */
+	node = fdt_node_offset_by_phandle(fdt, phandle);
+	if (node < 0)
+		return node;
+	ret = fdt_overlay_get_path(stack, fdt, node, pathp);
+
+	return ret ? ret : node;
+}
+
+/* Merge each fragment and record the phandles which it adds */
+static int fdt_overlay_merge(struct fdt_overlay_stack *stack, void *fdt,
+			     void *fdto)
+{
+	int fragment, overlay, target, ret;
+	const char *path;
+
+	fdt_for_each_subnode(fragment, fdto, 0) {
+		overlay = fdt_subnode_offset(fdto, fragment, "__overlay__");
+		if (overlay == -FDT_ERR_NOTFOUND)
+			continue;
+		if (overlay < 0)
+			return overlay;
+
+		target = fdt_overlay_target(stack, fdt, fdto, fragment, &path);
+		if (target < 0)
+			return target;
+		ret = fdt_overlay_merge_node(fdt, target, fdto, overlay);
+		if (ret)
+			return ret;
+
+		/* A target-path may be an alias, so use the real path */
+		if (*path != '/') {
+			ret = fdt_overlay_get_path(stack, fdt, target, &path);
+			if (ret)
+				return ret;
+		}
+		ret = fdt_overlay_add_nodes(stack, fdto, overlay, path);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * fdt_overlay_update_symbols() - Add an overlay's symbols to the base tree
+ *
+ * This does the same as overlay_symbol_update(), and records the symbols
+ *
+ * @stack: Stack for the base tree
+ * @fdt: Base tree
+ * @fdto: Overlay
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+static int fdt_overlay_update_symbols(struct fdt_overlay_stack *stack,
+				      void *fdt, const void *fdto)
+{
+	int root_sym, ov_sym, prop, fragment, len, rel_len, size, ret;
+	const char *path, *name, *end, *sep, *rel, *target;
+	char *val;
+
+	ov_sym = fdt_subnode_offset(fdto, 0, "__symbols__");
+	if (ov_sym < 0)
+		return 0;
+
+	root_sym = fdt_subnode_offset(fdt, 0, "__symbols__");
+	if (root_sym == -FDT_ERR_NOTFOUND)
+		root_sym = fdt_add_subnode(fdt, 0, "__symbols__");
+	if (root_sym < 0)
+		return root_sym;
+	stack->has_symbols = true;
+
+	fdt_for_each_property_offset(prop, fdto, ov_sym) {
+		path = fdt_getprop_by_offset(fdto, prop, &name, &len);
+		if (!path)
+			return len;
+		if (len < 1 || memchr(path, '\0', len) != &path[len - 1])
+			return -FDT_ERR_BADVALUE;
+		if (*path != '/')
+			return -FDT_ERR_BADVALUE;
+		end = path + len;
+
+		/* Only /<fragment>/__overlay__[/<path>] ends up in the tree */
+		sep = strchr(path + 1, '/');
+		if (!sep)
+			continue;
+		len = sizeof("/__overlay__/") - 1;
+		if (end - sep > len && !memcmp(sep, "/__overlay__/", len)) {
+			rel = sep + len;
+			rel_len = end - rel;
+		} else if (end - sep == len &&
+			   !memcmp(sep, "/__overlay__", len - 1)) {
+			rel = "";
+			rel_len = 0;
+		} else {
+			continue;
+		}
+
+		fragment = fdt_subnode_offset_namelen(fdto, 0, path + 1,
+						      sep - path - 1);
+		if (fragment < 0)
+			return -FDT_ERR_BADOVERLAY;
+		if (fdt_subnode_offset(fdto, fragment, "__overlay__") < 0)
+			return -FDT_ERR_BADOVERLAY;
+		ret = fdt_overlay_target(stack, fdt, fdto, fragment, &target);
+		if (ret < 0)
+			return ret;
+
+		/*
+		 * <target>/<rel>, with the same length as libfdt uses, which
+		 * leaves a second nul at the end if @rel_len includes one
+		 */
+		len = strlen(target);
+		size = len + (len > 1) + rel_len + 1;
+		ret = fdt_setprop_placeholder(fdt, root_sym, name, size,
+					      (void **)&val);
+		if (ret)
+			return ret;
+		if (len > 1)
+			memcpy(val, target, len);
+		else
+			len = 0;
+		val[len] = '/';
+		memcpy(val + len + 1, rel, rel_len);
+		val[len + 1 + rel_len] = '\0';
+
+		ret = fdt_overlay_add(&stack->symbols, name, val,
+				      strlen(val), 0);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int fdt_overlay_stack_apply(struct fdt_overlay_stack *stack, void *fdt,
+			    void *fdto)
+{
+	int ret;
+
+	if (!stack)
+		return fdt_overlay_apply_verbose(fdt, fdto);
+
+	ret = fdt_check_header(fdt);
+	if (!ret)
+		ret = fdt_check_header(fdto);
+	if (ret)
+		goto err;
+
+	ret = fdt_overlay_adjust_phandles(fdto, stack->max_phandle);
+	if (!ret)
+		ret = fdt_overlay_fixup_phandles(stack, fdt, fdto);
+	if (!ret)
+		ret = fdt_overlay_merge(stack, fdt, fdto);
+	if (!ret)
+		ret = fdt_overlay_update_symbols(stack, fdt, fdto);
+
+	/* As with fdt_overlay_apply(), the overlay is damaged either way */
+	fdt_set_magic(fdto, ~0);
+	if (ret)
+		fdt_set_magic(fdt, ~0);
+err:
+	if (ret) {
+		printf("failed on fdt_overlay_apply(): %s\n",
+		       fdt_strerror(ret));
+		if (!stack->has_symbols) {
+			printf("base fdt does did not have a /__symbols__ node\n");
+			printf("make sure you've compiled with -@\n");
+		}
+	}
+
+	return ret;
+}
@@ -72,6 +72,33 @@ u32 fdt_getprop_u32_default(const void *fdt, const char *path,
 	return fdt_getprop_u32_default_node(fdt, off, 0, prop, dflt);
 }
 
+/*
+ * Set a property, or record the change if fixups to @fdt are being batched.
+ * See fdt_batch_begin().
+ */
+static int fdt_fixup_setprop(void *fdt, int nodeoffset, const char *name,
+			     const void *val, int len)
+{
+	struct fdt_batch *batch = fdt_batch_active(fdt);
+
+	if (batch)
+		return fdt_batch_setprop(batch, nodeoffset, name, val, len);
+
+	return fdt_setprop(fdt, nodeoffset, name, val, len);
+}
+
+/* Check whether a node has a property, including any batched change */
+static bool fdt_fixup_hasprop(const void *fdt, int nodeoffset,
+			      const char *name)
+{
+	struct fdt_batch *batch = fdt_batch_active(fdt);
+
+	if (batch)
+		return fdt_batch_getprop(batch, nodeoffset, name, NULL);
+
+	return fdt_get_property(fdt, nodeoffset, name, NULL);
+}
+
 /**
  * fdt_find_and_setprop: Find a node and set it's property
  *
@@ -92,10 +119,10 @@ int fdt_find_and_setprop(void *fdt, const char *node, const char *prop,
 	if (nodeoff < 0)
 		return nodeoff;
 
-	if ((!create) && (fdt_get_property(fdt, nodeoff, prop, NULL) == NULL))
+	if (!create && !fdt_fixup_hasprop(fdt, nodeoff, prop))
 		return 0; /* create flag not set; so exit quietly */
 
-	return fdt_setprop(fdt, nodeoff, prop, val, len);
+	return fdt_fixup_setprop(fdt, nodeoff, prop, val, len);
 }
 
 /**
@@ -127,8 +154,8 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 #if defined(OF_STDOUT_PATH)
 static int fdt_fixup_stdout(void *fdt, int chosenoff)
 {
-	return fdt_setprop(fdt, chosenoff, "linux,stdout-path",
-			      OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
+	return fdt_fixup_setprop(fdt, chosenoff, "linux,stdout-path",
+				 OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
 }
 #elif defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
 static int fdt_fixup_stdout(void *fdt, int chosenoff)
@@ -157,7 +184,7 @@ static int fdt_fixup_stdout(void *fdt, int chosenoff)
 	/* fdt_setprop may break "path" so we copy it to tmp buffer */
 	memcpy(tmp, path, len);
 
-	err = fdt_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
+	err = fdt_fixup_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
 	if (err < 0)
 		printf("WARNING: could not set linux,stdout-path %s.\n",
 		       fdt_strerror(err));
@@ -199,8 +226,8 @@ int fdt_root(void *fdt)
 
 	serial = env_get("serial#");
 	if (serial) {
-		err = fdt_setprop(fdt, 0, "serial-number", serial,
-				  strlen(serial) + 1);
+		err = fdt_fixup_setprop(fdt, 0, "serial-number", serial,
+					strlen(serial) + 1);
 
 		if (err < 0) {
 			printf("WARNING: could not set serial-number %s.\n",
@@ -291,8 +318,8 @@ int fdt_chosen(void *fdt)
 
 	str = env_get("bootargs");
 	if (str) {
-		err = fdt_setprop(fdt, nodeoffset, "bootargs", str,
-				  strlen(str) + 1);
+		err = fdt_fixup_setprop(fdt, nodeoffset, "bootargs", str,
+					strlen(str) + 1);
 		if (err < 0) {
 			printf("WARNING: could not set bootargs %s.\n",
 			       fdt_strerror(err));
@@ -341,8 +368,8 @@ void do_fixup_by_prop(void *fdt,
 #endif
 	off = fdt_node_offset_by_prop_value(fdt, -1, pname, pval, plen);
 	while (off != -FDT_ERR_NOTFOUND) {
-		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+		if (create || fdt_fixup_hasprop(fdt, off, prop))
+			fdt_fixup_setprop(fdt, off, prop, val, len);
 		off = fdt_node_offset_by_prop_value(fdt, off, pname, pval, plen);
 	}
 }
@@ -368,8 +395,8 @@ void do_fixup_by_compat(void *fdt, const char *compat,
 #endif
 	off = fdt_node_offset_by_compatible(fdt, -1, compat);
 	while (off != -FDT_ERR_NOTFOUND) {
-		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+		if (create || fdt_fixup_hasprop(fdt, off, prop))
+			fdt_fixup_setprop(fdt, off, prop, val, len);
 		off = fdt_node_offset_by_compatible(fdt, off, compat);
 	}
 }
@@ -439,8 +466,8 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 	if (nodeoffset < 0)
 			return nodeoffset;
 
-	err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
-			sizeof("memory"));
+	err = fdt_fixup_setprop(blob, nodeoffset, "device_type", "memory",
+				sizeof("memory"));
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n", "device_type",
 				fdt_strerror(err));
@@ -459,7 +486,7 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 
 	len = fdt_pack_reg(blob, tmp, start, size, banks);
 
-	err = fdt_setprop(blob, nodeoffset, "reg", tmp, len);
+	err = fdt_fixup_setprop(blob, nodeoffset, "reg", tmp, len);
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n",
 				"reg", fdt_strerror(err));
@@ -1425,32 +1452,30 @@ int fdt_set_node_status(void *fdt, int nodeoffset,
 			enum fdt_status status, unsigned int error_code)
 {
 	char buf[16];
-	int ret = 0;
 
 	if (nodeoffset < 0)
 		return nodeoffset;
 
 	switch (status) {
 	case FDT_STATUS_OKAY:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "okay");
+		strcpy(buf, "okay");
 		break;
 	case FDT_STATUS_DISABLED:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "disabled");
+		strcpy(buf, "disabled");
 		break;
 	case FDT_STATUS_FAIL:
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", "fail");
+		strcpy(buf, "fail");
 		break;
 	case FDT_STATUS_FAIL_ERROR_CODE:
 		sprintf(buf, "fail-%d", error_code);
-		ret = fdt_setprop_string(fdt, nodeoffset, "status", buf);
 		break;
 	default:
 		printf("Invalid fdt status: %x\n", status);
-		ret = -1;
-		break;
+		return -1;
 	}
 
-	return ret;
+	return fdt_fixup_setprop(fdt, nodeoffset, "status", buf,
+				 strlen(buf) + 1);
 }
 
 /*
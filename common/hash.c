@@ -12,11 +12,13 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <command.h>
+#include <cpu_func.h>
 #include <env.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <hw_sha.h>
 #include <asm/io.h>
+#include <div64.h>
 #include <linux/errno.h>
 #include <u-boot/crc.h>
 #else
@@ -26,6 +28,7 @@
 #endif /* !USE_HOSTCC*/
 
 #include <hash.h>
+#include <watchdog.h>
 #include <u-boot/crc.h>
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
@@ -65,6 +68,23 @@ static int hash_finish_sha1(struct hash_algo *algo, void *ctx, void *dest_buf,
 }
 #endif
 
+#if defined(CONFIG_SHA1) && !defined(CONFIG_SHA_HW_ACCEL)
+static void hash_start_sha1(void *ctx)
+{
+	sha1_starts(ctx);
+}
+
+static void hash_chunk_sha1(void *ctx, const void *buf, unsigned int size)
+{
+	sha1_update(ctx, buf, size);
+}
+
+static void hash_end_sha1(void *ctx, void *dest_buf)
+{
+	sha1_finish(ctx, dest_buf);
+}
+#endif
+
 #if defined(CONFIG_SHA256) && !defined(CONFIG_SHA_PROG_HW_ACCEL)
 static int hash_init_sha256(struct hash_algo *algo, void **ctxp)
 {
@@ -93,6 +113,23 @@ static int hash_finish_sha256(struct hash_algo *algo, void *ctx, void
 }
 #endif
 
+#if defined(CONFIG_SHA256) && !defined(CONFIG_SHA_HW_ACCEL)
+static void hash_start_sha256(void *ctx)
+{
+	sha256_starts(ctx);
+}
+
+static void hash_chunk_sha256(void *ctx, const void *buf, unsigned int size)
+{
+	sha256_update(ctx, buf, size);
+}
+
+static void hash_end_sha256(void *ctx, void *dest_buf)
+{
+	sha256_finish(ctx, dest_buf);
+}
+#endif
+
 static int hash_init_crc16_ccitt(struct hash_algo *algo, void **ctxp)
 {
 	uint16_t *ctx = malloc(sizeof(uint16_t));
@@ -120,6 +157,27 @@ static int hash_finish_crc16_ccitt(struct hash_algo *algo, void *ctx,
 	return 0;
 }
 
+static void hash_start_crc16_ccitt(void *ctx)
+{
+	*(uint16_t *)ctx = 0;
+}
+
+static void hash_chunk_crc16_ccitt(void *ctx, const void *buf,
+				   unsigned int size)
+{
+	*(uint16_t *)ctx = crc16_ccitt(*(uint16_t *)ctx, buf, size);
+}
+
+/* This matches crc16_ccitt_wd_buf(), which is big-endian */
+static void hash_end_crc16_ccitt(void *ctx, void *dest_buf)
+{
+	uint16_t crc = *(uint16_t *)ctx;
+	uint8_t *dest = dest_buf;
+
+	dest[0] = crc >> 8;
+	dest[1] = crc;
+}
+
 static int hash_init_crc32(struct hash_algo *algo, void **ctxp)
 {
 	uint32_t *ctx = malloc(sizeof(uint32_t));
@@ -146,6 +204,40 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 	return 0;
 }
 
+static void hash_start_crc32(void *ctx)
+{
+	*(uint32_t *)ctx = 0;
+}
+
+static void hash_chunk_crc32(void *ctx, const void *buf, unsigned int size)
+{
+	*(uint32_t *)ctx = crc32(*(uint32_t *)ctx, buf, size);
+}
+
+/* This matches crc32_wd_buf(), which is big-endian */
+static void hash_end_crc32(void *ctx, void *dest_buf)
+{
+	uint32_t crc = *(uint32_t *)ctx;
+	uint8_t *dest = dest_buf;
+
+	dest[0] = crc >> 24;
+	dest[1] = crc >> 16;
+	dest[2] = crc >> 8;
+	dest[3] = crc;
+}
+
+/* Context for hash_chunked(), large enough for any algorithm */
+union hash_ctx {
+#ifdef CONFIG_SHA1
+	sha1_context sha1;
+#endif
+#ifdef CONFIG_SHA256
+	sha256_context sha256;
+#endif
+	uint16_t crc16;
+	uint32_t crc32;
+};
+
 /*
  * These are the hash algorithms we support.  If we have hardware acceleration
  * is enable we will use that, otherwise a software version of the algorithm.
@@ -170,6 +262,14 @@ static struct hash_algo hash_algo[] = {
 		.hash_init	= hash_init_sha1,
 		.hash_update	= hash_update_sha1,
 		.hash_finish	= hash_finish_sha1,
+#endif
+#ifndef CONFIG_SHA_HW_ACCEL
+		.hash_start	= hash_start_sha1,
+		.hash_chunk	= hash_chunk_sha1,
+		.hash_end	= hash_end_sha1,
+#endif
+#if !defined(USE_HOSTCC) && !defined(CONFIG_SHA_HW_ACCEL)
+		.select_backend	= sha1_select_backend,
 #endif
 	},
 #endif
@@ -191,6 +291,14 @@ static struct hash_algo hash_algo[] = {
 		.hash_init	= hash_init_sha256,
 		.hash_update	= hash_update_sha256,
 		.hash_finish	= hash_finish_sha256,
+#endif
+#ifndef CONFIG_SHA_HW_ACCEL
+		.hash_start	= hash_start_sha256,
+		.hash_chunk	= hash_chunk_sha256,
+		.hash_end	= hash_end_sha256,
+#endif
+#if !defined(USE_HOSTCC) && !defined(CONFIG_SHA_HW_ACCEL)
+		.select_backend	= sha256_select_backend,
 #endif
 	},
 #endif
@@ -202,6 +310,9 @@ static struct hash_algo hash_algo[] = {
 		.hash_init	= hash_init_crc16_ccitt,
 		.hash_update	= hash_update_crc16_ccitt,
 		.hash_finish	= hash_finish_crc16_ccitt,
+		.hash_start	= hash_start_crc16_ccitt,
+		.hash_chunk	= hash_chunk_crc16_ccitt,
+		.hash_end	= hash_end_crc16_ccitt,
 	},
 	{
 		.name		= "crc32",
@@ -211,6 +322,9 @@ static struct hash_algo hash_algo[] = {
 		.hash_init	= hash_init_crc32,
 		.hash_update	= hash_update_crc32,
 		.hash_finish	= hash_finish_crc32,
+		.hash_start	= hash_start_crc32,
+		.hash_chunk	= hash_chunk_crc32,
+		.hash_end	= hash_end_crc32,
 	},
 };
 
@@ -236,6 +350,13 @@ static void reloc_update(void)
 			hash_algo[i].hash_init += gd->reloc_off;
 			hash_algo[i].hash_update += gd->reloc_off;
 			hash_algo[i].hash_finish += gd->reloc_off;
+			if (hash_algo[i].hash_start) {
+				hash_algo[i].hash_start += gd->reloc_off;
+				hash_algo[i].hash_chunk += gd->reloc_off;
+				hash_algo[i].hash_end += gd->reloc_off;
+			}
+			if (hash_algo[i].select_backend)
+				hash_algo[i].select_backend += gd->reloc_off;
 		}
 	}
 #endif
@@ -278,6 +399,105 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	return -EPROTONOSUPPORT;
 }
 
+#ifdef CONFIG_HASH_CHUNK_SIZE
+#define HASH_CHUNK_SIZE		CONFIG_HASH_CHUNK_SIZE
+#else
+#define HASH_CHUNK_SIZE		0x40000
+#endif
+
+/* Amount of the next piece to prefetch, one cache line at a time */
+#define HASH_PREFETCH_SIZE	256
+#define HASH_PREFETCH_STRIDE	64
+
+/* Print a progress mark after hashing this many bytes */
+#define HASH_PROGRESS_SIZE	(256 << 20)
+
+/*
+ * Ask for the start of the next piece while the current one is hashed, so
+ * that the CPU does not stall when moving on to it. The data is only read
+ * once, so it need not stay in the cache.
+ */
+static void hash_prefetch(const uint8_t *buf, ulong len)
+{
+	ulong i;
+
+	for (i = 0; i < len; i += HASH_PREFETCH_STRIDE)
+		__builtin_prefetch(buf + i, 0, 0);
+}
+
+int hash_chunked(struct hash_algo *algo, const void *buf, ulong len,
+		 void *output, uint flags)
+{
+	const uint8_t *ptr = buf, *end = ptr + len;
+	ulong progress = 0;
+	union hash_ctx ctx;
+	bool marks = false;
+	uint size;
+
+	if (!algo->hash_start) {
+		/* This algorithm can only hash the whole buffer at once */
+		if (flags & HASH_CHUNK_NO_WATCHDOG)
+			return -ENOSYS;
+		if (len > UINT_MAX)
+			return -E2BIG;
+		algo->hash_func_ws(buf, len, output, algo->chunk_size);
+		return 0;
+	}
+#ifndef USE_HOSTCC
+	if ((flags & HASH_CHUNK_DMA) &&
+	    !IS_ALIGNED((ulong)buf, ARCH_DMA_MINALIGN))
+		return -EINVAL;
+	if (flags & HASH_CHUNK_REPORT)
+		bootstage_start(BOOTSTAGE_ID_ACCUM_HASH, "hash");
+#endif
+
+	algo->hash_start(&ctx);
+	while (ptr < end) {
+		size = HASH_CHUNK_SIZE;
+		if (end - ptr < size)
+			size = end - ptr;
+#ifndef USE_HOSTCC
+		/* Drop stale cache lines so that the DMA'd data is read */
+		if (flags & HASH_CHUNK_DMA) {
+			ulong start = (ulong)ptr;
+
+			invalidate_dcache_range(round_down(start,
+							   ARCH_DMA_MINALIGN),
+						ALIGN(start + size,
+						      ARCH_DMA_MINALIGN));
+		}
+#endif
+		if (end - ptr > size + HASH_PREFETCH_SIZE)
+			hash_prefetch(ptr + size, HASH_PREFETCH_SIZE);
+		algo->hash_chunk(&ctx, ptr, size);
+		ptr += size;
+		if (!(flags & HASH_CHUNK_NO_WATCHDOG))
+			WATCHDOG_RESET();
+
+#ifndef USE_HOSTCC
+		if (flags & HASH_CHUNK_REPORT) {
+			progress += size;
+			if (progress >= HASH_PROGRESS_SIZE) {
+				progress -= HASH_PROGRESS_SIZE;
+				putc('.');
+				marks = true;
+			}
+		}
+#endif
+	}
+	algo->hash_end(&ctx, output);
+
+#ifndef USE_HOSTCC
+	if (flags & HASH_CHUNK_REPORT) {
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_HASH);
+		if (marks)
+			putc('\n');
+	}
+#endif
+
+	return 0;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
@@ -457,6 +677,7 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 	if (multi_hash()) {
 		struct hash_algo *algo;
 		u8 *output;
+		int ret;
 		uint8_t vsum[HASH_MAX_DIGEST_SIZE];
 		void *buf;
 
@@ -475,8 +696,13 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 				  sizeof(uint32_t) * HASH_MAX_DIGEST_SIZE);
 
 		buf = map_sysmem(addr, len);
-		algo->hash_func_ws(buf, len, output, algo->chunk_size);
+		ret = hash_chunked(algo, buf, len, output, HASH_CHUNK_REPORT);
 		unmap_sysmem(buf);
+		if (ret) {
+			printf("Cannot hash %#lx bytes with %s (err=%d)\n",
+			       len, algo->name, ret);
+			return 1;
+		}
 
 		/* Try to avoid code bloat when verify is not needed */
 #if defined(CONFIG_CRC32_VERIFY) || defined(CONFIG_SHA1SUM_VERIFY) || \
@@ -532,4 +758,74 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 	return 0;
 }
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
+
+#ifdef CONFIG_CMD_HASH_BENCH
+/* Time to spend measuring each algorithm and backend */
+#define HASH_BENCH_US	100000
+
+static void hash_bench_one(struct hash_algo *algo, const char *backend,
+			   bool is_default, const uint8_t *buf, ulong size)
+{
+	uint8_t output[HASH_MAX_DIGEST_SIZE];
+	ulong start, us;
+	u64 bytes = 0;
+	uint rate;
+
+	start = timer_get_us();
+	do {
+		algo->hash_func_ws(buf, size, output, algo->chunk_size);
+		bytes += size;
+		us = timer_get_us() - start;
+	} while (us < HASH_BENCH_US);
+
+	/* MB/s is bytes per microsecond; keep one decimal place */
+	rate = lldiv(bytes * 10, us);
+	printf("%-12s %-12s %6u.%u MB/s%s\n", algo->name, backend, rate / 10,
+	       rate % 10, is_default ? " *" : "");
+}
+
+int hash_bench(ulong size)
+{
+	const char *name, *default_name;
+	struct hash_algo *algo;
+	uint8_t *buf;
+	int i, index, ret;
+
+	reloc_update();
+	buf = malloc(size);
+	if (!buf) {
+		printf("Cannot allocate %#lx bytes\n", size);
+		return -ENOMEM;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7;
+
+	printf("%-12s %-12s %11s\n", "Algorithm", "Backend", "Speed");
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		algo = &hash_algo[i];
+		if (!algo->select_backend) {
+			hash_bench_one(algo, "-", false, buf, size);
+			continue;
+		}
+		algo->select_backend(-1, &default_name);
+		for (index = 0;; index++) {
+			ret = algo->select_backend(index, &name);
+			if (ret == -ENOENT)
+				break;
+			if (ret)
+				printf("%-12s %-12s not supported by this CPU\n",
+				       algo->name, name);
+			else
+				hash_bench_one(algo, name,
+					       !strcmp(name, default_name), buf,
+					       size);
+		}
+		algo->select_backend(-1, NULL);
+	}
+	printf("* backend used by default\n");
+	free(buf);
+
+	return 0;
+}
+#endif /* CONFIG_CMD_HASH_BENCH */
 #endif /* !USE_HOSTCC */
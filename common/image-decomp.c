@@ -0,0 +1,498 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompressing an image a piece at a time, while it is being loaded
+ *
+ * The uncompressed data is written in one piece to its final place, which the
+ * decompressors also use to look back at earlier data. So only a piece of the
+ * compressed data which straddles two calls needs to be held back, at most
+ * one compressed block for LZ4 and Zstandard.
+ */
+
+#include <common.h>
+#include <env.h>
+#include <image.h>
+#include <lz4.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+
+/**
+ * struct decomp_stream_ops - a decompressor which takes data a piece at a time
+ *
+ * @comp:	Compression algorithm (IH_COMP_...)
+ * @start:	Set up the decompressor, allocating strm->priv if needed
+ * @write:	Decompress the next piece of compressed data, setting
+ *		strm->done once the end of the compressed data is seen
+ * @finish:	Free strm->priv (may be NULL if nothing was allocated)
+ */
+struct decomp_stream_ops {
+	int comp;
+	int (*start)(struct image_decomp_stream *strm);
+	int (*write)(struct image_decomp_stream *strm, const u8 *buf,
+		     ulong len);
+	void (*finish)(struct image_decomp_stream *strm);
+};
+
+/*
+ * Get the next @need bytes of input in one place, taking them from @bufp and
+ * @lenp. They are used where they are if possible, else they are gathered in
+ * @stage, with @fillp holding the number of bytes gathered so far.
+ *
+ * Returns a pointer to the bytes, or NULL if more input is needed
+ */
+static const u8 *decomp_gather(u8 *stage, size_t *fillp, size_t need,
+			       const u8 **bufp, ulong *lenp)
+{
+	const u8 *ptr = *bufp;
+	size_t len;
+
+	if (!*fillp && *lenp >= need) {
+		*bufp += need;
+		*lenp -= need;
+		return ptr;
+	}
+
+	len = min_t(size_t, need - *fillp, *lenp);
+	memcpy(stage + *fillp, ptr, len);
+	*fillp += len;
+	*bufp += len;
+	*lenp -= len;
+	if (*fillp < need)
+		return NULL;
+	*fillp = 0;
+
+	return stage;
+}
+
+static int none_start(struct image_decomp_stream *strm)
+{
+	/* Any amount of data is complete */
+	strm->done = true;
+
+	return 0;
+}
+
+static int none_write(struct image_decomp_stream *strm, const u8 *buf,
+		      ulong len)
+{
+	if (len > strm->out_size - strm->out_len)
+		return -ENOSPC;
+	memcpy(strm->out + strm->out_len, buf, len);
+	strm->out_len += len;
+
+	return 0;
+}
+
+#ifdef CONFIG_GZIP
+static int gzip_start(struct image_decomp_stream *strm)
+{
+	z_stream *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+	s->next_out = strm->out;
+	s->avail_out = min_t(ulong, strm->out_size, UINT_MAX);
+
+	/* Adding 16 to the window size expects a gzip header and trailer */
+	if (inflateInit2(s, MAX_WBITS + 16) != Z_OK) {
+		free(s);
+		return -ENOMEM;
+	}
+	strm->priv = s;
+
+	return 0;
+}
+
+static int gzip_write(struct image_decomp_stream *strm, const u8 *buf,
+		      ulong len)
+{
+	z_stream *s = strm->priv;
+	int ret;
+
+	s->next_in = (u8 *)buf;
+	s->avail_in = len;
+	while (s->avail_in && !strm->done) {
+		ret = inflate(s, Z_NO_FLUSH);
+		strm->out_len = s->next_out - (u8 *)strm->out;
+		if (ret == Z_STREAM_END)
+			strm->done = true;
+		else if (ret == Z_BUF_ERROR && !s->avail_out)
+			return -ENOSPC;
+		else if (ret != Z_OK)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void gzip_finish(struct image_decomp_stream *strm)
+{
+	inflateEnd(strm->priv);
+	free(strm->priv);
+}
+#endif /* CONFIG_GZIP */
+
+#ifdef CONFIG_LZ4
+enum lz4_stage {
+	LZ4_FRAME_HEADER,	/* magic number, flags and block descriptor */
+	LZ4_FRAME_HEADER_REST,	/* content size and header checksum */
+	LZ4_BLOCK_HEADER,
+	LZ4_BLOCK,
+	LZ4_BLOCK_CHECKSUM,
+	LZ4_CONTENT_CHECKSUM,
+	LZ4_DONE,
+};
+
+/**
+ * struct lz4_stream - state of LZ4 decompression
+ *
+ * @stage:		Part of the frame expected next
+ * @need:		Number of bytes in that part
+ * @fill:		Number of bytes of it gathered so far
+ * @header:		Frame header, the current block header and checksums
+ *			are gathered here
+ * @block:		Header of the current block
+ * @block_checksum:	true if each block is followed by a checksum
+ * @content_checksum:	true if the frame ends with a checksum
+ * @block_max:		Maximum size of a block
+ * @buf:		Compressed blocks are gathered here
+ */
+struct lz4_stream {
+	enum lz4_stage stage;
+	size_t need;
+	size_t fill;
+	u8 header[sizeof(struct lz4_frame_header) + sizeof(u64) + sizeof(u8)];
+	struct lz4_block_header block;
+	bool block_checksum;
+	bool content_checksum;
+	size_t block_max;
+	u8 *buf;
+};
+
+static int lz4_start(struct image_decomp_stream *strm)
+{
+	struct lz4_stream *ls;
+
+	ls = calloc(1, sizeof(*ls));
+	if (!ls)
+		return -ENOMEM;
+	ls->stage = LZ4_FRAME_HEADER;
+	ls->need = sizeof(struct lz4_frame_header);
+	strm->priv = ls;
+
+	return 0;
+}
+
+static int lz4_frame_header(struct lz4_stream *ls, const u8 *src)
+{
+	const struct lz4_frame_header *h = (const void *)src;
+
+	if (get_unaligned_le32(&h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if (h->reserved0 || h->reserved1 || h->reserved2)
+		return -EINVAL;	/* reserved must be zero */
+	if (h->max_block_size < 4)
+		return -EINVAL;	/* block sizes start at 64KB */
+
+	/*
+	 * Blocks which depend on earlier ones are fine, since the earlier
+	 * data is always just before them in the output
+	 */
+	ls->block_checksum = h->has_block_checksum;
+	ls->content_checksum = h->has_content_checksum;
+	ls->block_max = 1 << (8 + 2 * h->max_block_size);
+	ls->buf = malloc(ls->block_max);
+	if (!ls->buf)
+		return -ENOMEM;
+	ls->stage = LZ4_FRAME_HEADER_REST;
+	ls->need = (h->has_content_size ? sizeof(u64) : 0) + sizeof(u8);
+
+	return 0;
+}
+
+static int lz4_block(struct image_decomp_stream *strm, const u8 *src)
+{
+	struct lz4_stream *ls = strm->priv;
+	ulong space = strm->out_size - strm->out_len;
+	void *out = strm->out + strm->out_len;
+	int ret;
+
+	if (ls->block.not_compressed) {
+		if (ls->block.size > space)
+			return -ENOSPC;
+		memcpy(out, src, ls->block.size);
+		ret = ls->block.size;
+	} else {
+		ret = ulz4_decompress_block(src, ls->block.size, out,
+					    min_t(ulong, space, INT_MAX),
+					    strm->out);
+		if (ret < 0)
+			return ret;
+	}
+	strm->out_len += ret;
+
+	return 0;
+}
+
+static int lz4_write(struct image_decomp_stream *strm, const u8 *buf,
+		     ulong len)
+{
+	struct lz4_stream *ls = strm->priv;
+	const u8 *src;
+	int ret;
+
+	while (len && ls->stage != LZ4_DONE) {
+		src = decomp_gather(ls->stage == LZ4_BLOCK ? ls->buf :
+				    ls->header, &ls->fill, ls->need, &buf,
+				    &len);
+		if (!src)
+			break;
+
+		switch (ls->stage) {
+		case LZ4_FRAME_HEADER:
+			ret = lz4_frame_header(ls, src);
+			if (ret)
+				return ret;
+			continue;
+		case LZ4_BLOCK_HEADER:
+			ls->block.raw = get_unaligned_le32(src);
+			if (!ls->block.size) {
+				ls->stage = LZ4_CONTENT_CHECKSUM;
+				ls->need = sizeof(u32);
+				if (!ls->content_checksum)
+					ls->stage = LZ4_DONE;
+				continue;
+			}
+			if (ls->block.size > ls->block_max)
+				return -EINVAL;
+			ls->stage = LZ4_BLOCK;
+			ls->need = ls->block.size;
+			continue;
+		case LZ4_BLOCK:
+			ret = lz4_block(strm, src);
+			if (ret)
+				return ret;
+			if (ls->block_checksum) {
+				ls->stage = LZ4_BLOCK_CHECKSUM;
+				ls->need = sizeof(u32);
+				continue;
+			}
+			break;
+		case LZ4_CONTENT_CHECKSUM:
+			ls->stage = LZ4_DONE;
+			continue;
+		default:
+			/* Checksums are not checked, as with ulz4fn() */
+			break;
+		}
+		ls->stage = LZ4_BLOCK_HEADER;
+		ls->need = sizeof(struct lz4_block_header);
+	}
+	strm->done = ls->stage == LZ4_DONE;
+
+	return 0;
+}
+
+static void lz4_finish(struct image_decomp_stream *strm)
+{
+	struct lz4_stream *ls = strm->priv;
+
+	free(ls->buf);
+	free(ls);
+}
+#endif /* CONFIG_LZ4 */
+
+#ifdef CONFIG_ZSTD
+/**
+ * struct zstd_stream - state of Zstandard decompression
+ *
+ * This uses the buffer-less streaming API, which decompresses directly into
+ * the output and looks back at earlier output there, so no window buffer is
+ * needed. Decompression stops at the end of the first frame which is not a
+ * skippable frame.
+ *
+ * @dctx:	Decompression context
+ * @workspace:	Memory used by @dctx
+ * @fill:	Number of bytes gathered in @buf
+ * @buf_size:	Size of @buf, which holds a compressed block and its header
+ * @buf:	Input is gathered here when a piece of it is split between calls
+ */
+struct zstd_stream {
+	ZSTD_DCtx *dctx;
+	void *workspace;
+	size_t fill;
+	size_t buf_size;
+	u8 *buf;
+};
+
+static int zstd_start(struct image_decomp_stream *strm)
+{
+	size_t wsize = ZSTD_DCtxWorkspaceBound();
+	struct zstd_stream *zs;
+
+	zs = calloc(1, sizeof(*zs));
+	if (!zs)
+		return -ENOMEM;
+	zs->buf_size = ZSTD_DStreamInSize();
+	zs->workspace = malloc(wsize);
+	zs->buf = malloc(zs->buf_size);
+	if (!zs->workspace || !zs->buf) {
+		free(zs->buf);
+		free(zs->workspace);
+		free(zs);
+		return -ENOMEM;
+	}
+	zs->dctx = ZSTD_initDCtx(zs->workspace, wsize);
+	ZSTD_decompressBegin(zs->dctx);
+	strm->priv = zs;
+
+	return 0;
+}
+
+static int zstd_write(struct image_decomp_stream *strm, const u8 *buf,
+		      ulong len)
+{
+	struct zstd_stream *zs = strm->priv;
+	const u8 *src;
+	size_t need, ret;
+	bool skip;
+
+	while (len && !strm->done) {
+		need = ZSTD_nextSrcSizeToDecompress(zs->dctx);
+		if (need > zs->buf_size)
+			return -EFBIG;	/* e.g. a large skippable frame */
+		src = decomp_gather(zs->buf, &zs->fill, need, &buf, &len);
+		if (!src)
+			break;
+
+		skip = ZSTD_nextInputType(zs->dctx) == ZSTDnit_skippableFrame;
+		ret = ZSTD_decompressContinue(zs->dctx,
+					      strm->out + strm->out_len,
+					      strm->out_size - strm->out_len,
+					      src, need);
+		if (ZSTD_isError(ret)) {
+			if (ZSTD_getErrorCode(ret) ==
+			    ZSTD_error_dstSize_tooSmall)
+				return -ENOSPC;
+			return -EINVAL;
+		}
+		strm->out_len += ret;
+		if (!ZSTD_nextSrcSizeToDecompress(zs->dctx)) {
+			/* Skippable frames may come before the data */
+			if (skip)
+				ZSTD_decompressBegin(zs->dctx);
+			else
+				strm->done = true;
+		}
+	}
+
+	return 0;
+}
+
+static void zstd_finish(struct image_decomp_stream *strm)
+{
+	struct zstd_stream *zs = strm->priv;
+
+	free(zs->buf);
+	free(zs->workspace);
+	free(zs);
+}
+#endif /* CONFIG_ZSTD */
+
+static const struct decomp_stream_ops decomp_stream_ops[] = {
+	{ IH_COMP_NONE, none_start, none_write, NULL },
+#ifdef CONFIG_GZIP
+	{ IH_COMP_GZIP, gzip_start, gzip_write, gzip_finish },
+#endif
+#ifdef CONFIG_LZ4
+	{ IH_COMP_LZ4, lz4_start, lz4_write, lz4_finish },
+#endif
+#ifdef CONFIG_ZSTD
+	{ IH_COMP_ZSTD, zstd_start, zstd_write, zstd_finish },
+#endif
+};
+
+static const struct decomp_stream_ops *decomp_stream_get_ops(int comp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(decomp_stream_ops); i++) {
+		if (decomp_stream_ops[i].comp == comp)
+			return &decomp_stream_ops[i];
+	}
+
+	return NULL;
+}
+
+int image_decomp_stream_start(struct image_decomp_stream *strm, int comp,
+			      void *load_buf, ulong unc_len)
+{
+	const struct decomp_stream_ops *ops = decomp_stream_get_ops(comp);
+
+	memset(strm, '\0', sizeof(*strm));
+	if (!ops) {
+		printf("Cannot decompress %s while loading\n",
+		       genimg_get_comp_name(comp));
+		return -ENOSYS;
+	}
+	strm->comp = comp;
+	strm->out = load_buf;
+	strm->out_size = unc_len;
+
+	return ops->start(strm);
+}
+
+int image_decomp_stream_write(struct image_decomp_stream *strm,
+			      const void *buf, ulong len)
+{
+	const struct decomp_stream_ops *ops = decomp_stream_get_ops(strm->comp);
+	int ret;
+
+	if (strm->err)
+		return strm->err;
+	ret = ops->write(strm, buf, len);
+	strm->in_len += len;
+	if (ret) {
+		debug("%s: %s error %d after %lu bytes\n", __func__,
+		      genimg_get_comp_name(strm->comp), ret, strm->in_len);
+		strm->err = ret;
+	}
+
+	return ret;
+}
+
+int image_decomp_stream_finish(struct image_decomp_stream *strm, ulong *lenp)
+{
+	const struct decomp_stream_ops *ops = decomp_stream_get_ops(strm->comp);
+	int ret = strm->err;
+
+	if (ops->finish)
+		ops->finish(strm);
+	strm->priv = NULL;
+	if (!ret && !strm->done)
+		ret = -EINVAL;	/* the compressed data ended early */
+	if (lenp)
+		*lenp = strm->out_len;
+
+	return ret;
+}
+
+int image_decomp_stream_opt(int argc, char * const argv[], int *compp)
+{
+	*compp = IH_COMP_NONE;
+	if (argc < 2 || strcmp(argv[1], "-d"))
+		return 0;
+	if (argc < 3)
+		return -EINVAL;
+	*compp = genimg_get_comp_id(argv[2]);
+	if (*compp < 0) {
+		printf("Unknown compression '%s'\n", argv[2]);
+		return -EINVAL;
+	}
+
+	return 2;
+}
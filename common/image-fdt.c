@@ -528,6 +528,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 {
 	ulong *initrd_start = &images->initrd_start;
 	ulong *initrd_end = &images->initrd_end;
+	struct fdt_batch batch;
 	int ret = -EPERM;
 	int fdt_ret;
 
@@ -543,8 +544,18 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		printf("ERROR: arch-specific fdt fixup failed\n");
 		goto err;
 	}
-	/* Update ethernet nodes */
+	/*
+	 * Update ethernet nodes, making the changes all at once if enabled.
+	 * The batch is committed before the hooks below, which may mix
+	 * fdt_support fixups with direct libfdt access to the same properties.
+	 */
+	fdt_batch_begin(&batch, blob);
 	fdt_fixup_ethernet(blob);
+	fdt_ret = fdt_batch_commit(&batch);
+	if (fdt_ret) {
+		printf("ERROR: fdt fixups failed: %s\n", fdt_strerror(fdt_ret));
+		goto err;
+	}
 	if (IMAGE_OF_BOARD_SETUP) {
 		fdt_ret = ft_board_setup(blob, gd->bd);
 		if (fdt_ret) {
@@ -17,13 +17,16 @@
 #include <linux/kconfig.h>
 #include <common.h>
 #include <errno.h>
+#include <job_queue.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 #include <malloc.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
 #include <bootm.h>
+#include <hash.h>
 #include <image.h>
 #include <bootstage.h>
 #include <u-boot/crc.h>
@@ -31,6 +34,14 @@ DECLARE_GLOBAL_DATA_PTR;
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
 
+/* hash_chunked() is available wherever common/hash.c is built */
+#if defined(USE_HOSTCC) || \
+	(!defined(CONFIG_SPL_BUILD) && defined(CONFIG_HASH))
+#define FIT_HASH_CHUNKED	1
+#else
+#define FIT_HASH_CHUNKED	0
+#endif
+
 /*****************************************************************************/
 /* New uImage format routines */
 /*****************************************************************************/
@@ -1116,6 +1127,74 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 	return 0;
 }
 
+/*
+ * Calculate a hash, resetting the watchdog as it goes unless @job is true, in
+ * which case this may be running on a secondary CPU (see job_queue.h)
+ */
+static int fit_calculate_hash(const void *data, size_t data_len,
+			      const char *algo, uint8_t *value, int *value_len,
+			      bool job)
+{
+	struct hash_algo *hash;
+	int ret;
+
+	if (FIT_HASH_CHUNKED && !hash_lookup_algo(algo, &hash)) {
+		ret = hash_chunked(hash, data, data_len, value,
+				   job ? HASH_CHUNK_NO_WATCHDOG : 0);
+		if (!ret) {
+			*value_len = hash->digest_size;
+			return 0;
+		}
+		/* Hardware hashing resets the watchdog, so use software */
+		if (ret != -ENOSYS)
+			return -1;
+	}
+
+	if (data_len > UINT_MAX) {
+		debug("Data too large to hash\n");
+		return -1;
+	}
+	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
+		if (job)
+			*((uint32_t *)value) = crc32(0, data, data_len);
+		else
+			*((uint32_t *)value) = crc32_wd(0, data, data_len,
+							CHUNKSZ_CRC32);
+		*((uint32_t *)value) = cpu_to_uimage(*((uint32_t *)value));
+		*value_len = 4;
+	} else if (IMAGE_ENABLE_SHA1 && strcmp(algo, "sha1") == 0) {
+		if (job)
+			sha1_csum(data, data_len, value);
+		else
+			sha1_csum_wd((unsigned char *)data, data_len,
+				     (unsigned char *)value, CHUNKSZ_SHA1);
+		*value_len = 20;
+	} else if (IMAGE_ENABLE_SHA256 && strcmp(algo, "sha256") == 0) {
+		if (job) {
+			sha256_context ctx;
+
+			sha256_starts(&ctx);
+			sha256_update(&ctx, data, data_len);
+			sha256_finish(&ctx, value);
+		} else {
+			sha256_csum_wd((unsigned char *)data, data_len,
+				       (unsigned char *)value, CHUNKSZ_SHA256);
+		}
+		*value_len = SHA256_SUM_LEN;
+	} else if (IMAGE_ENABLE_MD5 && strcmp(algo, "md5") == 0) {
+		if (job)
+			md5((unsigned char *)data, data_len, value);
+		else
+			md5_wd((unsigned char *)data, data_len, value,
+			       CHUNKSZ_MD5);
+		*value_len = 16;
+	} else {
+		debug("Unsupported hash alogrithm\n");
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * calculate_hash - calculate and return hash for provided input data
  * @data: pointer to the input data
@@ -1130,36 +1209,231 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
  * Resulting hash value is placed in caller provided 'value' buffer, length
  * of the calculated hash is returned via value_len pointer argument.
  *
+ * Where the hash API is available, the data is hashed a piece at a time
+ * with hash_chunked(), which handles any length.
+ *
  * returns:
  *     0, on success
- *    -1, when algo is unsupported
+ *    -1, when algo is unsupported or the data is too large
  */
-int calculate_hash(const void *data, int data_len, const char *algo,
+int calculate_hash(const void *data, size_t data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
-	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
-		*((uint32_t *)value) = crc32_wd(0, data, data_len,
-							CHUNKSZ_CRC32);
-		*((uint32_t *)value) = cpu_to_uimage(*((uint32_t *)value));
-		*value_len = 4;
-	} else if (IMAGE_ENABLE_SHA1 && strcmp(algo, "sha1") == 0) {
-		sha1_csum_wd((unsigned char *)data, data_len,
-			     (unsigned char *)value, CHUNKSZ_SHA1);
-		*value_len = 20;
-	} else if (IMAGE_ENABLE_SHA256 && strcmp(algo, "sha256") == 0) {
-		sha256_csum_wd((unsigned char *)data, data_len,
-			       (unsigned char *)value, CHUNKSZ_SHA256);
-		*value_len = SHA256_SUM_LEN;
-	} else if (IMAGE_ENABLE_MD5 && strcmp(algo, "md5") == 0) {
-		md5_wd((unsigned char *)data, data_len, value, CHUNKSZ_MD5);
-		*value_len = 16;
-	} else {
-		debug("Unsupported hash alogrithm\n");
-		return -1;
+	return fit_calculate_hash(data, data_len, algo, value, value_len,
+				  false);
+}
+
+#if IMAGE_ENABLE_PARALLEL_VERIFY || IMAGE_ENABLE_STREAM_VERIFY
+/**
+ * struct fit_hash_value - a hash calculated before the image is checked
+ *
+ * @fit:	FIT containing the hash node
+ * @noffset:	Offset of the hash node
+ * @data:	Image data which was hashed
+ * @size:	Size of image data in bytes
+ * @algo:	Name of hash algorithm
+ * @ret:	0 if @value is valid, else -ve error
+ * @value:	Calculated hash value
+ * @value_len:	Length of @value in bytes
+ */
+struct fit_hash_value {
+	const void *fit;
+	int noffset;
+	const void *data;
+	size_t size;
+	const char *algo;
+	int ret;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+};
+
+/* Hashes calculated in advance for the verification in progress */
+static struct fit_hash_value *fit_hash_values;
+static int fit_hash_count;
+
+static struct fit_hash_value *fit_hash_add(const void *fit, int noffset,
+					   const void *data, size_t size,
+					   const char *algo)
+{
+	struct fit_hash_value *hval;
+
+	hval = realloc(fit_hash_values, (fit_hash_count + 1) * sizeof(*hval));
+	if (!hval)
+		return NULL;
+	fit_hash_values = hval;
+	hval += fit_hash_count++;
+	hval->fit = fit;
+	hval->noffset = noffset;
+	hval->data = data;
+	hval->size = size;
+	hval->algo = algo;
+	hval->ret = -ENOENT;
+
+	return hval;
+}
+
+static void fit_hash_release(void)
+{
+	free(fit_hash_values);
+	fit_hash_values = NULL;
+	fit_hash_count = 0;
+}
+
+/* Look up a hash calculated in advance */
+static int fit_hash_get_prepared(const void *fit, int noffset,
+				 const void *data, size_t size,
+				 const char *algo, uint8_t *value,
+				 int *value_len)
+{
+	struct fit_hash_value *hval;
+	int i;
+
+	for (i = 0, hval = fit_hash_values; i < fit_hash_count; i++, hval++) {
+		if (hval->fit != fit || hval->noffset != noffset ||
+		    hval->data != data || hval->size != size ||
+		    strcmp(hval->algo, algo) || hval->ret)
+			continue;
+		memcpy(value, hval->value, hval->value_len);
+		*value_len = hval->value_len;
+
+		return 0;
 	}
+
+	return -ENOENT;
+}
+#else
+static inline void fit_hash_release(void) {}
+
+static inline int fit_hash_get_prepared(const void *fit, int noffset,
+					const void *data, size_t size,
+					const char *algo, uint8_t *value,
+					int *value_len)
+{
+	return -ENOENT;
+}
+#endif
+
+#if IMAGE_ENABLE_PARALLEL_VERIFY
+static int fit_hash_job_run(struct job *job)
+{
+	struct fit_hash_value *hval = job->priv;
+
+	return fit_calculate_hash(hval->data, hval->size, hval->algo,
+				  hval->value, &hval->value_len, true);
+}
+
+static int fit_hash_add_image(const void *fit, int image_noffset,
+			      const void *data, size_t size)
+{
+	int noffset, ignore;
+	char *algo;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (!fit_hash_add(fit, noffset, data, size, algo))
+			return -ENOMEM;
+	}
+
 	return 0;
 }
 
+/**
+ * fit_hash_prepare() - calculate image hashes in parallel
+ *
+ * This calculates the hashes for one image, or all images in a FIT, using
+ * the job queue. They are then picked up by fit_image_check_hash(), which
+ * still reports the results and errors for each hash node in turn.
+ *
+ * @fit:		FIT to check
+ * @image_noffset:	Image node to check, or -1 for all images
+ * @data:		Data for @image_noffset (ignored if -1)
+ * @size:		Size of @data
+ * @return true if the hashes were calculated, in which case
+ *	fit_hash_release() must be called when done, false if the hashes are
+ *	to be calculated as they are checked
+ */
+static bool fit_hash_prepare(const void *fit, int image_noffset,
+			     const void *data, size_t size)
+{
+	struct fit_hash_value *hval;
+	struct job *jobs;
+	ulong cpu_us = 0;
+	int noffset;
+	int ret = 0;
+	int i;
+
+	/* Leave it to the outermost check if already in progress */
+	if (fit_hash_values)
+		return false;
+
+	if (image_noffset == -1) {
+		noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
+		fdt_for_each_subnode(image_noffset, fit, noffset) {
+			if (fit_image_get_data_and_size(fit, image_noffset,
+							&data, &size))
+				continue;
+			ret = fit_hash_add_image(fit, image_noffset, data,
+						 size);
+			if (ret)
+				break;
+		}
+	} else {
+		ret = fit_hash_add_image(fit, image_noffset, data, size);
+	}
+	if (ret || fit_hash_count < 2)
+		goto err;
+
+	jobs = calloc(fit_hash_count, sizeof(*jobs));
+	if (!jobs)
+		goto err;
+	for (i = 0, hval = fit_hash_values; i < fit_hash_count; i++, hval++) {
+		jobs[i].func = fit_hash_job_run;
+		jobs[i].priv = hval;
+		jobs[i].cost = hval->size;
+	}
+
+	/* Build the CRC table here if it is built at first use */
+	if (IMAGE_ENABLE_CRC32)
+		crc32(0, NULL, 0);
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_HASH, "fit_hash");
+	job_queue_run(jobs, fit_hash_count);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_HASH);
+
+	for (i = 0, hval = fit_hash_values; i < fit_hash_count; i++, hval++) {
+		hval->ret = jobs[i].ret;
+		cpu_us += jobs[i].time_us;
+	}
+	bootstage_accum_add(BOOTSTAGE_ID_ACCUM_FIT_HASH_CPU, "fit_hash_cpu",
+			    cpu_us);
+	free(jobs);
+
+	return true;
+
+err:
+	fit_hash_release();
+
+	return false;
+}
+#else
+static inline bool fit_hash_prepare(const void *fit, int image_noffset,
+				    const void *data, size_t size)
+{
+	return false;
+}
+#endif
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
@@ -1192,7 +1466,9 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (fit_hash_get_prepared(fit, noffset, data, size, algo, value,
+				  &value_len) &&
+	    calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1214,6 +1490,7 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 	int		noffset = 0;
 	char		*err_msg = "";
 	int verify_all = 1;
+	bool prepared = false;
 	int ret;
 
 	/* Verify all required signatures */
@@ -1224,6 +1501,9 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		goto error;
 	}
 
+	/* Calculate several hashes at once if possible */
+	prepared = fit_hash_prepare(fit, image_noffset, data, size);
+
 	/* Process all hash subnodes of the component image node */
 	fdt_for_each_subnode(noffset, fit, image_noffset) {
 		const char *name = fit_get_name(fit, noffset, NULL);
@@ -1263,15 +1543,127 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		goto error;
 	}
 
+	if (prepared)
+		fit_hash_release();
+
 	return 1;
 
 error:
+	if (prepared)
+		fit_hash_release();
 	printf(" error!\n%s for '%s' hash node in '%s' image node\n",
 	       err_msg, fit_get_name(fit, noffset, NULL),
 	       fit_get_name(fit, image_noffset, NULL));
 	return 0;
 }
 
+#if IMAGE_ENABLE_STREAM_VERIFY
+int fit_image_hash_stream_start(struct fit_hash_stream *stream,
+				const void *fit, int image_noffset)
+{
+	int noffset, ignore;
+	char *algo;
+
+	stream->fit = fit;
+	stream->image_noffset = image_noffset;
+	stream->count = 0;
+	stream->size = 0;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (stream->count == FIT_STREAM_MAX_HASHES)
+			break;
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+
+		if (IMAGE_ENABLE_CRC32 && !strcmp(algo, "crc32"))
+			stream->hash[stream->count].ctx.crc32 = 0;
+		else if (IMAGE_ENABLE_SHA1 && !strcmp(algo, "sha1"))
+			sha1_starts(&stream->hash[stream->count].ctx.sha1);
+		else if (IMAGE_ENABLE_SHA256 && !strcmp(algo, "sha256"))
+			sha256_starts(&stream->hash[stream->count].ctx.sha256);
+		else
+			continue;
+		stream->hash[stream->count].noffset = noffset;
+		stream->hash[stream->count].algo = algo;
+		stream->count++;
+	}
+
+	return stream->count;
+}
+
+void fit_image_hash_stream_update(struct fit_hash_stream *stream,
+				  const void *data, size_t len)
+{
+	int i;
+
+	for (i = 0; i < stream->count; i++) {
+		const char *algo = stream->hash[i].algo;
+
+		if (IMAGE_ENABLE_CRC32 && !strcmp(algo, "crc32"))
+			stream->hash[i].ctx.crc32 =
+				crc32(stream->hash[i].ctx.crc32, data, len);
+		else if (IMAGE_ENABLE_SHA1 && !strcmp(algo, "sha1"))
+			sha1_update(&stream->hash[i].ctx.sha1, data, len);
+		else if (IMAGE_ENABLE_SHA256 && !strcmp(algo, "sha256"))
+			sha256_update(&stream->hash[i].ctx.sha256, data, len);
+	}
+	stream->size += len;
+}
+
+int fit_image_verify_stream(struct fit_hash_stream *stream, const void *data,
+			    size_t size)
+{
+	struct fit_hash_value *hval;
+	bool prepared = false;
+	int ret, i;
+
+	/* Only use the hashes if they cover exactly the data being checked */
+	if (!fit_hash_values && stream->size == size) {
+		for (i = 0; i < stream->count; i++) {
+			const char *algo = stream->hash[i].algo;
+
+			hval = fit_hash_add(stream->fit, stream->hash[i].noffset,
+					    data, size, algo);
+			if (!hval)
+				break;
+			prepared = true;
+			hval->ret = 0;
+			if (IMAGE_ENABLE_CRC32 && !strcmp(algo, "crc32")) {
+				put_unaligned_be32(stream->hash[i].ctx.crc32,
+						   hval->value);
+				hval->value_len = 4;
+			} else if (IMAGE_ENABLE_SHA1 && !strcmp(algo, "sha1")) {
+				sha1_finish(&stream->hash[i].ctx.sha1,
+					    hval->value);
+				hval->value_len = SHA1_SUM_LEN;
+			} else if (IMAGE_ENABLE_SHA256 &&
+				   !strcmp(algo, "sha256")) {
+				sha256_finish(&stream->hash[i].ctx.sha256,
+					      hval->value);
+				hval->value_len = SHA256_SUM_LEN;
+			}
+		}
+	}
+
+	ret = fit_image_verify_with_data(stream->fit, stream->image_noffset,
+					 data, size);
+	if (prepared)
+		fit_hash_release();
+
+	return ret;
+}
+#endif
+
 /**
  * fit_image_verify - verify data integrity
  * @fit: pointer to the FIT format image header
@@ -1318,9 +1710,11 @@ int fit_image_verify(const void *fit, int image_noffset)
 int fit_all_image_verify(const void *fit)
 {
 	int images_noffset;
+	bool prepared;
 	int noffset;
 	int ndepth;
 	int count;
+	int ret = 1;
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
@@ -1333,6 +1727,7 @@ int fit_all_image_verify(const void *fit)
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
+	prepared = fit_hash_prepare(fit, -1, NULL, 0);
 	for (ndepth = 0, count = 0,
 	     noffset = fdt_next_node(fit, images_noffset, &ndepth);
 			(noffset >= 0) && (ndepth > 0);
@@ -1346,12 +1741,17 @@ int fit_all_image_verify(const void *fit)
 			       fit_get_name(fit, noffset, NULL));
 			count++;
 
-			if (!fit_image_verify(fit, noffset))
-				return 0;
+			if (!fit_image_verify(fit, noffset)) {
+				ret = 0;
+				break;
+			}
 			printf("\n");
 		}
 	}
-	return 1;
+	if (prepared)
+		fit_hash_release();
+
+	return ret;
 }
 
 /**
@@ -2085,6 +2485,8 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 	const char *uname;
 	void *base, *ov;
 	int i, err, noffset, ov_noffset;
+	struct fdt_overlay_stack *stack = NULL;
+	ulong start;
 #endif
 
 	fit_uname = fit_unamep ? *fit_unamep : NULL;
@@ -2138,6 +2540,9 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 
 	base = map_sysmem(load, len);
 
+	/* look through the base tree once, rather than for each overlay */
+	stack = fdt_overlay_stack_create(base);
+
 	/* apply extra configs in FIT first, followed by args */
 	for (i = 1; ; i++) {
 		if (i < count) {
@@ -2190,7 +2595,10 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 			goto out;
 		}
 		/* the verbose method prints out messages on error */
-		err = fdt_overlay_apply_verbose(base, ov);
+		start = timer_get_us();
+		err = fdt_overlay_stack_apply(stack, base, ov);
+		bootstage_accum_add(BOOTSTAGE_ID_ALLOC, uname,
+				    timer_get_us() - start);
 		if (err < 0) {
 			fdt_noffset = err;
 			goto out;
@@ -2204,6 +2612,9 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
 #endif
 
 out:
+#ifdef CONFIG_OF_LIBFDT_OVERLAY
+	fdt_overlay_stack_free(stack);
+#endif
 	if (datap)
 		*datap = load;
 	if (lenp)
@@ -22,6 +22,7 @@
 #include <gzip.h>
 #include <image.h>
 #include <lz4.h>
+#include <malloc.h>
 #include <mapmem.h>
 
 #if IMAGE_ENABLE_FIT || IMAGE_ENABLE_OF_LIBFDT
@@ -41,6 +42,7 @@
 #include <lzma/LzmaTypes.h>
 #include <lzma/LzmaDec.h>
 #include <lzma/LzmaTools.h>
+#include <linux/zstd.h>
 
 #ifdef CONFIG_CMD_BDI
 extern int do_bdinfo(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
@@ -191,6 +193,7 @@ static const table_entry_t uimage_comp[] = {
 	{	IH_COMP_LZMA,	"lzma",		"lzma compressed",	},
 	{	IH_COMP_LZO,	"lzo",		"lzo compressed",	},
 	{	IH_COMP_LZ4,	"lz4",		"lz4 compressed",	},
+	{	IH_COMP_ZSTD,	"zstd",		"zstd compressed",	},
 	{	-1,		"",		"",			},
 };
 
@@ -405,6 +408,32 @@ static void print_decomp_msg(int comp_type, int type, bool is_xip)
 		printf("   Uncompressing %s\n", name);
 }
 
+#ifdef CONFIG_ZSTD
+static int zstd_decompress(void *dst, size_t *dstn, const void *src,
+			   size_t srcn)
+{
+	size_t wsize = ZSTD_DCtxWorkspaceBound();
+	void *workspace;
+	ZSTD_DCtx *dctx;
+	size_t ret;
+
+	workspace = malloc(wsize);
+	if (!workspace)
+		return -ENOMEM;
+	dctx = ZSTD_initDCtx(workspace, wsize);
+	ret = ZSTD_decompressDCtx(dctx, dst, *dstn, src, srcn);
+	free(workspace);
+	if (ZSTD_isError(ret)) {
+		if (ZSTD_getErrorCode(ret) == ZSTD_error_dstSize_tooSmall)
+			return -ENOSPC;
+		return -EINVAL;
+	}
+	*dstn = ret;
+
+	return 0;
+}
+#endif
+
 int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end)
@@ -478,6 +507,15 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		break;
 	}
 #endif /* CONFIG_LZ4 */
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD: {
+		size_t size = unc_len;
+
+		ret = zstd_decompress(load_buf, &size, image_buf, image_len);
+		image_len = size;
+		break;
+	}
+#endif /* CONFIG_ZSTD */
 	default:
 		printf("Unimplemented compression type %d\n", comp);
 		return -ENOSYS;
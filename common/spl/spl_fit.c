@@ -18,6 +18,9 @@ DECLARE_GLOBAL_DATA_PTR;
 #define CONFIG_SYS_BOOTM_LEN	(64 << 20)
 #endif
 
+/* Size of the pieces in which image data is read when hashing it as it loads */
+#define SPL_FIT_STREAM_CHUNK	(256 << 10)
+
 __weak void board_spl_fit_post_load(ulong load_addr, size_t length)
 {
 }
@@ -153,6 +156,46 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/**
+ * spl_fit_read_hashed(): read external image data, hashing it as it arrives
+ * @info:	points to information about the device to load data from
+ * @sector:	the first sector (or byte offset, for a filesystem) to read
+ * @count:	the number of sectors (or bytes) to read
+ * @buf:	buffer to read into
+ * @overhead:	offset of the image data within @buf
+ * @length:	length of the image data
+ * @stream:	hashes to update with the image data
+ *
+ * The data is read in chunks, each of which is hashed straight after it is
+ * read, while it is still in the cache.
+ *
+ * Return:	0 on success or -EIO on a read error
+ */
+static int spl_fit_read_hashed(struct spl_load_info *info, ulong sector,
+			       int count, void *buf, ulong overhead,
+			       size_t length, struct fit_hash_stream *stream)
+{
+	int unit = info->filename ? 1 : info->bl_len;
+	int chunk = max(SPL_FIT_STREAM_CHUNK / unit, 1);
+	ulong start, end;
+	int done, n;
+
+	for (done = 0; done < count; done += n) {
+		n = min(chunk, count - done);
+		if (info->read(info, sector + done, n, buf + done * unit) != n)
+			return -EIO;
+
+		/* Hash whatever part of the image data has just been read */
+		start = max((ulong)done * unit, overhead);
+		end = min((ulong)(done + n) * unit, overhead + length);
+		if (start < end)
+			fit_image_hash_stream_update(stream, buf + start,
+						     end - start);
+	}
+
+	return 0;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -186,6 +229,9 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	bool external_data = false;
+	struct fit_hash_stream stream;
+	__maybe_unused bool streamed = false;
+	__maybe_unused int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA_SUPPORT) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -223,10 +269,20 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		overhead = get_aligned_image_overhead(info, offset);
 		nr_sectors = get_aligned_image_size(info, length, offset);
 
-		if (info->read(info,
+		if (IMAGE_ENABLE_STREAM_VERIFY &&
+		    fit_image_hash_stream_start(&stream, fit, node)) {
+			ret = spl_fit_read_hashed(info, sector +
+					get_aligned_image_offset(info, offset),
+					nr_sectors, (void *)load_ptr, overhead,
+					length, &stream);
+			if (ret)
+				return ret;
+			streamed = true;
+		} else if (info->read(info,
 			       sector + get_aligned_image_offset(info, offset),
-			       nr_sectors, (void *)load_ptr) != nr_sectors)
+			       nr_sectors, (void *)load_ptr) != nr_sectors) {
 			return -EIO;
+		}
 
 		debug("External data: dst=%lx, offset=%x, size=%lx\n",
 		      load_ptr, offset, (unsigned long)length);
@@ -245,8 +301,11 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 #ifdef CONFIG_SPL_FIT_SIGNATURE
 	printf("## Checking hash(es) for Image %s ... ",
 	       fit_get_name(fit, node, NULL));
-	if (!fit_image_verify_with_data(fit, node,
-					 src, length))
+	if (streamed)
+		ret = fit_image_verify_stream(&stream, src, length);
+	else
+		ret = fit_image_verify_with_data(fit, node, src, length);
+	if (!ret)
 		return -EPERM;
 	puts("OK\n");
 #endif
@@ -426,6 +426,154 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/* Set the result of a request and tell the caller */
+static void blk_req_finish(struct blk_req *req, long result)
+{
+	req->result = result;
+	req->complete = true;
+	if (req->done)
+		req->done(req);
+}
+
+void blk_req_complete(struct blk_req *req, long result)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(req->dev);
+
+	if (req->cached && req->op == BLK_REQ_READ) {
+		if (result == req->blkcnt)
+			blkcache_fill(desc->if_type, desc->devnum, req->start,
+				      req->blkcnt, desc->blksz, req->buffer);
+	} else if (req->cached) {
+		if (result == req->blkcnt)
+			blkcache_write(desc->if_type, desc->devnum, req->start,
+				       req->blkcnt, desc->blksz, req->buffer);
+		else
+			blkcache_invalidate_range(desc->if_type, desc->devnum,
+						  req->start, req->blkcnt,
+						  desc->blksz);
+	}
+	blk_req_finish(req, result);
+}
+
+/* Start a request, falling back to the synchronous operations if needed */
+static int blk_start(struct blk_req *req)
+{
+	struct udevice *dev = req->dev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong ret;
+
+	req->result = 0;
+	req->complete = false;
+	if (ops->submit)
+		return ops->submit(dev, req);
+
+	switch (req->op) {
+	case BLK_REQ_READ:
+		if (!ops->read)
+			return -ENOSYS;
+		ret = ops->read(dev, req->start, req->blkcnt, req->buffer);
+		break;
+	case BLK_REQ_WRITE:
+		if (!ops->write)
+			return -ENOSYS;
+		ret = ops->write(dev, req->start, req->blkcnt, req->buffer);
+		break;
+	default:
+		return -EINVAL;
+	}
+	blk_req_complete(req, ret);
+
+	return 0;
+}
+
+int blk_submit(struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(req->dev);
+
+	if (req->op != BLK_REQ_READ && req->op != BLK_REQ_WRITE)
+		return -EINVAL;
+	req->cached = true;
+	if (req->op == BLK_REQ_READ &&
+	    blkcache_read(desc->if_type, desc->devnum, req->start, req->blkcnt,
+			  desc->blksz, req->buffer)) {
+		blk_req_finish(req, req->blkcnt);
+		return 0;
+	}
+
+	return blk_start(req);
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+long blk_wait(struct blk_req *req)
+{
+	int ret;
+
+	while (!req->complete) {
+		ret = blk_poll(req->dev);
+		if (ret < 0)
+			return ret;
+		/* The driver has lost track of the request */
+		if (!ret && !req->complete)
+			return -EIO;
+	}
+
+	return req->result;
+}
+
+/* Carry out a transfer using an asynchronous request, bypassing the cache */
+static ulong blk_transfer(struct udevice *dev, enum blk_req_op op,
+			  lbaint_t start, lbaint_t blkcnt, void *buffer)
+{
+	struct blk_req req = {
+		.dev = dev,
+		.op = op,
+		.start = start,
+		.blkcnt = blkcnt,
+		.buffer = buffer,
+	};
+	long ret;
+
+	ret = blk_start(&req);
+	if (!ret)
+		ret = blk_wait(&req);
+
+	return ret;
+}
+
+static ulong blk_read_dev(struct blk_desc *block_dev, lbaint_t start,
+			  lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (ops->submit)
+		return blk_transfer(dev, BLK_REQ_READ, start, blkcnt, buffer);
+
+	return ops->read(dev, start, blkcnt, buffer);
+}
+
+static ulong blk_write_dev(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (ops->submit)
+		return blk_transfer(dev, BLK_REQ_WRITE, start, blkcnt,
+				    (void *)buffer);
+
+	return ops->write(dev, start, blkcnt, buffer);
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
@@ -433,13 +581,16 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
 
-	if (!ops->read)
+	if (!ops->read && !ops->submit)
 		return -ENOSYS;
 
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
+	if (blkcache_read_ahead(block_dev, start, blkcnt, buffer,
+				blk_read_dev))
+		return blkcnt;
+	blks_read = blk_read_dev(block_dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
@@ -452,12 +603,21 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_written;
 
-	if (!ops->write)
+	if (!ops->write && !ops->submit)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	blks_written = blk_write_dev(block_dev, start, blkcnt, buffer);
+	if (blks_written == blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	else
+		blkcache_invalidate_range(block_dev->if_type,
+					  block_dev->devnum, start, blkcnt,
+					  block_dev->blksz);
+
+	return blks_written;
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -469,7 +629,8 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt, block_dev->blksz);
 	return ops->erase(dev, start, blkcnt);
 }
 
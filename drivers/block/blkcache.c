@@ -7,161 +7,451 @@
 #include <config.h>
 #include <common.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
 
-struct block_cache_node {
-	struct list_head lh;
+/*
+ * The cache holds fixed-size lines of max_blocks_per_entry blocks, each
+ * starting at a multiple of that size. Lines are looked up by hashing the
+ * device and line number into a set of BLKCACHE_WAYS lines, with the least
+ * recently used line in the set being replaced when a new one is added.
+ */
+
+/* Number of lines in each set */
+#define BLKCACHE_WAYS	4
+
+/**
+ * struct block_cache_line - a cached, aligned run of blocks
+ *
+ * @iftype:	IF_TYPE_x for type of device
+ * @devnum:	device index of particular type
+ * @start:	first block in the line
+ * @blksz:	size in bytes of each block
+ * @age:	value of 'tick' when last used, 0 if the line is empty
+ * @size:	allocated size of @cache in bytes
+ * @cache:	cached data
+ */
+struct block_cache_line {
 	int iftype;
 	int devnum;
 	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
+	ulong age;
+	ulong size;
 	char *cache;
 };
 
-static LIST_HEAD(block_cache);
+/**
+ * struct block_cache_dev - per-device state of the cache
+ *
+ * @lh:		link in the 'block_cache_devs' list
+ * @next:	block following the last one read, to detect sequential reads
+ * @stats:	statistics for this device
+ */
+struct block_cache_dev {
+	struct list_head lh;
+	lbaint_t next;
+	struct block_cache_dev_stats stats;
+};
+
+static LIST_HEAD(block_cache_devs);
+static struct block_cache_line *lines;
+static unsigned ways, sets;
+static ulong tick;
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_entries = 32,
+	.readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
+static struct block_cache_dev *cache_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh) {
+		if (bdev->stats.iftype == iftype &&
+		    bdev->stats.devnum == devnum)
+			return bdev;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find or add the state for a device which is about to fill the cache. Only
+ * a read which missed gets here, so a new device starts with that miss.
+ */
+static struct block_cache_dev *cache_dev_add(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev;
+
+	bdev = cache_dev(iftype, devnum);
+	if (bdev)
+		return bdev;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->stats.iftype = iftype;
+	bdev->stats.devnum = devnum;
+	bdev->stats.misses = 1;
+	list_add_tail(&bdev->lh, &block_cache_devs);
+
+	return bdev;
+}
+
+/* Largest request which is looked up in, and added to, the cache */
+static lbaint_t cache_max_blocks(void)
+{
+	return max(_stats.max_blocks_per_entry, _stats.readahead);
+}
+
+static struct block_cache_line *cache_set(int iftype, int devnum,
+					  lbaint_t start)
+{
+	ulong hash;
+
+	hash = (ulong)(start / _stats.max_blocks_per_entry);
+	hash ^= (ulong)iftype << 24 ^ (ulong)devnum << 16;
+	hash *= 0x9e3779b1;
+
+	return &lines[((hash >> 8) % sets) * ways];
+}
+
+static struct block_cache_line *cache_find(int iftype, int devnum,
+					   lbaint_t start,
 					   unsigned long blksz)
 {
-	struct block_cache_node *node;
-
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+	struct block_cache_line *line;
+	int i;
+
+	line = cache_set(iftype, devnum, start);
+	for (i = 0; i < ways; i++, line++) {
+		if (line->age && line->start == start &&
+		    line->iftype == iftype && line->devnum == devnum &&
+		    line->blksz == blksz)
+			return line;
+	}
+
+	return NULL;
+}
+
+/* Allocate the lines if needed; on success the cache has lines to fill */
+static int cache_alloc(void)
+{
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry)
+		return -ENOSPC;
+	if (lines)
+		return 0;
+
+	ways = min_t(unsigned, _stats.max_entries, BLKCACHE_WAYS);
+	sets = _stats.max_entries / ways;
+	lines = calloc(sets * ways, sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void cache_free(void)
+{
+	int i;
+
+	if (lines) {
+		for (i = 0; i < sets * ways; i++)
+			free(lines[i].cache);
+		free(lines);
+		lines = NULL;
+	}
+	_stats.entries = 0;
+}
+
+/* Add or update the line starting at @start, which must be aligned */
+static void cache_add(int iftype, int devnum, lbaint_t start,
+		      unsigned long blksz, const void *buffer)
+{
+	struct block_cache_line *line, *victim;
+	ulong bytes = blksz * _stats.max_blocks_per_entry;
+	int i;
+
+	line = cache_find(iftype, devnum, start, blksz);
+	if (!line) {
+		victim = cache_set(iftype, devnum, start);
+		for (line = victim, i = 0; i < ways; i++, line++) {
+			if (line->age < victim->age)
+				victim = line;
+		}
+		line = victim;
+		if (line->age) {
+			debug("drop: start " LBAF "\n", line->start);
+			_stats.entries--;
+		}
+		if (line->size < bytes) {
+			free(line->cache);
+			line->cache = malloc(bytes);
+			if (!line->cache) {
+				line->age = 0;
+				line->size = 0;
+				return;
 			}
-			return node;
+			line->size = bytes;
 		}
-	return 0;
+		line->iftype = iftype;
+		line->devnum = devnum;
+		line->start = start;
+		line->blksz = blksz;
+		_stats.entries++;
+	}
+
+	debug("fill: start " LBAF "\n", start);
+	memcpy(line->cache, buffer, bytes);
+	line->age = ++tick;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	lbaint_t per_line = _stats.max_blocks_per_entry;
+	struct block_cache_dev *bdev;
+	struct block_cache_line *line;
+	lbaint_t blk, end, first, count;
+	char *dst;
+
+	if (!blkcnt || blkcnt > cache_max_blocks())
+		return 0;
+
+	bdev = cache_dev(iftype, devnum);
+	if (!lines || !per_line)
+		goto miss;
+
+	/* Only use the cache if every line covering the request is present */
+	end = start + blkcnt;
+	for (blk = start - start % per_line; blk < end; blk += per_line) {
+		if (!cache_find(iftype, devnum, blk, blksz))
+			goto miss;
+	}
+
+	dst = buffer;
+	for (blk = start; blk < end; blk += count) {
+		first = blk - blk % per_line;
+		line = cache_find(iftype, devnum, first, blksz);
+		count = min(end, first + per_line) - blk;
+		memcpy(dst, line->cache + (blk - first) * blksz, count * blksz);
+		dst += count * blksz;
+		line->age = ++tick;
+	}
+
+	debug("hit: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	++_stats.hits;
+	if (bdev) {
+		bdev->stats.hits++;
+		bdev->next = end;
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	return 1;
+miss:
+	debug("miss: start " LBAF ", count " LBAFU "\n", start, blkcnt);
 	++_stats.misses;
+	if (bdev)
+		bdev->stats.misses++;
+
 	return 0;
 }
 
+/* Add the whole lines within a range of blocks */
+static void cache_fill(int iftype, int devnum, lbaint_t start,
+		       lbaint_t blkcnt, unsigned long blksz,
+		       const void *buffer)
+{
+	lbaint_t per_line = _stats.max_blocks_per_entry;
+	lbaint_t blk, end;
+
+	if (!lines || !per_line)
+		return;
+
+	end = start + blkcnt;
+	blk = start + (per_line - start % per_line) % per_line;
+	for (; blk + per_line <= end; blk += per_line)
+		cache_add(iftype, devnum, blk, blksz,
+			  (const char *)buffer + (blk - start) * blksz);
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt > cache_max_blocks() || cache_alloc())
 		return;
 
-	if (_stats.max_entries == 0)
+	bdev = cache_dev_add(iftype, devnum);
+	if (bdev)
+		bdev->next = start + blkcnt;
+
+	cache_fill(iftype, devnum, start, blkcnt, blksz, buffer);
+}
+
+long blkcache_read_ahead(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buffer, blkcache_read_t read)
+{
+	lbaint_t per_line = _stats.max_blocks_per_entry;
+	unsigned long blksz = block_dev->blksz;
+	struct block_cache_dev *bdev;
+	lbaint_t first, end, count;
+	ulong blks_read;
+	char *buf;
+
+	if (!blkcnt || blkcnt > cache_max_blocks() || cache_alloc())
+		return 0;
+	bdev = cache_dev_add(block_dev->if_type, block_dev->devnum);
+	if (!bdev)
+		return 0;
+
+	/* Read whole lines, and further ahead if reading sequentially */
+	first = start - start % per_line;
+	end = start + blkcnt;
+	if (start == bdev->next)
+		end = max(end, start + _stats.readahead);
+	end = roundup(end, per_line);
+	if (block_dev->lba && end > block_dev->lba)
+		end = max(block_dev->lba, start + blkcnt);
+	count = end - first;
+	if (count == blkcnt)
+		return 0;
+
+	buf = malloc_cache_aligned(count * blksz);
+	if (!buf)
+		return 0;
+	blks_read = read(block_dev, first, count, buf);
+	if (blks_read != count) {
+		free(buf);
+		return 0;
+	}
+
+	debug("read ahead: start " LBAF ", count " LBAFU "\n", first, count);
+	cache_fill(block_dev->if_type, block_dev->devnum, first, count,
+		   blksz, buf);
+	memcpy(buffer, buf + (start - first) * blksz, blkcnt * blksz);
+	free(buf);
+	bdev->next = start + blkcnt;
+	bdev->stats.readahead += count - blkcnt;
+
+	return blkcnt;
+}
+
+void blkcache_write(int iftype, int devnum,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer)
+{
+	lbaint_t per_line = _stats.max_blocks_per_entry;
+	struct block_cache_dev *bdev;
+	struct block_cache_line *line;
+	lbaint_t blk, end, first, count;
+	const char *src;
+
+	if (!lines || !_stats.entries)
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
+	/* A large write is cheaper to handle by dropping the device's lines */
+	if (blkcnt > (lbaint_t)sets * ways * per_line) {
+		blkcache_invalidate(iftype, devnum);
+		return;
 	}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+	bdev = cache_dev(iftype, devnum);
+	end = start + blkcnt;
+	src = buffer;
+	for (blk = start; blk < end; blk += count) {
+		first = blk - blk % per_line;
+		count = min(end, first + per_line) - blk;
+		line = cache_find(iftype, devnum, first, blksz);
+		if (line) {
+			memcpy(line->cache + (blk - first) * blksz, src,
+			       count * blksz);
+			if (bdev)
+				bdev->stats.writes += count;
 		}
+		src += count * blksz;
 	}
+}
+
+void blkcache_invalidate_range(int iftype, int devnum,
+			       lbaint_t start, lbaint_t blkcnt,
+			       unsigned long blksz)
+{
+	lbaint_t per_line = _stats.max_blocks_per_entry;
+	struct block_cache_line *line;
+	lbaint_t blk, end;
+
+	if (!lines || !_stats.entries)
+		return;
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	if (blkcnt > (lbaint_t)sets * ways * per_line) {
+		blkcache_invalidate(iftype, devnum);
+		return;
+	}
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	end = start + blkcnt;
+	for (blk = start - start % per_line; blk < end; blk += per_line) {
+		line = cache_find(iftype, devnum, blk, blksz);
+		if (line) {
+			line->age = 0;
+			_stats.entries--;
+		}
+	}
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	int i;
+
+	bdev = cache_dev(iftype, devnum);
+	if (bdev)
+		bdev->next = 0;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
+	if (!lines)
+		return;
+
+	for (i = 0; i < sets * ways; i++) {
+		if (lines[i].age && lines[i].iftype == iftype &&
+		    lines[i].devnum == devnum) {
+			lines[i].age = 0;
 			--_stats.entries;
 		}
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_configure(unsigned blocks, unsigned entries, unsigned readahead)
 {
-	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+
+	/* Lines of no blocks cannot hold anything */
+	if (!blocks && (entries || readahead))
+		return -EINVAL;
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries)) {
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+		cache_free();
 	}
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	_stats.readahead = readahead;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	list_for_each_entry(bdev, &block_cache_devs, lh)
+		bdev->next = 0;
+
+	return 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -170,3 +460,22 @@ void blkcache_stats(struct block_cache_stats *stats)
 	_stats.hits = 0;
 	_stats.misses = 0;
 }
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh) {
+		if (index--)
+			continue;
+		memcpy(stats, &bdev->stats, sizeof(*stats));
+		bdev->stats.hits = 0;
+		bdev->stats.misses = 0;
+		bdev->stats.readahead = 0;
+		bdev->stats.writes = 0;
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
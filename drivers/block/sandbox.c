@@ -53,6 +53,7 @@ static unsigned long host_block_read(struct blk_desc *block_dev,
 		printf("ERROR: Invalid block %lx\n", start);
 		return -1;
 	}
+	host_dev->reads++;
 	ssize_t len = os_read(host_dev->fd, buffer, blkcnt * block_dev->blksz);
 	if (len >= 0)
 		return len / block_dev->blksz;
@@ -163,6 +164,7 @@ int host_dev_bind(int dev, char *filename)
 	}
 	if (host_dev->filename)
 		free(host_dev->filename);
+	host_dev->reads = 0;
 	if (filename && *filename) {
 		host_dev->filename = strdup(filename);
 	} else {
@@ -218,15 +220,77 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+/*
+ * Asynchronous requests are queued and carried out one at a time by
+ * host_block_poll(), so that callers see them complete later, as with a real
+ * device
+ */
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	list_add_tail(&req->sibling, &host_dev->reqs);
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_req *req;
+	long ret;
+
+	if (list_empty(&host_dev->reqs))
+		return 0;
+
+	req = list_first_entry(&host_dev->reqs, struct blk_req, sibling);
+	list_del(&req->sibling);
+	if (req->op == BLK_REQ_READ)
+		ret = host_block_read(dev, req->start, req->blkcnt,
+				      req->buffer);
+	else
+		ret = host_block_write(dev, req->start, req->blkcnt,
+				       req->buffer);
+	blk_req_complete(req, ret);
+
+	return !list_empty(&host_dev->reqs);
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	INIT_LIST_HEAD(&host_dev->reqs);
+
+	return 0;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_req *req, *next;
+
+	list_for_each_entry_safe(req, next, &host_dev->reqs, sibling) {
+		list_del(&req->sibling);
+		blk_req_complete(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
+	.remove		= host_block_remove,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
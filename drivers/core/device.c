@@ -567,6 +567,7 @@ int device_get_child(struct udevice *parent, int index, struct udevice **devp)
 {
 	struct udevice *dev;
 
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if (!index--)
 			return device_get_device_tail(dev, 0, devp);
@@ -580,6 +581,7 @@ int device_get_child_count(struct udevice *parent)
 	struct udevice *dev;
 	int count = 0;
 
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node)
 		count++;
 
@@ -595,6 +597,7 @@ int device_find_child_by_seq(struct udevice *parent, int seq_or_req_seq,
 	if (seq_or_req_seq == -1)
 		return -ENODEV;
 
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
 				seq_or_req_seq) {
@@ -631,6 +634,7 @@ int device_find_child_by_of_offset(struct udevice *parent, int of_offset,
 
 	*devp = NULL;
 
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if (dev_of_offset(dev) == of_offset) {
 			*devp = dev;
@@ -671,6 +675,7 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
+	dm_lazy_bind_node(ofnode);
 	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 
 	return *devp ? 0 : -ENOENT;
@@ -680,12 +685,14 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
 
+	dm_lazy_bind_node(ofnode);
 	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
 
 int device_find_first_child(struct udevice *parent, struct udevice **devp)
 {
+	dm_lazy_bind_children(parent);
 	if (list_empty(&parent->child_head)) {
 		*devp = NULL;
 	} else {
@@ -718,6 +725,7 @@ int device_find_first_inactive_child(struct udevice *parent,
 	struct udevice *dev;
 
 	*devp = NULL;
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if (!device_active(dev) &&
 		    device_get_uclass_id(dev) == uclass_id) {
@@ -736,6 +744,7 @@ int device_find_first_child_by_uclass(struct udevice *parent,
 	struct udevice *dev;
 
 	*devp = NULL;
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if (device_get_uclass_id(dev) == uclass_id) {
 			*devp = dev;
@@ -753,6 +762,7 @@ int device_find_child_by_name(struct udevice *parent, const char *name,
 
 	*devp = NULL;
 
+	dm_lazy_bind_children(parent);
 	list_for_each_entry(dev, &parent->child_head, sibling_node) {
 		if (!strcmp(dev->name, name)) {
 			*devp = dev;
@@ -829,15 +839,29 @@ void device_set_name_alloced(struct udevice *dev)
 
 int device_set_name(struct udevice *dev, const char *name)
 {
+	bool indexed;
+
 	name = strdup(name);
 	if (!name)
 		return -ENOMEM;
+	indexed = uclass_index_del(dev);
 	dev->name = name;
+	if (indexed)
+		uclass_index_add(dev);
 	device_set_name_alloced(dev);
 
 	return 0;
 }
 
+void dev_set_ofnode(struct udevice *dev, ofnode node)
+{
+	bool indexed = uclass_index_del(dev);
+
+	dev->node = node;
+	if (indexed)
+		uclass_index_add(dev);
+}
+
 #if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
 bool device_is_compatible(struct udevice *dev, const char *compat)
 {
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Binding device-tree devices only when they are needed
+ *
+ * With lazy binding, scanning the device tree records each node instead of
+ * binding it, along with the uclasses that the node and the nodes below it
+ * could provide. A recorded node is bound when one of those uclasses is used,
+ * when the children of its parent are looked up or when its own node (or a
+ * node below it) is looked up. Binding a node may record more nodes, e.g. when
+ * a bus scans its children, and these are bound in the same way.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/util.h>
+#include <linux/list.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of words in a bitmap of uclass IDs, as used by lists_uclass_fdt() */
+#define DM_LAZY_ID_WORDS	DIV_ROUND_UP(UCLASS_COUNT, 32)
+
+static bool dm_lazy_test_id(const u32 *ids, enum uclass_id id)
+{
+	return ids[id / 32] & BIT(id % 32);
+}
+
+/**
+ * struct dm_lazy_node - a device-tree node which has not been bound yet
+ *
+ * @sibling: Node in the list of recorded nodes, in the order they were found
+ * @parent: Parent device for the device which will be created
+ * @node: Device-tree node to bind
+ * @pre_reloc_only: Value to pass to lists_bind_fdt()
+ * @id: uclass of the first driver which matches the node, for display
+ * @ids: uclasses which the node and the nodes below it could provide
+ */
+struct dm_lazy_node {
+	struct list_head sibling;
+	struct udevice *parent;
+	ofnode node;
+	bool pre_reloc_only;
+	enum uclass_id id;
+	u32 ids[DM_LAZY_ID_WORDS];
+};
+
+/**
+ * struct dm_lazy - state of lazy binding
+ *
+ * @head: List of recorded nodes (struct dm_lazy_node)
+ * @ids: uclasses which any recorded node could provide, so that uclasses with
+ *	nothing recorded can be skipped quickly
+ * @busy: uclasses whose recorded nodes are being bound, so that binding a node
+ *	does not bind the later nodes of the same uclass before it
+ */
+struct dm_lazy {
+	struct list_head head;
+	u32 ids[DM_LAZY_ID_WORDS];
+	u32 busy[DM_LAZY_ID_WORDS];
+};
+
+int dm_lazy_init(void)
+{
+	struct dm_lazy *lazy;
+
+	if (gd->dm_lazy)
+		return 0;
+	lazy = calloc(1, sizeof(*lazy));
+	if (!lazy)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&lazy->head);
+	gd->dm_lazy = lazy;
+
+	return 0;
+}
+
+/* Add the uclasses which the nodes below @node could provide to @ids */
+static void dm_lazy_scan_subnodes(ofnode node, bool pre_reloc_only, u32 *ids)
+{
+	ofnode subnode;
+
+	ofnode_for_each_subnode(subnode, node) {
+		if (!ofnode_is_available(subnode))
+			continue;
+		lists_uclass_fdt(subnode, pre_reloc_only, ids);
+		dm_lazy_scan_subnodes(subnode, pre_reloc_only, ids);
+	}
+}
+
+int dm_lazy_add(struct udevice *parent, ofnode node, bool pre_reloc_only)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	u32 ids[DM_LAZY_ID_WORDS] = { 0 };
+	struct dm_lazy_node *ln;
+	int i;
+
+	if (!lazy)
+		return lists_bind_fdt(parent, node, NULL, pre_reloc_only);
+
+	/* If no driver matches, lists_bind_fdt() would not bind anything */
+	if (!lists_uclass_fdt(node, pre_reloc_only, ids))
+		return 0;
+
+	ln = calloc(1, sizeof(*ln));
+	if (!ln)
+		return -ENOMEM;
+	for (ln->id = 0; !dm_lazy_test_id(ids, ln->id); ln->id++)
+		;
+	memcpy(ln->ids, ids, sizeof(ids));
+	dm_lazy_scan_subnodes(node, pre_reloc_only, ln->ids);
+
+	ln->parent = parent;
+	ln->node = node;
+	ln->pre_reloc_only = pre_reloc_only;
+	for (i = 0; i < DM_LAZY_ID_WORDS; i++)
+		lazy->ids[i] |= ln->ids[i];
+	list_add_tail(&ln->sibling, &lazy->head);
+	parent->flags |= DM_FLAG_LAZY_CHILDREN;
+	log_debug("record node %s\n", ofnode_get_name(node));
+
+	return 0;
+}
+
+/* Bind a recorded node, removing it from the list */
+static int dm_lazy_bind(struct dm_lazy_node *ln)
+{
+	int ret;
+
+	list_del(&ln->sibling);
+	log_debug("bind node %s\n", ofnode_get_name(ln->node));
+	ret = lists_bind_fdt(ln->parent, ln->node, NULL, ln->pre_reloc_only);
+	if (ret)
+		dm_warn("Error binding node '%s': %d\n",
+			ofnode_get_name(ln->node), ret);
+	free(ln);
+
+	return ret;
+}
+
+/*
+ * Binding a node can bind or record any number of other nodes, so each of the
+ * functions below looks for the next node to bind from the start of the list.
+ */
+
+void dm_lazy_bind_uclass(enum uclass_id id)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct dm_lazy_node *ln;
+	bool found;
+
+	if (!lazy || (uint)id >= UCLASS_COUNT ||
+	    !dm_lazy_test_id(lazy->ids, id) || dm_lazy_test_id(lazy->busy, id))
+		return;
+
+	lazy->busy[id / 32] |= BIT(id % 32);
+	do {
+		found = false;
+		list_for_each_entry(ln, &lazy->head, sibling) {
+			if (dm_lazy_test_id(ln->ids, id)) {
+				dm_lazy_bind(ln);
+				found = true;
+				break;
+			}
+		}
+	} while (found);
+	lazy->busy[id / 32] &= ~BIT(id % 32);
+	lazy->ids[id / 32] &= ~BIT(id % 32);
+}
+
+void dm_lazy_bind_children(struct udevice *parent)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct dm_lazy_node *ln;
+	bool found;
+
+	if (!lazy || !(parent->flags & DM_FLAG_LAZY_CHILDREN))
+		return;
+
+	parent->flags &= ~DM_FLAG_LAZY_CHILDREN;
+	do {
+		found = false;
+		list_for_each_entry(ln, &lazy->head, sibling) {
+			if (ln->parent == parent) {
+				dm_lazy_bind(ln);
+				found = true;
+				break;
+			}
+		}
+	} while (found);
+}
+
+/* Check if @node is @ancestor or is below it */
+static bool dm_lazy_node_within(ofnode node, ofnode ancestor)
+{
+	for (; ofnode_valid(node); node = ofnode_get_parent(node)) {
+		if (ofnode_equal(node, ancestor))
+			return true;
+	}
+
+	return false;
+}
+
+void dm_lazy_bind_node(ofnode node)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct dm_lazy_node *ln;
+	bool found;
+
+	if (!lazy)
+		return;
+
+	do {
+		found = false;
+		list_for_each_entry(ln, &lazy->head, sibling) {
+			if (dm_lazy_node_within(node, ln->node)) {
+				dm_lazy_bind(ln);
+				found = true;
+				break;
+			}
+		}
+	} while (found);
+}
+
+void dm_lazy_forget(struct udevice *parent)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct dm_lazy_node *ln, *next;
+
+	if (!lazy || !(parent->flags & DM_FLAG_LAZY_CHILDREN))
+		return;
+
+	list_for_each_entry_safe(ln, next, &lazy->head, sibling) {
+		if (ln->parent == parent) {
+			list_del(&ln->sibling);
+			free(ln);
+		}
+	}
+	parent->flags &= ~DM_FLAG_LAZY_CHILDREN;
+}
+
+int dm_lazy_bind_all(void)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct dm_lazy_node *ln;
+	int ret = 0, err;
+
+	if (!lazy)
+		return 0;
+
+	while (!list_empty(&lazy->head)) {
+		ln = list_first_entry(&lazy->head, struct dm_lazy_node,
+				      sibling);
+		err = dm_lazy_bind(ln);
+		if (err && !ret)
+			ret = err;
+	}
+	gd->dm_lazy = NULL;
+	free(lazy);
+
+	return ret;
+}
+
+void dm_dump_unbound(void)
+{
+	struct dm_lazy *lazy = gd->dm_lazy;
+	struct uclass_driver *uc_drv;
+	struct dm_lazy_node *ln;
+	int count = 0;
+
+	if (!lazy) {
+		printf("Lazy binding is not active\n");
+		return;
+	}
+
+	printf(" Class       Parent                Node\n");
+	printf("-----------------------------------------------------------\n");
+	list_for_each_entry(ln, &lazy->head, sibling) {
+		uc_drv = lists_uclass_lookup(ln->id);
+		printf(" %-10.10s  %-20.20s  %s\n",
+		       uc_drv ? uc_drv->name : "?", ln->parent->name,
+		       ofnode_get_name(ln->node));
+		count++;
+	}
+	printf("%d node%s not bound\n", count, count == 1 ? "" : "s");
+}
@@ -206,4 +206,38 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 
 	return result;
 }
+
+int lists_uclass_fdt(ofnode node, bool pre_reloc_only, u32 *ids)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id;
+	struct driver *entry;
+	const char *compat_list, *compat;
+	int compat_length, i;
+	int count = 0;
+
+	compat_list = ofnode_get_property(node, "compatible", &compat_length);
+	if (!compat_list)
+		return 0;
+
+	for (i = 0; i < compat_length; i += strlen(compat) + 1) {
+		compat = compat_list + i;
+		for (entry = driver; entry != driver + n_ents; entry++) {
+			if (!driver_check_compatible(entry->of_match, &id,
+						     compat))
+				break;
+		}
+		if (entry == driver + n_ents)
+			continue;
+
+		if (pre_reloc_only && !dm_ofnode_pre_reloc(node) &&
+		    !(entry->flags & DM_FLAG_PRE_RELOC))
+			break;
+		ids[entry->id / 32] |= BIT(entry->id % 32);
+		count++;
+	}
+
+	return count;
+}
 #endif
@@ -25,6 +25,8 @@
 #include <linux/ctype.h>
 #include <linux/err.h>
 #include <linux/ioport.h>
+#include <linux/log2.h>
+#include <malloc.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -43,6 +45,18 @@ static struct device_node *of_stdout;
 /* pointer to options given after the alias (separated by :) or NULL if none */
 static const char *of_stdout_options;
 
+/*
+ * Hash table of nodes with a phandle, indexed by the low bits of the phandle
+ * with linear probing. Since dtc numbers phandles from 1, these rarely clash.
+ */
+static struct device_node **phandle_cache;
+
+/* Number of slots in phandle_cache minus one (the size is a power of two) */
+static uint phandle_cache_mask;
+
+/* Root of the tree that phandle_cache was built for */
+static struct device_node *phandle_cache_root;
+
 /**
  * struct alias_prop - Alias property in 'aliases' node
  *
@@ -403,13 +417,65 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 	return np;
 }
 
+int of_phandle_cache_build(struct device_node *root)
+{
+	struct device_node *np;
+	uint count = 0, size, i;
+
+	free(phandle_cache);
+	phandle_cache = NULL;
+	phandle_cache_root = NULL;
+	if (!root)
+		return 0;
+
+	for (np = root; np; np = of_find_all_nodes(np))
+		if (np->phandle)
+			count++;
+	if (!count)
+		return 0;
+
+	/* Keep the table at most half full so that probe chains stay short */
+	size = roundup_pow_of_two(count * 2);
+	phandle_cache = calloc(size, sizeof(*phandle_cache));
+	if (!phandle_cache)
+		return -ENOMEM;
+	phandle_cache_mask = size - 1;
+	phandle_cache_root = root;
+
+	/* Earlier nodes come first in each chain, as with a walk of the tree */
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		if (!np->phandle)
+			continue;
+		for (i = np->phandle & phandle_cache_mask; phandle_cache[i];
+		     i = (i + 1) & phandle_cache_mask)
+			;
+		phandle_cache[i] = np;
+	}
+
+	return 0;
+}
+
 struct device_node *of_find_node_by_phandle(phandle handle)
 {
 	struct device_node *np;
+	uint i;
 
 	if (!handle)
 		return NULL;
 
+	if (phandle_cache && phandle_cache_root == gd->of_root) {
+		for (i = handle & phandle_cache_mask; phandle_cache[i];
+		     i = (i + 1) & phandle_cache_mask) {
+			np = phandle_cache[i];
+			if (np->phandle == handle)
+				return of_node_get(np);
+		}
+	}
+
+	/*
+	 * Not in the table, so search the tree in case a node has gained a
+	 * phandle since the table was built
+	 */
 	for_each_of_allnodes(np)
 		if (np->phandle == handle)
 			break;
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <linux/libfdt.h>
 #include <dm/of_access.h>
@@ -230,8 +231,8 @@ ofnode ofnode_get_by_phandle(uint phandle)
 	if (of_live_active())
 		node = np_to_ofnode(of_find_node_by_phandle(phandle));
 	else
-		node.of_offset = fdt_node_offset_by_phandle(gd->fdt_blob,
-							    phandle);
+		node.of_offset = fdt_index_node_by_phandle(gd->fdt_blob,
+							   phandle);
 
 	return node;
 }
@@ -416,7 +417,8 @@ ofnode ofnode_path(const char *path)
 	if (of_live_active())
 		return np_to_ofnode(of_find_node_by_path(path));
 	else
-		return offset_to_ofnode(fdt_path_offset(gd->fdt_blob, path));
+		return offset_to_ofnode(fdt_index_path_offset(gd->fdt_blob,
+							      path));
 }
 
 const char *ofnode_get_chosen_prop(const char *name)
@@ -803,7 +805,7 @@ ofnode ofnode_by_compatible(ofnode from, const char *compat)
 			(struct device_node *)ofnode_to_np(from), NULL,
 			compat));
 	} else {
-		return offset_to_ofnode(fdt_node_offset_by_compatible(
+		return offset_to_ofnode(fdt_index_node_by_compatible(
 				gd->fdt_blob, ofnode_to_offset(from), compat));
 	}
 }
@@ -138,6 +138,10 @@ int dm_init(bool of_live)
 		return -EINVAL;
 	}
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+	/* Any nodes recorded before relocation refer to the old devices */
+	gd->dm_lazy = NULL;
+#endif
 
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
 	fix_drivers();
@@ -168,6 +172,10 @@ int dm_uninit(void)
 	device_remove(dm_root(), DM_REMOVE_NORMAL);
 	device_unbind(dm_root());
 	gd->dm_root = NULL;
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+	free(gd->dm_lazy);
+	gd->dm_lazy = NULL;
+#endif
 
 	return 0;
 }
@@ -194,6 +202,18 @@ int dm_scan_platdata(bool pre_reloc_only)
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
+/* Bind a node, or record it to be bound when needed if binding lazily */
+static int dm_scan_bind_node(struct udevice *parent, ofnode node,
+			     bool pre_reloc_only)
+{
+	if (CONFIG_IS_ENABLED(DM_LAZY_BIND))
+		return dm_lazy_add(parent, node, pre_reloc_only);
+
+	return lists_bind_fdt(parent, node, NULL, pre_reloc_only);
+}
+#endif
+
 #if CONFIG_IS_ENABLED(OF_LIVE)
 static int dm_scan_fdt_live(struct udevice *parent,
 			    const struct device_node *node_parent,
@@ -217,8 +237,8 @@ static int dm_scan_fdt_live(struct udevice *parent,
 			pr_debug("   - ignoring disabled device\n");
 			continue;
 		}
-		err = lists_bind_fdt(parent, np_to_ofnode(np), NULL,
-				     pre_reloc_only);
+		err = dm_scan_bind_node(parent, np_to_ofnode(np),
+					pre_reloc_only);
 		if (err && !ret) {
 			ret = err;
 			debug("%s: ret=%d\n", np->name, ret);
@@ -275,8 +295,8 @@ static int dm_scan_fdt_node(struct udevice *parent, const void *blob,
 			pr_debug("   - ignoring disabled device\n");
 			continue;
 		}
-		err = lists_bind_fdt(parent, offset_to_ofnode(offset), NULL,
-				     pre_reloc_only);
+		err = dm_scan_bind_node(parent, offset_to_ofnode(offset),
+					pre_reloc_only);
 		if (err && !ret) {
 			ret = err;
 			debug("%s: ret=%d\n", node_name, ret);
@@ -376,6 +396,9 @@ int dm_init_and_scan(bool pre_reloc_only)
 	}
 
 	if (CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)) {
+		ret = dm_lazy_init();
+		if (ret)
+			return ret;
 		ret = dm_extended_scan_fdt(gd->fdt_blob, pre_reloc_only);
 		if (ret) {
 			debug("dm_extended_scan_dt() failed: %d\n", ret);
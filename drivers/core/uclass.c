@@ -132,6 +132,9 @@ int uclass_destroy(struct uclass *uc)
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	free(uc->index);
+#endif
 	free(uc);
 
 	return 0;
@@ -142,6 +145,7 @@ int uclass_get(enum uclass_id id, struct uclass **ucp)
 	struct uclass *uc;
 
 	*ucp = NULL;
+	dm_lazy_bind_uclass(id);
 	uc = uclass_find(id);
 	if (!uc)
 		return uclass_add(id, ucp);
@@ -247,6 +251,265 @@ int uclass_find_next_device(struct udevice **devp)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/* Number of devices a uclass must have before it is worth indexing */
+#define UCLASS_INDEX_MIN	16
+
+/**
+ * struct uclass_index - hash tables of the devices in a uclass
+ *
+ * Each table has 1 << @bits buckets. A device whose name or node changes is
+ * moved to the right bucket by device_set_name() and dev_set_ofnode().
+ *
+ * @count: Number of devices in the index
+ * @bits: Number of bits in a bucket number
+ * @by_name: Devices hashed by name
+ * @by_node: Devices hashed by device-tree node
+ * @by_phandle: Devices hashed by the phandle of their node, if they have one
+ */
+struct uclass_index {
+	int count;
+	int bits;
+	struct hlist_head *by_name;
+	struct hlist_head *by_node;
+	struct hlist_head *by_phandle;
+};
+
+static uint uclass_index_bucket(struct uclass_index *idx, u32 key)
+{
+	return (key * 0x9e3779b9U) >> (32 - idx->bits);
+}
+
+static u32 uclass_index_name_key(const char *name)
+{
+	u32 key = 2166136261U;
+
+	while (*name) {
+		key ^= (unsigned char)*name++;
+		key *= 16777619;
+	}
+
+	return key;
+}
+
+static u32 uclass_index_node_key(ofnode node)
+{
+	u64 val = (ulong)node.of_offset;
+
+	return (u32)val ^ (u32)(val >> 32);
+}
+
+static uint uclass_index_phandle(struct udevice *dev)
+{
+#if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
+	if (dev_has_of_node(dev))
+		return dev_read_phandle(dev);
+#endif
+	return 0;
+}
+
+/* Add a node to the end of a hash chain, so that earlier devices come first */
+static void uclass_index_add_tail(struct hlist_node *node,
+				  struct hlist_head *head)
+{
+	struct hlist_node *last;
+
+	if (!head->first) {
+		hlist_add_head(node, head);
+		return;
+	}
+	for (last = head->first; last->next; last = last->next)
+		;
+	hlist_add_after(last, node);
+}
+
+static void uclass_index_insert(struct uclass_index *idx, struct udevice *dev)
+{
+	uint phandle;
+	u32 key;
+
+	key = uclass_index_name_key(dev->name);
+	uclass_index_add_tail(&dev->name_hash_node,
+			      &idx->by_name[uclass_index_bucket(idx, key)]);
+	if (dev_has_of_node(dev)) {
+		key = uclass_index_node_key(dev_ofnode(dev));
+		uclass_index_add_tail(&dev->node_hash_node,
+				&idx->by_node[uclass_index_bucket(idx, key)]);
+	}
+	phandle = uclass_index_phandle(dev);
+	if (phandle) {
+		uclass_index_add_tail(&dev->phandle_hash_node,
+				&idx->by_phandle[uclass_index_bucket(idx,
+								     phandle)]);
+	}
+	idx->count++;
+}
+
+/**
+ * uclass_index_build() - (re)create the index of a uclass
+ *
+ * @uc: uclass to index
+ * @bits: Number of bits in a bucket number
+ * @return 0 if OK, -ENOMEM if out of memory (the old index is kept)
+ */
+static int uclass_index_build(struct uclass *uc, int bits)
+{
+	struct uclass_index *idx;
+	struct udevice *dev;
+	int buckets = 1 << bits;
+
+	idx = calloc(1, sizeof(*idx) + 3 * buckets * sizeof(struct hlist_head));
+	if (!idx)
+		return -ENOMEM;
+	idx->bits = bits;
+	idx->by_name = (struct hlist_head *)(idx + 1);
+	idx->by_node = idx->by_name + buckets;
+	idx->by_phandle = idx->by_node + buckets;
+
+	uclass_foreach_dev(dev, uc) {
+		INIT_HLIST_NODE(&dev->name_hash_node);
+		INIT_HLIST_NODE(&dev->node_hash_node);
+		INIT_HLIST_NODE(&dev->phandle_hash_node);
+		uclass_index_insert(idx, dev);
+	}
+	free(uc->index);
+	uc->index = idx;
+	log_debug("uclass %s: %d devices, %d buckets\n", uc->uc_drv->name,
+		  idx->count, buckets);
+
+	return 0;
+}
+
+/* Add a newly bound device to the index, creating or growing it if needed */
+static void uclass_index_bind(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+	struct uclass_index *idx = uc->index;
+	struct list_head *pos;
+	int count = 0;
+
+	if (idx && idx->count < 2 << idx->bits) {
+		uclass_index_insert(idx, dev);
+		return;
+	}
+	if (!idx) {
+		list_for_each(pos, &uc->dev_head) {
+			if (++count == UCLASS_INDEX_MIN)
+				break;
+		}
+		if (count < UCLASS_INDEX_MIN)
+			return;
+	}
+
+	/*
+	 * The device is already in the list, so it is indexed with the rest.
+	 * If there is no memory for a bigger index, keep using the old one.
+	 */
+	if (uclass_index_build(uc, idx ? idx->bits + 2 : 5) && idx)
+		uclass_index_insert(idx, dev);
+}
+
+bool uclass_index_del(struct udevice *dev)
+{
+	struct uclass_index *idx = dev->uclass->index;
+
+	if (!idx || hlist_unhashed(&dev->name_hash_node))
+		return false;
+	hlist_del_init(&dev->name_hash_node);
+	hlist_del_init(&dev->node_hash_node);
+	hlist_del_init(&dev->phandle_hash_node);
+	idx->count--;
+
+	return true;
+}
+
+void uclass_index_add(struct udevice *dev)
+{
+	if (dev->uclass->index)
+		uclass_index_insert(dev->uclass->index, dev);
+}
+
+static int uclass_index_find_name(struct uclass *uc, const char *name,
+				  struct udevice **devp)
+{
+	struct uclass_index *idx = uc->index;
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->by_name[uclass_index_bucket(idx,
+				uclass_index_name_key(name))], name_hash_node) {
+		if (!strcmp(dev->name, name)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int uclass_index_find_node(struct uclass *uc, ofnode node,
+				  struct udevice **devp)
+{
+	struct uclass_index *idx = uc->index;
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->by_node[uclass_index_bucket(idx,
+				uclass_index_node_key(node))], node_hash_node) {
+		if (ofnode_equal(dev_ofnode(dev), node)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int __maybe_unused uclass_index_find_phandle(struct uclass *uc,
+				uint phandle, struct udevice **devp)
+{
+	struct uclass_index *idx = uc->index;
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->by_phandle[uclass_index_bucket(idx,
+				phandle)], phandle_hash_node) {
+		if (uclass_index_phandle(dev) == phandle) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+#else
+static inline void uclass_index_bind(struct udevice *dev) {}
+
+static inline int uclass_index_find_name(struct uclass *uc, const char *name,
+					 struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int uclass_index_find_node(struct uclass *uc, ofnode node,
+					 struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static inline int __maybe_unused uclass_index_find_phandle(struct uclass *uc,
+				uint phandle, struct udevice **devp)
+{
+	return -ENOSYS;
+}
+#endif
+
 int uclass_find_device_by_name(enum uclass_id id, const char *name,
 			       struct udevice **devp)
 {
@@ -261,6 +524,10 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_name(uc, name, devp);
+	if (ret != -ENOSYS)
+		return ret;
+
 	uclass_foreach_dev(dev, uc) {
 		if (!strcmp(dev->name, name)) {
 			*devp = dev;
@@ -366,11 +633,16 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_node(uc, node, devp);
+	if (ret != -ENOSYS)
+		goto done;
+
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
 		if (ofnode_equal(dev_ofnode(dev), node)) {
 			*devp = dev;
+			ret = 0;
 			goto done;
 		}
 	}
@@ -399,6 +671,10 @@ int uclass_find_device_by_phandle(enum uclass_id id, struct udevice *parent,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_phandle(uc, find_phandle, devp);
+	if (ret != -ENOSYS)
+		return ret;
+
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
 
@@ -526,6 +802,12 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find_phandle(uc, phandle_id, &dev);
+	if (!ret)
+		return uclass_get_device_tail(dev, 0, devp);
+	if (ret != -ENOSYS)
+		return ret;
+
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
 
@@ -533,7 +815,7 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 
 		if (phandle == phandle_id) {
 			*devp = dev;
-			return uclass_get_device_tail(dev, ret, devp);
+			return uclass_get_device_tail(dev, 0, devp);
 		}
 	}
 
@@ -636,6 +918,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_bind(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -650,6 +933,7 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	uclass_index_del(dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -668,6 +952,7 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
+	uclass_index_del(dev);
 	list_del(&dev->uclass_node);
 	return 0;
 }
@@ -30,6 +30,8 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+	mmc_cmdq_prepare_cmd(mmc, cmd);
+
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
@@ -136,6 +138,35 @@ int mmc_host_power_cycle(struct mmc *mmc)
 	return dm_mmc_host_power_cycle(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+int dm_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_enable)
+		return -ENOSYS;
+	return ops->cqe_enable(dev, enable);
+}
+
+int dm_mmc_cqe_submit(struct udevice *dev, struct mmc_cmdq_task *task)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_submit)
+		return -ENOSYS;
+	return ops->cqe_submit(dev, task);
+}
+
+int dm_mmc_cqe_poll(struct udevice *dev)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_poll)
+		return -ENOSYS;
+	return ops->cqe_poll(dev);
+}
+#endif
+
 int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 {
 	int val;
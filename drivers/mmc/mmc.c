@@ -452,6 +452,9 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		return 0;
 	}
 
+	if (!mmc_cmdq_enable(mmc))
+		return mmc_cmdq_read(mmc, start, blkcnt, dst);
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		pr_debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
@@ -2353,6 +2356,20 @@ static int mmc_startup_v4(struct mmc *mmc)
 
 	mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
 
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	/*
+	 * Only note whether command queuing can be used here. Most commands,
+	 * including SEND_EXT_CSD, are not allowed once it is enabled, so that
+	 * waits until the first block transfer.
+	 */
+	if (mmc->version >= MMC_VERSION_5_1 && mmc->high_capacity &&
+	    mmc->read_bl_len == MMC_MAX_BLOCK_LEN &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & EXT_CSD_CMDQ_SUPPORTED) &&
+	    (mmc->host_caps & MMC_CAP_CMDQ))
+		mmc->cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				   EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+#endif
+
 	return 0;
 error:
 	if (mmc->ext_csd) {
@@ -2538,6 +2555,9 @@ static int mmc_startup(struct mmc *mmc)
 	mmc->erase_grp_size = 1;
 #endif
 	mmc->part_config = MMCPART_NOAVAILABLE;
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	mmc->cmdq_depth = 0;
+#endif
 
 	err = mmc_startup_v4(mmc);
 	if (err)
@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * eMMC command queuing
+ *
+ * An eMMC 5.1 device with command queuing enabled accepts up to 32 read and
+ * write tasks at once and carries them out in whatever order suits it. The
+ * host's command queue engine (CQE) sends the tasks and reports when each one
+ * completes, so block transfers are split into tasks which are kept queued
+ * until all are done.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <mmc.h>
+#include <time.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include "mmc_private.h"
+
+/* The block count in a task descriptor has 16 bits */
+#define MMC_CMDQ_MAX_BLKS	0xffff
+
+/* Give up if no task completes for this long */
+#define MMC_CMDQ_TIMEOUT_MS	10000
+
+int mmc_cmdq_enable(struct mmc *mmc)
+{
+	int ret;
+
+	if (!mmc->cmdq_depth)
+		return -ENOSYS;
+
+	/* Queued tasks cannot access the RPMB partition */
+	if (mmc_get_blk_desc(mmc)->hwpart == MMC_PART_RPMB)
+		return -EACCES;
+
+	if (!mmc->cmdq_en) {
+		ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CMDQ_MODE_EN,
+				 EXT_CSD_CMDQ_MODE_ENABLED);
+		if (ret)
+			goto err;
+		mmc->cmdq_en = true;
+	}
+	if (!mmc->cqe_on) {
+		ret = dm_mmc_cqe_enable(mmc->dev, true);
+		if (ret)
+			goto err;
+		mmc->cqe_on = true;
+	}
+
+	return 0;
+err:
+	debug("%s: Cannot use command queuing (err=%d)\n", __func__, ret);
+	mmc->cmdq_depth = 0;
+
+	return ret;
+}
+
+void mmc_cmdq_prepare_cmd(struct mmc *mmc, struct mmc_cmd *cmd)
+{
+	uint index, value;
+
+	if (mmc->cqe_on) {
+		dm_mmc_cqe_enable(mmc->dev, false);
+		mmc->cqe_on = false;
+	}
+	if (!mmc->cmdq_en)
+		return;
+
+	/* These are allowed while command queuing is enabled */
+	switch (cmd->cmdidx) {
+	case MMC_CMD_SEND_STATUS:
+	case MMC_CMD_CMDQ_TASK_MGMT:
+		return;
+	case MMC_CMD_SWITCH:
+		index = (cmd->cmdarg >> 16) & 0xff;
+		value = (cmd->cmdarg >> 8) & 0xff;
+		if (index != EXT_CSD_PART_CONF ||
+		    (value & PART_ACCESS_MASK) != MMC_PART_RPMB)
+			return;
+		break;
+	}
+
+	/* GO_IDLE resets the device, which disables command queuing anyway */
+	mmc->cmdq_en = false;
+	if (cmd->cmdidx != MMC_CMD_GO_IDLE_STATE &&
+	    mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0))
+		debug("%s: Failed to disable command queuing\n", __func__);
+}
+
+/* Stop the engine and drop anything the device still has queued */
+static void mmc_cmdq_discard(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+
+	if (mmc->cqe_on) {
+		dm_mmc_cqe_enable(mmc->dev, false);
+		mmc->cqe_on = false;
+	}
+
+	cmd.cmdidx = MMC_CMD_CMDQ_TASK_MGMT;
+	cmd.cmdarg = MMC_CMDQ_DISCARD_QUEUE;
+	cmd.resp_type = MMC_RSP_R1b;
+	if (mmc_send_cmd(mmc, &cmd, NULL))
+		debug("%s: Failed to discard the queue\n", __func__);
+}
+
+static ulong mmc_cmdq_xfer(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			   const struct mmc_data *data)
+{
+	struct mmc_cmdq_stats *stats = &mmc->cmdq_stats;
+	struct mmc_cmdq_task tasks[MMC_CMDQ_MAX_DEPTH];
+	struct mmc_cmdq_task *task;
+	lbaint_t next = start, todo = blkcnt;
+	uint max_blks = min(mmc->cfg->b_max, (uint)MMC_CMDQ_MAX_BLKS);
+	ulong last_done;
+	u64 busy_start;
+	u32 busy = 0;
+	uint tag, cnt;
+	int ret;
+
+	if (start + blkcnt > mmc_get_blk_desc(mmc)->lba) {
+		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
+		       start + blkcnt, mmc_get_blk_desc(mmc)->lba);
+		return 0;
+	}
+
+	busy_start = timer_get_us();
+	last_done = get_timer(0);
+	while (todo || busy) {
+		/* Keep every free tag in use until all blocks are queued */
+		for (tag = 0; todo && tag < mmc->cmdq_depth; tag++) {
+			if (busy & BIT(tag))
+				continue;
+			task = &tasks[tag];
+			cnt = min(todo, (lbaint_t)max_blks);
+			task->tag = tag;
+			task->start = next;
+			task->data.dest = data->dest +
+				(next - start) * MMC_MAX_BLOCK_LEN;
+			task->data.flags = data->flags;
+			task->data.blocks = cnt;
+			task->data.blocksize = MMC_MAX_BLOCK_LEN;
+			task->result = 0;
+			task->complete = false;
+			ret = dm_mmc_cqe_submit(mmc->dev, task);
+			if (ret)
+				goto err;
+			busy |= BIT(tag);
+			next += cnt;
+			todo -= cnt;
+		}
+		stats->max_queued = max(stats->max_queued,
+					(uint)hweight32(busy));
+
+		ret = dm_mmc_cqe_poll(mmc->dev);
+		if (ret)
+			goto err;
+		for (tag = 0; tag < mmc->cmdq_depth; tag++) {
+			task = &tasks[tag];
+			if (!(busy & BIT(tag)) || !task->complete)
+				continue;
+			ret = task->result;
+			if (ret)
+				goto err;
+			busy &= ~BIT(tag);
+			stats->tasks++;
+			stats->blocks += task->data.blocks;
+			last_done = get_timer(0);
+		}
+		if (busy && get_timer(last_done) > MMC_CMDQ_TIMEOUT_MS) {
+			ret = -ETIMEDOUT;
+			goto err;
+		}
+	}
+	stats->busy_us += timer_get_us() - busy_start;
+
+	return blkcnt;
+err:
+	debug("%s: Transfer failed at block " LBAF " (err=%d)\n", __func__,
+	      next, ret);
+	stats->busy_us += timer_get_us() - busy_start;
+	mmc_cmdq_discard(mmc);
+
+	return 0;
+}
+
+ulong mmc_cmdq_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		    void *dst)
+{
+	struct mmc_data data;
+
+	data.dest = dst;
+	data.flags = MMC_DATA_READ;
+
+	return mmc_cmdq_xfer(mmc, start, blkcnt, &data);
+}
+
+ulong mmc_cmdq_write(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		     const void *src)
+{
+	struct mmc_data data;
+
+	data.src = src;
+	data.flags = MMC_DATA_WRITE;
+
+	return mmc_cmdq_xfer(mmc, start, blkcnt, &data);
+}
+
+void mmc_cmdq_print_stats(struct mmc *mmc)
+{
+	struct mmc_cmdq_stats *stats = &mmc->cmdq_stats;
+	u64 bytes = stats->blocks * MMC_MAX_BLOCK_LEN;
+	u64 rate = 0;
+
+	if (stats->busy_us)
+		rate = div64_u64(bytes * 1000000, stats->busy_us);
+
+	printf("Command Queue: depth %u, %s\n", mmc->cmdq_depth,
+	       mmc->cmdq_en ? "enabled" : "disabled");
+	printf("Queued Tasks: %llu, ", stats->tasks);
+	print_size(bytes, " in ");
+	printf("%llu ms (", div64_u64(stats->busy_us, 1000));
+	print_size(rate, "/s), ");
+	printf("up to %u queued\n", stats->max_queued);
+}
@@ -91,6 +91,77 @@ static inline void mmc_trace_state(struct mmc *mmc, struct mmc_cmd *cmd)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+/**
+ * mmc_cmdq_enable() - Put a device into command queue mode if possible
+ *
+ * This enables command queuing on the card and starts the host's command queue
+ * engine. If this fails, command queuing is not tried again until the device
+ * is next initialised.
+ *
+ * @mmc:	MMC device
+ * @return 0 if OK, -ENOSYS if not supported, other -ve on error
+ */
+int mmc_cmdq_enable(struct mmc *mmc);
+
+/**
+ * mmc_cmdq_prepare_cmd() - Leave command queue mode before a command is sent
+ *
+ * Commands other than queued tasks cannot be sent while the host's engine is
+ * running, and most cannot be sent while command queuing is enabled on the
+ * card. This stops whichever of these is needed.
+ *
+ * @mmc:	MMC device
+ * @cmd:	Command about to be sent
+ */
+void mmc_cmdq_prepare_cmd(struct mmc *mmc, struct mmc_cmd *cmd);
+
+/**
+ * mmc_cmdq_read() - Read blocks using queued tasks
+ *
+ * @mmc:	MMC device, which must be in command queue mode
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @dst:	Buffer for the data
+ * @return number of blocks read, 0 on error
+ */
+ulong mmc_cmdq_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		    void *dst);
+
+/**
+ * mmc_cmdq_write() - Write blocks using queued tasks
+ *
+ * @mmc:	MMC device, which must be in command queue mode
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks to write
+ * @src:	Data to write
+ * @return number of blocks written, 0 on error
+ */
+ulong mmc_cmdq_write(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		     const void *src);
+#else
+static inline int mmc_cmdq_enable(struct mmc *mmc)
+{
+	return -ENOSYS;
+}
+
+static inline void mmc_cmdq_prepare_cmd(struct mmc *mmc, struct mmc_cmd *cmd)
+{
+}
+
+static inline ulong mmc_cmdq_read(struct mmc *mmc, lbaint_t start,
+				  lbaint_t blkcnt, void *dst)
+{
+	return 0;
+}
+
+static inline ulong mmc_cmdq_write(struct mmc *mmc, lbaint_t start,
+				   lbaint_t blkcnt, const void *src)
+{
+	return 0;
+}
+#endif
+
 /**
  * mmc_get_next_devnum() - Get the next available MMC device number
  *
@@ -206,6 +206,9 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (err < 0)
 		return 0;
 
+	if (!mmc_cmdq_enable(mmc))
+		return mmc_cmdq_write(mmc, start, blkcnt, src);
+
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
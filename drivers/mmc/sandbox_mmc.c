@@ -8,14 +8,158 @@
 #include <dm.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <asm/test.h>
 
+#define SANDBOX_EMMC_BLOCKS	2048
+#define SANDBOX_EMMC_B_MAX	16
+#define SANDBOX_EMMC_CMDQ_DEPTH	16
+#define SANDBOX_EMMC_LOG_SIZE	256
+
+enum {
+	SANDBOX_MMC_SD,
+	SANDBOX_MMC_EMMC,
+};
+
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
 };
 
+/**
+ * struct sandbox_mmc_priv - State of an emulated eMMC device
+ *
+ * @buf: Contents of the user area
+ * @ext_csd: Extended CSD register
+ * @cqe_on: true if the host's command queue engine is running
+ * @tasks: Task queued with each tag, NULL if none
+ * @order: Tags of the queued tasks, in the order they were submitted
+ * @queued: Number of entries in @order
+ * @log_tag: Tag of each task carried out, in order
+ * @log_start: First block of each task carried out
+ * @log_count: Number of entries in @log_tag and @log_start
+ */
+struct sandbox_mmc_priv {
+	u8 *buf;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	bool cqe_on;
+	struct mmc_cmdq_task *tasks[SANDBOX_EMMC_CMDQ_DEPTH];
+	uint order[SANDBOX_EMMC_CMDQ_DEPTH];
+	uint queued;
+	uint log_tag[SANDBOX_EMMC_LOG_SIZE];
+	uint log_start[SANDBOX_EMMC_LOG_SIZE];
+	uint log_count;
+};
+
+static int sandbox_emmc_xfer(struct sandbox_mmc_priv *priv, uint start,
+			     struct mmc_data *data)
+{
+	u8 *ptr = priv->buf + start * MMC_MAX_BLOCK_LEN;
+	uint size;
+
+	if (!data || data->blocksize != MMC_MAX_BLOCK_LEN ||
+	    start + data->blocks > SANDBOX_EMMC_BLOCKS)
+		return -EIO;
+	size = data->blocks * MMC_MAX_BLOCK_LEN;
+	if (data->flags & MMC_DATA_READ)
+		memcpy(data->dest, ptr, size);
+	else
+		memcpy(ptr, data->src, size);
+
+	return 0;
+}
+
+static void sandbox_emmc_discard(struct sandbox_mmc_priv *priv)
+{
+	memset(priv->tasks, '\0', sizeof(priv->tasks));
+	priv->queued = 0;
+}
+
+/**
+ * sandbox_emmc_send_cmd() - Emulate eMMC commands
+ *
+ * This emulates an eMMC 5.1 device which supports command queuing. Only the
+ * commands needed by the MMC core are implemented.
+ */
+static int sandbox_emmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u8 *ext_csd = priv->ext_csd;
+	uint index;
+
+	/* The host cannot send commands while its engine is running */
+	if (priv->cqe_on)
+		return -EBUSY;
+	if (ext_csd[EXT_CSD_CMDQ_MODE_EN] & EXT_CSD_CMDQ_MODE_ENABLED) {
+		switch (cmd->cmdidx) {
+		case MMC_CMD_GO_IDLE_STATE:
+		case MMC_CMD_SWITCH:
+		case MMC_CMD_SEND_STATUS:
+		case MMC_CMD_CMDQ_TASK_MGMT:
+			break;
+		default:
+			debug("%s: Command %d not allowed in CMDQ mode\n",
+			      __func__, cmd->cmdidx);
+			return -EIO;
+		}
+	}
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		ext_csd[EXT_CSD_CMDQ_MODE_EN] = 0;
+		ext_csd[EXT_CSD_HS_TIMING] = 0;
+		ext_csd[EXT_CSD_BUS_WIDTH] = 0;
+		sandbox_emmc_discard(priv);
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS | MMC_VDD_32_33 |
+			MMC_VDD_33_34;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		memset(cmd->response, '\0', sizeof(cmd->response));
+		break;
+	case MMC_CMD_SET_RELATIVE_ADDR:
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_STOP_TRANSMISSION:
+	case MMC_CMD_SET_BLOCKLEN:
+		break;
+	case MMC_CMD_SEND_CSD:
+		cmd->response[0] = 4 << 26;	/* MMC version 4 */
+		cmd->response[1] = 9 << 16;	/* 1 << read block length */
+		cmd->response[2] = 1 << 16;	/* (1 + 1) << 10 blocks */
+		cmd->response[3] = 9 << 22;	/* 1 << write block length */
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* Without data this is SD_CMD_SEND_IF_COND */
+		if (!data)
+			return -ETIMEDOUT;
+		memcpy(data->dest, ext_csd, MMC_MAX_BLOCK_LEN);
+		break;
+	case MMC_CMD_SWITCH:
+		index = (cmd->cmdarg >> 16) & 0xff;
+		ext_csd[index] = (cmd->cmdarg >> 8) & 0xff;
+		break;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		return sandbox_emmc_xfer(priv, cmd->cmdarg, data);
+	case MMC_CMD_CMDQ_TASK_MGMT:
+		sandbox_emmc_discard(priv);
+		break;
+	default:
+		/* This includes the SD commands, which eMMC ignores */
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -25,6 +169,9 @@ struct sandbox_mmc_plat {
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	if (dev_get_driver_data(dev) == SANDBOX_MMC_EMMC)
+		return sandbox_emmc_send_cmd(dev, cmd, data);
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
@@ -99,19 +246,138 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+static int sandbox_emmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (enable &&
+	    !(priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] & EXT_CSD_CMDQ_MODE_ENABLED))
+		return -EIO;
+	if (!enable)
+		sandbox_emmc_discard(priv);
+	priv->cqe_on = enable;
+
+	return 0;
+}
+
+static int sandbox_emmc_cqe_submit(struct udevice *dev,
+				   struct mmc_cmdq_task *task)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cqe_on || task->tag >= SANDBOX_EMMC_CMDQ_DEPTH)
+		return -EINVAL;
+	if (priv->tasks[task->tag])
+		return -EBUSY;
+	priv->tasks[task->tag] = task;
+	priv->order[priv->queued++] = task->tag;
+
+	return 0;
+}
+
+static int sandbox_emmc_cqe_poll(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_cmdq_task *task;
+	uint tag;
+
+	if (!priv->cqe_on)
+		return -EIO;
+	if (!priv->queued)
+		return 0;
+
+	/*
+	 * Carry out one task each time, newest first, so that tasks complete
+	 * in a different order from the one they were submitted in
+	 */
+	tag = priv->order[--priv->queued];
+	task = priv->tasks[tag];
+	priv->tasks[tag] = NULL;
+	task->result = sandbox_emmc_xfer(priv, task->start, &task->data);
+	task->complete = true;
+	if (priv->log_count < SANDBOX_EMMC_LOG_SIZE) {
+		priv->log_tag[priv->log_count] = tag;
+		priv->log_start[priv->log_count++] = task->start;
+	}
+
+	return 0;
+}
+#endif
+
+uint sandbox_mmc_get_cqe_log(struct udevice *dev, uint *tags, uint *starts,
+			     uint max)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	uint count = min(priv->log_count, max);
+
+	memcpy(tags, priv->log_tag, count * sizeof(uint));
+	memcpy(starts, priv->log_start, count * sizeof(uint));
+	priv->log_count = 0;
+
+	return count;
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	.cqe_enable = sandbox_emmc_cqe_enable,
+	.cqe_submit = sandbox_emmc_cqe_submit,
+	.cqe_poll = sandbox_emmc_cqe_poll,
+#endif
 };
 
+/* Set up the device contents: each block holds its own block number */
+static int sandbox_emmc_setup(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u8 *ext_csd = priv->ext_csd;
+	u32 *ptr;
+	uint i;
+
+	priv->buf = malloc(SANDBOX_EMMC_BLOCKS * MMC_MAX_BLOCK_LEN);
+	if (!priv->buf)
+		return -ENOMEM;
+	ptr = (u32 *)priv->buf;
+	for (i = 0; i < SANDBOX_EMMC_BLOCKS * MMC_MAX_BLOCK_LEN / 4; i++)
+		ptr[i] = i * 4 / MMC_MAX_BLOCK_LEN;
+
+	ext_csd[EXT_CSD_REV] = 8;	/* eMMC 5.1 */
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52;
+	ext_csd[EXT_CSD_SEC_CNT] = SANDBOX_EMMC_BLOCKS & 0xff;
+	ext_csd[EXT_CSD_SEC_CNT + 1] = SANDBOX_EMMC_BLOCKS >> 8;
+	ext_csd[EXT_CSD_CMDQ_SUPPORT] = EXT_CSD_CMDQ_SUPPORTED;
+	ext_csd[EXT_CSD_CMDQ_DEPTH] = SANDBOX_EMMC_CMDQ_DEPTH - 1;
+
+	return 0;
+}
+
 int sandbox_mmc_probe(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	int ret;
+
+	if (dev_get_driver_data(dev) == SANDBOX_MMC_EMMC) {
+		ret = sandbox_emmc_setup(dev);
+		if (ret)
+			return ret;
+	}
 
 	return mmc_init(&plat->mmc);
 }
 
+static int sandbox_mmc_remove(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	free(priv->buf);
+
+	return 0;
+}
+
 int sandbox_mmc_bind(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
@@ -123,6 +389,11 @@ int sandbox_mmc_bind(struct udevice *dev)
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
 	cfg->b_max = U32_MAX;
+	if (dev_get_driver_data(dev) == SANDBOX_MMC_EMMC) {
+		cfg->b_max = SANDBOX_EMMC_B_MAX;
+		if (CONFIG_IS_ENABLED(MMC_CMDQ))
+			cfg->host_caps |= MMC_CAP_CMDQ;
+	}
 
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
@@ -135,7 +406,8 @@ int sandbox_mmc_unbind(struct udevice *dev)
 }
 
 static const struct udevice_id sandbox_mmc_ids[] = {
-	{ .compatible = "sandbox,mmc" },
+	{ .compatible = "sandbox,mmc", .data = SANDBOX_MMC_SD },
+	{ .compatible = "sandbox,emmc", .data = SANDBOX_MMC_EMMC },
 	{ }
 };
 
@@ -147,5 +419,7 @@ U_BOOT_DRIVER(mmc_sandbox) = {
 	.bind		= sandbox_mmc_bind,
 	.unbind		= sandbox_mmc_unbind,
 	.probe		= sandbox_mmc_probe,
+	.remove		= sandbox_mmc_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 	.platdata_auto_alloc_size = sizeof(struct sandbox_mmc_plat),
 };
@@ -14,13 +14,12 @@
 #include <dm/device-internal.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_IO_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
@@ -67,8 +66,8 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+static int nvme_setup_prps(struct nvme_dev *dev, struct nvme_io_cmd *cmd,
+			   u64 *prp2, int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
@@ -96,37 +95,38 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	nprps = DIV_ROUND_UP(length, page_size);
 	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
+	if (nprps > cmd->prp_entry_num) {
+		free(cmd->prp_pool);
 		/*
 		 * Always increase in increments of pages.  It doesn't waste
 		 * much memory and reduces the number of allocations.
 		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
+		cmd->prp_pool = memalign(page_size, num_pages * page_size);
+		if (!cmd->prp_pool) {
+			cmd->prp_entry_num = 0;
 			printf("Error: malloc prp_pool fail\n");
 			return -ENOMEM;
 		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+		cmd->prp_entry_num = prps_per_page * num_pages;
 	}
 
-	prp_pool = dev->prp_pool;
+	prp_pool = cmd->prp_pool;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
+		if (i == prps_per_page) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += page_size >> 3;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)cmd->prp_pool;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
+	flush_dcache_range((ulong)cmd->prp_pool, (ulong)cmd->prp_pool +
+			   cmd->prp_entry_num / prps_per_page * page_size);
 
 	return 0;
 }
@@ -149,12 +149,12 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -164,10 +164,36 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
 }
 
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/* Move on to the next completion queue entry */
+static void nvme_advance_cq(struct nvme_queue *nvmeq)
+{
+	if (++nvmeq->cq_head == nvmeq->q_depth) {
+		nvmeq->cq_head = 0;
+		nvmeq->cq_phase = !nvmeq->cq_phase;
+	}
+}
+
+/* Tell the controller which completion queue entries have been used */
+static void nvme_ring_cq_db(struct nvme_queue *nvmeq)
+{
+	writel(nvmeq->cq_head, nvmeq->q_db + nvmeq->dev->db_stride);
+}
+
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 				struct nvme_command *cmd,
 				u32 *result, unsigned timeout)
@@ -196,14 +222,8 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	if (status) {
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
+		nvme_advance_cq(nvmeq);
+		nvme_ring_cq_db(nvmeq);
 
 		return -EIO;
 	}
@@ -211,13 +231,8 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	if (result)
 		*result = le32_to_cpu(readl(&(nvmeq->cqes[head].result)));
 
-	if (++head == nvmeq->q_depth) {
-		head = 0;
-		phase = !phase;
-	}
-	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-	nvmeq->cq_head = head;
-	nvmeq->cq_phase = phase;
+	nvme_advance_cq(nvmeq);
+	nvme_ring_cq_db(nvmeq);
 
 	return status;
 }
@@ -615,7 +630,7 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 		 * and is reported as a power of two (2^n).
 		 *
 		 * The spec also says: a value of 0h indicates no restrictions
-		 * on transfer size. But in nvme_blk_read/write() below we have
+		 * on transfer size. But in nvme_blk_issue() below we have
 		 * the following algorithm for maximum number of logic blocks
 		 * per transfer:
 		 *
@@ -706,81 +721,209 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/*
+ * Block requests are split into read/write commands of up to the maximum
+ * transfer size. As many commands as fit are put in the I/O queue before
+ * ringing the doorbell, each with its own PRP list, and completions are
+ * reaped in batches, so that the controller always has work to do.
+ */
+
+/* Check whether a request still has commands to submit or complete */
+static bool nvme_blk_req_busy(struct nvme_dev *dev, struct blk_req *req)
 {
-	struct nvme_ns *ns = dev_get_priv(udev);
-	struct nvme_dev *dev = ns->dev;
+	int i;
+
+	if (!list_empty(&dev->io_reqs) &&
+	    list_first_entry(&dev->io_reqs, struct blk_req, sibling) == req)
+		return true;
+	for (i = 0; i < dev->q_depth - 1; i++) {
+		if (dev->io_cmds[i].req == req)
+			return true;
+	}
+
+	return false;
+}
+
+static void nvme_blk_finish(struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(req->dev);
+	ulong start = (ulong)req->buffer;
+
+	if (req->op == BLK_REQ_READ)
+		invalidate_dcache_range(start, start + (req->blkcnt <<
+							desc->log2blksz));
+	blk_req_complete(req, req->result);
+}
+
+/* Put a command for the next part of the first request in the I/O queue */
+static int nvme_blk_issue(struct nvme_dev *dev, int cid)
+{
+	struct nvme_io_cmd *cmd = &dev->io_cmds[cid];
+	struct blk_req *req = list_first_entry(&dev->io_reqs, struct blk_req,
+					       sibling);
+	struct nvme_ns *ns = dev_get_priv(req->dev);
+	void *buffer = req->buffer + (dev->io_issued << ns->lba_shift);
+	u64 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
+	int ret;
 
-	flush_dcache_range((unsigned long)buffer,
-			   (unsigned long)buffer + total_len);
+	lbas = min_t(u64, lbas, req->blkcnt - dev->io_issued);
+	ret = nvme_setup_prps(dev, cmd, &prp2, lbas << ns->lba_shift,
+			      (ulong)buffer);
+	if (ret)
+		return ret;
 
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
+	memset(&c, '\0', sizeof(c));
+	c.rw.opcode = req->op == BLK_REQ_READ ? nvme_cmd_read : nvme_cmd_write;
+	c.rw.command_id = cpu_to_le16(cid);
 	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+	c.rw.slba = cpu_to_le64(req->start + dev->io_issued);
+	c.rw.length = cpu_to_le16(lbas - 1);
+	c.rw.prp1 = cpu_to_le64((ulong)buffer);
+	c.rw.prp2 = cpu_to_le64(prp2);
+	nvme_queue_cmd(dev->queues[NVME_IO_Q], &c);
+
+	cmd->req = req;
+	cmd->lbas = lbas;
+	cmd->start = timer_get_us();
+	if (!dev->io_active++)
+		dev->io_busy_start = cmd->start;
+	dev->io_max_active = max(dev->io_max_active, dev->io_active);
+
+	dev->io_issued += lbas;
+	if (dev->io_issued == req->blkcnt) {
+		list_del(&req->sibling);
+		dev->io_issued = 0;
+	}
+
+	return 0;
+}
+
+/* Fill the I/O queue with commands for the waiting requests */
+static void nvme_blk_fill(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct blk_req *req;
+	bool added = false;
+	int cid = 0;
+	int ret;
+
+	/* Requests submitted by completion callbacks are picked up below */
+	dev->io_filling = true;
+	while (!list_empty(&dev->io_reqs) &&
+	       dev->io_active < dev->q_depth - 1) {
+		while (dev->io_cmds[cid].req)
+			cid++;
+		ret = nvme_blk_issue(dev, cid);
+		if (!ret) {
+			added = true;
+			continue;
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
-			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+		/* Give up on the rest of the request */
+		req = list_first_entry(&dev->io_reqs, struct blk_req, sibling);
+		list_del(&req->sibling);
+		dev->io_issued = 0;
+		req->result = ret;
+		if (!nvme_blk_req_busy(dev, req))
+			nvme_blk_finish(req);
 	}
+	dev->io_filling = false;
+
+	if (added)
+		writel(nvmeq->sq_tail, nvmeq->q_db);
+}
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+/* Handle the completion of a command, with @ret set to 0 if it succeeded */
+static void nvme_blk_done(struct nvme_dev *dev, int cid, int ret)
+{
+	struct nvme_io_cmd *cmd = &dev->io_cmds[cid];
+	struct blk_req *req = cmd->req;
+	struct nvme_ns *ns = dev_get_priv(req->dev);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	cmd->req = NULL;
+	if (!--dev->io_active)
+		dev->io_busy_us += timer_get_us() - dev->io_busy_start;
+	if (ret) {
+		req->result = ret;
+	} else {
+		dev->io_count++;
+		dev->io_bytes += (u64)cmd->lbas << ns->lba_shift;
+		if (req->result >= 0)
+			req->result += cmd->lbas;
+	}
+	if (!nvme_blk_req_busy(dev, req))
+		nvme_blk_finish(req);
 }
 
-static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
-			   lbaint_t blkcnt, void *buffer)
+static int nvme_blk_submit(struct udevice *udev, struct blk_req *req)
 {
-	return nvme_blk_rw(udev, blknr, blkcnt, buffer, true);
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	struct blk_desc *desc = dev_get_uclass_platdata(udev);
+	ulong start = (ulong)req->buffer;
+
+	if (!req->blkcnt) {
+		blk_req_complete(req, 0);
+		return 0;
+	}
+
+	flush_dcache_range(start, start + (req->blkcnt << desc->log2blksz));
+	list_add_tail(&req->sibling, &dev->io_reqs);
+	if (!dev->io_filling)
+		nvme_blk_fill(dev);
+
+	return 0;
 }
 
-static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
-			    lbaint_t blkcnt, const void *buffer)
+static int nvme_blk_poll(struct udevice *udev)
 {
-	return nvme_blk_rw(udev, blknr, blkcnt, (void *)buffer, false);
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_completion *cqe;
+	ulong now;
+	u16 status, cid;
+	int i, reaped = 0;
+
+	while (dev->io_active) {
+		status = nvme_read_completion_status(nvmeq, nvmeq->cq_head);
+		if ((status & 0x01) != nvmeq->cq_phase)
+			break;
+		cqe = &nvmeq->cqes[nvmeq->cq_head];
+		cid = le16_to_cpu(readw(&cqe->command_id));
+		nvme_advance_cq(nvmeq);
+		reaped++;
+
+		status >>= 1;
+		if (cid >= dev->q_depth - 1 || !dev->io_cmds[cid].req) {
+			printf("ERROR: unexpected command ID %d\n", cid);
+			continue;
+		}
+		if (status)
+			printf("ERROR: status = %x\n", status);
+		nvme_blk_done(dev, cid, status ? -EIO : 0);
+	}
+
+	if (reaped) {
+		nvme_ring_cq_db(nvmeq);
+	} else {
+		now = timer_get_us();
+		for (i = 0; i < dev->q_depth - 1; i++) {
+			if (dev->io_cmds[i].req &&
+			    now - dev->io_cmds[i].start >= IO_TIMEOUT * 100000)
+				nvme_blk_done(dev, i, -ETIMEDOUT);
+		}
+	}
+	nvme_blk_fill(dev);
+
+	return dev->io_active || !list_empty(&dev->io_reqs);
 }
 
 static const struct blk_ops nvme_blk_ops = {
-	.read	= nvme_blk_read,
-	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -809,6 +952,7 @@ static int nvme_probe(struct udevice *udev)
 	ndev->instance = trailing_strtol(udev->name);
 
 	INIT_LIST_HEAD(&ndev->namespaces);
+	INIT_LIST_HEAD(&ndev->io_reqs);
 	ndev->bar = dm_pci_map_bar(udev, PCI_BASE_ADDRESS_0,
 			PCI_REGION_MEM);
 	if (readl(&ndev->bar->csts) == -1) {
@@ -834,14 +978,12 @@ static int nvme_probe(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
+	ndev->io_cmds = calloc(ndev->q_depth - 1, sizeof(struct nvme_io_cmd));
+	if (!ndev->io_cmds) {
 		ret = -ENOMEM;
 		printf("Error: %s: Out of memory!\n", udev->name);
 		goto free_nvme;
 	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
 
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
@@ -602,6 +602,23 @@ enum {
 	NVME_CSTS_SHST_MASK	= 3 << 2,
 };
 
+/**
+ * struct nvme_io_cmd - a read or write command in the I/O queue
+ *
+ * @req:	Block request which the command is part of, or NULL if unused
+ * @lbas:	Number of blocks transferred by the command
+ * @start:	Time the command was submitted, in microseconds
+ * @prp_pool:	PRP list for the command, allocated when first needed
+ * @prp_entry_num: Number of entries which fit in @prp_pool
+ */
+struct nvme_io_cmd {
+	struct blk_req *req;
+	u32 lbas;
+	ulong start;
+	u64 *prp_pool;
+	u32 prp_entry_num;
+};
+
 /* Represents an NVM Express device. Each nvme_dev is a PCI function. */
 struct nvme_dev {
 	struct list_head node;
@@ -624,9 +641,20 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
+	/* Read/write commands in the I/O queue, indexed by command ID */
+	struct nvme_io_cmd *io_cmds;
+	u32 io_active;		/* number of commands in the I/O queue */
+	bool io_filling;	/* adding commands to the I/O queue */
+	/* Block requests waiting for commands; the first may have some */
+	struct list_head io_reqs;
+	u64 io_issued;		/* blocks of the first request with commands */
+	/* Statistics, shown by nvme_print_stats() */
+	u64 io_count;		/* read/write commands completed */
+	u64 io_bytes;		/* bytes transferred by those commands */
+	u64 io_busy_us;		/* time with commands in the I/O queue */
+	ulong io_busy_start;	/* time the I/O queue last became busy */
+	u32 io_max_active;	/* most commands in the I/O queue at once */
 };
 
 /*
@@ -9,6 +9,8 @@
 #include <errno.h>
 #include <memalign.h>
 #include <nvme.h>
+#include <time.h>
+#include <linux/math64.h>
 #include "nvme.h"
 
 static void print_optional_admin_cmd(u16 oacs, int devnum)
@@ -102,6 +104,25 @@ static void print_metadata_cap(u8 mc, int devnum)
 	       mc & 0x01 ? "yes" : "No");
 }
 
+void nvme_print_stats(struct udevice *udev)
+{
+	struct nvme_dev *dev = dev_get_priv(udev);
+	u64 busy_us = dev->io_busy_us;
+	u64 rate = 0;
+
+	if (dev->io_active)
+		busy_us += timer_get_us() - dev->io_busy_start;
+	if (busy_us)
+		rate = div64_u64(dev->io_bytes * 1000000, busy_us);
+
+	printf("%s: %llu commands, ", udev->name, dev->io_count);
+	print_size(dev->io_bytes, " in ");
+	printf("%llu ms (", div64_u64(busy_us, 1000));
+	print_size(rate, "/s), ");
+	printf("queue depth %d, up to %u used\n", dev->q_depth - 1,
+	       dev->io_max_active);
+}
+
 int nvme_print_info(struct udevice *udev)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -124,6 +145,7 @@ int nvme_print_info(struct udevice *udev)
 	print_formats(id, ns);
 	print_data_protect_cap(id->dpc, ns->devnum);
 	print_metadata_cap(id->mc, ns->devnum);
+	nvme_print_stats(udev->parent);
 
 	return 0;
 }
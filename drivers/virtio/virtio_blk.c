@@ -7,31 +7,67 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+/*
+ * Requests are added to the virtqueue as they are submitted, but the device
+ * is only notified when polled, so that a single notification covers all the
+ * requests submitted since the last one. With indirect descriptors, each
+ * request takes just one entry in the ring, so the whole ring can be used
+ * for requests.
+ */
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	struct list_head pending;
+	unsigned int active;
+	bool kick;
+};
+
+/**
+ * struct virtio_blk_req - a block request which is in the virtqueue
+ *
+ * @out_hdr: Request header, which must come first since its address is what
+ *	virtqueue_get_buf() returns
+ * @status: Status written by the device
+ * @req: Block request being carried out
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct blk_req *req;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/* Add a request to the virtqueue, returning -ENOSPC if it is full */
+static int virtio_blk_add(struct udevice *dev, struct blk_req *req)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	unsigned int num_out = 0, num_in = 0;
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	struct virtio_blk_req *vreq;
 	struct virtio_sg *sgs[3];
-	u8 status;
+	u32 type;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	vreq = malloc(sizeof(*vreq));
+	if (!vreq)
+		return -ENOMEM;
+
+	type = req->op == BLK_REQ_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	vreq->out_hdr.type = cpu_to_virtio32(dev, type);
+	vreq->out_hdr.ioprio = 0;
+	vreq->out_hdr.sector = cpu_to_virtio64(dev, req->start);
+	vreq->req = req;
+
+	hdr_sg.addr = &vreq->out_hdr;
+	hdr_sg.length = sizeof(vreq->out_hdr);
+	data_sg.addr = req->buffer;
+	data_sg.length = req->blkcnt * 512;
+	status_sg.addr = &vreq->status;
+	status_sg.length = sizeof(vreq->status);
 
 	sgs[num_out++] = &hdr_sg;
 
@@ -43,29 +79,75 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 	sgs[num_out + num_in++] = &status_sg;
 
 	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
+	if (ret) {
+		free(vreq);
 		return ret;
+	}
+	priv->active++;
 
-	virtqueue_kick(priv->vq);
-
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
-
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return 0;
 }
 
-static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
-			     lbaint_t blkcnt, void *buffer)
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
 {
-	return virtio_blk_do_req(dev, start, blkcnt, buffer,
-				 VIRTIO_BLK_T_IN);
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	/* Keep requests in order behind any which are waiting for room */
+	if (!list_empty(&priv->pending)) {
+		list_add_tail(&req->sibling, &priv->pending);
+		return 0;
+	}
+
+	ret = virtio_blk_add(dev, req);
+	if (ret == -ENOSPC) {
+		list_add_tail(&req->sibling, &priv->pending);
+		return 0;
+	} else if (ret) {
+		return ret;
+	}
+	priv->kick = true;
+
+	return 0;
 }
 
-static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
-			      lbaint_t blkcnt, const void *buffer)
+static int virtio_blk_poll(struct udevice *dev)
 {
-	return virtio_blk_do_req(dev, start, blkcnt, (void *)buffer,
-				 VIRTIO_BLK_T_OUT);
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_req *vreq;
+	struct blk_req *req, *next;
+	int ret;
+
+	if (priv->kick) {
+		priv->kick = false;
+		virtqueue_kick(priv->vq);
+	}
+
+	while ((vreq = virtqueue_get_buf(priv->vq, NULL))) {
+		req = vreq->req;
+		ret = vreq->status == VIRTIO_BLK_S_OK ? req->blkcnt : -EIO;
+		free(vreq);
+		priv->active--;
+		blk_req_complete(req, ret);
+	}
+
+	list_for_each_entry_safe(req, next, &priv->pending, sibling) {
+		ret = virtio_blk_add(dev, req);
+		if (ret == -ENOSPC)
+			break;
+		list_del(&req->sibling);
+		if (ret)
+			blk_req_complete(req, ret);
+		else
+			priv->kick = true;
+	}
+	/* This also covers requests submitted by the completion callbacks */
+	if (priv->kick) {
+		priv->kick = false;
+		virtqueue_kick(priv->vq);
+	}
+
+	return priv->active || !list_empty(&priv->pending);
 }
 
 static int virtio_blk_bind(struct udevice *dev)
@@ -112,6 +194,7 @@ static int virtio_blk_probe(struct udevice *dev)
 	ret = virtio_find_vqs(dev, 1, &priv->vq);
 	if (ret)
 		return ret;
+	INIT_LIST_HEAD(&priv->pending);
 
 	desc->blksz = 512;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
@@ -121,8 +204,8 @@ static int virtio_blk_probe(struct udevice *dev)
 }
 
 static const struct blk_ops virtio_blk_ops = {
-	.read	= virtio_blk_read,
-	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
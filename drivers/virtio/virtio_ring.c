@@ -13,10 +13,27 @@
 #include <virtio.h>
 #include <virtio_ring.h>
 
+/* Allocate a table of descriptors, chained together, for an indirect buffer */
+static struct vring_desc *alloc_indirect(struct virtqueue *vq,
+					 unsigned int total_sg)
+{
+	struct vring_desc *desc;
+	unsigned int i;
+
+	desc = memalign(VRING_DESC_ALIGN_SIZE, total_sg * sizeof(*desc));
+	if (!desc)
+		return NULL;
+
+	for (i = 0; i < total_sg; i++)
+		desc[i].next = cpu_to_virtio16(vq->vdev, i + 1);
+
+	return desc;
+}
+
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs)
 {
-	struct vring_desc *desc;
+	struct vring_desc *desc, *indir_desc = NULL;
 	unsigned int total_sg = out_sgs + in_sgs;
 	unsigned int i, n, avail, descs_used, uninitialized_var(prev);
 	int head;
@@ -25,9 +42,18 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 
 	head = vq->free_head;
 
-	desc = vq->vring.desc;
-	i = head;
-	descs_used = total_sg;
+	if (vq->indirect && total_sg > 1 && vq->num_free)
+		indir_desc = alloc_indirect(vq, total_sg);
+
+	if (indir_desc) {
+		desc = indir_desc;
+		i = 0;
+		descs_used = 1;
+	} else {
+		desc = vq->vring.desc;
+		i = head;
+		descs_used = total_sg;
+	}
 
 	if (vq->num_free < descs_used) {
 		debug("Can't add buf len %i - avail = %i\n",
@@ -67,11 +93,29 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	/* Last one doesn't continue */
 	desc[prev].flags &= cpu_to_virtio16(vq->vdev, ~VRING_DESC_F_NEXT);
 
+	if (indir_desc) {
+		/* Now that the indirect table is filled in, map it */
+		desc = &vq->vring.desc[head];
+		desc->flags = cpu_to_virtio16(vq->vdev, VRING_DESC_F_INDIRECT);
+		desc->addr = cpu_to_virtio64(vq->vdev,
+					     (u64)(uintptr_t)indir_desc);
+		desc->len = cpu_to_virtio32(vq->vdev,
+					    total_sg * sizeof(*indir_desc));
+	}
+
 	/* We're using some buffers from the free list. */
 	vq->num_free -= descs_used;
 
 	/* Update free pointer */
-	vq->free_head = i;
+	if (indir_desc)
+		vq->free_head = virtio16_to_cpu(vq->vdev,
+						vq->vring.desc[head].next);
+	else
+		vq->free_head = i;
+
+	/* Store the buffer to return and the indirect table to free later */
+	vq->desc_state[head].data = sgs[0]->addr;
+	vq->desc_state[head].indir_desc = indir_desc;
 
 	/*
 	 * Put entry in available array (but don't update avail->idx
@@ -149,6 +193,9 @@ static void detach_buf(struct virtqueue *vq, unsigned int head)
 
 	/* Plus final descriptor */
 	vq->num_free++;
+
+	free(vq->desc_state[head].indir_desc);
+	vq->desc_state[head].indir_desc = NULL;
 }
 
 static inline bool more_used(const struct virtqueue *vq)
@@ -161,6 +208,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 {
 	unsigned int i;
 	u16 last_used;
+	void *ret;
 
 	if (!more_used(vq)) {
 		debug("(%s.%d): No more buffers in queue\n",
@@ -186,7 +234,9 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		return NULL;
 	}
 
+	ret = vq->desc_state[i].data;
 	detach_buf(vq, i);
+	vq->desc_state[i].data = NULL;
 	vq->last_used_idx++;
 	/*
 	 * If we expect an interrupt for the next entry, tell host
@@ -197,8 +247,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)virtio64_to_cpu(vq->vdev,
-						  vq->vring.desc[i].addr);
+	return ret;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
@@ -213,6 +262,11 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	vq = malloc(sizeof(*vq));
 	if (!vq)
 		return NULL;
+	vq->desc_state = calloc(vring.num, sizeof(struct vring_desc_state));
+	if (!vq->desc_state) {
+		free(vq);
+		return NULL;
+	}
 
 	vq->vdev = vdev;
 	vq->index = index;
@@ -225,6 +279,7 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	list_add_tail(&vq->list, &uc_priv->vqs);
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC);
 
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
@@ -287,6 +342,11 @@ struct virtqueue *vring_create_virtqueue(unsigned int index, unsigned int num,
 
 void vring_del_virtqueue(struct virtqueue *vq)
 {
+	unsigned int i;
+
+	for (i = 0; i < vq->vring.num; i++)
+		free(vq->desc_state[i].indir_desc);
+	free(vq->desc_state);
 	free(vq->vring.desc);
 	list_del(&vq->list);
 	free(vq);
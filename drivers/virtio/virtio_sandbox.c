@@ -3,15 +3,24 @@
  * Copyright (C) 2018, Bin Meng <bmeng.cn@gmail.com>
  *
  * VirtIO Sandbox transport driver, for testing purpose only
+ *
+ * The device behind the transport is a block device backed by memory, which
+ * carries out the requests in the ring each time it is notified.
  */
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <linux/compat.h>
 #include <linux/io.h>
+#include "virtio_blk.h"
+
+#define VIRTIO_SANDBOX_QUEUE_SIZE	16
+#define VIRTIO_SANDBOX_BLK_SECTORS	4096
 
 struct virtio_sandbox_priv {
 	u8 id;
@@ -21,11 +30,24 @@ struct virtio_sandbox_priv {
 	ulong queue_desc;
 	ulong queue_available;
 	ulong queue_used;
+	struct virtio_blk_config config;
+	u8 *disk;
+	u16 last_avail_idx;
+	uint notify_count;
+	uint req_count;
+	uint indirect_count;
 };
 
 static int virtio_sandbox_get_config(struct udevice *udev, unsigned int offset,
 				     void *buf, unsigned int len)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	if (offset + len > sizeof(priv->config))
+		return -EINVAL;
+	if (len)
+		memcpy(buf, (u8 *)&priv->config + offset, len);
+
 	return 0;
 }
 
@@ -94,11 +116,13 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 	int err;
 
 	/* Create the vring */
-	vq = vring_create_virtqueue(index, 4, 4096, udev);
+	vq = vring_create_virtqueue(index, VIRTIO_SANDBOX_QUEUE_SIZE, 4096,
+				    udev);
 	if (!vq) {
 		err = -ENOMEM;
 		goto error_new_virtqueue;
 	}
+	priv->last_avail_idx = 0;
 
 	addr = virtqueue_get_desc_addr(vq);
 	priv->queue_desc = addr;
@@ -147,24 +171,137 @@ static int virtio_sandbox_find_vqs(struct udevice *udev, unsigned int nvqs,
 	return 0;
 }
 
+/* Carry out a block request, returning the number of bytes written to it */
+static uint virtio_sandbox_blk_req(struct udevice *udev, struct virtqueue *vq,
+				   u16 head)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct udevice *vdev = vq->vdev;
+	struct vring_desc *table = vq->vring.desc;
+	struct virtio_blk_outhdr *hdr = NULL;
+	u8 status = VIRTIO_BLK_S_OK;
+	u8 *statusp = NULL;
+	uint written = 0;
+	u64 offset = 0;
+	u32 type = 0;
+	u16 i = head;
+	u16 flags;
+	void *addr;
+	u32 len;
+
+	if (virtio16_to_cpu(vdev, table[i].flags) & VRING_DESC_F_INDIRECT) {
+		table = (void *)(uintptr_t)virtio64_to_cpu(vdev, table[i].addr);
+		i = 0;
+		priv->indirect_count++;
+	}
+	priv->req_count++;
+
+	/* The header comes first, then the data and finally the status */
+	do {
+		addr = (void *)(uintptr_t)virtio64_to_cpu(vdev, table[i].addr);
+		len = virtio32_to_cpu(vdev, table[i].len);
+		flags = virtio16_to_cpu(vdev, table[i].flags);
+		i = virtio16_to_cpu(vdev, table[i].next);
+
+		if (!hdr) {
+			hdr = addr;
+			type = virtio32_to_cpu(vdev, hdr->type);
+			offset = virtio64_to_cpu(vdev, hdr->sector) * 512;
+		} else if (!(flags & VRING_DESC_F_NEXT)) {
+			statusp = addr;
+		} else if (offset + len > VIRTIO_SANDBOX_BLK_SECTORS * 512) {
+			status = VIRTIO_BLK_S_IOERR;
+		} else if (type == VIRTIO_BLK_T_OUT) {
+			memcpy(priv->disk + offset, addr, len);
+			offset += len;
+		} else if (type == VIRTIO_BLK_T_IN) {
+			memcpy(addr, priv->disk + offset, len);
+			offset += len;
+			written += len;
+		} else {
+			status = VIRTIO_BLK_S_UNSUPP;
+		}
+	} while (flags & VRING_DESC_F_NEXT);
+
+	if (statusp) {
+		*statusp = status;
+		written++;
+	}
+
+	return written;
+}
+
 static int virtio_sandbox_notify(struct udevice *udev, struct virtqueue *vq)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+	struct udevice *vdev = vq->vdev;
+	struct vring *vring = &vq->vring;
+	struct vring_used_elem *used;
+	u16 head, used_idx;
+	uint len;
+
+	priv->notify_count++;
+
+	/* Only handle requests once the block driver is up and running */
+	if (!uc_priv->vdev || !device_active(uc_priv->vdev))
+		return 0;
+	if (!priv->disk) {
+		priv->disk = calloc(VIRTIO_SANDBOX_BLK_SECTORS, 512);
+		if (!priv->disk)
+			return -ENOMEM;
+	}
+
+	while (priv->last_avail_idx != virtio16_to_cpu(vdev,
+						       vring->avail->idx)) {
+		head = priv->last_avail_idx++ & (vring->num - 1);
+		head = virtio16_to_cpu(vdev, vring->avail->ring[head]);
+		len = virtio_sandbox_blk_req(udev, vq, head);
+
+		used_idx = virtio16_to_cpu(vdev, vring->used->idx);
+		used = &vring->used->ring[used_idx & (vring->num - 1)];
+		used->len = cpu_to_virtio32(vdev, len);
+		used->id = cpu_to_virtio32(vdev, head);
+		vring->used->idx = cpu_to_virtio16(vdev, used_idx + 1);
+	}
+
 	return 0;
 }
 
+void sandbox_virtio_blk_get_stats(struct udevice *dev, uint *notifiesp,
+				  uint *reqsp, uint *indirectp)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(dev);
+
+	*notifiesp = priv->notify_count;
+	*reqsp = priv->req_count;
+	*indirectp = priv->indirect_count;
+}
+
 static int virtio_sandbox_probe(struct udevice *udev)
 {
 	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
 
 	/* fake some information for testing */
-	priv->device_features = VIRTIO_F_VERSION_1;
+	priv->device_features = VIRTIO_F_VERSION_1 |
+				BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC);
+	priv->config.capacity = VIRTIO_SANDBOX_BLK_SECTORS;
 	uc_priv->device = VIRTIO_ID_BLOCK;
 	uc_priv->vendor = ('u' << 24) | ('b' << 16) | ('o' << 8) | 't';
 
 	return 0;
 }
 
+static int virtio_sandbox_remove(struct udevice *udev)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	free(priv->disk);
+
+	return 0;
+}
+
 /* check virtio device driver's remove routine was called to reset the device */
 static int virtio_sandbox_child_post_remove(struct udevice *vdev)
 {
@@ -201,6 +338,7 @@ U_BOOT_DRIVER(virtio_sandbox1) = {
 	.of_match = virtio_sandbox1_ids,
 	.ops	= &virtio_sandbox1_ops,
 	.probe	= virtio_sandbox_probe,
+	.remove	= virtio_sandbox_remove,
 	.child_post_remove = virtio_sandbox_child_post_remove,
 	.priv_auto_alloc_size = sizeof(struct virtio_sandbox_priv),
 };
@@ -229,5 +367,6 @@ U_BOOT_DRIVER(virtio_sandbox2) = {
 	.of_match = virtio_sandbox2_ids,
 	.ops	= &virtio_sandbox2_ops,
 	.probe	= virtio_sandbox_probe,
+	.remove	= virtio_sandbox_remove,
 	.priv_auto_alloc_size = sizeof(struct virtio_sandbox_priv),
 };
@@ -9,7 +9,7 @@
 #include <u-boot/crc.h>
 #include <asm/unaligned.h>
 
-static u32 btrfs_crc32c_table[256];
+static u32 btrfs_crc32c_table[CRC32C_TABLE_SIZE];
 
 void btrfs_hash_init(void)
 {
@@ -1522,10 +1522,15 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
+/*
+ * Find the leaf of the extent tree which covers @fileblock. If @limitp is not
+ * NULL, it is lowered to the first block covered by a later subtree, so that
+ * the caller knows where the leaf ends.
+ */
 static struct ext4_extent_header *ext4fs_get_extent_block
 	(struct ext2_data *data, struct ext_block_cache *cache,
 		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+		uint32_t fileblock, int log2_blksz, uint32_t *limitp)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
@@ -1553,6 +1558,9 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 		 */
 		if (i > 0)
 			i--;
+		if (limitp && i + 1 < le16_to_cpu(ext_block->eh_entries))
+			*limitp = min(*limitp,
+				      le32_to_cpu(index[i + 1].ei_block));
 
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
@@ -1672,7 +1680,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			ext4fs_get_extent_block(ext4fs_root, c,
 						(struct ext4_extent_header *)
 						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
+						fileblock, log2_blksz, NULL);
 		if (!ext_block) {
 			printf("invalid extent block\n");
 			if (!cache)
@@ -1992,6 +2000,145 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	return blknr;
 }
 
+/* Extents longer than this are uninitialised and read as zeroes */
+#define EXT4_EXT_INIT_MAX_LEN	(1 << 15)
+
+static uint64_t ext4fs_extent_start(const struct ext4_extent *extent)
+{
+	return ((uint64_t)le16_to_cpu(extent->ee_start_hi) << 32) +
+		le32_to_cpu(extent->ee_start_lo);
+}
+
+/* Find the run starting at @iter->next in a file which uses extents */
+static int ext4fs_extent_run(struct ext4_extent_iter *iter,
+			     struct ext4_extent_run *run)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	uint32_t start, len, limit = iter->end;
+	int log2_blksz;
+	int i, entries;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	ext_block = ext4fs_get_extent_block(ext4fs_root, &iter->cache,
+					    (struct ext4_extent_header *)
+					    iter->inode->b.blocks.dir_blocks,
+					    iter->next, log2_blksz, &limit);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	/* Anything not covered by an extent in this leaf is a hole */
+	run->lblock = iter->next;
+	run->pblock = 0;
+	run->len = limit - iter->next;
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+	for (i = 0; i < entries; i++) {
+		start = le32_to_cpu(extent[i].ee_block);
+		len = le16_to_cpu(extent[i].ee_len);
+		if (start > run->lblock) {
+			run->len = min(start, limit) - run->lblock;
+			break;
+		}
+		if (len > EXT4_EXT_INIT_MAX_LEN) {
+			len -= EXT4_EXT_INIT_MAX_LEN;
+			if (run->lblock < start + len) {
+				run->len = start + len - run->lblock;
+				break;
+			}
+			continue;
+		}
+		if (run->lblock >= start + len)
+			continue;
+
+		run->pblock = ext4fs_extent_start(&extent[i]) +
+			run->lblock - start;
+		run->len = start + len - run->lblock;
+
+		/* Add any following extents which carry on from this one */
+		for (i++; i < entries; i++) {
+			len = le16_to_cpu(extent[i].ee_len);
+			if (len > EXT4_EXT_INIT_MAX_LEN ||
+			    le32_to_cpu(extent[i].ee_block) !=
+			    run->lblock + run->len ||
+			    ext4fs_extent_start(&extent[i]) !=
+			    run->pblock + run->len)
+				break;
+			run->len += len;
+		}
+		break;
+	}
+	run->len = min(run->len, limit - run->lblock);
+
+	return 0;
+}
+
+/* Find the run starting at @iter->next in a file which uses block maps */
+static int ext4fs_blockmap_run(struct ext4_extent_iter *iter,
+			       struct ext4_extent_run *run)
+{
+	long int blknr, next;
+
+	blknr = read_allocated_block(iter->inode, iter->next, NULL);
+	if (blknr < 0)
+		return blknr;
+
+	run->lblock = iter->next;
+	run->pblock = blknr;
+	for (run->len = 1; run->lblock + run->len < iter->end; run->len++) {
+		next = read_allocated_block(iter->inode,
+					    run->lblock + run->len, NULL);
+		if (next < 0)
+			return next;
+		if (blknr ? next != blknr + run->len : next != 0)
+			break;
+	}
+
+	return 0;
+}
+
+void ext4fs_extent_iter_init(struct ext4_extent_iter *iter,
+			     struct ext2_inode *inode, uint32_t first,
+			     uint32_t count)
+{
+	iter->inode = inode;
+	iter->next = first;
+	iter->end = first + count;
+	ext_cache_init(&iter->cache);
+}
+
+int ext4fs_extent_iter_next(struct ext4_extent_iter *iter,
+			    struct ext4_extent_run *run)
+{
+	int ret;
+
+	if (iter->next >= iter->end)
+		return 0;
+
+	if (le32_to_cpu(iter->inode->flags) & EXT4_EXTENTS_FL)
+		ret = ext4fs_extent_run(iter, run);
+	else
+		ret = ext4fs_blockmap_run(iter, run);
+	if (ret)
+		return ret;
+
+	/* A corrupt tree could give an empty run, so always move forward */
+	if (!run->len)
+		run->len = 1;
+	iter->next = run->lblock + run->len;
+
+	return 1;
+}
+
+void ext4fs_extent_iter_fini(struct ext4_extent_iter *iter)
+{
+	ext_cache_fini(&iter->cache);
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -41,141 +41,65 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Read a file one run of contiguous blocks at a time, so that each run needs
+ * only one lookup in the extent tree and one read from the device
  */
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
-	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
-	lbaint_t delayed_next = 0;
-	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
-	struct ext_block_cache cache;
-
-	ext_cache_init(&cache);
+	struct ext4_extent_iter iter;
+	struct ext4_extent_run run;
+	loff_t start, end, offset;
+	uint32_t first, blockcnt;
+	int count, ret;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = (filesize - pos);
 
-	if (blocksize <= 0 || len <= 0) {
-		ext_cache_fini(&cache);
+	if (blocksize <= 0 || len <= 0)
 		return -1;
-	}
 
+	first = lldiv(pos, blocksize);
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		blknr = blknr << log2_fs_blocksize;
+	ext4fs_extent_iter_init(&iter, &node->inode, first, blockcnt - first);
+	while ((ret = ext4fs_extent_iter_next(&iter, &run)) > 0) {
+		start = max((loff_t)run.lblock * blocksize, pos);
+		end = min((loff_t)(run.lblock + run.len) * blocksize,
+			  pos + len);
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
+		if (!run.pblock) {
+			memset(buf + (start - pos), 0, end - start);
+			continue;
 		}
 
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
-		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
+		/* ext4fs_devread() takes an int, so split very long runs */
+		for (; start < end; start += count) {
+			count = min(end - start,
+				    (loff_t)(INT_MAX & ~(blocksize - 1)));
+			offset = start - (loff_t)run.lblock * blocksize;
+			if (!ext4fs_devread((run.pblock << log2_fs_blocksize) +
+					    (offset >> log2blksz),
+					    offset & ((1 << log2blksz) - 1),
+					    count, buf + (start - pos))) {
+				ret = -EIO;
+				break;
 			}
-		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
-			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
-		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
 		}
-		previous_block_number = -1;
+		if (ret < 0)
+			break;
 	}
+	ext4fs_extent_iter_fini(&iter);
+	if (ret < 0)
+		return -1;
 
 	*actread  = len;
-	ext_cache_fini(&cache);
 	return 0;
 }
 
@@ -155,6 +155,89 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/*
+ * Allocate the FAT cache, with as many lines of FATLINEBUFS windows as fit in
+ * FATCACHESIZE KiB. Following a fragmented cluster chain then does not
+ * keep reading the same parts of the FAT again, and following a long chain
+ * reads the FAT in larger pieces.
+ */
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int count = max(FATCACHESIZE * 1024 / FATLINESIZE, 1);
+	int i;
+
+	mydata->fatcache = malloc_cache_aligned(count * FATLINESIZE +
+			count * sizeof(struct fat_cache_tag));
+	if (!mydata->fatcache)
+		return -ENOMEM;
+	mydata->fatcache_tags = (struct fat_cache_tag *)(mydata->fatcache +
+							 count * FATLINESIZE);
+	for (i = 0; i < count; i++) {
+		mydata->fatcache_tags[i].line = -1;
+		mydata->fatcache_tags[i].age = 0;
+	}
+	mydata->fatcache_count = count;
+	mydata->fatcache_tick = 0;
+	mydata->fatbuf = NULL;
+	mydata->fatbufnum = -1;
+	mydata->fat_dirty = 0;
+
+	return 0;
+}
+
+/*
+ * Make window 'bufnum' of the FAT the current one in mydata->fatbuf. Unless it
+ * is in the cache already, the line holding it is read into the least recently
+ * used slot. The current window is written back first if it has been modified.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_window(fsdata *mydata, __u32 bufnum)
+{
+	struct fat_cache_tag *tags = mydata->fatcache_tags;
+	int line = bufnum / FATLINEBUFS;
+	__u32 getsize = FATLINEBUFS * FATBUFBLOCKS;
+	__u32 startblock = line * getsize;
+	int i, slot = 0;
+
+	if (bufnum == mydata->fatbufnum)
+		return 0;
+
+	/* Write back the fatbuf to the disk */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	for (i = 0; i < mydata->fatcache_count; i++) {
+		if (tags[i].line == line) {
+			slot = i;
+			goto found;
+		}
+		if (tags[i].age < tags[slot].age)
+			slot = i;
+	}
+
+	/* Cap length if fatlength is not a multiple of the line size */
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	tags[slot].line = -1;
+	if (disk_read(startblock, getsize,
+		      mydata->fatcache + slot * FATLINESIZE) < 0) {
+		debug("Error reading FAT blocks\n");
+		mydata->fatbufnum = -1;
+		return -1;
+	}
+	tags[slot].line = line;
+found:
+	tags[slot].age = ++mydata->fatcache_tick;
+	mydata->fatbuf = mydata->fatcache + slot * FATLINESIZE +
+		(bufnum % FATLINEBUFS) * FATBUFSIZE;
+	mydata->fatbufnum = bufnum;
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -193,28 +276,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	       mydata->fatsize, entry, entry, offset, offset);
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_cache_window(mydata, bufnum) < 0)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
@@ -239,6 +302,14 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/*
+ * Aligned buffer for reads into a misaligned destination. It is kept between
+ * calls and only grows, up to MAX_CLUSTSIZE, so a large misaligned read does
+ * not go to malloc() for every cluster run.
+ */
+static __u8 *bounce_buf;
+static unsigned long bounce_size;
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -258,21 +329,38 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
-	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+	if (((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) &&
+	    size >= mydata->sect_size) {
+		__u32 bufsects = min(size, (unsigned long)MAX_CLUSTSIZE) /
+			mydata->sect_size;
 
 		debug("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* Read through an aligned buffer, in large pieces */
+		if (bounce_size < bufsects * mydata->sect_size) {
+			free(bounce_buf);
+			bounce_size = bufsects * mydata->sect_size;
+			bounce_buf = malloc_cache_aligned(bounce_size);
+			if (!bounce_buf) {
+				debug("Error: allocating buffer\n");
+				bounce_size = 0;
+				return -1;
+			}
+		}
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			idx = min((unsigned long)bufsects,
+				  size / mydata->sect_size);
+			ret = disk_read(startsect, idx, bounce_buf);
+			if (ret != idx) {
 				debug("Error reading data (got %d)\n", ret);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			startsect += idx;
+			idx *= mydata->sect_size;
+			memcpy(buffer, bounce_buf, idx);
+			buffer += idx;
+			size -= idx;
 		}
 	} else {
 		idx = size / mydata->sect_size;
@@ -424,7 +512,8 @@ getit:
 		filesize -= actsize;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, endclust);
+		/* the run ended at the entry which was just looked up */
+		curclust = newclust;
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
@@ -621,10 +710,7 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_cache_alloc(mydata)) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1149,7 +1235,7 @@ int fat_exists(const char *filename)
 		goto out;
 
 	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out:
 	free(itr);
 	return ret == 0;
@@ -1174,7 +1260,7 @@ int fat_size(const char *filename, loff_t *size)
 		 * Directories don't have size, but fs_size() is not
 		 * expected to fail if passed a directory path:
 		 */
-		free(fsdata.fatbuf);
+		free(fsdata.fatcache);
 		ret = fat_itr_root(itr, &fsdata);
 		if (ret)
 			goto out_free_itr;
@@ -1186,7 +1272,7 @@ int fat_size(const char *filename, loff_t *size)
 
 	*size = FAT2CPU32(itr->dent->size);
 out_free_both:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1218,7 +1304,7 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1277,7 +1363,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	free(dir->fsdata.fatcache);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1309,7 +1395,7 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	free(dir->fsdata.fatcache);
 	free(dir);
 }
 
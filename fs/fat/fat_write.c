@@ -285,27 +285,8 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	}
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_cache_window(mydata, bufnum) < 0)
+		return -1;
 
 	/* Mark as dirty */
 	mydata->fat_dirty = 1;
@@ -1073,7 +1054,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 		      loff_t size, loff_t *actwrite)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatcache = NULL, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	int ret = -1;
@@ -1203,7 +1184,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 exit:
 	free(filename_copy);
-	free(mydata->fatbuf);
+	free(mydata->fatcache);
 	free(itr);
 	return ret;
 }
@@ -1217,8 +1198,7 @@ int file_fat_write(const char *filename, void *buffer, loff_t offset,
 static int fat_dir_entries(fat_itr *itr)
 {
 	fat_itr *dirs;
-	fsdata fsdata = { .fatbuf = NULL, }, *mydata = &fsdata;
-						/* for FATBUFSIZE */
+	fsdata fsdata = { .fatcache = NULL, };
 	int count;
 
 	dirs = malloc_cache_aligned(sizeof(fat_itr));
@@ -1233,20 +1213,18 @@ static int fat_dir_entries(fat_itr *itr)
 	fsdata = *dirs->fsdata;
 
 	/* allocate local fat buffer */
-	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (!fsdata.fatbuf) {
+	if (fat_cache_alloc(&fsdata)) {
 		debug("Error: allocating memory\n");
 		count = -ENOMEM;
 		goto exit;
 	}
-	fsdata.fatbufnum = -1;
 	dirs->fsdata = &fsdata;
 
 	for (count = 0; fat_itr_next(dirs); count++)
 		;
 
 exit:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 	free(dirs);
 	return count;
 }
@@ -1282,7 +1260,7 @@ static int delete_dentry(fat_itr *itr)
 
 int fat_unlink(const char *filename)
 {
-	fsdata fsdata = { .fatbuf = NULL, };
+	fsdata fsdata = { .fatcache = NULL, };
 	fat_itr *itr = NULL;
 	int n_entries, ret;
 	char *filename_copy, *dirname, *basename;
@@ -1344,7 +1322,7 @@ int fat_unlink(const char *filename)
 	ret = delete_dentry(itr);
 
 exit:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 	free(itr);
 	free(filename_copy);
 
@@ -1354,7 +1332,7 @@ exit:
 int fat_mkdir(const char *new_dirname)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatcache = NULL, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	char *dirname_copy, *parent, *dirname;
@@ -1480,7 +1458,7 @@ int fat_mkdir(const char *new_dirname)
 
 exit:
 	free(dirname_copy);
-	free(mydata->fatbuf);
+	free(mydata->fatcache);
 	free(itr);
 	free(dotdent);
 	return ret;
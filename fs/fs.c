@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <common.h>
 #include <env.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -18,6 +19,7 @@
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <linux/sizes.h>
 #include <efi_loader.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -529,6 +531,79 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return _fs_read(filename, addr, offset, len, 0, actread);
 }
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+/* Size of each piece of a file read while decompressing it */
+#define FS_DECOMP_CHUNK_SIZE	SZ_1M
+
+/*
+ * Read a file a piece at a time into a bounce buffer, decompressing each piece
+ * to @addr before reading the next, so that reading and decompressing overlap
+ * and the compressed file is never held in memory as a whole. The file system
+ * stays mounted until the whole file is read.
+ */
+static int fs_read_decomp(const char *filename, ulong addr, loff_t offset,
+			  loff_t len, int comp, loff_t *actread,
+			  ulong *unc_lenp)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct image_decomp_stream strm;
+	ulong size = ULONG_MAX - addr;
+	loff_t pos, end, chunk;
+	void *buf = NULL;
+	int ret;
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+#endif
+
+	ret = info->size(filename, &end);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		goto err;
+	}
+	if (len && offset + len < end)
+		end = offset + len;
+#ifdef CONFIG_LMB
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+	size = lmb_get_free_size(&lmb, addr);
+	if (!size) {
+		printf("** Reading file would overwrite reserved memory **\n");
+		ret = -ENOSPC;
+		goto err;
+	}
+#endif
+	buf = malloc(FS_DECOMP_CHUNK_SIZE);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	ret = image_decomp_stream_start(&strm, comp, map_sysmem(addr, size),
+					size);
+	if (ret)
+		goto err;
+
+	for (pos = offset; !ret && pos < end; pos += chunk) {
+		chunk = min_t(loff_t, end - pos, FS_DECOMP_CHUNK_SIZE);
+		ret = info->read(filename, buf, pos, chunk, &chunk);
+		if (!ret && !chunk)
+			ret = -EIO;
+		if (!ret)
+			ret = image_decomp_stream_write(&strm, buf, chunk);
+	}
+	*actread = pos - offset;
+
+	if (image_decomp_stream_finish(&strm, unc_lenp) && !ret) {
+		printf("** %s data is incomplete or invalid **\n",
+		       genimg_get_comp_name(comp));
+		ret = -EINVAL;
+	}
+err:
+	free(buf);
+	fs_close();
+
+	return ret;
+}
+#endif
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
@@ -671,10 +746,19 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	loff_t bytes;
 	loff_t pos;
 	loff_t len_read;
+	ulong unc_len = 0;
+	int comp = IH_COMP_NONE;
 	int ret;
 	unsigned long time;
 	char *ep;
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	ret = image_decomp_stream_opt(argc, argv, &comp);
+	if (ret < 0)
+		return CMD_RET_USAGE;
+	argc -= ret;
+	argv += ret;
+#endif
 	if (argc < 2)
 		return CMD_RET_USAGE;
 	if (argc > 7)
@@ -717,7 +801,13 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 			(argc > 4) ? argv[4] : "");
 #endif
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	if (comp != IH_COMP_NONE)
+		ret = fs_read_decomp(filename, addr, pos, bytes, comp,
+				     &len_read, &unc_len);
+	else
+#endif
+		ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
@@ -729,6 +819,10 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		puts(")");
 	}
 	puts("\n");
+	if (comp != IH_COMP_NONE) {
+		printf("%lu bytes after decompression\n", unc_len);
+		len_read = unc_len;
+	}
 
 	env_set_hex("fileaddr", addr);
 	env_set_hex("filesize", len_read);
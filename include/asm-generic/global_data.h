@@ -67,6 +67,9 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+	struct dm_lazy	*dm_lazy;	/* Device-tree nodes not yet bound */
+#endif
 #endif
 #ifdef CONFIG_TIMER
 	struct udevice	*timer;		/* Timer instance for Driver Model */
@@ -75,6 +78,9 @@ typedef struct global_data {
 	const void *fdt_blob;		/* Our device tree, NULL if none */
 	void *new_fdt;			/* Relocated FDT */
 	unsigned long fdt_size;		/* Space reserved for relocated FDT */
+#if CONFIG_IS_ENABLED(OF_FLAT_INDEX)
+	struct fdt_index *fdt_index;	/* Lookup tables for fdt_blob */
+#endif
 #ifdef CONFIG_OF_LIVE
 	struct device_node *of_root;
 #endif
@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -112,6 +113,18 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/**
+ * blkcache_read_t - function used by the block cache to read from a device
+ *
+ * @block_dev:	Block device descriptor
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Place to put the data
+ * @return number of blocks read
+ */
+typedef ulong (*blkcache_read_t)(struct blk_desc *block_dev, lbaint_t start,
+				 lbaint_t blkcnt, void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
@@ -133,6 +146,8 @@ int blkcache_read(int iftype, int dev,
  * blkcache_fill() - make data read from a block device available
  * to the block cache
  *
+ * Only whole cache lines within the range are added.
+ *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
  * @param start - starting block number
@@ -145,6 +160,56 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_read_ahead() - read a request which missed the cache
+ *
+ * This extends the request to whole cache lines, and further by the
+ * read-ahead window if it follows on from the previous read from the device,
+ * reads the lot with @read and adds it to the cache.
+ *
+ * @param block_dev - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param buffer - buffer to contain the data requested
+ * @param read - function to read from the device
+ *
+ * @return - @blkcnt if the request was read, '0' if it should be read
+ * directly from the device instead
+ */
+long blkcache_read_ahead(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buffer, blkcache_read_t read);
+
+/**
+ * blkcache_write() - update the cache with data written to a device
+ *
+ * Any cached blocks in the range are updated with the new data, so that the
+ * cache remains valid (write-through).
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks written
+ * @param blksz - size in bytes of each block
+ * @param buffer - data written
+ */
+void blkcache_write(int iftype, int dev,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer);
+
+/**
+ * blkcache_invalidate_range() - discard the cache for a range of blocks
+ * because of an erase or failed write
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks
+ * @param blksz - size in bytes of each block
+ */
+void blkcache_invalidate_range(int iftype, int dev,
+			       lbaint_t start, lbaint_t blkcnt,
+			       unsigned long blksz);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -157,10 +222,12 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
+ * @param blocks - blocks per entry (cache line)
  * @param entries - maximum entries in cache
+ * @param readahead - number of blocks to read ahead for sequential reads
+ * @return 0 if OK, -EINVAL if @blocks is 0 but @entries or @readahead is not
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+int blkcache_configure(unsigned blocks, unsigned entries, unsigned readahead);
 
 /*
  * statistics of the block cache
@@ -171,6 +238,19 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned readahead; /* read-ahead window in blocks */
+};
+
+/*
+ * statistics of the block cache for one device
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned readahead; /* blocks read beyond those requested */
+	unsigned writes; /* cached blocks updated by writes */
 };
 
 /**
@@ -180,6 +260,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics for a device and reset
+ *
+ * @param index - index of the device, counting from 0 in the order in which
+ *	devices were first used
+ * @param stats - statistics are copied here
+ * @return 0 if OK, -ENOENT if there is no device with that index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -193,6 +283,21 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline long blkcache_read_ahead(struct blk_desc *block_dev,
+				       lbaint_t start, lbaint_t blkcnt,
+				       void *buffer, blkcache_read_t read)
+{
+	return 0;
+}
+
+static inline void blkcache_write(int iftype, int dev,
+				  lbaint_t start, lbaint_t blkcnt,
+				  unsigned long blksz, void const *buffer) {}
+
+static inline void blkcache_invalidate_range(int iftype, int dev,
+					     lbaint_t start, lbaint_t blkcnt,
+					     unsigned long blksz) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -200,6 +305,59 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/* Operations which can be carried out by an asynchronous block request */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+struct blk_req;
+
+/**
+ * blk_req_done_t - called when an asynchronous block request completes
+ *
+ * @req:	The request, with @req->result set
+ */
+typedef void (*blk_req_done_t)(struct blk_req *req);
+
+/**
+ * struct blk_req - an asynchronous block request
+ *
+ * The caller sets up the fields from @dev to @priv and passes the request to
+ * blk_submit(). The request and the buffer must stay valid until the request
+ * completes.
+ *
+ * @dev:	Block device to use
+ * @op:		Operation to carry out
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Destination buffer for reads, source buffer for writes
+ * @done:	Function to call when the request completes, or NULL
+ * @priv:	Private data for the caller, e.g. for use by @done
+ * @result:	Number of blocks transferred, or -ve error number, once the
+ *		request completes. This is 0 when the request starts and the
+ *		driver may use it to keep count while the request is in
+ *		progress
+ * @complete:	true once the request completes
+ * @cached:	true if the block cache is updated when the request completes
+ *		(set up by blk_submit())
+ * @sibling:	List node for use by the driver while the request is in
+ *		progress, e.g. to queue requests
+ */
+struct blk_req {
+	struct udevice *dev;
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	blk_req_done_t done;
+	void *priv;
+	long result;
+	bool complete;
+	bool cached;
+	struct list_head sibling;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -258,6 +416,36 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous request
+	 *
+	 * This starts the request, or queues it if the device is busy, and
+	 * returns without waiting. When the request completes, the driver
+	 * calls blk_req_complete(), usually from its poll() method.
+	 *
+	 * This method is optional. Without it, requests are carried out
+	 * synchronously using read() and write().
+	 *
+	 * @dev:	Device to use
+	 * @req:	Request to start
+	 * @return 0 if OK, -ve on error (in which case the request is not
+	 * started and does not complete)
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - check for completed asynchronous requests
+	 *
+	 * This calls blk_req_complete() for any requests which have finished
+	 * and starts any queued requests for which there is now room. It does
+	 * not wait.
+	 *
+	 * @dev:	Device to check
+	 * @return 0 if no requests are in progress, a positive value if some
+	 * are, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -275,6 +463,51 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_submit() - start an asynchronous block request
+ *
+ * Reads which can be satisfied from the block cache complete immediately. If
+ * the driver does not support asynchronous requests, the request is carried
+ * out synchronously and also completes before this function returns. In both
+ * cases @req->done is called before returning.
+ *
+ * @req:	Request to start, with the fields up to @priv set up
+ * @return 0 if OK, -ve on error (in which case the request does not complete)
+ */
+int blk_submit(struct blk_req *req);
+
+/**
+ * blk_poll() - check for completed asynchronous requests
+ *
+ * @dev:	Block device to check
+ * @return 0 if no requests are in progress, a positive value if some are, or
+ * -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - wait for an asynchronous block request to complete
+ *
+ * This polls the device until the request completes. Other requests on the
+ * device may complete meanwhile.
+ *
+ * @req:	Request to wait for, which must have been started by
+ *		blk_submit()
+ * @return number of blocks transferred, or -ve error number
+ */
+long blk_wait(struct blk_req *req);
+
+/**
+ * blk_req_complete() - mark an asynchronous block request as complete
+ *
+ * This is called by drivers when a request finishes. It updates the block
+ * cache and calls @req->done, which may submit further requests.
+ *
+ * @req:	Request which has finished
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_req_complete(struct blk_req *req, long result);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -432,6 +665,9 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+	if (blkcache_read_ahead(block_dev, start, blkcnt, buffer,
+				block_dev->block_read))
+		return blkcnt;
 
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
@@ -449,14 +685,26 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return block_dev->block_write(block_dev, start, blkcnt, buffer);
+	ulong blks_written;
+
+	blks_written = block_dev->block_write(block_dev, start, blkcnt,
+					      buffer);
+	if (blks_written == blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	else
+		blkcache_invalidate_range(block_dev->if_type,
+					  block_dev->devnum, start, blkcnt,
+					  block_dev->blksz);
+
+	return blks_written;
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blkcache_invalidate_range(block_dev->if_type, block_dev->devnum,
+				  start, blkcnt, block_dev->blksz);
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
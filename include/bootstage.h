@@ -202,6 +202,13 @@ enum bootstage_id {
 	BOOTSTATE_ID_ACCUM_DM_SPL,
 	BOOTSTATE_ID_ACCUM_DM_F,
 	BOOTSTATE_ID_ACCUM_DM_R,
+	BOOTSTAGE_ID_ACCUM_FIT_HASH,
+	BOOTSTAGE_ID_ACCUM_FIT_HASH_CPU,
+	BOOTSTAGE_ID_ACCUM_LZ4,
+	BOOTSTAGE_ID_ACCUM_LZ4_CPU,
+	BOOTSTAGE_ID_ACCUM_GZIP,
+	BOOTSTAGE_ID_ACCUM_GZIP_CPU,
+	BOOTSTAGE_ID_ACCUM_HASH,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -307,6 +314,22 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Add a measured time to an accumulator
+ *
+ * This is like a bootstage_start()/bootstage_accum() pair but for activity
+ * whose duration has been measured separately, such as work done on other
+ * CPUs.
+ *
+ * @param id	Bootstage id to record this time against, or BOOTSTAGE_ID_ALLOC
+ *		to use a new id
+ * @param name	Textual name to display for this id in the report (maybe NULL)
+ * @param duration	Time to add in microseconds
+ * @return total time accumulated for this id
+ */
+uint32_t bootstage_accum_add(enum bootstage_id id, const char *name,
+			     uint32_t duration);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -406,6 +429,12 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_add(enum bootstage_id id,
+					   const char *name, uint32_t duration)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
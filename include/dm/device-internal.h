@@ -11,6 +11,7 @@
 #define _DM_DEVICE_INTERNAL_H
 
 #include <dm/ofnode.h>
+#include <dm/uclass-id.h>
 
 struct device_node;
 struct udevice;
@@ -180,6 +181,60 @@ static inline int device_chld_remove(struct udevice *dev, struct driver *drv,
  */
 fdt_addr_t simple_bus_translate(struct udevice *dev, fdt_addr_t addr);
 
+/**
+ * dm_lazy_add() - Record a device-tree node to be bound when needed
+ *
+ * If lazy binding is not active, this binds the node straight away. This is
+ * only available with CONFIG_DM_LAZY_BIND.
+ *
+ * @parent: Parent device for the device that will be created
+ * @node: Device-tree node to record
+ * @pre_reloc_only: As for lists_bind_fdt()
+ * @return 0 if OK, -ve on error
+ */
+int dm_lazy_add(struct udevice *parent, ofnode node, bool pre_reloc_only);
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/**
+ * dm_lazy_bind_uclass() - Bind recorded nodes which could provide a uclass
+ *
+ * This binds each recorded node which could have a device in the uclass
+ * itself or among its children.
+ *
+ * @id: uclass ID about to be used
+ */
+void dm_lazy_bind_uclass(enum uclass_id id);
+
+/**
+ * dm_lazy_bind_children() - Bind the recorded children of a device
+ *
+ * @parent: Device whose children are about to be used
+ */
+void dm_lazy_bind_children(struct udevice *parent);
+
+/**
+ * dm_lazy_bind_node() - Bind the recorded node containing a node
+ *
+ * This binds any recorded node which is @node or one of its parents, so that
+ * a device for @node is bound if there is one.
+ *
+ * @node: Device-tree node about to be looked up
+ */
+void dm_lazy_bind_node(ofnode node);
+
+/**
+ * dm_lazy_forget() - Drop the recorded children of a device being unbound
+ *
+ * @parent: Device being unbound
+ */
+void dm_lazy_forget(struct udevice *parent);
+#else
+static inline void dm_lazy_bind_uclass(enum uclass_id id) {}
+static inline void dm_lazy_bind_children(struct udevice *parent) {}
+static inline void dm_lazy_bind_node(ofnode node) {}
+static inline void dm_lazy_forget(struct udevice *parent) {}
+#endif
+
 /* Cast away any volatile pointer */
 #define DM_ROOT_NON_CONST		(((gd_t *)gd)->dm_root)
 #define DM_UCLASS_ROOT_NON_CONST	(((gd_t *)gd)->uclass_root)
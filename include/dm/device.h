@@ -64,6 +64,9 @@ struct driver_info;
 /* DM does not enable/disable the power domains corresponding to this device */
 #define DM_FLAG_DEFAULT_PD_CTRL_OFF	(1 << 11)
 
+/* Device has children in the device tree which are not bound yet */
+#define DM_FLAG_LAZY_CHILDREN		(1 << 12)
+
 /*
  * One or multiple of these flags are passed to device_remove() so that
  * a selective device removal as specified by the remove-stage and the
@@ -126,6 +129,9 @@ enum {
  *		When CONFIG_DEVRES is enabled, devm_kmalloc() and friends will
  *		add to this list. Memory so-allocated will be freed
  *		automatically when the device is removed / unbound
+ * @name_hash_node: Used by uclass to index its devices by name
+ * @node_hash_node: Used by uclass to index its devices by device-tree node
+ * @phandle_hash_node: Used by uclass to index its devices by phandle
  */
 struct udevice {
 	const struct driver *driver;
@@ -149,6 +155,11 @@ struct udevice {
 #ifdef CONFIG_DEVRES
 	struct list_head devres_head;
 #endif
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_node name_hash_node;
+	struct hlist_node node_hash_node;
+	struct hlist_node phandle_hash_node;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -165,9 +176,20 @@ static inline int dev_of_offset(const struct udevice *dev)
 	return ofnode_to_offset(dev->node);
 }
 
+/**
+ * dev_set_ofnode() - set the device-tree node of a device
+ *
+ * This should be used instead of changing @dev->node directly once the device
+ * is bound, so that the device can still be found by its node.
+ *
+ * @dev:	Device to update
+ * @node:	New node for the device
+ */
+void dev_set_ofnode(struct udevice *dev, ofnode node);
+
 static inline void dev_set_of_offset(struct udevice *dev, int of_offset)
 {
-	dev->node = offset_to_ofnode(of_offset);
+	dev_set_ofnode(dev, offset_to_ofnode(of_offset));
 }
 
 static inline bool dev_has_of_node(struct udevice *dev)
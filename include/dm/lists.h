@@ -61,6 +61,21 @@ int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   bool pre_reloc_only);
 
+/**
+ * lists_uclass_fdt() - find the uclasses a device tree node could bind to
+ *
+ * This matches the node's compatible strings against the drivers in the same
+ * way as lists_bind_fdt(), but does not bind anything.
+ *
+ * @node: device tree node to check
+ * @pre_reloc_only: If true, only consider drivers which lists_bind_fdt()
+ * would bind before relocation
+ * @ids: bitmap of uclass IDs (bit n % 32 of word n / 32 for ID n), to which
+ * the uclass of each matching driver is added
+ * @return number of matching drivers
+ */
+int lists_uclass_fdt(ofnode node, bool pre_reloc_only, u32 *ids);
+
 /**
  * device_bind_driver() - bind a device to a driver
  *
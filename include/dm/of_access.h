@@ -209,9 +209,26 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 					       const char *propname,
 					       const void *propval,
 					       int proplen);
+/**
+ * of_phandle_cache_build() - Build the table used to look up phandles
+ *
+ * This records every node in the tree which has a phandle, so that
+ * of_find_node_by_phandle() does not need to walk the whole tree. It is called
+ * by of_live_build() and should be called again if the tree is replaced or
+ * phandles are removed. Nodes which gain a phandle later are still found, but
+ * more slowly.
+ *
+ * @root:	Root of the tree to record, or NULL to just drop the table
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int of_phandle_cache_build(struct device_node *root);
+
 /**
  * of_find_node_by_phandle() - Find a node given a phandle
  *
+ * This uses the table built by of_phandle_cache_build() if it is for the
+ * current tree, otherwise it searches the tree.
+ *
  * @handle:	phandle of the node to find
  *
  * @return node pointer, or NULL if not found
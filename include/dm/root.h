@@ -114,6 +114,30 @@ int dm_init(bool of_live);
  */
 int dm_uninit(void);
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/**
+ * dm_lazy_init() - Start binding device-tree devices lazily
+ *
+ * After this, scanning the device tree records each node instead of binding
+ * it. A node is bound when a device in a uclass it (or a node below it) could
+ * provide is looked up, when the children of its parent are looked up, or
+ * when its own node is looked up. This is called by dm_init_and_scan().
+ *
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int dm_lazy_init(void);
+
+/**
+ * dm_lazy_bind_all() - Bind all recorded nodes and stop binding lazily
+ *
+ * @return 0 if OK, else the first error from binding a node
+ */
+int dm_lazy_bind_all(void);
+#else
+static inline int dm_lazy_init(void) { return 0; }
+static inline int dm_lazy_bind_all(void) { return 0; }
+#endif
+
 #if CONFIG_IS_ENABLED(DM_DEVICE_REMOVE)
 /**
  * dm_remove_devices_flags - Call remove function of all drivers with
@@ -196,6 +196,29 @@ int uclass_unbind_device(struct udevice *dev);
 static inline int uclass_unbind_device(struct udevice *dev) { return 0; }
 #endif
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/**
+ * uclass_index_del() - Remove a device from its uclass's lookup index
+ *
+ * This is used before changing the name or node of a device, which is then
+ * added back with uclass_index_add().
+ *
+ * @dev:	Pointer to the device
+ * @return true if the device was in the index, false if not
+ */
+bool uclass_index_del(struct udevice *dev);
+
+/**
+ * uclass_index_add() - Add a device back to its uclass's lookup index
+ *
+ * @dev:	Pointer to the device, which must be in its uclass's list
+ */
+void uclass_index_add(struct udevice *dev);
+#else
+static inline bool uclass_index_del(struct udevice *dev) { return false; }
+static inline void uclass_index_add(struct udevice *dev) {}
+#endif
+
 /**
  * uclass_pre_probe_device() - Deal with a device that is about to be probed
  *
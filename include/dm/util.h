@@ -30,6 +30,15 @@ void dm_dump_all(void);
 /* Dump out a list of uclasses and their devices */
 void dm_dump_uclass(void);
 
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/* Dump out a list of device-tree nodes which are not bound yet */
+void dm_dump_unbound(void);
+#else
+static inline void dm_dump_unbound(void)
+{
+}
+#endif
+
 #ifdef CONFIG_DEBUG_DEVRES
 /* Dump out a list of device resources */
 void dm_dump_devres(void);
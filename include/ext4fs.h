@@ -123,6 +123,34 @@ struct ext_block_cache {
 	int size;
 };
 
+/**
+ * struct ext4_extent_run - blocks of a file which are contiguous on disk
+ *
+ * @lblock: First block of the file in the run
+ * @pblock: Filesystem block holding @lblock, or 0 if the run is a hole
+ * @len: Number of blocks in the run
+ */
+struct ext4_extent_run {
+	uint32_t lblock;
+	uint64_t pblock;
+	uint32_t len;
+};
+
+/**
+ * struct ext4_extent_iter - state for walking the blocks of a file in runs
+ *
+ * @inode: Inode of the file
+ * @cache: Last block read from the extent tree
+ * @next: Next block of the file to map
+ * @end: Block of the file to stop at
+ */
+struct ext4_extent_iter {
+	struct ext2_inode *inode;
+	struct ext_block_cache cache;
+	uint32_t next;
+	uint32_t end;
+};
+
 extern struct ext2_data *ext4fs_root;
 extern struct ext2fs_node *ext4fs_file;
 
@@ -155,6 +183,41 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+
+/**
+ * ext4fs_extent_iter_init() - start walking the blocks of a file in runs
+ *
+ * @iter: Iterator to set up
+ * @inode: Inode of the file
+ * @first: First block of the file to map
+ * @count: Number of blocks to map
+ */
+void ext4fs_extent_iter_init(struct ext4_extent_iter *iter,
+			     struct ext2_inode *inode, uint32_t first,
+			     uint32_t count);
+
+/**
+ * ext4fs_extent_iter_next() - get the next run of blocks of a file
+ *
+ * Runs are returned in order and cover the blocks given to
+ * ext4fs_extent_iter_init() without gaps. Each one is either a hole or a set
+ * of blocks which can be read from the disk in one go.
+ *
+ * @iter: Iterator
+ * @run: Returns the run
+ * @return 1 if a run was returned, 0 if all the blocks have been mapped,
+ * -ve on error
+ */
+int ext4fs_extent_iter_next(struct ext4_extent_iter *iter,
+			    struct ext4_extent_run *run);
+
+/**
+ * ext4fs_extent_iter_fini() - free the resources used by an iterator
+ *
+ * @iter: Iterator
+ */
+void ext4fs_extent_iter_fini(struct ext4_extent_iter *iter);
+
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -25,6 +25,14 @@
 
 #define FATBUFBLOCKS	6
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+#ifdef CONFIG_SPL_BUILD
+#define FATLINEBUFS	1	/* Windows read together into the FAT cache */
+#define FATCACHESIZE	CONFIG_SPL_FS_FAT_CACHE_SIZE
+#else
+#define FATLINEBUFS	4
+#define FATCACHESIZE	CONFIG_FS_FAT_CACHE_SIZE
+#endif
+#define FATLINESIZE	(FATBUFSIZE * FATLINEBUFS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -154,6 +162,12 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/* Slot in the FAT cache, which holds a line of FATLINEBUFS windows */
+struct fat_cache_tag {
+	int	line;		/* Line of the FAT held, -1 if none */
+	__u32	age;		/* Value of fatcache_tick when last used */
+};
+
 /*
  * Private filesystem parameters
  *
@@ -161,7 +175,11 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* Current FAT buffer, within fatcache */
+	__u8	*fatcache;	/* FAT cache, holding fatcache_count windows */
+	struct fat_cache_tag *fatcache_tags; /* Window held by each slot */
+	int	fatcache_count;	/* Number of slots in the FAT cache */
+	__u32	fatcache_tick;	/* Counter for finding the oldest slot */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Lookup tables for the flat control device tree
+ *
+ * libfdt finds a node by phandle, compatible string or alias by scanning the
+ * blob from the start. When binding devices this is done for many nodes, so
+ * the time taken grows with the square of the tree size. With
+ * CONFIG_OF_FLAT_INDEX these functions use tables built in a single pass over
+ * the control FDT (gd->fdt_blob) instead. Other blobs, and anything the
+ * tables cannot answer, are passed straight to libfdt so that callers see the
+ * same results either way.
+ */
+
+#ifndef _FDT_INDEX_H
+#define _FDT_INDEX_H
+
+#include <linux/libfdt.h>
+
+#if CONFIG_IS_ENABLED(OF_FLAT_INDEX)
+
+/**
+ * fdt_index_node_by_phandle() - Find a node given its phandle
+ *
+ * This behaves like fdt_node_offset_by_phandle()
+ *
+ * @blob: FDT to search
+ * @phandle: phandle to look for
+ * @return offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_node_by_phandle(const void *blob, uint32_t phandle);
+
+/**
+ * fdt_index_node_by_compatible() - Find the next node with a compatible string
+ *
+ * This behaves like fdt_node_offset_by_compatible()
+ *
+ * @blob: FDT to search
+ * @startoffset: Only consider nodes after this offset, -1 to search all
+ * @compat: Compatible string to look for
+ * @return offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_node_by_compatible(const void *blob, int startoffset,
+				 const char *compat);
+
+/**
+ * fdt_index_path_offset() - Find a node given its path or an alias
+ *
+ * This behaves like fdt_path_offset(). Only plain aliases, "/aliases" and
+ * "/chosen" are looked up in the tables.
+ *
+ * @blob: FDT to search
+ * @path: Full path of the node, or alias
+ * @return offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_path_offset(const void *blob, const char *path);
+
+/**
+ * fdt_index_drop() - Discard the tables for the control FDT
+ *
+ * This must be called when gd->fdt_blob is replaced by a different tree which
+ * may have the same address and size. The tables are rebuilt when next
+ * needed. Changes to the tree which alter its size are noticed without this.
+ */
+void fdt_index_drop(void);
+
+#else
+
+static inline int fdt_index_node_by_phandle(const void *blob, uint32_t phandle)
+{
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+
+static inline int fdt_index_node_by_compatible(const void *blob,
+					       int startoffset,
+					       const char *compat)
+{
+	return fdt_node_offset_by_compatible(blob, startoffset, compat);
+}
+
+static inline int fdt_index_path_offset(const void *blob, const char *path)
+{
+	return fdt_path_offset(blob, path);
+}
+
+static inline void fdt_index_drop(void)
+{
+}
+
+#endif
+
+#endif
@@ -312,6 +312,64 @@ int fdt_setup_simplefb_node(void *fdt, int node, u64 base_address, u32 width,
 
 int fdt_overlay_apply_verbose(void *fdt, void *fdto);
 
+struct fdt_overlay_stack;
+
+#ifdef CONFIG_OF_LIBFDT_OVERLAY_STACK
+/**
+ * fdt_overlay_stack_create() - Scan a tree to apply a stack of overlays to
+ *
+ * This records the highest phandle, the path of each node with a phandle
+ * and the symbols in the tree. fdt_overlay_stack_apply() uses these instead
+ * of scanning the tree for each overlay, and adds what each overlay brings.
+ *
+ * Until the stack is freed, @fdt must only be changed by applying overlays
+ * to it with fdt_overlay_stack_apply(). It may be moved or resized with
+ * fdt_open_into() and fdt_pack().
+ *
+ * @fdt: Base tree
+ * @return new stack, or NULL if out of memory or the tree is not valid
+ */
+struct fdt_overlay_stack *fdt_overlay_stack_create(const void *fdt);
+
+/**
+ * fdt_overlay_stack_apply() - Apply an overlay to a tree
+ *
+ * This gives the same result as fdt_overlay_apply_verbose(), including the
+ * messages printed on error. As with that, the overlay is damaged and on
+ * error so may the tree be.
+ *
+ * @stack: Stack for @fdt, or NULL to use fdt_overlay_apply_verbose()
+ * @fdt: Base tree, with enough space for the overlay
+ * @fdto: Overlay to apply
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_overlay_stack_apply(struct fdt_overlay_stack *stack, void *fdt,
+			    void *fdto);
+
+/**
+ * fdt_overlay_stack_free() - Free a stack
+ *
+ * @stack: Stack to free (may be NULL)
+ */
+void fdt_overlay_stack_free(struct fdt_overlay_stack *stack);
+#else
+static inline struct fdt_overlay_stack *
+fdt_overlay_stack_create(const void *fdt)
+{
+	return NULL;
+}
+
+static inline int fdt_overlay_stack_apply(struct fdt_overlay_stack *stack,
+					  void *fdt, void *fdto)
+{
+	return fdt_overlay_apply_verbose(fdt, fdto);
+}
+
+static inline void fdt_overlay_stack_free(struct fdt_overlay_stack *stack)
+{
+}
+#endif
+
 /**
  * fdt_get_cells_len() - Get the length of a type of cell in top-level nodes
  *
@@ -322,6 +380,161 @@ int fdt_overlay_apply_verbose(void *fdt, void *fdto);
  */
 int fdt_get_cells_len(const void *blob, char *nr_cells_name);
 
+struct fdt_batch_prop;
+struct fdt_batch_walk;
+
+/**
+ * struct fdt_batch - Property changes to make to a device tree in one pass
+ *
+ * Each fdt_setprop() moves the rest of the tree to make room, so making many
+ * changes to a large tree takes time proportional to the number of changes
+ * times the size of the tree. A batch records the changes and rewrites the
+ * tree once when it is committed.
+ *
+ * Changes are recorded against the path of the node, so nodes may still be
+ * added and removed with libfdt while the batch is open. Recorded values are
+ * not in the tree until the batch is committed, so code which reads them back
+ * must use fdt_batch_getprop(). Code which changes the same properties with
+ * libfdt must not run while the batch is open, since the recorded value would
+ * replace the later change when the batch is committed.
+ *
+ * @blob: Tree to change
+ * @props: Recorded changes
+ * @count: Number of entries in @props
+ * @size: Number of entries allocated for @props
+ * @hash: Hash table to find changes by path and name, with twice @size slots,
+ *	each holding the index in @props plus one, or 0 if empty
+ * @seq: Sequence number of the last change which added a property
+ * @walk: Where the last node was found, to speed up finding the next
+ */
+struct fdt_batch {
+	void *blob;
+	struct fdt_batch_prop *props;
+	int count;
+	int size;
+	int *hash;
+	int seq;
+	struct fdt_batch_walk *walk;
+};
+
+#ifdef CONFIG_OF_FIXUP_BATCH
+/**
+ * fdt_batch_begin() - Start recording changes to a device tree
+ *
+ * Until the batch is committed or aborted, the fixup functions in this file
+ * (fdt_chosen(), do_fixup_by_compat(), fdt_fixup_memory_banks(), etc.) record
+ * their changes to @blob in the batch rather than making them directly.
+ *
+ * @batch: Batch to set up
+ * @blob: Tree to change
+ */
+void fdt_batch_begin(struct fdt_batch *batch, void *blob);
+
+/**
+ * fdt_batch_active() - Get the batch which fixups to a tree are recorded in
+ *
+ * @blob: Tree being changed
+ * @return batch started by fdt_batch_begin() for @blob, or NULL if none
+ */
+struct fdt_batch *fdt_batch_active(const void *blob);
+
+/**
+ * fdt_batch_setprop() - Record setting a property
+ *
+ * @batch: Batch to update
+ * @nodeoffset: Offset of the node in the tree
+ * @name: Name of the property
+ * @val: Value to set, which is copied
+ * @len: Length of @val in bytes
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len);
+
+/**
+ * fdt_batch_delprop() - Record removing a property
+ *
+ * @batch: Batch to update
+ * @nodeoffset: Offset of the node in the tree
+ * @name: Name of the property
+ * @return 0 if ok, -FDT_ERR_NOTFOUND if there is no such property, or other
+ *	-FDT_ERR_... on error
+ */
+int fdt_batch_delprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name);
+
+/**
+ * fdt_batch_getprop() - Read a property, including any recorded change
+ *
+ * @batch: Batch to check
+ * @nodeoffset: Offset of the node in the tree
+ * @name: Name of the property
+ * @lenp: Returns the length of the value, or -FDT_ERR_... on error (may be
+ *	NULL)
+ * @return value of the property, or NULL if not found
+ */
+const void *fdt_batch_getprop(struct fdt_batch *batch, int nodeoffset,
+			      const char *name, int *lenp);
+
+/**
+ * fdt_batch_commit() - Make the recorded changes to the tree
+ *
+ * The tree is rewritten in one pass within its current total size. Either all
+ * the changes are made or, on error, none are. The batch is then finished.
+ *
+ * @batch: Batch to commit
+ * @return 0 if ok, -FDT_ERR_NOSPACE if the tree or malloc() is out of space,
+ *	or other -FDT_ERR_... on error
+ */
+int fdt_batch_commit(struct fdt_batch *batch);
+
+/**
+ * fdt_batch_abort() - Discard the recorded changes
+ *
+ * This may also be called on a batch which is already finished.
+ *
+ * @batch: Batch to discard
+ */
+void fdt_batch_abort(struct fdt_batch *batch);
+#else
+static inline void fdt_batch_begin(struct fdt_batch *batch, void *blob)
+{
+}
+
+static inline struct fdt_batch *fdt_batch_active(const void *blob)
+{
+	return NULL;
+}
+
+static inline int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+				    const char *name, const void *val, int len)
+{
+	return -FDT_ERR_INTERNAL;
+}
+
+static inline int fdt_batch_delprop(struct fdt_batch *batch, int nodeoffset,
+				    const char *name)
+{
+	return -FDT_ERR_INTERNAL;
+}
+
+static inline const void *fdt_batch_getprop(struct fdt_batch *batch,
+					    int nodeoffset, const char *name,
+					    int *lenp)
+{
+	return NULL;
+}
+
+static inline int fdt_batch_commit(struct fdt_batch *batch)
+{
+	return 0;
+}
+
+static inline void fdt_batch_abort(struct fdt_batch *batch)
+{
+}
+#endif
+
 #endif /* ifdef CONFIG_OF_LIBFDT */
 
 #ifdef USE_HOSTCC
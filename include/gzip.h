@@ -21,6 +21,9 @@ int gzip_parse_header(const unsigned char *src, unsigned long len);
 /**
  * gunzip() - Decompress gzipped data
  *
+ * If the data holds several gzip members, these are decompressed one after
+ * the other, or on several CPUs at once with CONFIG_GZIP_PARALLEL.
+ *
  * @dst: Destination for uncompressed data
  * @dstlen: Size of destination buffer
  * @src: Source data to decompress
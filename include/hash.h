@@ -70,6 +70,34 @@ struct hash_algo {
 	 */
 	int (*hash_finish)(struct hash_algo *algo, void *ctx, void *dest_buf,
 			   int size);
+	/*
+	 * hash_start, hash_chunk, hash_end: Hash data a piece at a time
+	 *
+	 * Unlike the progressive functions above, these do not allocate
+	 * memory: the context is provided by the caller. They are used by
+	 * hash_chunked() and are NULL if not available, e.g. with hardware
+	 * hashing.
+	 *
+	 * @ctx: Context for hashing
+	 * @buf: Pointer to the buffer being hashed
+	 * @size: Size of the buffer being hashed
+	 * @dest_buf: Pointer to the buffer for the result, digest_size bytes
+	 */
+	void (*hash_start)(void *ctx);
+	void (*hash_chunk)(void *ctx, const void *buf, unsigned int size);
+	void (*hash_end)(void *ctx, void *dest_buf);
+	/*
+	 * select_backend: Select the implementation of the algorithm to use
+	 *
+	 * This is NULL if the algorithm only has one implementation.
+	 *
+	 * @index: Backend to use, counting from 0, or -1 to use the fastest
+	 *   one which the CPU supports
+	 * @namep: Returns the name of the backend, if not NULL
+	 * @return 0 if ok, -ENOENT if @index is too large, -ENODEV if the CPU
+	 *   does not support this backend
+	 */
+	int (*select_backend)(int index, const char **namep);
 };
 
 #ifndef USE_HOSTCC
@@ -88,6 +116,22 @@ struct hash_algo {
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[]);
 
+/* Default buffer size for hash_bench() */
+#define HASH_BENCH_SIZE		0x10000
+
+/**
+ * hash_bench() - Measure the speed of each hash algorithm
+ *
+ * Each algorithm is run for a while over a buffer of @size bytes and its
+ * speed printed in MB/s. Where an algorithm has several backends, each one
+ * which the CPU supports is measured and the default one is marked. The
+ * default backend is used again afterwards.
+ *
+ * @size:	Size of the buffer to hash, in bytes
+ * @return 0 if OK, -ENOMEM if the buffer cannot be allocated
+ */
+int hash_bench(ulong size);
+
 /**
  * hash_block() - Hash a block according to the requested algorithm
  *
@@ -139,6 +183,52 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/* Flags for hash_chunked() */
+enum hash_chunk_flags {
+	/*
+	 * The buffer was written by DMA, so invalidate the cache over each
+	 * piece before hashing it. The buffer must start on a cache-line
+	 * boundary and the cache lines it ends in must not hold other data.
+	 */
+	HASH_CHUNK_DMA		= 1 << 0,
+	/*
+	 * Print a progress mark for large buffers and record the time taken
+	 * in bootstage. This must not be used in a job (see job_queue.h).
+	 */
+	HASH_CHUNK_REPORT	= 1 << 1,
+	/*
+	 * Do not reset the watchdog. This must be used in a job, since only
+	 * the CPU running the job queue may reset it (see job_queue.h).
+	 */
+	HASH_CHUNK_NO_WATCHDOG	= 1 << 2,
+};
+
+/**
+ * hash_chunked() - Hash a buffer a piece at a time
+ *
+ * This hashes buffers of any size, including over 4GiB, in pieces of
+ * CONFIG_HASH_CHUNK_SIZE bytes. The watchdog is reset after each piece,
+ * unless HASH_CHUNK_NO_WATCHDOG is given, and the start of the next piece is
+ * prefetched. No memory is allocated, so this can be used in a job if
+ * HASH_CHUNK_NO_WATCHDOG is given and HASH_CHUNK_REPORT is not.
+ *
+ * Algorithms which cannot hash data in pieces, such as hardware hashing,
+ * are given the whole buffer at once. These reset the watchdog themselves,
+ * so cannot be used with HASH_CHUNK_NO_WATCHDOG.
+ *
+ * @algo:	Algorithm to use
+ * @buf:	Data to hash
+ * @len:	Length of data in bytes
+ * @output:	Returns the digest, algo->digest_size bytes
+ * @flags:	Flags to use (enum hash_chunk_flags)
+ * @return 0 if OK, -E2BIG if the algorithm cannot hash @len bytes, -EINVAL
+ * if HASH_CHUNK_DMA is given and @buf is not aligned to a cache line,
+ * -ENOSYS if HASH_CHUNK_NO_WATCHDOG is given and the algorithm can only
+ * hash the whole buffer at once
+ */
+int hash_chunked(struct hash_algo *algo, const void *buf, ulong len,
+		 void *output, uint flags);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
@@ -38,6 +38,9 @@ struct fdt_region;
 #define IMAGE_ENABLE_IGNORE	0
 #define IMAGE_INDENT_STRING	""
 
+#define IMAGE_ENABLE_PARALLEL_VERIFY	0
+#define IMAGE_ENABLE_STREAM_VERIFY	0
+
 #else
 
 #include <lmb.h>
@@ -51,12 +54,19 @@ struct fdt_region;
 #define IMAGE_ENABLE_FIT	CONFIG_IS_ENABLED(FIT)
 #define IMAGE_ENABLE_OF_LIBFDT	CONFIG_IS_ENABLED(OF_LIBFDT)
 
+/* Calculate hashes on several CPUs at once */
+#define IMAGE_ENABLE_PARALLEL_VERIFY	CONFIG_IS_ENABLED(FIT_PARALLEL_VERIFY)
+/* Calculate hashes while loading image data */
+#define IMAGE_ENABLE_STREAM_VERIFY	CONFIG_IS_ENABLED(FIT_STREAM_VERIFY)
+
 #endif /* USE_HOSTCC */
 
 #if IMAGE_ENABLE_FIT
 #include <hash.h>
 #include <linux/libfdt.h>
 #include <fdt_support.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
 # ifdef CONFIG_SPL_BUILD
 #  ifdef CONFIG_SPL_CRC32_SUPPORT
 #   define IMAGE_ENABLE_CRC32	1
@@ -303,6 +313,7 @@ enum {
 	IH_COMP_LZMA,			/* lzma  Compression Used	*/
 	IH_COMP_LZO,			/* lzo   Compression Used	*/
 	IH_COMP_LZ4,			/* lz4   Compression Used	*/
+	IH_COMP_ZSTD,			/* zstd  Compression Used	*/
 
 	IH_COMP_COUNT,
 };
@@ -868,6 +879,97 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+#ifndef USE_HOSTCC
+/**
+ * struct image_decomp_stream - an image decompressed a piece at a time
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space for decompression
+ * @out_len:	Number of bytes decompressed so far
+ * @in_len:	Number of compressed bytes passed in so far
+ * @done:	true if the end of the compressed data has been seen
+ * @err:	First error returned by image_decomp_stream_write(), if any
+ * @priv:	State of the decompressor
+ */
+struct image_decomp_stream {
+	int comp;
+	void *out;
+	ulong out_size;
+	ulong out_len;
+	ulong in_len;
+	bool done;
+	int err;
+	void *priv;
+};
+
+/**
+ * image_decomp_stream_start() - start decompressing an image as it is loaded
+ *
+ * This allows an image to be decompressed while it is being read from storage
+ * or the network, instead of after it has been loaded in full, so that the two
+ * overlap and the compressed image need not be held in memory. The
+ * uncompressed data is written directly to @load_buf, which must have room
+ * for all of it, and the compressed data is passed in a piece at a time with
+ * image_decomp_stream_write(). None, gzip, LZ4 and Zstandard compression are
+ * supported, according to the CONFIG options enabled.
+ *
+ * @strm:	Stream to set up
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load_buf:	Place to decompress to
+ * @unc_len:	Available space for decompression
+ * @return 0 if OK, -ENOSYS if @comp is not supported, -ENOMEM if out of
+ *	memory
+ */
+int image_decomp_stream_start(struct image_decomp_stream *strm, int comp,
+			      void *load_buf, ulong unc_len);
+
+/**
+ * image_decomp_stream_write() - decompress the next piece of an image
+ *
+ * Any data after the end of the compressed data is ignored.
+ *
+ * @strm:	Stream set up by image_decomp_stream_start()
+ * @buf:	Next piece of compressed data
+ * @len:	Length of @buf in bytes
+ * @return 0 if OK, -ENOSPC if the uncompressed data does not fit, other -ve
+ *	value if the compressed data is invalid. Once an error is returned,
+ *	the same error is returned for any later calls.
+ */
+int image_decomp_stream_write(struct image_decomp_stream *strm,
+			      const void *buf, ulong len);
+
+/**
+ * image_decomp_stream_finish() - finish decompressing an image
+ *
+ * This frees the state of the decompressor, so must be called once for each
+ * successful call to image_decomp_stream_start(), even after an error.
+ *
+ * @strm:	Stream set up by image_decomp_stream_start()
+ * @lenp:	Returns the number of bytes decompressed (may be NULL)
+ * @return 0 if OK, -EINVAL if the compressed data ended early, or the error
+ *	returned by image_decomp_stream_write()
+ */
+int image_decomp_stream_finish(struct image_decomp_stream *strm, ulong *lenp);
+
+/**
+ * image_decomp_stream_opt() - parse a command's decompression option
+ *
+ * Commands which load a file (such as 'load' and 'tftpboot') decompress it
+ * while loading if their first argument is "-d <comp>", where <comp> is the
+ * name of a compression algorithm, e.g. "gzip". The size of the uncompressed
+ * data is then stored in 'filesize'.
+ *
+ * @argc:	Number of arguments, including the command name
+ * @argv:	Arguments, with the command name in argv[0]
+ * @compp:	Returns the compression algorithm (IH_COMP_...), IH_COMP_NONE
+ *		if there is no option
+ * @return number of arguments used by the option (0 or 2), or -EINVAL if
+ *	it is incomplete or the algorithm is not recognised
+ */
+int image_decomp_stream_opt(int argc, char * const argv[], int *compp);
+#endif /* USE_HOSTCC */
+
 /**
  * Set up properties in the FDT
  *
@@ -1087,9 +1189,82 @@ int fit_conf_get_prop_node(const void *fit, int noffset,
 int fit_check_ramdisk(const void *fit, int os_noffset,
 		uint8_t arch, int verify);
 
-int calculate_hash(const void *data, int data_len, const char *algo,
+int calculate_hash(const void *data, size_t data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+#ifndef USE_HOSTCC
+/* Number of hashes in an image which can be calculated while loading it */
+#define FIT_STREAM_MAX_HASHES	2
+
+/**
+ * struct fit_hash_stream - hashes of an image calculated as it is loaded
+ *
+ * @fit:		FIT containing the image
+ * @image_noffset:	Offset of the image node
+ * @count:		Number of hashes being calculated
+ * @size:		Number of bytes hashed so far
+ * @hash:		Hashes being calculated, each with the offset of its
+ *			hash node, its algorithm name and context
+ */
+struct fit_hash_stream {
+	const void *fit;
+	int image_noffset;
+	int count;
+	ulong size;
+	struct {
+		int noffset;
+		const char *algo;
+		union {
+			uint32_t crc32;
+			sha1_context sha1;
+			sha256_context sha256;
+		} ctx;
+	} hash[FIT_STREAM_MAX_HASHES];
+};
+
+/**
+ * fit_image_hash_stream_start() - start hashing an image as it is loaded
+ *
+ * This looks up the hash nodes of an image so that the image data can be
+ * hashed a piece at a time with fit_image_hash_stream_update() while it is
+ * being read from storage, rather than in a separate pass afterwards. Only
+ * the CRC32, SHA1 and SHA256 algorithms are supported; other hashes are
+ * calculated by fit_image_verify_stream() as usual.
+ *
+ * @stream:		Stream to set up
+ * @fit:		FIT containing the image
+ * @image_noffset:	Offset of the image node
+ * @return number of hashes which will be calculated while loading
+ */
+int fit_image_hash_stream_start(struct fit_hash_stream *stream,
+				const void *fit, int image_noffset);
+
+/**
+ * fit_image_hash_stream_update() - hash the next piece of image data
+ *
+ * @stream:	Stream set up by fit_image_hash_stream_start()
+ * @data:	Next piece of image data
+ * @len:	Length of @data in bytes
+ */
+void fit_image_hash_stream_update(struct fit_hash_stream *stream,
+				  const void *data, size_t len);
+
+/**
+ * fit_image_verify_stream() - verify an image hashed while loading
+ *
+ * This is like fit_image_verify_with_data() but uses the hashes already
+ * calculated by fit_image_hash_stream_update(), provided that all of @data
+ * was passed to it.
+ *
+ * @stream:	Stream set up by fit_image_hash_stream_start()
+ * @data:	Image data
+ * @size:	Size of @data in bytes
+ * @return 1 if all hashes are valid, 0 otherwise (or on error)
+ */
+int fit_image_verify_stream(struct fit_hash_stream *stream, const void *data,
+			    size_t size);
+#endif
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Simple job queue for running independent pieces of work on several CPUs
+ */
+
+#ifndef __JOB_QUEUE_H
+#define __JOB_QUEUE_H
+
+/**
+ * enum job_flags - flags for a job
+ *
+ * @JOBF_BOOT_CPU:	Run the job on the CPU which called job_queue_run()
+ */
+enum job_flags {
+	JOBF_BOOT_CPU	= 1 << 0,
+};
+
+/**
+ * struct job - a piece of work which can be run on any CPU
+ *
+ * A job function may run on a secondary CPU at the same time as other jobs,
+ * so it must only do computation on memory it is given: it must not call
+ * malloc(), print anything or access devices, including resetting the
+ * watchdog. The calling CPU resets the watchdog after each of its own jobs
+ * and while it waits for the others. A job which needs to do these things
+ * can set JOBF_BOOT_CPU to run on the calling CPU, alongside the jobs
+ * running on other CPUs.
+ *
+ * @func:	Function to run, returning 0 if OK or -ve on error
+ * @priv:	Private data for @func
+ * @cost:	Estimate of the work involved (e.g. number of bytes to
+ *		process), used to share the jobs out evenly between CPUs
+ * @flags:	Flags for the job (enum job_flags)
+ * @ret:	Set to the return value of @func
+ * @cpu:	Set to the number of the CPU which runs the job, 0 being the
+ *		CPU which called job_queue_run(). This is set before @func is
+ *		called, so @func can use it to pick per-CPU resources, and is
+ *		below min(job_queue_cpus(), count)
+ * @time_us:	Set to the time taken by @func in microseconds
+ */
+struct job {
+	int (*func)(struct job *job);
+	void *priv;
+	ulong cost;
+	uint flags;
+	int ret;
+	int cpu;
+	ulong time_us;
+};
+
+/**
+ * job_queue_cpus() - get the number of CPUs which can run jobs
+ *
+ * @return number of CPUs, including the boot CPU (always at least 1)
+ */
+int job_queue_cpus(void);
+
+/**
+ * job_queue_run() - run a list of jobs and wait for them all to finish
+ *
+ * The jobs are shared out between the available CPUs, largest first, with
+ * the calling CPU taking a share. If the secondary CPUs are not available,
+ * the jobs run one after another on the calling CPU.
+ *
+ * @jobs:	Jobs to run
+ * @count:	Number of jobs
+ * @return 0 if all jobs succeeded, else the return value of the first job
+ *	(in @jobs order) which failed
+ */
+int job_queue_run(struct job *jobs, int count);
+
+/**
+ * arch_job_cpus() - get the number of CPUs which can run jobs
+ *
+ * This can be provided by the architecture or board to allow secondary CPUs
+ * to run jobs. The default returns 1.
+ *
+ * @return number of CPUs, including the boot CPU
+ */
+int arch_job_cpus(void);
+
+/**
+ * arch_job_start() - start a function running on a secondary CPU
+ *
+ * @cpu:	CPU to use (1 to arch_job_cpus() - 1)
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error, in which case the jobs for that CPU are run
+ *	on the calling CPU instead
+ */
+int arch_job_start(int cpu, void (*func)(void *arg), void *arg);
+
+/**
+ * arch_job_wait() - wait for a secondary CPU to finish its function
+ *
+ * On return, all memory written by the function must be visible to the
+ * calling CPU.
+ *
+ * @cpu:	CPU to wait for, as passed to arch_job_start()
+ * @return 0 if OK, -ve on error
+ */
+int arch_job_wait(int cpu);
+
+#endif
@@ -305,6 +305,33 @@ int fdt_next_region(const void *fdt,
  */
 int fdt_add_alias_regions(const void *fdt, struct fdt_region *region, int count,
 			  int max_regions, struct fdt_region_state *info);
+
+/**
+ * fdt_overlay_adjust_phandles() - Renumber the phandles within an overlay
+ *
+ * This is the first step of fdt_overlay_apply(). It adds @delta to each
+ * phandle defined in the overlay, and to each reference to one of them
+ * listed in /__local_fixups__.
+ *
+ * @fdto:	Device tree overlay
+ * @delta:	Amount to add, normally the highest phandle in the base tree
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_overlay_adjust_phandles(void *fdto, uint32_t delta);
+
+/**
+ * fdt_overlay_merge_node() - Merge an overlay node into a base tree node
+ *
+ * This copies the properties and subnodes of @node into @target, as
+ * fdt_overlay_apply() does for each fragment.
+ *
+ * @fdt:	Base device tree
+ * @target:	Offset of node to merge into
+ * @fdto:	Device tree overlay
+ * @node:	Offset of node to merge, normally an __overlay__ node
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_overlay_merge_node(void *fdt, int target, void *fdto, int node);
 #endif /* SWIG */
 
 extern struct fdt_header *working_fdt;  /* Pointer to the working fdt */
@@ -6,6 +6,46 @@
 #ifndef __LZ4_H
 #define __LZ4_H
 
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+struct lz4_frame_header {
+	u32 magic;
+	union {
+		u8 flags;
+		struct {
+			u8 reserved0:2;
+			u8 has_content_checksum:1;
+			u8 has_content_size:1;
+			u8 has_block_checksum:1;
+			u8 independent_blocks:1;
+			u8 version:2;
+		};
+	};
+	union {
+		u8 block_descriptor;
+		struct {
+			u8 reserved1:4;
+			u8 max_block_size:3;
+			u8 reserved2:1;
+		};
+	};
+	/* + u64 content_size iff has_content_size is set */
+	/* + u8 header_checksum */
+} __packed;
+
+struct lz4_block_header {
+	union {
+		u32 raw;
+		struct {
+			u32 size:31;
+			u32 not_compressed:1;
+		};
+	};
+	/* + size bytes of data */
+	/* + u32 block_checksum iff has_block_checksum is set */
+} __packed;
+
 /**
  * ulz4fn() - Decompress LZ4 data
  *
@@ -21,4 +61,24 @@
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * ulz4_decompress_block() - Decompress one compressed block of an LZ4 frame
+ *
+ * The uncompressed data of the frame must be contiguous in memory, starting at
+ * @start and continuing up to @dst, so that a block which depends on earlier
+ * ones can refer back to their data.
+ *
+ * @src: Compressed data of the block, without its header
+ * @srcn: Length of @src
+ * @dst: Destination for uncompressed data
+ * @dstn: Space available at @dst
+ * @start: Start of the uncompressed data of the frame, or @dst if the block
+ *	does not depend on earlier ones
+ * @return number of bytes written to @dst, or -EPROTO if the compressed data
+ *	causes an error in the decompression algorithm (including overrunning
+ *	@dstn)
+ */
+int ulz4_decompress_block(const void *src, size_t srcn, void *dst,
+			  size_t dstn, const void *start);
+
 #endif
@@ -70,6 +70,7 @@
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_CMDQ		BIT(17)	/* Host has a command queue engine */
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -108,6 +109,7 @@
 #define MMC_CMD_ERASE_GROUP_START	35
 #define MMC_CMD_ERASE_GROUP_END		36
 #define MMC_CMD_ERASE			38
+#define MMC_CMD_CMDQ_TASK_MGMT		48
 #define MMC_CMD_APP_CMD			55
 #define MMC_CMD_SPI_READ_OCR		58
 #define MMC_CMD_SPI_CRC_ON_OFF		59
@@ -208,6 +210,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -234,6 +237,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -303,6 +308,16 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_WR_DATA_REL_USR		(1 << 0)	/* user data area WR_REL */
 #define EXT_CSD_WR_DATA_REL_GP(x)	(1 << ((x)+1))	/* GP part (x+1) WR_REL */
 
+#define EXT_CSD_CMDQ_MODE_ENABLED	BIT(0)	/* Command queuing is on */
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)	/* Card can queue commands */
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1f	/* Queue depth less one */
+
+/* Argument to MMC_CMD_CMDQ_TASK_MGMT to discard every queued task */
+#define MMC_CMDQ_DISCARD_QUEUE		1
+
+/* Most tasks which a card can queue */
+#define MMC_CMDQ_MAX_DEPTH		32
+
 #define R1_ILLEGAL_COMMAND		(1 << 22)
 #define R1_APP_CMD			(1 << 5)
 
@@ -400,6 +415,38 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/**
+ * struct mmc_cmdq_task - A data transfer queued on an eMMC device
+ *
+ * @tag:	Task ID, from 0 to one less than the queue depth
+ * @start:	First block on the device
+ * @data:	Data to transfer, with MMC_DATA_READ or MMC_DATA_WRITE
+ * @result:	0 if the transfer succeeded, -ve on error
+ * @complete:	true once the task has finished
+ */
+struct mmc_cmdq_task {
+	uint tag;
+	uint start;
+	struct mmc_data data;
+	int result;
+	bool complete;
+};
+
+/**
+ * struct mmc_cmdq_stats - Counters for transfers made with command queuing
+ *
+ * @tasks:	Number of tasks completed
+ * @blocks:	Number of blocks transferred by those tasks
+ * @busy_us:	Time spent waiting for tasks, in microseconds
+ * @max_queued:	Most tasks queued at once
+ */
+struct mmc_cmdq_stats {
+	u64 tasks;
+	u64 blocks;
+	u64 busy_us;
+	uint max_queued;
+};
+
 /* forward decl. */
 struct mmc;
 
@@ -476,6 +523,44 @@ struct dm_mmc_ops {
 	 * @return 0 if not present, 1 if present, -ve on error
 	 */
 	int (*host_power_cycle)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	/**
+	 * cqe_enable() - Start or stop the command queue engine
+	 *
+	 * While the engine is running, the host only sends commands for the
+	 * tasks passed to cqe_submit(). Stopping it discards any tasks which
+	 * have not completed.
+	 *
+	 * @dev:	Device to update
+	 * @enable:	true to start the engine, false to stop it
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev, bool enable);
+
+	/**
+	 * cqe_submit() - Queue a task with the command queue engine
+	 *
+	 * The task stays queued until the driver sets @task->complete,
+	 * which it does in cqe_poll().
+	 *
+	 * @dev:	Device to use
+	 * @task:	Task to queue, whose tag is not in use by another task
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_submit)(struct udevice *dev, struct mmc_cmdq_task *task);
+
+	/**
+	 * cqe_poll() - Check for completed tasks
+	 *
+	 * This sets @result and @complete in each task which has finished. It
+	 * does not wait.
+	 *
+	 * @dev:	Device to check
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_poll)(struct udevice *dev);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -488,6 +573,9 @@ int dm_mmc_get_wp(struct udevice *dev);
 int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
 int dm_mmc_wait_dat0(struct udevice *dev, int state, int timeout_us);
 int dm_mmc_host_power_cycle(struct udevice *dev);
+int dm_mmc_cqe_enable(struct udevice *dev, bool enable);
+int dm_mmc_cqe_submit(struct udevice *dev, struct mmc_cmdq_task *task);
+int dm_mmc_cqe_poll(struct udevice *dev);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
@@ -663,6 +751,12 @@ struct mmc {
 				  * accessing the boot partitions
 				  */
 	u32 quirks;
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+	u8 cmdq_depth;		/* tasks the card can queue, 0 if not used */
+	bool cmdq_en;		/* command queuing is enabled on the card */
+	bool cqe_on;		/* host's command queue engine is running */
+	struct mmc_cmdq_stats cmdq_stats;
+#endif
 };
 
 struct mmc_hwpart_conf {
@@ -813,6 +907,15 @@ int mmc_rpmb_route_frames(struct mmc *mmc, void *req, unsigned long reqlen,
 int mmc_set_bkops_enable(struct mmc *mmc);
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+/**
+ * mmc_cmdq_print_stats() - Show the counters for queued transfers
+ *
+ * @mmc:	MMC device
+ */
+void mmc_cmdq_print_stats(struct mmc *mmc);
+#endif
+
 /**
  * Start device initialization and return immediately; it does not block on
  * polling OCR (operation condition register) status. Useful for checking
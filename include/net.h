@@ -540,6 +540,8 @@ extern char	net_boot_file_name[1024];/* Boot File name */
 extern bool	net_boot_file_name_explicit;
 /* The actual transferred size of the bootfile (in bytes) */
 extern u32	net_boot_file_size;
+/* Compression to undo while loading the bootfile (IH_COMP_...) */
+extern int	net_boot_file_comp;
 /* Boot file size in blocks as reported by the DHCP server */
 extern u32	net_boot_file_expected_size_in_blocks;
 
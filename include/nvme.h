@@ -78,6 +78,16 @@ int nvme_scan_namespace(void);
  */
 int nvme_print_info(struct udevice *udev);
 
+/**
+ * nvme_print_stats - print I/O statistics for an NVMe controller
+ *
+ * This prints the number of read/write commands and bytes transferred, the
+ * time the I/O queue was busy and the resulting throughput.
+ *
+ * @udev:	NVMe controller device
+ */
+void nvme_print_stats(struct udevice *udev);
+
 /**
  * nvme_get_namespace_id - return namespace identifier
  *
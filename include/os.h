@@ -375,4 +375,26 @@ int os_read_file(const char *name, void **bufp, int *sizep);
  */
 void *os_find_text_base(void);
 
+/**
+ * os_thread_create() - run a function in a new host thread
+ *
+ * The function must not call back into the host C library other than through
+ * functions in this file which are safe to call from several threads, such
+ * as os_get_nsec().
+ *
+ * @threadp:	Returns the thread, to pass to os_thread_join()
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_create(void **threadp, void (*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - wait for a thread to finish
+ *
+ * @thread:	Thread to wait for, as returned by os_thread_create()
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_join(void *thread);
+
 #endif
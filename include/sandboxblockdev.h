@@ -12,6 +12,10 @@ struct host_block_dev {
 #endif
 	char *filename;
 	int fd;
+	ulong reads;	/* number of reads from the backing file */
+#ifdef CONFIG_BLK
+	struct list_head reqs;
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
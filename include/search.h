@@ -45,6 +45,19 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int slots_used;	/* slots in table which are not free */
+	/* Previous table, whose entries are being moved into table */
+	struct env_entry_node *old_table;
+	unsigned int old_size;
+	unsigned int rehash_idx;	/* next slot in old_table to move */
+	/* Entries in the order they were added, NULL if deleted */
+	struct env_entry **entries;
+	unsigned int count;		/* number of entries used */
+	unsigned int alloced;		/* number of entries allocated */
+	/* Indexes into entries, in order of key, for exporting */
+	unsigned int *sorted;
+	unsigned int sorted_len;	/* number of indexes in sorted */
+	unsigned int sorted_upto;	/* entries before this are in sorted */
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -56,7 +69,10 @@ struct hsearch_data {
 			 enum env_op, int flag);
 };
 
-/* Create a new hash table which will contain at most "nel" elements.  */
+/*
+ * Create a new hash table with room for "nel" elements. It grows when it
+ * gets full.
+ */
 int hcreate_r(size_t nel, struct hsearch_data *htab);
 
 /* Destroy current internal hash table.  */
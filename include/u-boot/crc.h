@@ -8,6 +8,22 @@
 #ifndef _UBOOT_CRC_H
 #define _UBOOT_CRC_H
 
+/*
+ * Number of 256-entry tables used by the CRC32 and CRC32C implementations:
+ * 8 for slice-by-8, 1 for the byte-at-a-time version
+ */
+#ifndef USE_HOSTCC
+#if CONFIG_IS_ENABLED(CRC32_SLICE8)
+#define CRC32_SLICES	8
+#endif
+#endif
+#ifndef CRC32_SLICES
+#define CRC32_SLICES	1
+#endif
+
+/* Number of entries in a table passed to crc32c_init() and crc32c_cal() */
+#define CRC32C_TABLE_SIZE	(256 * CRC32_SLICES)
+
 /**
  * crc8() - Calculate and return CRC-8 of the data
  *
@@ -80,6 +96,22 @@ uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uint len,
  */
 uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 
+/**
+ * crc32_no_comp_bytewise() - Byte-at-a-time version of crc32_no_comp()
+ *
+ * This is always available, whichever implementation is selected, and is
+ * used by crc32_no_comp() for short buffers. It is exported so that the
+ * implementations can be checked against each other.
+ *
+ * @crc: Input crc to chain from a previous calculution (use 0 to start a new
+ *	calculation)
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * @return checksum value
+ */
+uint32_t crc32_no_comp_bytewise(uint32_t crc, const unsigned char *buf,
+				uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
@@ -96,7 +128,7 @@ void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 /**
  * crc32c_init() - Set up a the CRC32 table
  *
- * This sets up 256-item table to aid in CRC32 calculation
+ * This sets up a CRC32C_TABLE_SIZE-item table to aid in CRC32 calculation
  *
  * @crc32c_table: Place to put table
  * @pol: polynomial to use
@@ -118,4 +150,20 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol);
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table);
 
+/**
+ * crc32c_cal_bytewise() - Byte-at-a-time version of crc32c_cal()
+ *
+ * This only uses the first 256 entries of the table. It is used by
+ * crc32c_cal() for short buffers and is exported so that the implementations
+ * can be checked against each other.
+ *
+ * @crc: Previous crc (use 0 at start)
+ * @data: Data bytes to checksum
+ * @length: Number of bytes to process
+ * @crc32c_table:: CRC table
+ * @return checksum value
+ */
+uint32_t crc32c_cal_bytewise(uint32_t crc, const char *data, int length,
+			     uint32_t *crc32c_table);
+
 #endif /* _UBOOT_CRC_H */
@@ -101,6 +101,19 @@ void sha1_hmac(const unsigned char *key, int keylen,
  */
 int sha1_self_test( void );
 
+/**
+ * sha1_select_backend() - Select the implementation of SHA-1 to use
+ *
+ * The backends are numbered from 0 in the order of their names. By default
+ * the fastest one which the CPU supports is used.
+ *
+ * @index:	Backend to use, or -1 to pick one automatically
+ * @namep:	If not NULL, returns the name of the backend
+ * @return 0 if OK, -ENOENT if @index is too large, -ENODEV if the CPU does
+ * not support this backend
+ */
+int sha1_select_backend(int index, const char **namep);
+
 #ifdef __cplusplus
 }
 #endif
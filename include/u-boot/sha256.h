@@ -22,4 +22,17 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * sha256_select_backend() - Select the implementation of SHA-256 to use
+ *
+ * The backends are numbered from 0 in the order of their names. By default
+ * the fastest one which the CPU supports is used.
+ *
+ * @index:	Backend to use, or -1 to pick one automatically
+ * @namep:	If not NULL, returns the name of the backend
+ * @return 0 if OK, -ENOENT if @index is too large, -ENODEV if the CPU does
+ * not support this backend
+ */
+int sha256_select_backend(int index, const char **namep);
+
 #endif /* _SHA256_H */
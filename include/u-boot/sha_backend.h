@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Implementations of the SHA-1 and SHA-256 block functions
+ *
+ * The portable C code in lib/sha1.c and lib/sha256.c can be replaced at run
+ * time by code which uses CPU instructions for hashing, where the CPU has
+ * them. Each implementation is a backend, declared in a linker list.
+ */
+
+#ifndef _SHA_BACKEND_H
+#define _SHA_BACKEND_H
+
+#include <linker_lists.h>
+
+/**
+ * struct sha_backend - an implementation of a SHA block function
+ *
+ * @name:	Name of the backend, shown by 'hash bench'
+ * @priority:	Priority of the backend. When no backend is selected, the one
+ *		with the highest priority which the CPU supports is used. The
+ *		portable C code has priority 0.
+ * @probe:	Check whether the CPU can run this backend. This is called
+ *		often so should remember its result. NULL if the backend works
+ *		on any CPU.
+ * @blocks:	Hash @count 64-byte blocks from @data, updating @state, which
+ *		holds 5 words for SHA-1 and 8 for SHA-256
+ */
+struct sha_backend {
+	const char *name;
+	int priority;
+	bool (*probe)(void);
+	void (*blocks)(u32 *state, const u8 *data, uint count);
+};
+
+/* Declare a SHA-1 backend */
+#define U_BOOT_SHA1_BACKEND(__name)					\
+	ll_entry_declare(struct sha_backend, __name, sha1_backend)
+
+/* Declare a SHA-256 backend */
+#define U_BOOT_SHA256_BACKEND(__name)					\
+	ll_entry_declare(struct sha_backend, __name, sha256_backend)
+
+/**
+ * sha_backend_get() - Get the backend to use for hashing
+ *
+ * @start:	First backend in the linker list
+ * @count:	Number of backends in the list
+ * @selected:	Index of the backend selected by sha_backend_select(), or -1
+ *		to use the highest-priority one which the CPU supports
+ * @return backend to use
+ */
+const struct sha_backend *sha_backend_get(const struct sha_backend *start,
+					  int count, int selected);
+
+/**
+ * sha_backend_select() - Select a backend to use for hashing
+ *
+ * @start:	First backend in the linker list
+ * @count:	Number of backends in the list
+ * @index:	Index of the backend to select, or -1 to go back to using the
+ *		highest-priority one which the CPU supports
+ * @selectedp:	Holds the selected index, updated if the backend can be used
+ * @namep:	If not NULL, returns the name of the backend, even if the CPU
+ *		does not support it
+ * @return 0 if OK, -ENOENT if @index is past the end of the list, -ENODEV
+ * if the CPU does not support the backend
+ */
+int sha_backend_select(const struct sha_backend *start, int count, int index,
+		       int *selectedp, const char **namep);
+
+#endif /* _SHA_BACKEND_H */
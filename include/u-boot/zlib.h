@@ -83,6 +83,7 @@ extern "C" {
 #  define inflateSyncPoint      z_inflateSyncPoint
 #  define inflateCopy           z_inflateCopy
 #  define inflateReset          z_inflateReset
+#  define inflateWatchdog       z_inflateWatchdog
 #  define inflateBack           z_inflateBack
 #  define inflateBackEnd        z_inflateBackEnd
 #  define compress              z_compress
@@ -661,6 +662,17 @@ ZEXTERN int ZEXPORT inflateEnd OF((z_streamp strm));
 
 ZEXTERN int ZEXPORT inflateReset OF((z_streamp strm));
 
+ZEXTERN int ZEXPORT inflateWatchdog OF((z_streamp strm, int on));
+/*
+     U-Boot: sets whether inflate() resets the watchdog as it goes, which it
+   does by default. Turn this off with on set to 0 if inflate() is run in a
+   job (see job_queue.h), which must not access devices. inflateInit2() and
+   inflateEnd() may still reset the watchdog, so must be called elsewhere.
+
+     inflateWatchdog returns Z_OK if success, or Z_STREAM_ERROR if the stream
+   state was inconsistent.
+*/
+
                         /* utility functions */
 
 /*
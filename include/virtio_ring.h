@@ -95,6 +95,8 @@ struct vring {
  * @last_used_idx: last used index we've seen
  * @avail_flags_shadow: last written value to avail->flags
  * @avail_idx_shadow: last written value to avail->idx in guest byte order
+ * @indirect: indirect descriptor tables may be used
+ * @desc_state: state of each buffer in the ring, indexed by head descriptor
  */
 struct virtqueue {
 	struct list_head list;
@@ -108,6 +110,19 @@ struct virtqueue {
 	u16 last_used_idx;
 	u16 avail_flags_shadow;
 	u16 avail_idx_shadow;
+	bool indirect;
+	struct vring_desc_state *desc_state;
+};
+
+/**
+ * vring_desc_state - state of a buffer in the ring
+ *
+ * @data: memory buffer to return from virtqueue_get_buf()
+ * @indir_desc: indirect descriptor table used for the buffer, or NULL
+ */
+struct vring_desc_state {
+	void *data;
+	struct vring_desc *indir_desc;
 };
 
 /*
@@ -170,6 +185,10 @@ struct virtio_sg;
  * @in_sgs:	the number of scatterlists which are writable
  *		(after readable ones)
  *
+ * If indirect descriptors have been negotiated, a buffer with more than one
+ * scatterlist takes a single descriptor in the ring, pointing to a table
+ * which describes the scatterlists.
+ *
  * Caller must ensure we don't call this with other virtqueue operations
  * at the same time (except where noted).
  *
@@ -12,9 +12,13 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <u-boot/crc.h>
 
-uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
-		    uint32_t *crc32c_table)
+/* Below this length the byte-at-a-time version is used */
+#define CRC32C_SLICE8_MIN	64
+
+uint32_t crc32c_cal_bytewise(uint32_t crc, const char *data, int length,
+			     uint32_t *crc32c_table)
 {
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
@@ -22,6 +26,52 @@ uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 	return crc;
 }
 
+#if CRC32_SLICES == 8
+/*
+ * Process eight bytes per step. The table holds eight 256-entry slices, see
+ * crc32c_init().
+ */
+static uint32_t crc32c_cal_slice8(uint32_t crc, const u8 *data, int length,
+				  uint32_t *crc32c_table)
+{
+	uint32_t (*tab)[256] = (uint32_t (*)[256])crc32c_table;
+	uint32_t one, two;
+
+	for (; length && ((ulong)data & 3); length--)
+		crc = tab[0][(u8)(crc ^ *data++)] ^ (crc >> 8);
+
+	for (; length >= 8; length -= 8) {
+		one = le32_to_cpu(*(const uint32_t *)data) ^ crc;
+		two = le32_to_cpu(*(const uint32_t *)(data + 4));
+		crc = tab[7][one & 0xff] ^
+		      tab[6][(one >> 8) & 0xff] ^
+		      tab[5][(one >> 16) & 0xff] ^
+		      tab[4][one >> 24] ^
+		      tab[3][two & 0xff] ^
+		      tab[2][(two >> 8) & 0xff] ^
+		      tab[1][(two >> 16) & 0xff] ^
+		      tab[0][two >> 24];
+		data += 8;
+	}
+
+	while (length--)
+		crc = tab[0][(u8)(crc ^ *data++)] ^ (crc >> 8);
+
+	return crc;
+}
+#endif
+
+uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
+		    uint32_t *crc32c_table)
+{
+#if CRC32_SLICES == 8
+	if (length >= CRC32C_SLICE8_MIN)
+		return crc32c_cal_slice8(crc, (const u8 *)data, length,
+					 crc32c_table);
+#endif
+	return crc32c_cal_bytewise(crc, data, length, crc32c_table);
+}
+
 void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 {
 	int i, j;
@@ -35,4 +85,13 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 
 		crc32c_table[i] = v;
 	}
+
+	/*
+	 * Each further slice holds the CRC of the byte followed by one more
+	 * zero byte than the previous slice
+	 */
+	for (i = 256; i < CRC32C_TABLE_SIZE; i++) {
+		v = crc32c_table[i - 256];
+		crc32c_table[i] = crc32c_table[v & 0xff] ^ (v >> 8);
+	}
 }
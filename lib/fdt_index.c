@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Lookup tables for the flat control device tree
+ */
+
+#include <common.h>
+#include <fdt_index.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/*
+ * dtc numbers phandles from 1, so a table indexed by phandle is small. Do not
+ * use one if the phandles are spread out so that most of it would be empty.
+ */
+#define FDT_INDEX_MAX_SPARSE	4
+
+/*
+ * Before relocation malloc() takes from a small area that is never freed, so
+ * leave at least this fraction of what is left there for drivers
+ */
+#define FDT_INDEX_PRE_RELOC_SHARE	2
+
+/**
+ * struct fdt_index_entry - A string in the tree and the node it leads to
+ *
+ * @name: Offset of the string from the start of the blob
+ * @node: Offset of the node, or -ve FDT_ERR_... value
+ */
+struct fdt_index_entry {
+	u32 name;
+	int node;
+};
+
+/**
+ * struct fdt_index - Lookup tables for the control FDT
+ *
+ * @blob: Tree the tables were built for
+ * @size_struct: Size of its structure block at that time
+ * @size_strings: Size of its strings block at that time
+ * @full_malloc: true if allocated after full malloc() was set up
+ * @complete: true if the tables below are valid, false if out of memory or
+ *	too large for the pre-relocation malloc() area
+ * @tables: Memory holding @phandles, @compats and @aliases
+ * @phandle_max: Highest phandle in @phandles, 0 if there is no table
+ * @phandles: Node offset for each phandle, -FDT_ERR_NOTFOUND if none
+ * @compat_count: Number of entries in @compats
+ * @compats: Each compatible string of each node, sorted by string then node
+ * @alias_count: Number of entries in @aliases
+ * @aliases: Each property in /aliases, with the node it leads to
+ * @aliases_node: Offset of /aliases, or -ve FDT_ERR_... value
+ * @chosen_node: Offset of /chosen, or -ve FDT_ERR_... value
+ */
+struct fdt_index {
+	const void *blob;
+	u32 size_struct;
+	u32 size_strings;
+	bool full_malloc;
+	bool complete;
+	void *tables;
+	uint phandle_max;
+	int *phandles;
+	int compat_count;
+	struct fdt_index_entry *compats;
+	int alias_count;
+	struct fdt_index_entry *aliases;
+	int aliases_node;
+	int chosen_node;
+};
+
+static const char *fdt_index_str(const void *blob,
+				 const struct fdt_index_entry *entry)
+{
+	return (const char *)blob + entry->name;
+}
+
+static int fdt_index_compare(const void *blob,
+			     const struct fdt_index_entry *a,
+			     const struct fdt_index_entry *b)
+{
+	int ret;
+
+	ret = strcmp(fdt_index_str(blob, a), fdt_index_str(blob, b));
+
+	return ret ? ret : a->node - b->node;
+}
+
+/* A Shell sort, since qsort() has no way to pass the blob to the compare */
+static void fdt_index_sort(const void *blob, struct fdt_index_entry *list,
+			   int count)
+{
+	struct fdt_index_entry tmp;
+	int gap, i, j;
+
+	for (gap = count / 2; gap; gap /= 2) {
+		for (i = gap; i < count; i++) {
+			tmp = list[i];
+			for (j = i; j >= gap &&
+			     fdt_index_compare(blob, &list[j - gap], &tmp) > 0;
+			     j -= gap)
+				list[j] = list[j - gap];
+			list[j] = tmp;
+		}
+	}
+}
+
+/**
+ * fdt_index_scan() - Record the phandles and compatible strings in the tree
+ *
+ * @blob: Tree to scan
+ * @idx: Index to update. If the tables are not allocated yet, this just
+ *	counts the entries needed
+ * @phandle_countp: Returns the number of nodes with a phandle
+ */
+static void fdt_index_scan(const void *blob, struct fdt_index *idx,
+			   int *phandle_countp)
+{
+	const char *compat, *end, *next;
+	u32 phandle;
+	int node, len;
+
+	*phandle_countp = 0;
+	idx->compat_count = 0;
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle && phandle != (u32)-1) {
+			(*phandle_countp)++;
+			if (!idx->tables)
+				idx->phandle_max = max(idx->phandle_max,
+						       phandle);
+			else if (phandle <= idx->phandle_max &&
+				 idx->phandles[phandle] < 0)
+				idx->phandles[phandle] = node;
+		}
+
+		compat = fdt_getprop(blob, node, "compatible", &len);
+		if (!compat)
+			continue;
+		/* As with fdt_stringlist_contains(), ignore a partial string */
+		for (end = compat + len;
+		     (next = memchr(compat, '\0', end - compat));
+		     compat = next + 1) {
+			if (idx->tables) {
+				struct fdt_index_entry *entry;
+
+				entry = &idx->compats[idx->compat_count];
+				entry->name = compat - (const char *)blob;
+				entry->node = node;
+			}
+			idx->compat_count++;
+		}
+	}
+}
+
+/* Returns true if @size bytes of tables may be allocated now */
+static bool fdt_index_fits(ulong size)
+{
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return size <= (gd->malloc_limit - gd->malloc_ptr) /
+			FDT_INDEX_PRE_RELOC_SHARE;
+#endif
+
+	return true;
+}
+
+static struct fdt_index *fdt_index_build(const void *blob)
+{
+	struct fdt_index *idx;
+	int phandle_count, prop, size, i;
+	const char *name;
+
+	if (fdt_check_header(blob))
+		return NULL;
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+	idx->blob = blob;
+	idx->size_struct = fdt_size_dt_struct(blob);
+	idx->size_strings = fdt_size_dt_strings(blob);
+	idx->full_malloc = gd->flags & GD_FLG_FULL_MALLOC_INIT;
+	idx->aliases_node = fdt_path_offset(blob, "/aliases");
+	idx->chosen_node = fdt_path_offset(blob, "/chosen");
+
+	/* Count everything first, then allocate the tables and fill them */
+	fdt_index_scan(blob, idx, &phandle_count);
+	if (idx->phandle_max > phandle_count * FDT_INDEX_MAX_SPARSE + 64)
+		idx->phandle_max = 0;
+	fdt_for_each_property_offset(prop, blob, idx->aliases_node)
+		idx->alias_count++;
+	size = (idx->phandle_max + 1) * sizeof(int) +
+		(idx->compat_count + idx->alias_count) *
+		sizeof(struct fdt_index_entry);
+	if (!fdt_index_fits(size)) {
+		debug("%s: Not using %x bytes of early malloc() for tables\n",
+		      __func__, size);
+		return idx;
+	}
+	idx->tables = malloc(size);
+	if (!idx->tables) {
+		debug("%s: No memory for %x bytes of tables\n", __func__,
+		      size);
+		return idx;
+	}
+	idx->phandles = idx->tables;
+	idx->compats = (struct fdt_index_entry *)(idx->phandles +
+						  idx->phandle_max + 1);
+	idx->aliases = idx->compats + idx->compat_count;
+
+	for (i = 0; i <= idx->phandle_max; i++)
+		idx->phandles[i] = -FDT_ERR_NOTFOUND;
+	fdt_index_scan(blob, idx, &phandle_count);
+	fdt_index_sort(blob, idx->compats, idx->compat_count);
+
+	i = 0;
+	fdt_for_each_property_offset(prop, blob, idx->aliases_node) {
+		fdt_getprop_by_offset(blob, prop, &name, NULL);
+		idx->aliases[i].name = name - (const char *)blob;
+		idx->aliases[i++].node = fdt_path_offset(blob, name);
+	}
+	idx->complete = true;
+	debug("%s: %d phandles (max %u), %d compatible strings, %d aliases\n",
+	      __func__, phandle_count, idx->phandle_max, idx->compat_count,
+	      idx->alias_count);
+
+	return idx;
+}
+
+/* Returns the tables for @blob, building them if needed, or NULL if none */
+static const struct fdt_index *fdt_index_get(const void *blob)
+{
+	const struct fdt_index *idx = gd->fdt_index;
+
+	if (!blob || blob != gd->fdt_blob)
+		return NULL;
+
+	/* Rebuild if the tree changed or full malloc() is now available */
+	if (idx && (idx->blob != blob ||
+		    idx->size_struct != fdt_size_dt_struct(blob) ||
+		    idx->size_strings != fdt_size_dt_strings(blob) ||
+		    idx->full_malloc !=
+		    !!(gd->flags & GD_FLG_FULL_MALLOC_INIT))) {
+		fdt_index_drop();
+		idx = NULL;
+	}
+	if (!idx) {
+		gd->fdt_index = fdt_index_build(blob);
+		idx = gd->fdt_index;
+	}
+
+	return idx && idx->complete ? idx : NULL;
+}
+
+int fdt_index_node_by_phandle(const void *blob, uint32_t phandle)
+{
+	const struct fdt_index *idx = fdt_index_get(blob);
+	int node;
+
+	if (idx && idx->phandle_max && phandle &&
+	    phandle <= idx->phandle_max) {
+		node = idx->phandles[phandle];
+
+		/* Check in case the property was changed in place */
+		if (node >= 0 && fdt_get_phandle(blob, node) == phandle)
+			return node;
+	}
+
+	/* A property changed in place may hold a phandle the table lacks */
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+
+int fdt_index_node_by_compatible(const void *blob, int startoffset,
+				 const char *compat)
+{
+	const struct fdt_index *idx = fdt_index_get(blob);
+	const struct fdt_index_entry *entry;
+	int low, high, mid, ret;
+
+	if (!idx)
+		return fdt_node_offset_by_compatible(blob, startoffset, compat);
+
+	/* Find the first entry for @compat after @startoffset */
+	low = 0;
+	high = idx->compat_count;
+	while (low < high) {
+		mid = (low + high) / 2;
+		entry = &idx->compats[mid];
+		ret = strcmp(fdt_index_str(blob, entry), compat);
+		if (ret < 0 || (!ret && entry->node <= startoffset))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low == idx->compat_count)
+		return -FDT_ERR_NOTFOUND;
+	entry = &idx->compats[low];
+	if (strcmp(fdt_index_str(blob, entry), compat))
+		return -FDT_ERR_NOTFOUND;
+
+	/* Check in case the property was changed in place */
+	if (!fdt_node_check_compatible(blob, entry->node, compat))
+		return entry->node;
+
+	return fdt_node_offset_by_compatible(blob, startoffset, compat);
+}
+
+int fdt_index_path_offset(const void *blob, const char *path)
+{
+	const struct fdt_index *idx = fdt_index_get(blob);
+	int i;
+
+	if (!idx)
+		return fdt_path_offset(blob, path);
+
+	if (!strcmp(path, "/aliases"))
+		return idx->aliases_node;
+	if (!strcmp(path, "/chosen"))
+		return idx->chosen_node;
+	if (strchr(path, '/'))
+		return fdt_path_offset(blob, path);
+
+	for (i = 0; i < idx->alias_count; i++) {
+		if (!strcmp(fdt_index_str(blob, &idx->aliases[i]), path))
+			return idx->aliases[i].node;
+	}
+
+	return -FDT_ERR_BADPATH;
+}
+
+void fdt_index_drop(void)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	/* Memory from the pre-relocation malloc() area cannot be freed */
+	if (idx && idx->full_malloc &&
+	    (gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		free(idx->tables);
+		free(idx);
+	}
+	gd->fdt_index = NULL;
+}
@@ -11,6 +11,7 @@
 #include <env.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <gzip.h>
 #include <mapmem.h>
@@ -283,7 +284,7 @@ enum fdt_compat_id fdtdec_lookup(const void *blob, int node)
 
 int fdtdec_next_compatible(const void *blob, int node, enum fdt_compat_id id)
 {
-	return fdt_node_offset_by_compatible(blob, node, compat_names[id]);
+	return fdt_index_node_by_compatible(blob, node, compat_names[id]);
 }
 
 int fdtdec_next_compatible_subnode(const void *blob, int node,
@@ -460,7 +461,7 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 	find_name = fdt_get_name(blob, offset, &find_namelen);
 	debug("Looking for '%s' at %d, name %s\n", base, offset, find_name);
 
-	aliases = fdt_path_offset(blob, "/aliases");
+	aliases = fdt_index_path_offset(blob, "/aliases");
 	for (prop_offset = fdt_first_property_offset(blob, aliases);
 	     prop_offset > 0;
 	     prop_offset = fdt_next_property_offset(blob, prop_offset)) {
@@ -499,7 +500,7 @@ int fdtdec_get_alias_highest_id(const void *blob, const char *base)
 
 	debug("Looking for highest alias id for '%s'\n", base);
 
-	aliases = fdt_path_offset(blob, "/aliases");
+	aliases = fdt_index_path_offset(blob, "/aliases");
 	for (prop_offset = fdt_first_property_offset(blob, aliases);
 	     prop_offset > 0;
 	     prop_offset = fdt_next_property_offset(blob, prop_offset)) {
@@ -529,7 +530,7 @@ const char *fdtdec_get_chosen_prop(const void *blob, const char *name)
 
 	if (!blob)
 		return NULL;
-	chosen_node = fdt_path_offset(blob, "/chosen");
+	chosen_node = fdt_index_path_offset(blob, "/chosen");
 	return fdt_getprop(blob, chosen_node, name, NULL);
 }
 
@@ -540,7 +541,7 @@ int fdtdec_get_chosen_node(const void *blob, const char *name)
 	prop = fdtdec_get_chosen_prop(blob, name);
 	if (!prop)
 		return -FDT_ERR_NOTFOUND;
-	return fdt_path_offset(blob, prop);
+	return fdt_index_path_offset(blob, prop);
 }
 
 int fdtdec_check_fdt(void)
@@ -562,6 +563,7 @@ int fdtdec_check_fdt(void)
  */
 int fdtdec_prepare_fdt(void)
 {
+	fdt_index_drop();
 	if (!gd->fdt_blob || ((uintptr_t)gd->fdt_blob & 3) ||
 	    fdt_check_header(gd->fdt_blob)) {
 #ifdef CONFIG_SPL_BUILD
@@ -591,7 +593,7 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdt_index_node_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -722,8 +724,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdt_index_node_by_phandle(blob,
+								 phandle);
 				if (!node) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -1406,7 +1408,7 @@ int fdtdec_get_carveout(const void *blob, const char *node, const char *name,
 
 	phandle = fdt32_to_cpu(prop[index]);
 
-	offset = fdt_node_offset_by_phandle(blob, phandle);
+	offset = fdt_index_node_by_phandle(blob, phandle);
 	if (offset < 0) {
 		debug("failed to find node for phandle %u\n", phandle);
 		return offset;
@@ -5,13 +5,17 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <command.h>
 #include <console.h>
 #include <div64.h>
 #include <gzip.h>
 #include <image.h>
+#include <job_queue.h>
 #include <malloc.h>
 #include <memalign.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
 #include <u-boot/crc.h>
 #include <watchdog.h>
 #include <u-boot/zlib.h>
@@ -71,14 +75,278 @@ int gzip_parse_header(const unsigned char *src, unsigned long len)
 	return i;
 }
 
+static int zunzip_used(void *dst, int dstlen, unsigned char *src,
+		       unsigned long *lenp, int stoponerr, int offset,
+		       int *usedp);
+
+/* Check for the start of a gzip member */
+static bool gzip_is_member(const unsigned char *src)
+{
+	return src[0] == (u8)HEADER0 && src[1] == (u8)HEADER1 &&
+		src[2] == DEFLATED;
+}
+
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+/* Memory set aside for zlib to inflate one stream: its state and window */
+#define GZIP_ARENA_SIZE		SZ_64K
+
+/**
+ * struct gzip_arena - memory for zlib to use while running in a job
+ *
+ * zlib allocates its state when a stream is set up and its window during
+ * the first inflate(), but a job must not call malloc(), so these come from
+ * here instead. Nothing is freed until the whole arena is.
+ *
+ * @base:	Start of the memory, GZIP_ARENA_SIZE bytes
+ * @used:	Number of bytes allocated so far
+ */
+struct gzip_arena {
+	char *base;
+	uint used;
+};
+
+static void *gzalloc_arena(void *x, unsigned items, unsigned size)
+{
+	struct gzip_arena *arena = x;
+	void *p;
+
+	size = ALIGN(items * size, ZALLOC_ALIGNMENT);
+	if (size > GZIP_ARENA_SIZE - arena->used)
+		return NULL;
+	p = arena->base + arena->used;
+	arena->used += size;
+
+	return p;
+}
+
+static void gzfree_arena(void *x, void *addr, unsigned nb)
+{
+}
+
+/**
+ * struct gunzip_stream - a zlib stream used by the jobs running on one CPU
+ *
+ * The stream is set up before the jobs run, since inflateInit2() and
+ * inflateEnd() may reset the watchdog, and is reset for each member. Its
+ * state and window stay in the arena, so one arena serves all the members
+ * which the CPU inflates.
+ *
+ * @arena:	Memory for zlib
+ * @s:		zlib stream
+ */
+struct gunzip_stream {
+	struct gzip_arena arena;
+	z_stream s;
+};
+
+/**
+ * struct gunzip_member - a member of a gzip file, inflated by a job
+ *
+ * @src:	Deflate data of the member, without its header and trailer
+ * @srcn:	Length of @src
+ * @dst:	Destination for the uncompressed data
+ * @dstn:	Length of the uncompressed data, from the member's trailer
+ * @streams:	Stream for each CPU, indexed by the job's CPU number
+ */
+struct gunzip_member {
+	unsigned char *src;
+	ulong srcn;
+	void *dst;
+	ulong dstn;
+	struct gunzip_stream *streams;
+};
+
+static int gunzip_member_run(struct job *job)
+{
+	struct gunzip_member *mem = job->priv;
+	z_stream *s = &mem->streams[job->cpu].s;
+	int r;
+
+	if (inflateReset(s) != Z_OK)
+		return -EINVAL;
+	s->next_in = mem->src;
+	s->avail_in = mem->srcn;
+	s->next_out = mem->dst;
+	s->avail_out = mem->dstn;
+	r = inflate(s, Z_FINISH);
+	if (r != Z_STREAM_END || s->avail_out)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Get the size of a gzip member from the 'BC' subfield which bgzip (BGZF)
+ * puts in the extra field of each member's header, or 0 if there is none
+ */
+static ulong gzip_member_size(const unsigned char *src, ulong len)
+{
+	const unsigned char *extra, *end;
+	uint xlen, slen;
+
+	if (len < 18 || !gzip_is_member(src) || !(src[3] & EXTRA_FIELD))
+		return 0;
+	xlen = get_unaligned_le16(src + 10);
+	if (12 + xlen > len)
+		return 0;
+	end = src + 12 + xlen;
+	for (extra = src + 12; extra + 4 <= end; extra += 4 + slen) {
+		slen = get_unaligned_le16(extra + 2);
+		if (extra[0] == 'B' && extra[1] == 'C' && slen == 2 &&
+		    extra + 6 <= end)
+			return get_unaligned_le16(extra + 4) + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Inflate the members of a gzip file on several CPUs at once. This needs
+ * the size of each member to be recorded in its header, as bgzip does, so
+ * that the members can be found without inflating them. The place for the
+ * output of each member comes from the sizes in the trailers. If anything
+ * is wrong, this returns an error and the caller inflates the members one
+ * after another, which also reports the right error.
+ */
+static int gunzip_parallel(void *dst, int dstlen, unsigned char *src,
+			   unsigned long *lenp)
+{
+	struct gunzip_stream *streams = NULL;
+	struct gunzip_member *mems;
+	ulong pos, size, len = 0;
+	unsigned char *end;
+	struct job *jobs;
+	ulong cpu_us = 0;
+	int count, cpus, i;
+	int offset;
+	int ret;
+
+	if (job_queue_cpus() < 2)
+		return -EAGAIN;
+
+	for (count = 0, pos = 0; pos < *lenp; count++, pos += size) {
+		size = gzip_member_size(src + pos, *lenp - pos);
+		if (!size)
+			break;
+		if (size < 18 || size > *lenp - pos)
+			return -EINVAL;
+	}
+	/* Anything after the members must not be another gzip member */
+	if (count < 2 || (pos + 18 <= *lenp && gzip_is_member(src + pos)))
+		return -EINVAL;
+	end = src + pos;
+
+	/* Each CPU inflates its members one after another in its own arena */
+	cpus = min(job_queue_cpus(), count);
+	streams = calloc(cpus, sizeof(*streams));
+	mems = calloc(count, sizeof(*mems));
+	jobs = calloc(count, sizeof(*jobs));
+	if (!streams || !mems || !jobs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < cpus; i++) {
+		streams[i].arena.base = malloc(GZIP_ARENA_SIZE);
+		if (!streams[i].arena.base) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		streams[i].s.zalloc = gzalloc_arena;
+		streams[i].s.zfree = gzfree_arena;
+		streams[i].s.opaque = &streams[i].arena;
+		if (inflateInit2(&streams[i].s, -MAX_WBITS) != Z_OK) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		inflateWatchdog(&streams[i].s, 0);
+	}
+	for (i = 0, pos = 0; i < count; i++, pos += size) {
+		size = gzip_member_size(src + pos, *lenp - pos);
+		offset = gzip_parse_header(src + pos, size - 8);
+		if (offset < 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+		mems[i].src = src + pos + offset;
+		mems[i].srcn = size - offset - 8;
+		mems[i].dst = dst + len;
+		mems[i].dstn = get_unaligned_le32(src + pos + size - 4);
+		len += mems[i].dstn;
+		if (len > dstlen) {
+			ret = -ENOBUFS;
+			goto out;
+		}
+		mems[i].streams = streams;
+		jobs[i].func = gunzip_member_run;
+		jobs[i].priv = &mems[i];
+		jobs[i].cost = mems[i].srcn;
+	}
+
+	/* In-place decompression needs the members done in order */
+	if (src < (uchar *)dst + len && (uchar *)dst < end) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_GZIP, "gzip");
+	ret = job_queue_run(jobs, count);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_GZIP);
+	for (i = 0; i < count; i++)
+		cpu_us += jobs[i].time_us;
+	bootstage_accum_add(BOOTSTAGE_ID_ACCUM_GZIP_CPU, "gzip_cpu", cpu_us);
+	if (!ret)
+		*lenp = len;
+out:
+	if (streams) {
+		for (i = 0; i < cpus; i++) {
+			if (streams[i].s.state)
+				inflateEnd(&streams[i].s);
+			free(streams[i].arena.base);
+		}
+	}
+	free(jobs);
+	free(mems);
+	free(streams);
+
+	return ret;
+}
+#endif
+
 int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 {
-	int offset = gzip_parse_header(src, *lenp);
+	unsigned long len = *lenp;
+	unsigned long used, total = 0;
+	int offset;
+	int ret;
+
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	if (!gunzip_parallel(dst, dstlen, src, lenp))
+		return 0;
+#endif
 
-	if (offset < 0)
-		return offset;
+	/* Inflate each member in turn, as written by e.g. 'cat a.gz b.gz' */
+	do {
+		offset = gzip_parse_header(src, len);
+		if (offset < 0)
+			return offset;
+
+		used = len;
+		ret = zunzip_used(dst + total, dstlen - total, src, &used, 1,
+				  offset, &offset);
+		total += used;
+		if (ret)
+			break;
 
-	return zunzip(dst, dstlen, src, lenp, 1, offset);
+		/* Skip the trailer with the CRC and the uncompressed size */
+		offset += 8;
+		if (offset >= len)
+			break;
+		src += offset;
+		len -= offset;
+	} while (len >= 18 && gzip_is_member(src));
+	*lenp = total;
+
+	return ret;
 }
 
 #ifdef CONFIG_CMD_UNZIP
@@ -115,6 +383,92 @@ void gzwrite_progress_finish(int returnval,
 	}
 }
 
+/**
+ * struct gzwrite_state - state of gzwrite() while inflating and writing
+ *
+ * Each step inflates the next buffer's worth of data while the data from the
+ * previous step is written out. With CONFIG_GZIP_PARALLEL and a second CPU,
+ * these overlap, so the device rather than inflate() sets the pace.
+ *
+ * @s:		zlib stream
+ * @r:		Last value returned by inflate()
+ * @crc:	CRC32 of the data inflated so far
+ * @done:	true when there is nothing more to inflate
+ * @dev:	Device to write to
+ * @outblock:	Next block to write on @dev
+ * @szwritebuf:	Size of each buffer
+ * @buf:	Buffers which are inflated into and written from in turn
+ * @filled:	Number of bytes in each buffer waiting to be written
+ * @cur:	Buffer to inflate into next
+ */
+struct gzwrite_state {
+	z_stream s;
+	int r;
+	u32 crc;
+	bool done;
+	struct blk_desc *dev;
+	lbaint_t outblock;
+	unsigned long szwritebuf;
+	unsigned char *buf[2];
+	unsigned long filled[2];
+	int cur;
+};
+
+/* Inflate the next buffer's worth of data */
+static int gzwrite_inflate(struct job *job)
+{
+	struct gzwrite_state *st = job->priv;
+	unsigned char *buf = st->buf[st->cur];
+
+	st->s.avail_out = st->szwritebuf;
+	st->s.next_out = buf;
+	st->r = inflate(&st->s, Z_SYNC_FLUSH);
+	if (st->r != Z_OK && st->r != Z_STREAM_END) {
+		st->done = true;
+		return -EIO;
+	}
+	st->filled[st->cur] = st->szwritebuf - st->s.avail_out;
+	st->crc = crc32(st->crc, buf, st->filled[st->cur]);
+
+	/* Stop at the end of the stream, or if the input runs out early */
+	if (st->r == Z_STREAM_END || (st->s.avail_out && !st->s.avail_in))
+		st->done = true;
+
+	return 0;
+}
+
+/* Write out the data inflated by the previous step */
+static int gzwrite_write(struct job *job)
+{
+	struct gzwrite_state *st = job->priv;
+	int prev = !st->cur;
+	unsigned char *buf = st->buf[prev];
+	unsigned long numfilled = st->filled[prev];
+	struct blk_desc *dev = st->dev;
+	lbaint_t writeblocks;
+
+	writeblocks = DIV_ROUND_UP(numfilled, dev->blksz);
+	if (numfilled < st->szwritebuf)
+		memset(buf + numfilled, 0,
+		       dev->blksz - (numfilled % dev->blksz));
+	st->outblock += blk_dwrite(dev, st->outblock, writeblocks, buf);
+	st->filled[prev] = 0;
+
+	return 0;
+}
+
+static void gzwrite_run(struct job *jobs, int count)
+{
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	job_queue_run(jobs, count);
+#else
+	int i;
+
+	for (i = 0; i < count; i++)
+		jobs[i].ret = jobs[i].func(&jobs[i]);
+#endif
+}
+
 int gzwrite(unsigned char *src, int len,
 	    struct blk_desc *dev,
 	    unsigned long szwritebuf,
@@ -122,15 +476,17 @@ int gzwrite(unsigned char *src, int len,
 	    u64 szexpected)
 {
 	int i, flags;
-	z_stream s;
+	struct gzwrite_state st;
+	struct job jobs[2], *inflate_job;
 	int r = 0;
-	unsigned char *writebuf;
-	unsigned crc = 0;
 	u64 totalfilled = 0;
-	lbaint_t blksperbuf, outblock;
 	u32 expected_crc;
 	u32 payload_size;
 	int iteration = 0;
+	int count;
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	struct gzip_arena arena = { 0 };
+#endif
 
 	if (!szwritebuf ||
 	    (szwritebuf % dev->blksz) ||
@@ -146,8 +502,10 @@ int gzwrite(unsigned char *src, int len,
 		return -1;
 	}
 
-	blksperbuf = szwritebuf / dev->blksz;
-	outblock = lldiv(startoffs, dev->blksz);
+	memset(&st, '\0', sizeof(st));
+	st.dev = dev;
+	st.szwritebuf = szwritebuf;
+	st.outblock = lldiv(startoffs, dev->blksz);
 
 	/* skip header */
 	i = 10;
@@ -185,7 +543,7 @@ int gzwrite(unsigned char *src, int len,
 		       szexpected, szuncompressed);
 		return -1;
 	}
-	if (lldiv(szexpected, dev->blksz) > (dev->lba - outblock)) {
+	if (lldiv(szexpected, dev->blksz) > (dev->lba - st.outblock)) {
 		printf("%s: uncompressed size %llu exceeds device size\n",
 		       __func__, szexpected);
 		return -1;
@@ -193,89 +551,109 @@ int gzwrite(unsigned char *src, int len,
 
 	gzwrite_progress_init(szexpected);
 
-	s.zalloc = gzalloc;
-	s.zfree = gzfree;
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	/* inflate() may run on another CPU, so must not call malloc() */
+	arena.base = malloc(GZIP_ARENA_SIZE);
+	if (!arena.base)
+		return -1;
+	st.s.zalloc = gzalloc_arena;
+	st.s.zfree = gzfree_arena;
+	st.s.opaque = &arena;
+#else
+	st.s.zalloc = gzalloc;
+	st.s.zfree = gzfree;
+#endif
 
-	r = inflateInit2(&s, -MAX_WBITS);
+	r = inflateInit2(&st.s, -MAX_WBITS);
 	if (r != Z_OK) {
 		printf("Error: inflateInit2() returned %d\n", r);
-		return -1;
+		r = -1;
+		goto out_arena;
 	}
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	inflateWatchdog(&st.s, 0);
+	/* Build the CRC table here if it is built at first use */
+	crc32(0, NULL, 0);
+#endif
 
-	s.next_in = src + i;
-	s.avail_in = payload_size+8;
-	writebuf = (unsigned char *)malloc_cache_aligned(szwritebuf);
+	st.s.next_in = src + i;
+	st.s.avail_in = payload_size+8;
+	st.buf[0] = (unsigned char *)malloc_cache_aligned(szwritebuf);
+	st.buf[1] = (unsigned char *)malloc_cache_aligned(szwritebuf);
 
-	/* decompress until deflate stream ends or end of file */
+	/*
+	 * Inflate until the deflate stream ends or the input runs out, while
+	 * writing out what was inflated in the step before
+	 */
 	do {
-		if (s.avail_in == 0) {
-			printf("%s: weird termination with result %d\n",
-			       __func__, r);
-			break;
+		memset(jobs, '\0', sizeof(jobs));
+		count = 0;
+		inflate_job = NULL;
+		if (!st.done) {
+			inflate_job = &jobs[count++];
+			inflate_job->func = gzwrite_inflate;
+			inflate_job->priv = &st;
+			inflate_job->cost = szwritebuf;
+		}
+		if (st.filled[!st.cur]) {
+			jobs[count].func = gzwrite_write;
+			jobs[count].priv = &st;
+			jobs[count].cost = szwritebuf;
+			jobs[count++].flags = JOBF_BOOT_CPU;
 		}
+		if (!count)
+			break;
+		gzwrite_run(jobs, count);
 
-		/* run inflate() on input until output buffer not full */
-		do {
-			unsigned long blocks_written;
-			int numfilled;
-			lbaint_t writeblocks;
-
-			s.avail_out = szwritebuf;
-			s.next_out = writebuf;
-			r = inflate(&s, Z_SYNC_FLUSH);
-			if ((r != Z_OK) &&
-			    (r != Z_STREAM_END)) {
+		r = st.r;
+		if (inflate_job) {
+			if (inflate_job->ret) {
 				printf("Error: inflate() returned %d\n", r);
 				goto out;
 			}
-			numfilled = szwritebuf - s.avail_out;
-			crc = crc32(crc, writebuf, numfilled);
-			totalfilled += numfilled;
-			if (numfilled < szwritebuf) {
-				writeblocks = (numfilled+dev->blksz-1)
-						/ dev->blksz;
-				memset(writebuf+numfilled, 0,
-				       dev->blksz-(numfilled%dev->blksz));
-			} else {
-				writeblocks = blksperbuf;
-			}
-
-			gzwrite_progress(iteration++,
-					 totalfilled,
+			if (st.done && r != Z_STREAM_END)
+				printf("%s: weird termination with result %d\n",
+				       __func__, r);
+			totalfilled += st.filled[st.cur];
+			gzwrite_progress(iteration++, totalfilled,
 					 szexpected);
-			blocks_written = blk_dwrite(dev, outblock,
-						    writeblocks, writebuf);
-			outblock += blocks_written;
-			if (ctrlc()) {
-				puts("abort\n");
-				goto out;
-			}
-			WATCHDOG_RESET();
-		} while (s.avail_out == 0);
-		/* done when inflate() says it's done */
-	} while (r != Z_STREAM_END);
+		}
+		if (ctrlc()) {
+			puts("abort\n");
+			goto out;
+		}
+		WATCHDOG_RESET();
+		st.cur = !st.cur;
+	} while (1);
 
 	if ((szexpected != totalfilled) ||
-	    (crc != expected_crc))
+	    (st.crc != expected_crc))
 		r = -1;
 	else
 		r = 0;
 
 out:
 	gzwrite_progress_finish(r, totalfilled, szexpected,
-				expected_crc, crc);
-	free(writebuf);
-	inflateEnd(&s);
+				expected_crc, st.crc);
+	free(st.buf[1]);
+	free(st.buf[0]);
+	inflateEnd(&st.s);
+out_arena:
+#if CONFIG_IS_ENABLED(GZIP_PARALLEL)
+	free(arena.base);
+#endif
 
 	return r;
 }
 #endif
 
 /*
- * Uncompress blocks compressed with zlib without headers
+ * Uncompress blocks compressed with zlib without headers, setting *usedp (if
+ * not NULL) to the offset of the first byte after the compressed data
  */
-int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
-						int stoponerr, int offset)
+static int zunzip_used(void *dst, int dstlen, unsigned char *src,
+		       unsigned long *lenp, int stoponerr, int offset,
+		       int *usedp)
 {
 	z_stream s;
 	int err = 0;
@@ -303,7 +681,15 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 		}
 	} while (r == Z_BUF_ERROR);
 	*lenp = s.next_out - (unsigned char *) dst;
+	if (usedp)
+		*usedp = s.next_in - src;
 	inflateEnd(&s);
 
 	return err;
 }
+
+int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
+						int stoponerr, int offset)
+{
+	return zunzip_used(dst, dstlen, src, lenp, stoponerr, offset, NULL);
+}
@@ -60,14 +60,31 @@
  * which describes the current status.
  */
 
+/*
+ * The hash table itself only holds the hash of each key and the index of
+ * its entry in htab->entries, which lists the entries in the order they
+ * were added. Entries are allocated separately so they do not move when the
+ * table is resized, and walking through them does not need to look at the
+ * empty slots in the table.
+ *
+ * used is USED_FREE, USED_DELETED or the entry's index plus one.
+ */
 struct env_entry_node {
 	int used;
-	struct env_entry entry;
+	unsigned int hval;
 };
 
+/* Resize the table when more than this many of its slots are not free */
+#define HTAB_MAX_LOAD(size)	((size) * 3 / 4)
+
+/*
+ * Number of slots moved from the old table to the new one on each access
+ * while the table is being resized
+ */
+#define HTAB_REHASH_STEP	8
 
 static void _hdelete(const char *key, struct hsearch_data *htab,
-		     struct env_entry *ep, int idx);
+		     unsigned int hval);
 
 /*
  * hcreate()
@@ -91,6 +108,18 @@ static int isprime(unsigned int number)
 	return number % div != 0;
 }
 
+/* Get the first prime number not smaller than nel (and at least 3) */
+static unsigned int hprime(unsigned int nel)
+{
+	nel |= 1;		/* make odd */
+	if (nel < 3)
+		nel = 3;
+	while (!isprime(nel))
+		nel += 2;
+
+	return nel;
+}
+
 /*
  * Before using the hash table we must allocate memory for it.
  * Test for an existing table are done. We allocate one element
@@ -113,12 +142,16 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 
 	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
-
-	htab->size = nel;
+	htab->size = hprime(nel);
 	htab->filled = 0;
+	htab->slots_used = 0;
+	htab->old_table = NULL;
+	htab->entries = NULL;
+	htab->count = 0;
+	htab->alloced = 0;
+	htab->sorted = NULL;
+	htab->sorted_len = 0;
+	htab->sorted_upto = 0;
 
 	/* allocate memory and zero out */
 	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
@@ -151,15 +184,25 @@ void hdestroy_r(struct hsearch_data *htab)
 	}
 
 	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
+	for (i = 0; i < htab->count; ++i) {
+		struct env_entry *ep = htab->entries[i];
 
+		if (ep) {
 			free((void *)ep->key);
 			free(ep->data);
+			free(ep);
 		}
 	}
+	free(htab->entries);
+	free(htab->sorted);
+	free(htab->old_table);
 	free(htab->table);
+	htab->entries = NULL;
+	htab->sorted = NULL;
+	htab->old_table = NULL;
+	htab->count = 0;
+	htab->alloced = 0;
+	htab->filled = 0;
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
@@ -172,18 +215,23 @@ void hdestroy_r(struct hsearch_data *htab)
 /*
  * This is the search function. It uses double hashing with open addressing.
  * The argument item.key has to be a pointer to an zero terminated, most
- * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
+ * probably strings of chars. The key is hashed with FNV-1a, which spreads
+ * keys that differ only in their last few characters (e.g. "bootcount_17"
+ * and "bootcount_18") over the whole table.
  *
  * We use an trick to speed up the lookup. The table is created by hcreate
  * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
+ * special. This index will never be used because a slot with the index
+ * zero would be the end of every probe sequence. Each slot keeps the full
+ * hash value of its key, which is used as a first fast comparison for
  * equality of the stored and the parameter value. This helps to prevent
  * unnecessary expensive calls of strcmp.
  *
+ * Once more than three quarters of the slots are in use, a larger table
+ * is allocated. The entries are moved into it a few at a time on each
+ * later access, so that no single call has to rehash the whole table.
+ * Until this is complete, lookups check both tables.
+ *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
  *
@@ -196,225 +244,392 @@ void hdestroy_r(struct hsearch_data *htab)
  * - The standard implementation does not provide a way to update an
  *   existing entry.  This version will create a new entry or update an
  *   existing one when both "action == ENV_ENTER" and "item.data != NULL".
- * - Instead of returning 1 on success, we return the index into the
- *   internal hash table, which is also guaranteed to be positive.
- *   This allows us direct access to the found hash table slot for
- *   example for functions like hdelete().
+ * - Instead of returning 1 on success, we return the index of the entry
+ *   (counting from 1 in the order entries were added), which is also
+ *   guaranteed to be positive. This can be passed to hmatch_r() to carry
+ *   on from that entry.
  */
 
-int hmatch_r(const char *match, int last_idx, struct env_entry **retval,
-	     struct hsearch_data *htab)
+static unsigned int hhash(const char *key)
 {
-	unsigned int idx;
-	size_t key_len = strlen(match);
+	unsigned int hval = 2166136261U;
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
-		if (htab->table[idx].used <= 0)
-			continue;
-		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
-			*retval = &htab->table[idx].entry;
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619;
+	}
+
+	return hval;
+}
+
+/*
+ * Look for a key in a table. Returns the slot holding it, or 0 if it is not
+ * there. In that case, if insp is not NULL, *insp is set to the slot where
+ * the key should be added (or 0 if there is no room).
+ */
+static unsigned int hprobe(struct hsearch_data *htab,
+			   struct env_entry_node *table, unsigned int size,
+			   const char *key, unsigned int hval,
+			   unsigned int *insp)
+{
+	unsigned int first_deleted = 0, first_free = 0;
+	unsigned int idx, start, step;
+	struct env_entry_node *node;
+
+	/*
+	 * First hash function:
+	 * simply take the modul but prevent zero.
+	 */
+	start = hval % size;
+	if (start == 0)
+		++start;
+
+	/*
+	 * Second hash function:
+	 * as suggested in [Knuth]
+	 */
+	step = 1 + start % (size - 2);
+
+	idx = start;
+	do {
+		node = &table[idx];
+		if (node->used == USED_FREE) {
+			first_free = idx;
+			break;
+		}
+		if (node->used == USED_DELETED) {
+			if (!first_deleted)
+				first_deleted = idx;
+		} else if (node->hval == hval &&
+			   !strcmp(key, htab->entries[node->used - 1]->key)) {
 			return idx;
 		}
+
+		/*
+		 * Because SIZE is prime this guarantees to
+		 * step through all available indices.
+		 */
+		if (idx <= step)
+			idx = size + idx - step;
+		else
+			idx -= step;
+	} while (idx != start);
+
+	if (insp)
+		*insp = first_deleted ? first_deleted : first_free;
+
+	return 0;
+}
+
+/* Find the slot holding a key, in either table */
+static struct env_entry_node *hlookup(struct hsearch_data *htab,
+				      const char *key, unsigned int hval)
+{
+	unsigned int idx;
+
+	idx = hprobe(htab, htab->table, htab->size, key, hval, NULL);
+	if (idx)
+		return &htab->table[idx];
+	if (htab->old_table) {
+		idx = hprobe(htab, htab->old_table, htab->old_size, key, hval,
+			     NULL);
+		if (idx)
+			return &htab->old_table[idx];
+	}
+
+	return NULL;
+}
+
+/* Move up to count slots from the old table (if any) to the current one */
+static void hrehash(struct hsearch_data *htab, unsigned int count)
+{
+	struct env_entry_node *node;
+	unsigned int ins;
+
+	while (htab->old_table && count--) {
+		node = &htab->old_table[htab->rehash_idx];
+		if (node->used > 0) {
+			hprobe(htab, htab->table, htab->size,
+			       htab->entries[node->used - 1]->key, node->hval,
+			       &ins);
+			if (htab->table[ins].used == USED_FREE)
+				++htab->slots_used;
+			htab->table[ins] = *node;
+		}
+		if (++htab->rehash_idx > htab->old_size) {
+			free(htab->old_table);
+			htab->old_table = NULL;
+		}
 	}
+}
+
+/*
+ * Allocate a new table with room for twice the current number of entries
+ * (and at least as big as the current table, so that deleted slots are
+ * cleared out) and start moving the entries into it.
+ */
+static int hresize(struct hsearch_data *htab)
+{
+	struct env_entry_node *table;
+	unsigned int size;
+
+	/* Finish off any resize which is still in progress */
+	hrehash(htab, htab->old_size);
+
+	size = (htab->filled + 1) * 8 / 3;
+	if (size < htab->size)
+		size = htab->size;
+	size = hprime(size);
+	table = calloc(size + 1, sizeof(struct env_entry_node));
+	if (!table)
+		return -ENOMEM;
+	debug("hresize: table %p, %d -> %d slots, filled %d\n", htab,
+	      htab->size, size, htab->filled);
+
+	htab->old_table = htab->table;
+	htab->old_size = htab->size;
+	htab->rehash_idx = 1;
+	htab->table = table;
+	htab->size = size;
+	htab->slots_used = 0;
 
-	__set_errno(ESRCH);
-	*retval = NULL;
 	return 0;
 }
 
 /*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENV_ENTER.  This is simply a helper function for hsearch_r().
+ * Squeeze out the deleted entries from htab->entries. This changes the
+ * index of the entries, so the table and sorted index are updated too.
  */
-static inline int _compare_and_overwrite_entry(struct env_entry item,
-		enum env_action action, struct env_entry **retval,
-		struct hsearch_data *htab, int flag, unsigned int hval,
-		unsigned int idx)
+static int hcompact(struct hsearch_data *htab)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if (action == ENV_ENTER && item.data) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
+	unsigned int *remap;
+	unsigned int i, n;
+
+	remap = malloc(htab->count * sizeof(*remap));
+	if (!remap)
+		return -ENOMEM;
+
+	/* Only the current table needs to be updated after this */
+	hrehash(htab, htab->old_size);
+
+	for (i = 0, n = 0; i < htab->count; i++) {
+		if (htab->entries[i]) {
+			remap[i] = n;
+			htab->entries[n++] = htab->entries[i];
+		} else {
+			remap[i] = ~0U;
+		}
+	}
+	for (i = 1; i <= htab->size; i++) {
+		if (htab->table[i].used > 0)
+			htab->table[i].used = remap[htab->table[i].used - 1] + 1;
+	}
 
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
+	/*
+	 * The sorted index holds all the remaining entries before
+	 * sorted_upto, which are now the first n entries
+	 */
+	for (i = 0, n = 0; i < htab->sorted_len; i++) {
+		if (remap[htab->sorted[i]] != ~0U)
+			htab->sorted[n++] = remap[htab->sorted[i]];
+	}
+	htab->sorted_len = n;
+	htab->sorted_upto = n;
+	htab->count = htab->filled;
+	free(remap);
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
+	return 0;
+}
+
+/* Add an entry to the end of htab->entries, returning its index plus one */
+static int hadd_entry(struct hsearch_data *htab, struct env_entry *ep)
+{
+	unsigned int alloced;
+	void *ptr;
+
+	if (htab->count == htab->alloced) {
+		/* Reuse the space of deleted entries if there are many */
+		if (!htab->alloced ||
+		    htab->count - htab->filled < htab->alloced / 4 ||
+		    hcompact(htab)) {
+			alloced = htab->alloced ? htab->alloced * 2 : 16;
+			ptr = realloc(htab->entries, alloced * sizeof(ep));
+			if (!ptr)
+				return -ENOMEM;
+			htab->entries = ptr;
+			ptr = realloc(htab->sorted,
+				      alloced * sizeof(*htab->sorted));
+			if (!ptr)
+				return -ENOMEM;
+			htab->sorted = ptr;
+			htab->alloced = alloced;
 		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
 	}
-	/* keep searching */
-	return -1;
+	htab->entries[htab->count++] = ep;
+
+	return htab->count;
 }
 
-int hsearch_r(struct env_entry item, enum env_action action,
-	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+int hmatch_r(const char *match, int last_idx, struct env_entry **retval,
+	     struct hsearch_data *htab)
 {
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
+	size_t key_len = strlen(match);
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
+	for (idx = last_idx; idx < htab->count; ++idx) {
+		struct env_entry *ep = htab->entries[idx];
 
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+		if (!ep)
+			continue;
+		if (!strncmp(match, ep->key, key_len)) {
+			*retval = ep;
+			return idx + 1;
+		}
+	}
 
-	/* The first index tried. */
-	idx = hval;
+	__set_errno(ESRCH);
+	*retval = NULL;
+	return 0;
+}
 
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
+/*
+ * Overwrite an existing entry if the action is ENV_ENTER. This is simply a
+ * helper function for hsearch_r(). Returns 0 if OK, -1 if rejected.
+ */
+static inline int _overwrite_entry(struct env_entry item,
+		enum env_action action, struct env_entry *ep,
+		struct hsearch_data *htab, int flag)
+{
+	/* Overwrite existing value? */
+	if (action == ENV_ENTER && item.data) {
+		/* check for permission */
+		if (htab->change_ok != NULL && htab->change_ok(
+		    ep, item.data, env_op_overwrite, flag)) {
+			debug("change_ok() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EPERM);
+			return -1;
+		}
 
-		if (htab->table[idx].used == USED_DELETED
-		    && !first_deleted)
-			first_deleted = idx;
+		/* If there is a callback, call it */
+		if (ep->callback && ep->callback(item.key,
+		    item.data, env_op_overwrite, flag)) {
+			debug("callback() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EINVAL);
+			return -1;
+		}
 
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
+		free(ep->data);
+		ep->data = strdup(item.data);
+		if (!ep->data) {
+			__set_errno(ENOMEM);
+			return -1;
+		}
+	}
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
+	return 0;
+}
 
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
+int hsearch_r(struct env_entry item, enum env_action action,
+	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+{
+	struct env_entry_node *node;
+	struct env_entry *ep;
+	unsigned int hval = hhash(item.key);
+	unsigned int ins;
+	int idx;
 
-			if (htab->table[idx].used == USED_DELETED
-			    && !first_deleted)
-				first_deleted = idx;
+	hrehash(htab, HTAB_REHASH_STEP);
 
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
+	node = hlookup(htab, item.key, hval);
+	if (node) {
+		idx = node->used;
+		ep = htab->entries[idx - 1];
+		if (_overwrite_entry(item, action, ep, htab, flag)) {
+			*retval = NULL;
+			return 0;
 		}
-		while (htab->table[idx].used != USED_FREE);
+		/* return found entry */
+		*retval = ep;
+		return idx;
 	}
 
-	/* An empty bucket has been found. */
+	/* No entry found. */
 	if (action == ENV_ENTER) {
 		/*
-		 * If table is full and another entry should be
-		 * entered return with error.
+		 * Create new entry;
+		 * create copies of item.key and item.data
 		 */
-		if (htab->filled == htab->size) {
+		ep = calloc(1, sizeof(*ep));
+		if (ep) {
+			ep->key = strdup(item.key);
+			ep->data = strdup(item.data);
+		}
+		if (!ep || !ep->key || !ep->data ||
+		    hadd_entry(htab, ep) < 0) {
+			if (ep) {
+				free((void *)ep->key);
+				free(ep->data);
+			}
+			free(ep);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/*
-		 * Create new entry;
-		 * create copies of item.key and item.data
+		 * Grow the table if it is getting full. If that fails, carry on
+		 * as long as there is still a free slot.
 		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
+		if (htab->slots_used >= HTAB_MAX_LOAD(htab->size))
+			hresize(htab);
+		hprobe(htab, htab->table, htab->size, item.key, hval, &ins);
+		if (!ins) {
+			htab->entries[--htab->count] = NULL;
+			free((void *)ep->key);
+			free(ep->data);
+			free(ep);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
 
+		if (htab->table[ins].used == USED_FREE)
+			++htab->slots_used;
+		htab->table[ins].used = htab->count;
+		htab->table[ins].hval = hval;
 		++htab->filled;
 
 		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
+		env_callback_init(ep);
 		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
+		env_flags_init(ep);
 
 		/* check for permission */
 		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		    ep, item.data, env_op_create, flag)) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, hval);
 			__set_errno(EPERM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
-		    htab->table[idx].entry.callback(item.key, item.data,
+		if (ep->callback && ep->callback(item.key, item.data,
 		    env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, hval);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* return new entry */
-		*retval = &htab->table[idx].entry;
+		*retval = ep;
 		return 1;
 	}
 
@@ -435,33 +650,47 @@ int hsearch_r(struct env_entry item, enum env_action action,
  */
 
 static void _hdelete(const char *key, struct hsearch_data *htab,
-		     struct env_entry *ep, int idx)
+		     unsigned int hval)
 {
+	struct env_entry_node *node;
+	struct env_entry *ep;
+
+	/*
+	 * Look the key up again, since a callback may have changed the table
+	 * since it was found
+	 */
+	node = hlookup(htab, key, hval);
+	if (!node)
+		return;
+	ep = htab->entries[node->used - 1];
+
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
+	htab->entries[node->used - 1] = NULL;
+	node->used = USED_DELETED;
 	free((void *)ep->key);
 	free(ep->data);
-	ep->callback = NULL;
-	ep->flags = 0;
-	htab->table[idx].used = USED_DELETED;
+	free(ep);
 
 	--htab->filled;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
-	struct env_entry e, *ep;
-	int idx;
+	struct env_entry_node *node;
+	struct env_entry *ep;
+	unsigned int hval = hhash(key);
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
 
-	e.key = (char *)key;
+	hrehash(htab, HTAB_REHASH_STEP);
 
-	idx = hsearch_r(e, ENV_FIND, &ep, htab, 0);
-	if (idx == 0) {
+	node = hlookup(htab, key, hval);
+	if (!node) {
 		__set_errno(ESRCH);
 		return 0;	/* not found */
 	}
+	ep = htab->entries[node->used - 1];
 
 	/* Check for permission */
 	if (htab->change_ok != NULL &&
@@ -473,15 +702,14 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (htab->table[idx].entry.callback &&
-	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
+	if (ep->callback && ep->callback(key, NULL, env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
 		return 0;
 	}
 
-	_hdelete(key, htab, ep, idx);
+	_hdelete(key, htab, hval);
 
 	return 1;
 }
@@ -529,14 +757,69 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
+struct hsort_item {
+	const char *key;
+	unsigned int idx;
+};
+
 static int cmpkey(const void *p1, const void *p2)
 {
-	struct env_entry *e1 = *(struct env_entry **)p1;
-	struct env_entry *e2 = *(struct env_entry **)p2;
+	const struct hsort_item *e1 = p1;
+	const struct hsort_item *e2 = p2;
 
 	return (strcmp(e1->key, e2->key));
 }
 
+/*
+ * Bring the sorted index up to date. Only the entries added since it was
+ * last updated need sorting; they are then merged with the rest, so that
+ * exporting a large environment again after a few changes is cheap.
+ */
+static int hsort(struct hsearch_data *htab)
+{
+	struct hsort_item *tail;
+	unsigned int i, j, n, k;
+
+	if (htab->sorted_upto == htab->count)
+		return 0;
+
+	tail = malloc((htab->count - htab->sorted_upto) * sizeof(*tail));
+	if (!tail)
+		return -ENOMEM;
+	for (i = htab->sorted_upto, k = 0; i < htab->count; i++) {
+		if (htab->entries[i]) {
+			tail[k].key = htab->entries[i]->key;
+			tail[k++].idx = i;
+		}
+	}
+	qsort(tail, k, sizeof(*tail), cmpkey);
+
+	/* Drop deleted entries from the sorted part */
+	for (i = 0, n = 0; i < htab->sorted_len; i++) {
+		if (htab->entries[htab->sorted[i]])
+			htab->sorted[n++] = htab->sorted[i];
+	}
+
+	/* Merge from the end, so nothing is overwritten before it is used */
+	i = n;
+	j = k;
+	while (j > 0) {
+		if (i > 0 && strcmp(htab->entries[htab->sorted[i - 1]]->key,
+				    tail[j - 1].key) > 0) {
+			htab->sorted[i + j - 1] = htab->sorted[i - 1];
+			i--;
+		} else {
+			htab->sorted[i + j - 1] = tail[j - 1].idx;
+			j--;
+		}
+	}
+	htab->sorted_len = n + k;
+	htab->sorted_upto = htab->count;
+	free(tail);
+
+	return 0;
+}
+
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -595,14 +878,30 @@ static int match_entry(struct env_entry *ep, int flag, int argc,
 	return 0;
 }
 
+/* Check whether an entry should be exported */
+static int export_entry(struct env_entry *ep, int flag, int argc,
+			char *const argv[])
+{
+	if (!ep)
+		return 0;
+
+	if ((argc > 0) && (match_entry(ep, flag, argc, argv) == 0))
+		return 0;
+
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return 0;
+
+	return 1;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	struct env_entry *list[htab->size];
+	struct env_entry *ep;
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	int i;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -612,56 +911,39 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, size = %lu\n",
 	      htab, htab->size, htab->filled, (ulong)size);
+	/* Make sure the index of entries sorted by key is complete */
+	if (hsort(htab)) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * search used entries and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
-
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
-
-			list[n++] = ep;
+	for (i = 0, totlen = 0; i < htab->sorted_len; ++i) {
+		ep = htab->entries[htab->sorted[i]];
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(struct env_entry *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -689,17 +971,21 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	}
 	/*
 	 * Pass 2:
-	 * export sorted list of result data
+	 * export result data in key order
 	 */
-	for (i = 0, p = res; i < n; ++i) {
+	for (i = 0, p = res; i < htab->sorted_len; ++i) {
 		const char *s;
 
-		s = list[i]->key;
+		ep = htab->entries[htab->sorted[i]];
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
+
+		s = ep->key;
 		while (*s)
 			*p++ = *s++;
 		*p++ = '=';
 
-		s = list[i]->data;
+		s = ep->data;
 
 		while (*s) {
 			if ((*s == sep) || (*s == '\\'))
@@ -836,7 +1122,8 @@ int himport_r(struct hsearch_data *htab,
 	 * environment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. The table
+	 * grows as needed, so this is only a starting point.
 	 */
 
 	if (!htab->table) {
@@ -984,9 +1271,9 @@ int hwalk_r(struct hsearch_data *htab, int (*callback)(struct env_entry *entry))
 	int i;
 	int retval;
 
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			retval = callback(&htab->table[i].entry);
+	for (i = 0; i < htab->count; ++i) {
+		if (htab->entries[i]) {
+			retval = callback(htab->entries[i]);
 			if (retval)
 				return retval;
 		}
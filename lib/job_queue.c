@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Simple job queue for running independent pieces of work on several CPUs
+ *
+ * Jobs are shared out before any CPU starts, by giving each job in turn
+ * (largest first) to the CPU with the least work so far. Each CPU then runs
+ * its own jobs, so no locking is needed between the CPUs.
+ */
+
+#include <common.h>
+#include <job_queue.h>
+#include <watchdog.h>
+#include <linux/compiler.h>
+
+/**
+ * struct job_worker - a CPU running jobs
+ *
+ * @cpu:	CPU number
+ * @jobs:	All jobs, of which those with a matching CPU number are run
+ * @count:	Number of jobs
+ * @done:	Set when the CPU has finished its jobs
+ */
+struct job_worker {
+	int cpu;
+	struct job *jobs;
+	int count;
+	int done;
+};
+
+__weak int arch_job_cpus(void)
+{
+	return 1;
+}
+
+__weak int arch_job_start(int cpu, void (*func)(void *arg), void *arg)
+{
+	return -ENOSYS;
+}
+
+__weak int arch_job_wait(int cpu)
+{
+	return -ENOSYS;
+}
+
+int job_queue_cpus(void)
+{
+	int cpus = arch_job_cpus();
+
+	return max(1, min(cpus, CONFIG_JOB_QUEUE_MAX_CPUS));
+}
+
+static void job_worker_run(void *arg)
+{
+	struct job_worker *worker = arg;
+	struct job *job;
+	ulong start;
+	int i;
+
+	for (i = 0, job = worker->jobs; i < worker->count; i++, job++) {
+		if (job->cpu != worker->cpu)
+			continue;
+		start = timer_get_us();
+		job->ret = job->func(job);
+		job->time_us = timer_get_us() - start;
+		if (!worker->cpu)
+			WATCHDOG_RESET();
+	}
+	WRITE_ONCE(worker->done, 1);
+}
+
+/*
+ * Give each job which must run on the calling CPU to that CPU, then each
+ * other job, largest first, to the least-loaded CPU
+ */
+static void job_queue_assign(struct job *jobs, int count, int cpus)
+{
+	ulong load[CONFIG_JOB_QUEUE_MAX_CPUS] = { 0 };
+	struct job *job, *largest;
+	int i, j, cpu;
+	int left = count;
+
+	for (i = 0, job = jobs; i < count; i++, job++) {
+		job->cpu = -1;
+		if (job->flags & JOBF_BOOT_CPU) {
+			job->cpu = 0;
+			load[0] += job->cost;
+			left--;
+		}
+	}
+
+	for (i = 0; i < left; i++) {
+		largest = NULL;
+		for (j = 0, job = jobs; j < count; j++, job++) {
+			if (job->cpu == -1 &&
+			    (!largest || job->cost > largest->cost))
+				largest = job;
+		}
+		for (cpu = 0, j = 1; j < cpus; j++) {
+			if (load[j] < load[cpu])
+				cpu = j;
+		}
+		largest->cpu = cpu;
+		load[cpu] += largest->cost;
+	}
+}
+
+int job_queue_run(struct job *jobs, int count)
+{
+	struct job_worker workers[CONFIG_JOB_QUEUE_MAX_CPUS];
+	bool started[CONFIG_JOB_QUEUE_MAX_CPUS];
+	int cpus, cpu, i, ret;
+
+	cpus = min(job_queue_cpus(), count);
+	if (cpus < 1)
+		return 0;
+
+	job_queue_assign(jobs, count, cpus);
+
+	/* Make sure the timer is set up before secondary CPUs use it */
+	timer_get_us();
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		workers[cpu].cpu = cpu;
+		workers[cpu].jobs = jobs;
+		workers[cpu].count = count;
+		workers[cpu].done = 0;
+		started[cpu] = false;
+	}
+
+	for (cpu = 1; cpu < cpus; cpu++) {
+		ret = arch_job_start(cpu, job_worker_run, &workers[cpu]);
+		if (!ret) {
+			started[cpu] = true;
+			continue;
+		}
+		debug("%s: Cannot start CPU %d (err=%d)\n", __func__, cpu, ret);
+		for (i = 0; i < count; i++) {
+			if (jobs[i].cpu == cpu)
+				jobs[i].cpu = 0;
+		}
+	}
+
+	job_worker_run(&workers[0]);
+
+	/* Jobs cannot reset the watchdog, so do it for them while waiting */
+	ret = 0;
+	for (cpu = 1; cpu < cpus; cpu++) {
+		if (!started[cpu])
+			continue;
+		while (!READ_ONCE(workers[cpu].done))
+			WATCHDOG_RESET();
+		if (arch_job_wait(cpu))
+			ret = -EIO;
+	}
+	if (ret)
+		return ret;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].ret)
+			return jobs[i].ret;
+	}
+
+	return 0;
+}
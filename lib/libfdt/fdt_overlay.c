@@ -1,2 +1,23 @@
 #include <linux/libfdt_env.h>
 #include "../../scripts/dtc/libfdt/fdt_overlay.c"
+
+/*
+ * U-Boot additions, so that fdt_overlay_stack_apply() can use the steps
+ * above which only touch the overlay
+ */
+
+int fdt_overlay_adjust_phandles(void *fdto, uint32_t delta)
+{
+	int ret;
+
+	ret = overlay_adjust_local_phandles(fdto, delta);
+	if (ret)
+		return ret;
+
+	return overlay_update_local_references(fdto, delta);
+}
+
+int fdt_overlay_merge_node(void *fdt, int target, void *fdto, int node)
+{
+	return overlay_apply_node(fdt, target, fdto, node);
+}
@@ -4,9 +4,13 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <compiler.h>
 #include <image.h>
+#include <job_queue.h>
 #include <lz4.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -25,42 +29,201 @@ typedef uint64_t U64;
 /* Unaltered (except removing unrelated code) from github.com/Cyan4973/lz4. */
 #include "lz4.c"	/* #include for inlining, do not link! */
 
-struct lz4_frame_header {
-	u32 magic;
-	union {
-		u8 flags;
-		struct {
-			u8 reserved0:2;
-			u8 has_content_checksum:1;
-			u8 has_content_size:1;
-			u8 has_block_checksum:1;
-			u8 independent_blocks:1;
-			u8 version:2;
-		};
-	};
-	union {
-		u8 block_descriptor;
-		struct {
-			u8 reserved1:4;
-			u8 max_block_size:3;
-			u8 reserved2:1;
-		};
-	};
-	/* + u64 content_size iff has_content_size is set */
-	/* + u8 header_checksum */
-} __packed;
-
-struct lz4_block_header {
-	union {
-		u32 raw;
-		struct {
-			u32 size:31;
-			u32 not_compressed:1;
-		};
-	};
-	/* + size bytes of data */
-	/* + u32 block_checksum iff has_block_checksum is set */
-} __packed;
+int ulz4_decompress_block(const void *src, size_t srcn, void *dst,
+			  size_t dstn, const void *start)
+{
+	int ret;
+
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic(src, dst, srcn, dstn, endOnInputSize,
+				     full, 0, noDict, start, NULL, 0);
+
+	return ret < 0 ? -EPROTO : ret;
+}
+
+#if CONFIG_IS_ENABLED(LZ4_PARALLEL)
+/**
+ * struct ulz4_job - a block of an LZ4 frame, decompressed by a job
+ *
+ * @src:		Data of the block, without its header
+ * @srcn:		Length of @src
+ * @dst:		Destination for the uncompressed data
+ * @dstn:		Length of the uncompressed data, found by
+ *			ulz4_size_job_run()
+ * @not_compressed:	true if the block is stored uncompressed
+ * @len:		Set to the length of the uncompressed data
+ */
+struct ulz4_job {
+	const void *src;
+	size_t srcn;
+	void *dst;
+	size_t dstn;
+	bool not_compressed;
+	size_t len;
+};
+
+/* Read the extra bytes of a literal or match length */
+static int ulz4_read_length(const u8 **srcp, const u8 *end, size_t *lenp)
+{
+	u8 c;
+
+	do {
+		if (*srcp >= end)
+			return -EPROTO;
+		c = *(*srcp)++;
+		*lenp += c;
+	} while (c == 255);
+
+	return 0;
+}
+
+/*
+ * Work out the length of the data in a block without decompressing it, by
+ * adding up the lengths of its literals and matches
+ */
+static int ulz4_size_job_run(struct job *job)
+{
+	struct ulz4_job *blk = job->priv;
+	const u8 *src = blk->src, *end = src + blk->srcn;
+	size_t len = 0, n;
+	u8 token;
+
+	if (blk->not_compressed) {
+		blk->dstn = blk->srcn;
+		return 0;
+	}
+	while (src < end) {
+		token = *src++;
+		n = token >> ML_BITS;
+		if (n == RUN_MASK && ulz4_read_length(&src, end, &n))
+			return -EPROTO;
+		if (n > end - src)
+			return -EPROTO;
+		src += n;
+		len += n;
+		if (src == end)
+			break;	/* the last literals have no match */
+		if (end - src < 2)
+			return -EPROTO;
+		src += 2;	/* match offset */
+		n = token & ML_MASK;
+		if (n == ML_MASK && ulz4_read_length(&src, end, &n))
+			return -EPROTO;
+		len += n + MINMATCH;
+	}
+	blk->dstn = len;
+
+	return 0;
+}
+
+static int ulz4_job_run(struct job *job)
+{
+	struct ulz4_job *blk = job->priv;
+	int ret;
+
+	if (blk->not_compressed) {
+		memcpy(blk->dst, blk->src, blk->srcn);
+		blk->len = blk->srcn;
+		return 0;
+	}
+	ret = ulz4_decompress_block(blk->src, blk->srcn, blk->dst, blk->dstn,
+				    blk->dst);
+	if (ret < 0)
+		return ret;
+	blk->len = ret;
+
+	return 0;
+}
+
+/*
+ * Decompress the blocks of a frame on several CPUs at once. The length of the
+ * data in each block is found first, so that the place for its output is
+ * known exactly and nothing is written beyond the end of the data. If
+ * anything fails, this returns an error and the caller decompresses the frame
+ * one block at a time instead, which also reports the right error.
+ *
+ * @src, @srcn: frame; @in: first block header; @dst, @dstn: output
+ */
+static int ulz4fn_parallel(const void *src, size_t srcn, const void *in,
+			   void *dst, size_t *dstn, int has_block_checksum)
+{
+	size_t trailer = has_block_checksum ? sizeof(u32) : 0;
+	struct lz4_block_header b;
+	struct ulz4_job *blks;
+	const void *pos;
+	struct job *jobs;
+	ulong cpu_us = 0;
+	size_t len = 0;
+	int count, i;
+	int ret;
+
+	/* In-place decompression needs the blocks done in order */
+	if (src < dst + *dstn && dst < src + srcn)
+		return -EINVAL;
+	if (job_queue_cpus() < 2)
+		return -EAGAIN;
+
+	for (count = 0, pos = in;; count++) {
+		if (pos - src + sizeof(b) > srcn)
+			return -EINVAL;	/* input overrun */
+		b.raw = get_unaligned_le32(pos);
+		if (!b.size)
+			break;
+		pos += sizeof(b) + b.size + trailer;
+		if (pos - src > srcn)
+			return -EINVAL;	/* input overrun */
+	}
+	if (count < 2)
+		return -EINVAL;
+
+	blks = calloc(count, sizeof(*blks));
+	jobs = calloc(count, sizeof(*jobs));
+	if (!blks || !jobs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0, pos = in; i < count; i++) {
+		b.raw = get_unaligned_le32(pos);
+		pos += sizeof(b);
+		blks[i].src = pos;
+		blks[i].srcn = b.size;
+		blks[i].not_compressed = b.not_compressed;
+		jobs[i].func = ulz4_size_job_run;
+		jobs[i].priv = &blks[i];
+		jobs[i].cost = b.size;
+		pos += b.size + trailer;
+	}
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_LZ4, "lz4");
+	ret = job_queue_run(jobs, count);
+	for (i = 0; !ret && i < count; i++) {
+		cpu_us += jobs[i].time_us;
+		if (blks[i].dstn > *dstn - len) {
+			ret = -ENOBUFS;	/* output overrun */
+			break;
+		}
+		blks[i].dst = dst + len;
+		len += blks[i].dstn;
+		jobs[i].func = ulz4_job_run;
+	}
+	if (!ret)
+		ret = job_queue_run(jobs, count);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_LZ4);
+	for (i = 0; !ret && i < count; i++) {
+		cpu_us += jobs[i].time_us;
+		if (blks[i].len != blks[i].dstn)
+			ret = -EPROTO;
+	}
+	bootstage_accum_add(BOOTSTAGE_ID_ACCUM_LZ4_CPU, "lz4_cpu", cpu_us);
+	if (!ret)
+		*dstn = len;
+out:
+	free(jobs);
+	free(blks);
+
+	return ret;
+}
+#endif
 
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 {
@@ -92,6 +255,13 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		in += sizeof(u8);
 	}
 
+#if CONFIG_IS_ENABLED(LZ4_PARALLEL)
+	*dstn = end - dst;
+	if (!ulz4fn_parallel(src, srcn, in, dst, dstn, has_block_checksum))
+		return 0;
+	*dstn = 0;
+#endif
+
 	while (1) {
 		struct lz4_block_header b;
 
@@ -117,14 +287,10 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 				break;
 			}
 		} else {
-			/* constant folding essential, do not touch params! */
-			ret = LZ4_decompress_generic(in, out, b.size,
-					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
-			if (ret < 0) {
-				ret = -EPROTO;	/* decompression error */
-				break;
-			}
+			ret = ulz4_decompress_block(in, b.size, out, end - out,
+						    out);
+			if (ret < 0)
+				break;		/* decompression error */
 			out += ret;
 		}
 
@@ -324,6 +324,11 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp)
 		debug("Failed to create live tree: err=%d\n", ret);
 		return ret;
 	}
+	ret = of_phandle_cache_build(*rootp);
+	if (ret) {
+		debug("Failed to build phandle table: err=%d\n", ret);
+		return ret;
+	}
 	ret = of_alias_scan();
 	if (ret) {
 		debug("Failed to scan live tree aliases: err=%d\n", ret);
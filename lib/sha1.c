@@ -19,6 +19,7 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <linux/string.h>
+#include <u-boot/sha_backend.h>
 #else
 #include <string.h>
 #endif /* USE_HOSTCC */
@@ -65,7 +66,7 @@ void sha1_starts (sha1_context * ctx)
 	ctx->state[4] = 0xC3D2E1F0;
 }
 
-static void sha1_process(sha1_context *ctx, const unsigned char data[64])
+static void sha1_block(uint32_t *state, const unsigned char data[64])
 {
 	unsigned long temp, W[16], A, B, C, D, E;
 
@@ -98,11 +99,11 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);	\
 }
 
-	A = ctx->state[0];
-	B = ctx->state[1];
-	C = ctx->state[2];
-	D = ctx->state[3];
-	E = ctx->state[4];
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
 
 #define F(x,y,z) (z ^ (x & (y ^ z)))
 #define K 0x5A827999
@@ -212,11 +213,66 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 #undef K
 #undef F
 
-	ctx->state[0] += A;
-	ctx->state[1] += B;
-	ctx->state[2] += C;
-	ctx->state[3] += D;
-	ctx->state[4] += E;
+	state[0] += A;
+	state[1] += B;
+	state[2] += C;
+	state[3] += D;
+	state[4] += E;
+}
+
+static void sha1_blocks_generic(uint32_t *state, const unsigned char *data,
+				unsigned int count)
+{
+	for (; count; count--, data += 64)
+		sha1_block(state, data);
+}
+
+#ifndef USE_HOSTCC
+U_BOOT_SHA1_BACKEND(generic) = {
+	.name		= "generic",
+	.blocks		= sha1_blocks_generic,
+};
+
+/* Backend selected with sha1_select_backend(), -1 to pick automatically */
+static int sha1_selected = -1;
+
+static void sha1_blocks(uint32_t *state, const unsigned char *data,
+			unsigned int count)
+{
+	const struct sha_backend *backend;
+
+	backend = sha_backend_get(ll_entry_start(struct sha_backend,
+						 sha1_backend),
+				  ll_entry_count(struct sha_backend,
+						 sha1_backend),
+				  sha1_selected);
+	backend->blocks(state, data, count);
+}
+
+int sha1_select_backend(int index, const char **namep)
+{
+	return sha_backend_select(ll_entry_start(struct sha_backend,
+						 sha1_backend),
+				  ll_entry_count(struct sha_backend,
+						 sha1_backend),
+				  index, &sha1_selected, namep);
+}
+#else
+#define sha1_blocks	sha1_blocks_generic
+#endif /* USE_HOSTCC */
+
+static void sha1_process(sha1_context *ctx, const unsigned char *data,
+			 unsigned int count)
+{
+	uint32_t state[5];
+	int i;
+
+	/* The context holds the state in longs, which may be 64 bits */
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	sha1_blocks(state, data, count);
+	for (i = 0; i < 5; i++)
+		ctx->state[i] = state[i];
 }
 
 /*
@@ -242,16 +298,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		sha1_process(ctx, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		sha1_process(ctx, input, ilen / 64);
+		input += ilen & ~0x3f;
+		ilen &= 0x3f;
 	}
 
 	if (ilen > 0) {
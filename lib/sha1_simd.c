@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 with the message schedule worked out in SIMD registers
+ *
+ * The rounds run in general registers as in the portable C code, but the
+ * message schedule is calculated four words at a time in a SIMD register,
+ * alongside the rounds. This uses GCC's vector extensions, which become SSE2
+ * on 64-bit x86 and NEON (Advanced SIMD) on ARMv8. It is used when the CPU
+ * does not have SHA instructions.
+ *
+ * There is no SHA-256 version: its rounds take most of the time and neither
+ * SSE2 nor NEON has a vector rotate, so working out its schedule this way
+ * gained nothing with SSE2.
+ *
+ * This is also used by sandbox, on any host, so it does not use the CPU
+ * headers.
+ */
+
+#include <common.h>
+#include <asm/unaligned.h>
+#include <u-boot/sha_backend.h>
+
+#ifdef __x86_64__
+/* CR4 bit which allows SSE instructions */
+#define CR4_OSFXSR		BIT(9)
+
+/* U-Boot is built without SSE, so turn it on for the functions here */
+#define __sha_simd		__attribute__((target("sse2")))
+#else
+#define __sha_simd
+#endif
+
+/* Field of ID_AA64PFR0_EL1 which is 0xf if there is no Advanced SIMD */
+#define ID_AA64PFR0_ADVSIMD_SHIFT	20
+#define ID_AA64PFR0_ADVSIMD_NONE	0xf
+
+/* Four words of the message schedule, held in a SIMD register */
+typedef u32 sha_v4 __attribute__((vector_size(16)));
+
+/* Pick four words from the eight in @a and @b, numbered 0-7 */
+#ifdef __clang__
+#define SHA_SHUFFLE(a, b, i, j, k, l)	\
+	__builtin_shufflevector(a, b, i, j, k, l)
+#else
+#define SHA_SHUFFLE(a, b, i, j, k, l)	\
+	__builtin_shuffle(a, b, (sha_v4) { i, j, k, l })
+#endif
+
+/* This works on both single words and sha_v4 */
+#define ROL(x, n)	((x) << (n) | (x) >> (32 - (n)))
+
+#define CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define PARITY(x, y, z)	((x) ^ (y) ^ (z))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+static bool sha1_simd_probe(void)
+{
+#if defined(CONFIG_X86)
+	ulong cr4;
+
+	/* U-Boot does not enable SSE itself, but firmware may have */
+	asm volatile("mov %%cr4, %0" : "=r" (cr4));
+	if (!(cr4 & CR4_OSFXSR))
+		return false;
+#elif defined(CONFIG_ARM64)
+	ulong pfr0;
+
+	/* start.S enables FP/SIMD, but a CPU need not have it */
+	asm volatile("mrs %0, id_aa64pfr0_el1" : "=r" (pfr0));
+	if (((pfr0 >> ID_AA64PFR0_ADVSIMD_SHIFT) & 0xf) ==
+	    ID_AA64PFR0_ADVSIMD_NONE)
+		return false;
+#endif
+
+	return true;
+}
+
+/* Read four big-endian words of a block */
+#define SHA_LOAD(p)	((sha_v4) {					\
+	get_unaligned_be32((p)), get_unaligned_be32((p) + 4),		\
+	get_unaligned_be32((p) + 8), get_unaligned_be32((p) + 12) })
+
+/*
+ * Work out W[t..t+3] from the four words before it, etc. W[t + 3] needs W[t],
+ * so it is first calculated without it, then put right.
+ */
+#define SHA1_SCHEDULE(w, w16, w12, w8, w4) {				\
+	sha_v4 tmp = SHA_SHUFFLE(w4, zero, 1, 2, 3, 4) ^ (w8) ^	\
+		SHA_SHUFFLE(w16, w12, 2, 3, 4, 5) ^ (w16);		\
+									\
+	w = ROL(tmp, 1) ^ ROL(SHA_SHUFFLE(tmp, zero, 4, 4, 4, 0), 2);	\
+}
+
+#define SHA1_ROUND(a, b, c, d, e, f, wk) {				\
+	e += ROL(a, 5) + f(b, c, d) + (wk);				\
+	b = ROL(b, 30);							\
+}
+
+/* Five rounds, which leave the variables where they started */
+#define SHA1_ROUND5(f, wk) {						\
+	SHA1_ROUND(a, b, c, d, e, f, (wk)[0]);				\
+	SHA1_ROUND(e, a, b, c, d, f, (wk)[1]);				\
+	SHA1_ROUND(d, e, a, b, c, f, (wk)[2]);				\
+	SHA1_ROUND(c, d, e, a, b, f, (wk)[3]);				\
+	SHA1_ROUND(b, c, d, e, a, f, (wk)[4]);				\
+}
+
+/*
+ * Five rounds of each block at a time, working out the schedule for later
+ * rounds alongside so the CPU can do both at once
+ */
+#define SHA1_STAGE(f, end)						\
+	for (; i < (end); i++) {					\
+		if (i < 16) {						\
+			SHA1_SCHEDULE(w[i + 4], w[i], w[i + 1],	\
+				      w[i + 2], w[i + 3]);		\
+			wk.v[i + 4] = w[i + 4] + k[(i + 4) / 5];	\
+		}							\
+		SHA1_ROUND5(f, &wk.w[i * 5]);				\
+	}
+
+static void __sha_simd sha1_simd(u32 *state, const u8 *data, uint count)
+{
+	static const u32 k[4] = {
+		0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6,
+	};
+	const sha_v4 zero = { 0 };
+	union {
+		sha_v4 v[20];
+		u32 w[80];
+	} wk;
+	sha_v4 w[20];
+	u32 a, b, c, d, e;
+	int i;
+
+	for (; count; count--, data += 64) {
+		for (i = 0; i < 4; i++) {
+			w[i] = SHA_LOAD(data + i * 16);
+			wk.v[i] = w[i] + k[0];
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		i = 0;
+		SHA1_STAGE(CH, 4);
+		SHA1_STAGE(PARITY, 8);
+		SHA1_STAGE(MAJ, 12);
+		SHA1_STAGE(PARITY, 16);
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
+
+U_BOOT_SHA1_BACKEND(simd) = {
+#ifdef __x86_64__
+	.name		= "x86-sse2",
+#elif defined(__aarch64__)
+	.name		= "armv8-neon",
+#else
+	.name		= "simd",
+#endif
+	.priority	= 10,
+	.probe		= sha1_simd_probe,
+	.blocks		= sha1_simd,
+};
@@ -8,6 +8,7 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <linux/string.h>
+#include <u-boot/sha_backend.h>
 #else
 #include <string.h>
 #endif /* USE_HOSTCC */
@@ -55,7 +56,7 @@ void sha256_starts(sha256_context * ctx)
 	ctx->state[7] = 0x5BE0CD19;
 }
 
-static void sha256_process(sha256_context *ctx, const uint8_t data[64])
+static void sha256_block(uint32_t *state, const uint8_t data[64])
 {
 	uint32_t temp1, temp2;
 	uint32_t W[64];
@@ -102,14 +103,14 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	d += temp1; h = temp1 + temp2;		\
 }
 
-	A = ctx->state[0];
-	B = ctx->state[1];
-	C = ctx->state[2];
-	D = ctx->state[3];
-	E = ctx->state[4];
-	F = ctx->state[5];
-	G = ctx->state[6];
-	H = ctx->state[7];
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+	F = state[5];
+	G = state[6];
+	H = state[7];
 
 	P(A, B, C, D, E, F, G, H, W[0], 0x428A2F98);
 	P(H, A, B, C, D, E, F, G, W[1], 0x71374491);
@@ -176,16 +177,61 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	P(C, D, E, F, G, H, A, B, R(62), 0xBEF9A3F7);
 	P(B, C, D, E, F, G, H, A, R(63), 0xC67178F2);
 
-	ctx->state[0] += A;
-	ctx->state[1] += B;
-	ctx->state[2] += C;
-	ctx->state[3] += D;
-	ctx->state[4] += E;
-	ctx->state[5] += F;
-	ctx->state[6] += G;
-	ctx->state[7] += H;
+	state[0] += A;
+	state[1] += B;
+	state[2] += C;
+	state[3] += D;
+	state[4] += E;
+	state[5] += F;
+	state[6] += G;
+	state[7] += H;
 }
 
+static void sha256_blocks_generic(uint32_t *state, const uint8_t *data,
+				  unsigned int count)
+{
+	for (; count; count--, data += 64)
+		sha256_block(state, data);
+}
+
+#ifndef USE_HOSTCC
+U_BOOT_SHA256_BACKEND(generic) = {
+	.name		= "generic",
+	.blocks		= sha256_blocks_generic,
+};
+
+/* Backend selected with sha256_select_backend(), -1 to pick automatically */
+static int sha256_selected = -1;
+
+static void sha256_process(sha256_context *ctx, const uint8_t *data,
+			   unsigned int count)
+{
+	const struct sha_backend *backend;
+
+	backend = sha_backend_get(ll_entry_start(struct sha_backend,
+						 sha256_backend),
+				  ll_entry_count(struct sha_backend,
+						 sha256_backend),
+				  sha256_selected);
+	backend->blocks(ctx->state, data, count);
+}
+
+int sha256_select_backend(int index, const char **namep)
+{
+	return sha_backend_select(ll_entry_start(struct sha_backend,
+						 sha256_backend),
+				  ll_entry_count(struct sha_backend,
+						 sha256_backend),
+				  index, &sha256_selected, namep);
+}
+#else
+static void sha256_process(sha256_context *ctx, const uint8_t *data,
+			   unsigned int count)
+{
+	sha256_blocks_generic(ctx->state, data, count);
+}
+#endif /* USE_HOSTCC */
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -204,16 +250,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		sha256_process(ctx, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		sha256_process(ctx, input, length / 64);
+		input += length & ~0x3f;
+		length &= 0x3f;
 	}
 
 	if (length)
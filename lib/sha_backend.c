@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Choosing between implementations of the SHA-1 and SHA-256 block functions
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <u-boot/sha_backend.h>
+
+static bool sha_backend_usable(const struct sha_backend *backend)
+{
+	return !backend->probe || backend->probe();
+}
+
+const struct sha_backend *sha_backend_get(const struct sha_backend *start,
+					  int count, int selected)
+{
+	const struct sha_backend *backend, *best = NULL;
+
+	if (selected >= 0 && selected < count)
+		return start + selected;
+	for (backend = start; backend < start + count; backend++) {
+		if (best && backend->priority <= best->priority)
+			continue;
+		if (sha_backend_usable(backend))
+			best = backend;
+	}
+
+	return best;
+}
+
+int sha_backend_select(const struct sha_backend *start, int count, int index,
+		       int *selectedp, const char **namep)
+{
+	const struct sha_backend *backend;
+
+	if (index >= count)
+		return -ENOENT;
+	if (index >= 0) {
+		backend = start + index;
+		if (namep)
+			*namep = backend->name;
+		if (!sha_backend_usable(backend))
+			return -ENODEV;
+	}
+	*selectedp = index;
+	if (index < 0 && namep)
+		*namep = sha_backend_get(start, count, -1)->name;
+
+	return 0;
+}
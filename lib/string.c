@@ -20,6 +20,7 @@
 #include <linux/string.h>
 #include <linux/ctype.h>
 #include <malloc.h>
+#include <asm/byteorder.h>
 
 
 /**
@@ -481,6 +482,139 @@ char *strswab(const char *s)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(FAST_MEMCPY)
+#define MEM_WORD	sizeof(unsigned long)
+#define MEM_MASK	(MEM_WORD - 1)
+
+/*
+ * Below this size the setup cost of the word loops is not worth it and a
+ * plain byte loop is used
+ */
+#define MEM_MIN		(2 * MEM_WORD)
+
+/**
+ * mem_merge() - Build an unaligned word from two aligned ones
+ *
+ * @lo:		Aligned word at the lower address
+ * @hi:		Aligned word following @lo
+ * @off:	Offset in bytes into @lo of the first byte wanted (1..MEM_MASK)
+ * @return the MEM_WORD bytes starting at offset @off into @lo
+ */
+static inline unsigned long mem_merge(unsigned long lo, unsigned long hi,
+				      uint off)
+{
+	uint shift = off * 8;
+
+#ifdef __LITTLE_ENDIAN
+	return (lo >> shift) | (hi << (MEM_WORD * 8 - shift));
+#else
+	return (lo << shift) | (hi >> (MEM_WORD * 8 - shift));
+#endif
+}
+
+/**
+ * mem_copy_fwd() - Copy words upwards to an aligned destination
+ *
+ * The source may have any alignment. When it is not word-aligned, each
+ * destination word is built from two aligned source words, so that no
+ * unaligned accesses are made. The aligned source words may cover up to
+ * MEM_MASK bytes before and after the source region, but never cross a
+ * word (and therefore page) boundary outside it.
+ *
+ * This is safe for overlapping regions as long as @dl is below @src.
+ *
+ * @dl:		Word-aligned destination
+ * @src:	Source
+ * @words:	Number of words to copy
+ */
+static inline void mem_copy_fwd(unsigned long *dl, const char *src,
+				size_t words)
+{
+	uint off = (ulong)src & MEM_MASK;
+	const unsigned long *sl;
+	unsigned long lo, hi;
+
+	if (!off) {
+		sl = (const unsigned long *)src;
+		for (; words >= 4; words -= 4) {
+			dl[0] = sl[0];
+			dl[1] = sl[1];
+			dl[2] = sl[2];
+			dl[3] = sl[3];
+			dl += 4;
+			sl += 4;
+		}
+		while (words--)
+			*dl++ = *sl++;
+		return;
+	}
+
+	sl = (const unsigned long *)(src - off);
+	lo = *sl++;
+	for (; words >= 2; words -= 2) {
+		hi = sl[0];
+		dl[0] = mem_merge(lo, hi, off);
+		lo = sl[1];
+		dl[1] = mem_merge(hi, lo, off);
+		dl += 2;
+		sl += 2;
+	}
+	if (words) {
+		hi = *sl;
+		*dl = mem_merge(lo, hi, off);
+	}
+}
+
+/**
+ * mem_copy_back() - Copy words downwards to an aligned destination
+ *
+ * This is the mirror image of mem_copy_fwd(), working from the end of the
+ * region. It is safe for overlapping regions as long as @dl_end is above
+ * @src_end.
+ *
+ * @dl_end:	Word-aligned end of destination (exclusive)
+ * @src_end:	End of source (exclusive)
+ * @words:	Number of words to copy
+ */
+static inline void mem_copy_back(unsigned long *dl_end,
+				 const char *src_end, size_t words)
+{
+	uint off = (ulong)src_end & MEM_MASK;
+	const unsigned long *sl;
+	unsigned long lo, hi;
+
+	if (!off) {
+		sl = (const unsigned long *)src_end;
+		for (; words >= 4; words -= 4) {
+			dl_end -= 4;
+			sl -= 4;
+			dl_end[3] = sl[3];
+			dl_end[2] = sl[2];
+			dl_end[1] = sl[1];
+			dl_end[0] = sl[0];
+		}
+		while (words--)
+			*--dl_end = *--sl;
+		return;
+	}
+
+	sl = (const unsigned long *)(src_end - off);
+	hi = *sl;
+	for (; words >= 2; words -= 2) {
+		sl -= 2;
+		lo = sl[1];
+		dl_end[-1] = mem_merge(lo, hi, off);
+		hi = sl[0];
+		dl_end[-2] = mem_merge(hi, lo, off);
+		dl_end -= 2;
+	}
+	if (words) {
+		lo = sl[-1];
+		dl_end[-1] = mem_merge(lo, hi, off);
+	}
+}
+#endif
+
 #ifndef __HAVE_ARCH_MEMSET
 /**
  * memset - Fill a region of memory with the given value
@@ -495,7 +629,34 @@ void * memset(void * s,int c,size_t count)
 	unsigned long *sl = (unsigned long *) s;
 	char *s8;
 
-#if !CONFIG_IS_ENABLED(TINY_MEMSET)
+#if CONFIG_IS_ENABLED(FAST_MEMCPY)
+	unsigned long cl;
+
+	s8 = s;
+	if (count >= MEM_MIN) {
+		/* fill up to the first word boundary one byte at a time */
+		while ((ulong)s8 & MEM_MASK) {
+			*s8++ = c;
+			count--;
+		}
+		cl = (unsigned char)c;
+		cl |= cl << 8;
+		cl |= cl << 16;
+		if (MEM_WORD > 4)
+			cl |= cl << (MEM_WORD * 4);
+
+		sl = (unsigned long *)s8;
+		for (; count >= 4 * MEM_WORD; count -= 4 * MEM_WORD) {
+			sl[0] = cl;
+			sl[1] = cl;
+			sl[2] = cl;
+			sl[3] = cl;
+			sl += 4;
+		}
+		for (; count >= MEM_WORD; count -= MEM_WORD)
+			*sl++ = cl;
+	}
+#elif !CONFIG_IS_ENABLED(TINY_MEMSET)
 	unsigned long cl = 0;
 	int i;
 
@@ -531,22 +692,41 @@ void * memset(void * s,int c,size_t count)
  */
 void * memcpy(void *dest, const void *src, size_t count)
 {
-	unsigned long *dl = (unsigned long *)dest, *sl = (unsigned long *)src;
-	char *d8, *s8;
+	char *d8 = (char *)dest, *s8 = (char *)src;
 
 	if (src == dest)
 		return dest;
 
+#if CONFIG_IS_ENABLED(FAST_MEMCPY)
+	if (count >= MEM_MIN) {
+		size_t words;
+
+		/* copy up to the first destination word boundary */
+		while ((ulong)d8 & MEM_MASK) {
+			*d8++ = *s8++;
+			count--;
+		}
+		words = count / MEM_WORD;
+		mem_copy_fwd((unsigned long *)d8, s8, words);
+		d8 += words * MEM_WORD;
+		s8 += words * MEM_WORD;
+		count &= MEM_MASK;
+	}
+#else
 	/* while all data is aligned (common case), copy a word at a time */
-	if ( (((ulong)dest | (ulong)src) & (sizeof(*dl) - 1)) == 0) {
+	if ( (((ulong)dest | (ulong)src) & (sizeof(long) - 1)) == 0) {
+		unsigned long *dl = (unsigned long *)dest;
+		unsigned long *sl = (unsigned long *)src;
+
 		while (count >= sizeof(*dl)) {
 			*dl++ = *sl++;
 			count -= sizeof(*dl);
 		}
+		d8 = (char *)dl;
+		s8 = (char *)sl;
 	}
+#endif
 	/* copy the reset one byte at a time */
-	d8 = (char *)dl;
-	s8 = (char *)sl;
 	while (count--)
 		*d8++ = *s8++;
 
@@ -572,6 +752,22 @@ void * memmove(void * dest,const void *src,size_t count)
 	} else {
 		tmp = (char *) dest + count;
 		s = (char *) src + count;
+#if CONFIG_IS_ENABLED(FAST_MEMCPY)
+		if (count >= MEM_MIN) {
+			size_t words;
+
+			/* copy down to the last destination word boundary */
+			while ((ulong)tmp & MEM_MASK) {
+				*--tmp = *--s;
+				count--;
+			}
+			words = count / MEM_WORD;
+			mem_copy_back((unsigned long *)tmp, s, words);
+			tmp -= words * MEM_WORD;
+			s -= words * MEM_WORD;
+			count &= MEM_MASK;
+		}
+#endif
 		while (count--)
 			*--tmp = *--s;
 		}
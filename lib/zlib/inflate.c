@@ -25,7 +25,8 @@ int ZEXPORT inflateReset(z_streamp strm)
     state->hold = 0;
     state->bits = 0;
     state->lencode = state->distcode = state->next = state->codes;
-    WATCHDOG_RESET();
+    if (state->watchdog)
+	WATCHDOG_RESET();
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
 }
@@ -67,9 +68,20 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits, const char *version,
     }
     state->wbits = (unsigned)windowBits;
     state->window = Z_NULL;
+    state->watchdog = 1;
     return inflateReset(strm);
 }
 
+int ZEXPORT inflateWatchdog(z_streamp strm, int on)
+{
+    struct inflate_state FAR *state;
+
+    if (strm == Z_NULL || strm->state == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    state->watchdog = on;
+    return Z_OK;
+}
+
 int ZEXPORT inflateInit_(z_streamp strm, const char *version, int stream_size)
 {
     return inflateInit2_(strm, DEF_WBITS, version, stream_size);
@@ -543,7 +555,8 @@ int ZEXPORT inflate(z_streamp strm, int flush)
             strm->adler = state->check = adler32(0L, Z_NULL, 0);
             state->mode = TYPE;
         case TYPE:
-	    WATCHDOG_RESET();
+	    if (state->watchdog)
+		WATCHDOG_RESET();
             if (flush == Z_BLOCK) goto inf_leave;
         case TYPEDO:
             if (state->last) {
@@ -721,7 +734,8 @@ int ZEXPORT inflate(z_streamp strm, int flush)
             Tracev((stderr, "inflate:       codes ok\n"));
             state->mode = LEN;
         case LEN:
-	    WATCHDOG_RESET();
+	    if (state->watchdog)
+		WATCHDOG_RESET();
             if (have >= 6 && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
@@ -176,6 +176,8 @@ ushort		net_native_vlan = 0xFFFF;
 char net_boot_file_name[1024];
 /* Indicates whether the file name was specified on the command line */
 bool net_boot_file_name_explicit;
+/* Compression to undo while loading the bootfile, set by 'tftpboot -d' */
+int net_boot_file_comp;
 /* The actual transferred size of the bootfile (in bytes) */
 u32 net_boot_file_size;
 /* Boot file size in blocks as reported by the DHCP server */
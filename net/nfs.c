@@ -46,12 +46,44 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+#ifdef CONFIG_NFS_READ_REQUESTS
+#define NFS_READ_REQUESTS CONFIG_NFS_READ_REQUESTS
+#else
+#define NFS_READ_REQUESTS 1
+#endif
+
+/* Number of bytes loaded for each "loading" hash */
+#define NFS_HASH_SIZE	(NFS_READ_SIZE / 2 * 10)
+
+/**
+ * struct nfs_read_slot - a READ request waiting for its reply
+ *
+ * @id: RPC transaction ID (XID) of the request, 0 if the slot is free
+ * @offset: Offset in the file to read from
+ * @len: Number of bytes requested
+ * @sent: Time the request was last sent, from get_timer()
+ * @retries: Number of times the request was sent again
+ */
+struct nfs_read_slot {
+	unsigned long id;
+	uint offset;
+	uint len;
+	ulong sent;
+	int retries;
+};
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+static struct nfs_read_slot nfs_read_slots[NFS_READ_REQUESTS];
+static uint nfs_len;		/* bytes to request in each READ */
+static uint nfs_next_offset;	/* file offset of the next new READ */
+static bool nfs_eof;		/* true when nfs_file_size is known */
+static uint nfs_file_size;	/* size of the file, when nfs_eof */
+static uint nfs_received;	/* bytes received, for the progress display */
+static uint nfs_hashes;		/* number of "loading" hashes printed */
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -171,15 +203,14 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static void rpc_req_id(unsigned long id, int rpc_prog, int rpc_proc,
+		       uint32_t *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	rpc_pkt.u.call.id = htonl(id);
 	rpc_pkt.u.call.type = htonl(MSG_CALL);
 	rpc_pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
@@ -218,6 +249,11 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_req_id(++rpc_id, rpc_prog, rpc_proc, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -357,7 +393,7 @@ static void nfs_lookup_req(char *fname)
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -369,22 +405,115 @@ static void nfs_read_req(int offset, int readlen)
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		memcpy(p, filefh, NFS_FHSIZE);
 		p += (NFS_FHSIZE / 4);
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
 		*p++ = 0;
 	} else { /* NFSV3_FLAG */
 		*p++ = htonl(filefh3_length);
 		memcpy(p, filefh, filefh3_length);
 		p += (filefh3_length / 4);
 		*p++ = htonl(0); /* offset is 64-bit long, so fill with 0 */
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
 		*p++ = 0;
 	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	/* A request sent again keeps its ID, so a late reply still counts */
+	if (!slot->id)
+		slot->id = ++rpc_id;
+	slot->sent = get_timer(0);
+	rpc_req_id(slot->id, PROG_NFS, NFS_READ, data, len);
+}
+
+/*
+ * Several READs may be outstanding at once, each for its own part of the file
+ * and with its own retransmit timer. Replies are matched to requests by their
+ * RPC ID, so they may arrive in any order.
+ */
+
+/* Get ready to read the file, from the start */
+static void nfs_read_start(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	if (supported_nfs_versions & NFSV2_FLAG)
+		nfs_len = min(NFS_READ_SIZE, NFS2_MAXDATA);
+	else /* NFSV3_FLAG */
+		nfs_len = NFS_READ_SIZE;
+	nfs_next_offset = 0;
+	nfs_eof = false;
+	nfs_file_size = 0;
+	nfs_received = 0;
+	nfs_hashes = 0;
+}
+
+/* Forget all outstanding READs, so that replies to them are dropped */
+static void nfs_read_stop(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+}
+
+/* Send READs for the next parts of the file, until all slots are in use */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + NFS_READ_REQUESTS && !nfs_eof; slot++) {
+		if (slot->id)
+			continue;
+		slot->offset = nfs_next_offset;
+		slot->len = nfs_len;
+		slot->retries = 0;
+		nfs_next_offset += nfs_len;
+		nfs_read_req(slot);
+	}
+}
+
+static struct nfs_read_slot *nfs_read_find(unsigned long id)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + NFS_READ_REQUESTS; slot++) {
+		if (id && slot->id == id)
+			return slot;
+	}
+
+	return NULL;
+}
+
+/* Record the size of the file, dropping any READs beyond the end */
+static void nfs_read_set_eof(uint size)
+{
+	struct nfs_read_slot *slot;
+
+	if (nfs_eof && nfs_file_size <= size)
+		return;
+	nfs_eof = true;
+	nfs_file_size = size;
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + NFS_READ_REQUESTS; slot++) {
+		if (slot->offset >= size)
+			slot->id = 0;
+	}
+}
+
+/* Check if the whole file has been read */
+static bool nfs_read_done(void)
+{
+	struct nfs_read_slot *slot;
+
+	if (!nfs_eof)
+		return false;
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + NFS_READ_REQUESTS; slot++) {
+		if (slot->id)
+			return false;
+	}
+
+	return true;
 }
 
 /**************************************************************************
@@ -417,7 +546,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_fill();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -662,17 +791,19 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
+	struct nfs_read_slot *slot;
 	struct rpc_t rpc_pkt;
 	int rlen;
+	int eof = 0;
 	uchar *data_ptr;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt, len);
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	/* Drop replies to READs we are no longer waiting for */
+	slot = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -686,12 +817,6 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
 		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
@@ -701,8 +826,8 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = ntohl(rpc_pkt.u.reply.data[2 + nfsv3_data_offset]);
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
 		data_ptr = (uchar *)
@@ -712,8 +837,35 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
 			return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (rlen > slot->len)
+		return -9999;
+
+	/* Nothing to store past the end of the file */
+	if (rlen && store_block(data_ptr, slot->offset, rlen))
+		return -9999;
+
+	nfs_received += rlen;
+	while (nfs_hashes < DIV_ROUND_UP(nfs_received, NFS_HASH_SIZE)) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+
+	if (!rlen || eof) {
+		/* NFSv2 has no EOF flag, so we read until we get nothing */
+		slot->id = 0;
+		nfs_read_set_eof(slot->offset + rlen);
+	} else if (rlen < slot->len) {
+		/* Short read, so ask for the rest */
+		slot->offset += rlen;
+		slot->len -= rlen;
+		slot->id = 0;
+		slot->retries = 0;
+		nfs_read_req(slot);
+	} else {
+		slot->id = 0;
+	}
 
 	return rlen;
 }
@@ -721,8 +873,48 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 /**************************************************************************
 Interfaces of U-BOOT
 **************************************************************************/
+static void nfs_timeout_handler(void);
+
+/*
+ * Send again the READs which have timed out, each with its own back-off, and
+ * set the timeout handler for the next one due
+ */
+static void nfs_read_timeout(void)
+{
+	struct nfs_read_slot *slot;
+	ulong now = get_timer(0);
+	ulong next = nfs_timeout;
+	ulong tmo, elapsed;
+
+	for (slot = nfs_read_slots;
+	     slot < nfs_read_slots + NFS_READ_REQUESTS; slot++) {
+		if (!slot->id)
+			continue;
+		tmo = nfs_timeout + NFS_TIMEOUT * slot->retries;
+		elapsed = now - slot->sent;
+		if (elapsed >= tmo) {
+			if (++slot->retries > NFS_RETRY_COUNT) {
+				puts("\nRetry count exceeded; starting again\n");
+				net_start_again();
+				return;
+			}
+			puts("T ");
+			nfs_read_req(slot);
+			tmo = nfs_timeout + NFS_TIMEOUT * slot->retries;
+			elapsed = 0;
+		}
+		next = min(next, tmo - elapsed);
+	}
+	net_set_timeout_handler(next, nfs_timeout_handler);
+}
+
 static void nfs_timeout_handler(void)
 {
+	if (nfs_state == STATE_READ_REQ) {
+		nfs_read_timeout();
+		return;
+	}
+
 	if (++nfs_timeout_count > NFS_RETRY_COUNT) {
 		puts("\nRetry count exceeded; starting again\n");
 		net_start_again();
@@ -810,8 +1002,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_start();
 			nfs_send();
 		}
 		break;
@@ -838,18 +1029,21 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		rlen = nfs_read_reply(pkt, len);
 		if (rlen == -NFS_RPC_DROP)
 			break;
-		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
+		if (rlen >= 0 && !nfs_read_done()) {
 			nfs_send();
-		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
+			nfs_read_timeout();
+			break;
+		}
+		nfs_read_stop();
+		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
+		if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
+			else
 				debug("NFS READ error (%d)\n", rlen);
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
@@ -41,7 +41,12 @@
  * However, if CONFIG_IP_DEFRAG is set, a bigger value could be used.  In any
  * case, most NFS servers are optimized for a power of 2.
  */
+#ifdef CONFIG_NFS_READ_SIZE
+#define NFS_READ_SIZE	CONFIG_NFS_READ_SIZE
+#else
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#endif
+#define NFS2_MAXDATA	8192	/* NFSv2 cannot read more than this at once */
 #define NFS_MAX_ATTRS	26
 
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
@@ -75,19 +75,24 @@ static int	tftp_remote_port;
 /* The UDP port at our end */
 static int	tftp_our_port;
 static int	timeout_count;
-/* packet sequence number */
+/* packet sequence number, counting from the start of the transfer */
 static ulong	tftp_cur_block;
-/* last packet sequence number received */
-static ulong	tftp_prev_block;
-/* count of sequence number wraparounds */
-static ulong	tftp_block_wrap;
-/* memory offset due to wrapping */
-static ulong	tftp_block_wrap_offset;
+/* last block we acknowledged */
+static ulong	tftp_last_ack;
+/* number of the final (short) block, or 0 if not received yet */
+static ulong	tftp_final_block;
+/* blocks received out of order, bit n is block tftp_cur_block + 1 + n */
+static u64	tftp_window_map;
 static int	tftp_state;
 static ulong	tftp_load_addr;
 #ifdef CONFIG_LMB
 static ulong	tftp_load_size;
 #endif
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+/* decompresses the file as it arrives, if 'tftpboot -d' was used */
+static struct image_decomp_stream tftp_decomp;
+static bool	tftp_decomp_active;
+#endif
 #ifdef CONFIG_TFTP_TSIZE
 /* The file size reported by the server */
 static int	tftp_tsize;
@@ -113,8 +118,8 @@ static int	tftp_put_final_block_sent;
 
 /* default TFTP block size */
 #define TFTP_BLOCK_SIZE		512
-/* sequence number is 16 bit */
-#define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
+/* largest window we can track, see tftp_window_map */
+#define TFTP_WINDOWSIZE_MAX	64
 
 #define DEFAULT_NAME_LEN	(8 + 4 + 1)
 static char default_filename[DEFAULT_NAME_LEN];
@@ -141,14 +146,40 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
-static inline int store_block(int block, uchar *src, unsigned int len)
+/*
+ * Number of blocks the server sends before waiting for an ACK (RFC 7440). We
+ * ask for tftp_window_size_option, the server may choose something smaller.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
+
+static inline int store_block(ulong block, uchar *src, unsigned int len)
 {
-	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
+	ulong offset = block * tftp_block_size;
 	ulong newsize = offset + len;
 	ulong store_addr = tftp_load_addr + offset;
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	int i, rc = 0;
+#endif
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	if (tftp_decomp_active) {
+		if (image_decomp_stream_write(&tftp_decomp, src, len)) {
+			puts("\nTFTP error: ");
+			puts("decompression failed\n");
+			return -1;
+		}
+		net_boot_file_size = tftp_decomp.out_len;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	for (i = 0; i < CONFIG_SYS_MAX_FLASH_BANKS; i++) {
 		/* start address in flash? */
 		if (flash_info[i].flash_id == FLASH_UNKNOWN)
@@ -189,12 +220,56 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+/* Start decompressing the file as it arrives, if 'tftpboot -d' was used */
+static int tftp_decomp_start(void)
+{
+	ulong size = ULONG_MAX - tftp_load_addr;
+	int comp = net_boot_file_comp;
+
+	/* Drop any stream left by an earlier, failed transfer */
+	if (tftp_decomp_active)
+		image_decomp_stream_finish(&tftp_decomp, NULL);
+	tftp_decomp_active = false;
+
+	if (comp == IH_COMP_NONE)
+		return 0;
+#ifdef CONFIG_LMB
+	size = tftp_load_size;
+#endif
+	if (image_decomp_stream_start(&tftp_decomp, comp,
+				      map_sysmem(tftp_load_addr, size), size))
+		return -1;
+	tftp_decomp_active = true;
+
+	return 0;
+}
+
+/* Finish decompressing the file, setting the file size to its full size */
+static int tftp_decomp_finish(void)
+{
+	ulong size;
+
+	if (!tftp_decomp_active)
+		return 0;
+	tftp_decomp_active = false;
+	if (image_decomp_stream_finish(&tftp_decomp, &size)) {
+		puts("\nTFTP error: ");
+		puts("compressed data is incomplete or invalid\n");
+		return -1;
+	}
+	net_boot_file_size = size;
+
+	return 0;
+}
+#endif
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
-	tftp_prev_block = 0;
-	tftp_block_wrap = 0;
-	tftp_block_wrap_offset = 0;
+	tftp_last_ack = 0;
+	tftp_final_block = 0;
+	tftp_window_map = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -209,15 +284,14 @@ static void new_transfer(void)
  * @param len	Number of bytes in block (this one and every other)
  * @return number of bytes loaded
  */
-static int load_block(unsigned block, uchar *dst, unsigned len)
+static int load_block(ulong block, uchar *dst, unsigned len)
 {
-	/* We may want to get the final block from the previous set */
-	ulong offset = ((int)block - 1) * len + tftp_block_wrap_offset;
+	ulong offset = (block - 1) * len;
 	ulong tosend = len;
 
 	tosend = min(net_boot_file_size - offset, tosend);
 	(void)memcpy(dst, (void *)(save_addr + offset), tosend);
-	debug("%s: block=%d, offset=%ld, len=%d, tosend=%ld\n", __func__,
+	debug("%s: block=%ld, offset=%ld, len=%d, tosend=%ld\n", __func__,
 	      block, offset, len, tosend);
 	return tosend;
 }
@@ -232,8 +306,7 @@ static void show_block_marker(void)
 {
 #ifdef CONFIG_TFTP_TSIZE
 	if (tftp_tsize) {
-		ulong pos = tftp_cur_block * tftp_block_size +
-			tftp_block_wrap_offset;
+		ulong pos = tftp_cur_block * tftp_block_size;
 		if (pos > tftp_tsize)
 			pos = tftp_tsize;
 
@@ -262,24 +335,38 @@ static void restart(const char *msg)
 	net_start_again();
 }
 
+/**
+ * Convert a 16-bit sequence number from a packet into a block number
+ *
+ * The sequence number wraps around every 64K blocks, so pick the block number
+ * closest to the one we expect next. This copes with both wrapping and blocks
+ * which arrive out of order.
+ *
+ * @param seq	Sequence number from the packet
+ * @return block number, counting from the start of the transfer; this is
+ *	less than 1 for a sequence number before the start of the transfer
+ */
+static long tftp_block_number(ushort seq)
+{
+	long expect = tftp_cur_block + 1;
+
+	return expect + (short)(seq - (ushort)expect);
+}
+
 /*
- * Check if the block number has wrapped, and update progress
+ * Record that a block has been received, move tftp_cur_block past all the
+ * blocks now received in order, and update progress
  *
- * TODO: The egregious use of global variables in this file should be tidied.
+ * @param block	Block received, in the range tftp_cur_block + 1 to
+ *		tftp_cur_block + TFTP_WINDOWSIZE_MAX
  */
-static void update_block_number(void)
+static void update_block_number(ulong block)
 {
-	/*
-	 * RFC1350 specifies that the first data packet will
-	 * have sequence number 1. If we receive a sequence
-	 * number of 0 this means that there was a wrap
-	 * around of the (16 bit) counter.
-	 */
-	if (tftp_cur_block == 0 && tftp_prev_block != 0) {
-		tftp_block_wrap++;
-		tftp_block_wrap_offset += tftp_block_size * TFTP_SEQUENCE_SIZE;
+	tftp_window_map |= 1ULL << (block - tftp_cur_block - 1);
+	while (tftp_window_map & 1) {
+		tftp_window_map >>= 1;
+		tftp_cur_block++;
 		timeout_count = 0; /* we've done well, reset the timeout */
-	} else {
 		show_block_marker();
 	}
 }
@@ -295,6 +382,13 @@ static void tftp_complete(void)
 	}
 	puts("  ");
 	print_size(tftp_tsize, "");
+#endif
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+	if (tftp_decomp_finish()) {
+		eth_halt();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
 #endif
 	time_start = get_timer(time_start);
 	if (time_start > 0) {
@@ -347,6 +441,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* and for several blocks per ACK */
+		if (tftp_window_size_option > 1 && !tftp_put_active)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_window_size_option, 0);
 		len = pkt - xp;
 		break;
 
@@ -359,6 +457,7 @@ static void tftp_send(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(tftp_cur_block);
 		pkt = (uchar *)(s + 2);
+		tftp_last_ack = tftp_cur_block;
 #ifdef CONFIG_CMD_TFTPPUT
 		if (tftp_put_active) {
 			int toload = tftp_block_size;
@@ -447,11 +546,11 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				 * Move to the next block. We want our block
 				 * count to wrap just like the other end!
 				 */
-				int block = ntohs(*s);
+				long block = tftp_block_number(ntohs(*s));
 				int ack_ok = (tftp_cur_block == block);
 
-				tftp_cur_block = (unsigned short)(block + 1);
-				update_block_number();
+				tftp_cur_block = block + 1;
+				show_block_marker();
 				if (ack_ok)
 					tftp_send(); /* Send next data block */
 			}
@@ -491,6 +590,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* We cannot accept more than we asked for */
+				tftp_windowsize = clamp(tftp_windowsize,
+							(unsigned short)1,
+							tftp_window_size_option);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -509,13 +619,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 #endif
 		tftp_send(); /* Send ACK or first data block */
 		break;
-	case TFTP_DATA:
+	case TFTP_DATA: {
+		long block;
+		bool done;
+
 		if (len < 2)
 			return;
 		len -= 2;
-		tftp_cur_block = ntohs(*(__be16 *)pkt);
-
-		update_block_number();
 
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
@@ -526,41 +636,81 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_state = STATE_DATA;
 			tftp_remote_port = src;
 			new_transfer();
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+			if (tftp_decomp_start()) {
+				eth_halt();
+				net_set_state(NETLOOP_FAIL);
+				break;
+			}
+#endif
 
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* The first window may arrive in any order */
+			block = tftp_block_number(ntohs(*(__be16 *)pkt));
+			if (block < 1 || block > tftp_windowsize) {
 				puts("\nTFTP error: ");
 				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
+				       block);
 				puts("Starting again\n\n");
 				net_start_again();
 				break;
 			}
 		}
 
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
+		/*
+		 * Ignore blocks we already have and blocks too far ahead to
+		 * track. The server sends them again if needed.
+		 */
+		block = tftp_block_number(ntohs(*(__be16 *)pkt));
+		if (block <= (long)tftp_cur_block ||
+		    block - tftp_cur_block > TFTP_WINDOWSIZE_MAX ||
+		    tftp_window_map & (1ULL << (block - tftp_cur_block - 1)))
+			break;
+
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+		/*
+		 * Decompression needs the blocks in order, so drop any block
+		 * which arrives early. If it ends the window (or the file),
+		 * acknowledge the blocks so far, so that the remote sends the
+		 * rest again.
+		 */
+		if (tftp_decomp_active && block != tftp_cur_block + 1) {
+			if (block >= tftp_last_ack + tftp_windowsize ||
+			    len < tftp_block_size)
+				tftp_send();
 			break;
 		}
+#endif
 
-		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-		if (store_block(tftp_cur_block - 1, pkt + 2, len)) {
+		if (store_block(block - 1, pkt + 2, len)) {
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
+		if (len < tftp_block_size)
+			tftp_final_block = block;
+		update_block_number(block);
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 * Acknowledge the blocks received so far, which prompts the
+		 * remote for the next window, when:
+		 * - the whole window has arrived, or the whole file
+		 * - the last block of the window (or file) arrived while an
+		 *   earlier block is missing, so the remote resends from there
+		 * Blocks within a window may arrive in any order.
 		 */
-		tftp_send();
+		done = tftp_final_block && tftp_cur_block == tftp_final_block;
+		if (done || tftp_cur_block - tftp_last_ack >= tftp_windowsize ||
+		    block >= tftp_last_ack + tftp_windowsize ||
+		    block == tftp_final_block)
+			tftp_send();
 
-		if (len < tftp_block_size)
+		if (done)
 			tftp_complete();
 		break;
+	}
 
 	case TFTP_ERROR:
 		printf("\nTFTP error: '%s' (%d)\n",
@@ -633,6 +783,17 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL)
+		tftp_window_size_option = simple_strtol(ep, NULL, 10);
+
+	if (tftp_window_size_option < 1 ||
+	    tftp_window_size_option > TFTP_WINDOWSIZE_MAX) {
+		printf("TFTP windowsize (%d) out of range, set to %d\n",
+		       tftp_window_size_option, TFTP_WINDOWSIZE);
+		tftp_window_size_option = TFTP_WINDOWSIZE;
+	}
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -654,8 +815,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -754,8 +915,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
@@ -786,8 +948,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
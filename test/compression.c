@@ -5,12 +5,16 @@
 
 #include <common.h>
 #include <bootm.h>
+#include <bootstage.h>
 #include <command.h>
 #include <gzip.h>
+#include <job_queue.h>
 #include <lz4.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -20,6 +24,7 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/zstd.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -119,6 +124,23 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -c /tmp/plain.txt > /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xc5\x05\x00\x92\x0d\x25\x1a\x90\x17"
+	"\x36\x07\x84\x8d\x9a\xd8\x30\x5a\x8a\x8c\x88\xb5\x7c\x52\x5a\x07"
+	"\x34\xeb\x5b\xc6\x5d\x6f\xc7\x12\x65\xd0\x1b\xa9\xfc\x5c\x43\x6c"
+	"\xad\xc3\x2f\x38\xbc\xf1\x5a\x2b\xbb\x1f\xc7\x19\x4f\x62\x52\x84"
+	"\x76\x49\x53\x67\x61\x1d\x20\xe3\x66\xe2\xd5\x3b\xf2\x06\x78\xf8"
+	"\x39\x74\x78\x95\x65\xe1\x64\x43\x65\x51\xe9\xab\xba\x1a\x0f\x92"
+	"\x7c\xe3\x05\x50\x03\x08\x59\xc9\x5a\x60\x5f\xb6\x50\xdd\x54\x62"
+	"\xc2\x05\x51\x86\xab\x4c\xd6\xf4\xd5\xb2\x26\xae\x17\x31\x16\x9e"
+	"\x7c\x82\x44\x6e\xea\x92\xcf\xce\x67\x47\x81\x32\xac\xc1\xd7\xc5"
+	"\xf2\xa6\xf1\x91\x39\xd5\xb3\x23\xad\xe3\x86\xd0\x48\xf4\x39\x9d"
+	"\x89\x0b\x00\x45\x1b\x08\xb3\x17\x18\x6b\xa0\xb2\x6b\x8e\x28\xa8"
+	"\x55\x65\xb6\xc6\x6a\xa5\x4f\x23\x12\xee\x53\x55\x2d\x44\x2f\x54"
+	"\x95\x01\xe4\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 198;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -294,6 +316,46 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size, strlen(plain));
+	ut_asserteq(0, memcmp(plain, in, in_size));
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	size_t wsize = ZSTD_DCtxWorkspaceBound();
+	void *workspace;
+	ZSTD_DCtx *dctx;
+	size_t ret;
+
+	workspace = malloc(wsize);
+	ut_assertnonnull(workspace);
+	dctx = ZSTD_initDCtx(workspace, wsize);
+	ret = ZSTD_decompressDCtx(dctx, out, out_max, in, in_size);
+	free(workspace);
+	if (out_size && !ZSTD_isError(ret))
+		*out_size = ret;
+
+	return ZSTD_isError(ret);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -412,6 +474,122 @@ static int compression_test_gzip(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_gzip, 0);
 
+/*
+ * Get the time recorded so far in bootstage by the parallel decompressor for
+ * @comp (IH_COMP_GZIP or IH_COMP_LZ4). It only adds to this when it runs, so
+ * this shows whether it did.
+ */
+static ulong compression_parallel_us(int comp)
+{
+	/* Adding nothing gives the total so far */
+	if (comp == IH_COMP_GZIP)
+		return bootstage_accum_add(BOOTSTAGE_ID_ACCUM_GZIP, "gzip", 0);
+
+	return bootstage_accum_add(BOOTSTAGE_ID_ACCUM_LZ4, "lz4", 0);
+}
+
+/* Number of members in the files built by gzip_build_members() */
+#define GZIP_TEST_MEMBERS	12
+#define GZIP_TEST_MEMBER_SIZE	SZ_16K
+
+/**
+ * gzip_build_members() - Write a gzip file with several members
+ *
+ * Each member holds GZIP_TEST_MEMBER_SIZE bytes of the data at @expect.
+ *
+ * @uts:	Test state
+ * @out:	Place to write the file
+ * @expect:	Data to compress
+ * @bgzf:	true to record the size of each member in its header, as
+ *		bgzip does
+ * @lenp:	Returns the length of the file
+ * @return 0 if OK, non-zero on failure
+ */
+static int gzip_build_members(struct unit_test_state *uts, u8 *out,
+			      u8 *expect, bool bgzf, ulong *lenp)
+{
+	static const u8 bgzf_hdr[] = {
+		0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0
+	};
+	u8 *start = out;
+	ulong len;
+	int i;
+
+	for (i = 0; i < GZIP_TEST_MEMBERS; i++) {
+		len = GZIP_TEST_MEMBER_SIZE * 2;
+		ut_assertok(gzip(out, &len, expect, GZIP_TEST_MEMBER_SIZE));
+		expect += GZIP_TEST_MEMBER_SIZE;
+		if (!bgzf) {
+			out += len;
+			continue;
+		}
+
+		/* Swap the 10-byte header for one with an extra field */
+		memmove(out + 18, out + 10, len - 10);
+		memcpy(out, bgzf_hdr, sizeof(bgzf_hdr));
+		put_unaligned_le16(len + 8 - 1, out + 16);
+		out += len + 8;
+	}
+	*lenp = out - start;
+
+	return 0;
+}
+
+/* Decompress files with several members, which may be done on several CPUs */
+static int compression_test_gzip_members(struct unit_test_state *uts)
+{
+	const int unc_len = GZIP_TEST_MEMBERS * GZIP_TEST_MEMBER_SIZE;
+	bool parallel = CONFIG_IS_ENABLED(GZIP_PARALLEL) &&
+		IS_ENABLED(CONFIG_BOOTSTAGE) && job_queue_cpus() > 1;
+	u8 *in, *out, *expect;
+	ulong in_len, len, start_us;
+	int i;
+
+	in = malloc(unc_len * 2);
+	out = malloc(unc_len * 2);
+	expect = malloc(unc_len);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+	ut_assertnonnull(expect);
+	for (i = 0; i < unc_len; i++)
+		expect[i] = plain[i % (sizeof(plain) - 1)] ^ (i / 1000);
+
+	/*
+	 * Members which record their size, which are inflated in parallel,
+	 * then members which do not, which are inflated one at a time
+	 */
+	for (i = 0; i < 2; i++) {
+		ut_assertok(gzip_build_members(uts, in, expect, !i, &in_len));
+		memset(out, 'A', unc_len * 2);
+		len = in_len;
+		start_us = compression_parallel_us(IH_COMP_GZIP);
+		ut_assertok(gunzip(out, unc_len * 2, in, &len));
+		if (parallel)
+			ut_asserteq(!i, compression_parallel_us(IH_COMP_GZIP) >
+				    start_us);
+		ut_asserteq(unc_len, len);
+		ut_assertok(memcmp(expect, out, unc_len));
+		ut_asserteq('A', out[unc_len]);
+	}
+
+	/* Too little space */
+	ut_assertok(gzip_build_members(uts, in, expect, true, &in_len));
+	len = in_len;
+	ut_assert(gunzip(out, unc_len - 1, in, &len));
+
+	/* Corrupt the last member */
+	in[in_len - 12] ^= 0xff;
+	len = in_len;
+	ut_assert(gunzip(out, unc_len * 2, in, &len));
+
+	free(expect);
+	free(out);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_gzip_members, 0);
+
 static int compression_test_bzip2(struct unit_test_state *uts)
 {
 	return run_test(uts, "bzip2", compress_using_bzip2,
@@ -438,6 +616,175 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* Space for each block of the frames built by lz4_build_frame() */
+#define LZ4_TEST_BLOCK_MAX	SZ_64K
+#define LZ4_TEST_BLOCKS		6
+
+/**
+ * lz4_build_block() - Write an LZ4 block which repeats eight bytes
+ *
+ * The block holds eight literal bytes, a match which repeats them and five
+ * more literal bytes, which together give @size bytes of output.
+ *
+ * @out:	Place to write the block
+ * @expect:	Place to write the data which the block decompresses to
+ * @seed:	Value for the first literal byte
+ * @size:	Size of the data, at least 25
+ * @return length of the block
+ */
+static int lz4_build_block(u8 *out, u8 *expect, int seed, int size)
+{
+	int match = size - 8 - 5;
+	u8 *start = out;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		expect[i] = seed + i * 3;
+	for (i = 8; i < size - 5; i++)
+		expect[i] = expect[i - 8];
+	for (i = size - 5; i < size; i++)
+		expect[i] = seed ^ i;
+
+	*out++ = 8 << 4 | 15;
+	memcpy(out, expect, 8);
+	out += 8;
+	*out++ = 8;	/* match offset */
+	*out++ = 0;
+	for (i = match - 4 - 15; i >= 255; i -= 255)
+		*out++ = 255;
+	*out++ = i;
+	*out++ = 5 << 4;
+	memcpy(out, expect + size - 5, 5);
+	out += 5;
+
+	return out - start;
+}
+
+/**
+ * lz4_build_frame() - Write an LZ4 frame with several independent blocks
+ *
+ * The third block is stored uncompressed.
+ *
+ * @out:	Place to write the frame
+ * @expect:	Place to write the data which the frame decompresses to
+ * @sizes:	Size of the data in each block, LZ4_TEST_BLOCKS entries
+ * @return length of the frame
+ */
+static int lz4_build_frame(u8 *out, u8 *expect, const int *sizes)
+{
+	u8 *start = out;
+	u32 len;
+	int i;
+
+	put_unaligned_le32(LZ4F_MAGIC, out);
+	out += 4;
+	*out++ = 0x60;	/* version 1, independent blocks */
+	*out++ = 0x40;	/* blocks of up to 64KiB */
+	*out++ = 0;	/* header checksum, which is not checked */
+	for (i = 0; i < LZ4_TEST_BLOCKS; i++) {
+		len = lz4_build_block(out + 4, expect, i + 1, sizes[i]);
+		if (i == 2) {
+			memcpy(out + 4, expect, sizes[i]);
+			len = sizes[i] | BIT(31);
+		}
+		put_unaligned_le32(len, out);
+		out += 4 + (len & ~BIT(31));
+		expect += sizes[i];
+	}
+	put_unaligned_le32(0, out);	/* end mark */
+	out += 4;
+
+	return out - start;
+}
+
+/* Decompress frames with many blocks, which may be done on several CPUs */
+static int compression_test_lz4_blocks(struct unit_test_state *uts)
+{
+	static const int full[LZ4_TEST_BLOCKS] = {
+		SZ_64K, SZ_64K, SZ_64K, SZ_64K, SZ_64K, 1000,
+	};
+	static const int short_mid[LZ4_TEST_BLOCKS] = {
+		SZ_64K, 1000, SZ_64K, SZ_64K, SZ_64K, 1000,
+	};
+	const int max = LZ4_TEST_BLOCKS * LZ4_TEST_BLOCK_MAX;
+	bool parallel = CONFIG_IS_ENABLED(LZ4_PARALLEL) &&
+		IS_ENABLED(CONFIG_BOOTSTAGE) && job_queue_cpus() > 1;
+	u8 *in, *out, *expect;
+	size_t out_size;
+	ulong start_us;
+	int unc_len;
+	int in_len;
+
+	in = malloc(max);
+	out = malloc(max);
+	expect = malloc(max);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+	ut_assertnonnull(expect);
+
+	unc_len = SZ_64K * 5 + 1000;
+	in_len = lz4_build_frame(in, expect, full);
+	memset(out, 'A', max);
+	out_size = max;
+	start_us = compression_parallel_us(IH_COMP_LZ4);
+	ut_assertok(ulz4fn(in, in_len, out, &out_size));
+	if (parallel)
+		ut_assert(compression_parallel_us(IH_COMP_LZ4) > start_us);
+	ut_asserteq(unc_len, out_size);
+	ut_assertok(memcmp(expect, out, unc_len));
+	ut_asserteq('A', out[unc_len]);
+
+	/* Exactly enough space */
+	out_size = unc_len;
+	ut_assertok(ulz4fn(in, in_len, out, &out_size));
+	ut_asserteq(unc_len, out_size);
+	ut_assertok(memcmp(expect, out, unc_len));
+
+	/* Too little space */
+	memset(out, 'A', max);
+	out_size = unc_len - 1;
+	ut_assert(ulz4fn(in, in_len, out, &out_size));
+	ut_asserteq('A', out[unc_len - 1]);
+
+	/* Point the first match before the start of its block */
+	in[7 + 4 + 1 + 8] = 0xff;
+	in[7 + 4 + 1 + 8 + 1] = 0xff;
+	out_size = max;
+	ut_assert(ulz4fn(in, in_len, out, &out_size));
+
+	/* A short block which is not the last */
+	unc_len = SZ_64K * 4 + 2000;
+	in_len = lz4_build_frame(in, expect, short_mid);
+	memset(out, 'A', max);
+	out_size = max;
+	start_us = compression_parallel_us(IH_COMP_LZ4);
+	ut_assertok(ulz4fn(in, in_len, out, &out_size));
+	if (parallel)
+		ut_assert(compression_parallel_us(IH_COMP_LZ4) > start_us);
+	ut_asserteq(unc_len, out_size);
+	ut_assertok(memcmp(expect, out, unc_len));
+	ut_asserteq('A', out[unc_len]);
+
+	/* A block which claims to run past the end of the frame */
+	put_unaligned_le32(in_len, in + 7);
+	out_size = max;
+	ut_assert(ulz4fn(in, in_len, out, &out_size));
+
+	free(expect);
+	free(out);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_blocks, 0);
+
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -528,12 +875,116 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#ifdef CONFIG_IMAGE_DECOMP_STREAM
+/**
+ * run_stream_test() - Run tests on decompressing data passed in pieces
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	static const ulong piece_sizes[] = { 1, 3, 17, 100, TEST_BUFFER_SIZE };
+	struct image_decomp_stream strm;
+	ulong compress_size = TEST_BUFFER_SIZE;
+	ulong unc_len = strlen(plain);
+	char compressed[TEST_BUFFER_SIZE];
+	char out[TEST_BUFFER_SIZE];
+	ulong pos, len;
+	int i;
+
+	printf("Testing stream: %s\n", genimg_get_comp_name(comp_type));
+	ut_assertok(compress(uts, (void *)plain, unc_len, compressed,
+			     compress_size, &compress_size));
+
+	for (i = 0; i < ARRAY_SIZE(piece_sizes); i++) {
+		memset(out, 'A', sizeof(out));
+		ut_assertok(image_decomp_stream_start(&strm, comp_type, out,
+						      unc_len));
+		for (pos = 0; pos < compress_size; pos += len) {
+			len = min(piece_sizes[i], compress_size - pos);
+			ut_assertok(image_decomp_stream_write(&strm,
+							      compressed + pos,
+							      len));
+		}
+		ut_assertok(image_decomp_stream_finish(&strm, &len));
+		ut_asserteq(unc_len, len);
+		ut_assertok(memcmp(plain, out, unc_len));
+		ut_asserteq('A', out[unc_len]);
+	}
+
+	/* Too little space, which must not be overrun */
+	memset(out, 'A', sizeof(out));
+	ut_assertok(image_decomp_stream_start(&strm, comp_type, out,
+					      unc_len - 1));
+	ut_assert(image_decomp_stream_write(&strm, compressed, compress_size));
+	ut_assert(image_decomp_stream_finish(&strm, NULL));
+	ut_asserteq('A', out[unc_len - 1]);
+
+	/* We can't detect truncation when not decompressing */
+	if (comp_type == IH_COMP_NONE)
+		return 0;
+	ut_assertok(image_decomp_stream_start(&strm, comp_type, out,
+					      unc_len));
+	ut_assertok(image_decomp_stream_write(&strm, compressed,
+					      compress_size - 1));
+	ut_asserteq(-EINVAL, image_decomp_stream_finish(&strm, NULL));
+
+	/* Data after the end, here a second copy, is ignored */
+	memset(out, 'A', sizeof(out));
+	ut_assertok(image_decomp_stream_start(&strm, comp_type, out,
+					      unc_len));
+	ut_assertok(image_decomp_stream_write(&strm, compressed,
+					      compress_size));
+	ut_assertok(image_decomp_stream_write(&strm, compressed,
+					      compress_size));
+	ut_assertok(image_decomp_stream_finish(&strm, &len));
+	ut_asserteq(unc_len, len);
+	ut_assertok(memcmp(plain, out, unc_len));
+	ut_asserteq('A', out[unc_len]);
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+#endif /* CONFIG_IMAGE_DECOMP_STREAM */
+
 int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
@@ -5,6 +5,9 @@
 
 #include <common.h>
 #include <dm.h>
+#include <hexdump.h>
+#include <os.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -77,12 +80,12 @@ static int dm_test_blk_usb(struct unit_test_state *uts)
 	ut_asserteq_ptr(usb_dev, dev_get_parent(dev));
 
 	/* Check we have one block device for each mass storage device */
-	ut_asserteq(6, count_blk_devices());
+	ut_asserteq(7, count_blk_devices());
 
 	/* Now go around again, making sure the old devices were unbound */
 	ut_assertok(usb_stop());
 	ut_assertok(usb_init());
-	ut_asserteq(6, count_blk_devices());
+	ut_asserteq(7, count_blk_devices());
 	ut_assertok(usb_stop());
 
 	return 0;
@@ -162,3 +165,225 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#define BLK_ASYNC_TEST_FILE	"blk_async_test.img"
+#define BLK_ASYNC_TEST_BLOCKS	16
+
+static int blk_async_test_order[4];
+static int blk_async_test_count;
+
+static void blk_async_test_done(struct blk_req *req)
+{
+	blk_async_test_order[blk_async_test_count++] = (long)req->priv;
+}
+
+/* Test asynchronous requests on the host device */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	char disk[BLK_ASYNC_TEST_BLOCKS * 512], buf[3][2 * 512];
+	struct blk_req req[3];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	int i;
+
+	for (i = 0; i < sizeof(disk); i++)
+		disk[i] = i / 512 + i;
+	ut_assertok(os_write_file(BLK_ASYNC_TEST_FILE, disk, sizeof(disk)));
+	ut_assertok(host_dev_bind(0, BLK_ASYNC_TEST_FILE));
+	ut_assertok(blk_get_device(IF_TYPE_HOST, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+
+	/* Drop anything cached while probing, so that requests go to disk */
+	blkcache_invalidate(IF_TYPE_HOST, 0);
+
+	/* Nothing is in progress to start with */
+	ut_asserteq(0, blk_poll(dev));
+
+	/* Queue some reads, which complete in order */
+	memset(req, '\0', sizeof(req));
+	blk_async_test_count = 0;
+	for (i = 0; i < 3; i++) {
+		req[i].dev = dev;
+		req[i].op = BLK_REQ_READ;
+		req[i].start = 1 + i * 4;
+		req[i].blkcnt = 2;
+		req[i].buffer = buf[i];
+		req[i].done = blk_async_test_done;
+		req[i].priv = (void *)(long)i;
+		ut_assertok(blk_submit(&req[i]));
+	}
+	ut_assert(!req[0].complete);
+	ut_assert(blk_poll(dev) > 0);
+	ut_assert(req[0].complete);
+	ut_assert(!req[1].complete);
+	ut_asserteq(2, blk_wait(&req[2]));
+	ut_assert(req[1].complete);
+	ut_asserteq(0, blk_poll(dev));
+	ut_asserteq(3, blk_async_test_count);
+	for (i = 0; i < 3; i++) {
+		ut_asserteq(i, blk_async_test_order[i]);
+		ut_asserteq(2, req[i].result);
+		ut_asserteq_mem(disk + (1 + i * 4) * 512, buf[i], 2 * 512);
+	}
+
+	/* Write, then read back synchronously */
+	memset(buf[0], 0xa5, sizeof(buf[0]));
+	req[0].op = BLK_REQ_WRITE;
+	req[0].start = 6;
+	req[0].done = NULL;
+	ut_assertok(blk_submit(&req[0]));
+	ut_asserteq(2, blk_wait(&req[0]));
+	ut_asserteq(3, blk_dread(desc, 5, 3, buf[1]));
+	ut_asserteq_mem(disk + 5 * 512, buf[1], 512);
+	ut_asserteq_mem(buf[0], buf[1] + 512, 2 * 512);
+	memset(buf[1], '\0', sizeof(buf[1]));
+	ut_asserteq(2, blk_dread(desc, 6, 2, buf[1]));
+	ut_asserteq_mem(buf[0], buf[1], 2 * 512);
+
+	/* Removing the device completes any requests still in progress */
+	blkcache_invalidate(IF_TYPE_HOST, 0);
+	req[0].op = BLK_REQ_READ;
+	ut_assertok(blk_submit(&req[0]));
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_asserteq(-ENODEV, req[0].result);
+	ut_assert(req[0].complete);
+	ut_assertok(os_unlink(BLK_ASYNC_TEST_FILE));
+
+	/* Without async support, requests complete when they are submitted */
+	ut_assertok(blk_get_device(IF_TYPE_MMC, 0, &dev));
+	blk_async_test_count = 0;
+	req[1].dev = dev;
+	req[1].start = 0;
+	req[1].done = blk_async_test_done;
+	ut_assertok(blk_submit(&req[1]));
+	ut_assert(req[1].complete);
+	ut_asserteq(2, req[1].result);
+	ut_asserteq(1, blk_async_test_count);
+	ut_asserteq(0, blk_poll(dev));
+	ut_asserteq(2, blk_wait(&req[1]));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_BLOCK_CACHE
+#define BLKCACHE_TEST_BLOCKS	128
+
+static char *blkcache_test_disk;
+static int blkcache_test_reads;
+static int blkcache_test_blocks;
+
+static ulong blkcache_test_read(struct blk_desc *block_dev, lbaint_t start,
+				lbaint_t blkcnt, void *buffer)
+{
+	memcpy(buffer, blkcache_test_disk + start * block_dev->blksz,
+	       blkcnt * block_dev->blksz);
+	blkcache_test_reads++;
+	blkcache_test_blocks += blkcnt;
+
+	return blkcnt;
+}
+
+/* Test the block cache with read-ahead and write-through */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats, now;
+	struct block_cache_dev_stats dev_stats;
+	struct blk_desc desc;
+	char buf[24 * 512];
+	int i;
+
+	memset(&desc, '\0', sizeof(desc));
+	desc.if_type = IF_TYPE_HOST;
+	desc.devnum = 99;
+	desc.blksz = 512;
+	desc.lba = BLKCACHE_TEST_BLOCKS;
+	blkcache_test_disk = malloc(BLKCACHE_TEST_BLOCKS * desc.blksz);
+	ut_assertnonnull(blkcache_test_disk);
+	for (i = 0; i < BLKCACHE_TEST_BLOCKS * desc.blksz; i++)
+		blkcache_test_disk[i] = i / desc.blksz + i;
+	blkcache_test_reads = 0;
+	blkcache_test_blocks = 0;
+
+	blkcache_stats(&stats);
+	ut_assertok(blkcache_configure(8, 32, 16));
+	blkcache_invalidate(IF_TYPE_HOST, 99);
+
+	/* A miss reads the whole cache line */
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 3, 2, 512, buf));
+	ut_asserteq(2, blkcache_read_ahead(&desc, 3, 2, buf,
+					   blkcache_test_read));
+	ut_asserteq_mem(blkcache_test_disk + 3 * 512, buf, 2 * 512);
+	ut_asserteq(1, blkcache_test_reads);
+	ut_asserteq(8, blkcache_test_blocks);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 99, 3, 2, 512, buf));
+	ut_asserteq_mem(blkcache_test_disk + 3 * 512, buf, 2 * 512);
+
+	/* A sequential miss reads ahead */
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 5, 4, 512, buf));
+	ut_asserteq(4, blkcache_read_ahead(&desc, 5, 4, buf,
+					   blkcache_test_read));
+	ut_asserteq_mem(blkcache_test_disk + 5 * 512, buf, 4 * 512);
+	ut_asserteq(2, blkcache_test_reads);
+	ut_asserteq(32, blkcache_test_blocks);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 99, 9, 15, 512, buf));
+	ut_asserteq_mem(blkcache_test_disk + 9 * 512, buf, 15 * 512);
+	ut_asserteq(2, blkcache_test_reads);
+
+	/* Read-ahead stops at the end of the device */
+	desc.lba = 36;
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 24, 4, 512, buf));
+	ut_asserteq(4, blkcache_read_ahead(&desc, 24, 4, buf,
+					   blkcache_test_read));
+	ut_asserteq(3, blkcache_test_reads);
+	ut_asserteq(44, blkcache_test_blocks);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 99, 24, 8, 512, buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 32, 4, 512, buf));
+
+	/* Writes update the cache */
+	memset(blkcache_test_disk + 17 * 512, 0xa5, 512);
+	blkcache_write(IF_TYPE_HOST, 99, 17, 1, 512,
+		       blkcache_test_disk + 17 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 99, 16, 2, 512, buf));
+	ut_asserteq_mem(blkcache_test_disk + 16 * 512, buf, 2 * 512);
+
+	/* Erased blocks are dropped from the cache */
+	blkcache_invalidate_range(IF_TYPE_HOST, 99, 17, 1, 512);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 16, 2, 512, buf));
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 99, 8, 8, 512, buf));
+
+	for (i = 0; !blkcache_dev_stats(i, &dev_stats); i++) {
+		if (dev_stats.iftype == IF_TYPE_HOST && dev_stats.devnum == 99)
+			break;
+	}
+	ut_asserteq(IF_TYPE_HOST, dev_stats.iftype);
+	ut_asserteq(99, dev_stats.devnum);
+	ut_asserteq(5, dev_stats.hits);
+	ut_asserteq(5, dev_stats.misses);
+	ut_asserteq(6 + 20 + 8, dev_stats.readahead);
+	ut_asserteq(1, dev_stats.writes);
+
+	/* Lines must hold at least one block */
+	ut_asserteq(-EINVAL, blkcache_configure(0, 32, 0));
+	ut_asserteq(-EINVAL, blkcache_configure(0, 0, 8));
+	blkcache_stats(&now);
+	ut_asserteq(8, now.max_blocks_per_entry);
+	ut_asserteq(32, now.max_entries);
+	ut_asserteq(16, now.readahead);
+
+	/* With the cache turned off, nothing is looked up or added */
+	ut_assertok(blkcache_configure(0, 0, 0));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 99, 8, 8, 512, buf));
+	ut_asserteq(0, blkcache_read_ahead(&desc, 1000, 1, buf,
+					   blkcache_test_read));
+	blkcache_fill(IF_TYPE_HOST, 99, 8, 8, 512, buf);
+
+	blkcache_invalidate(IF_TYPE_HOST, 99);
+	ut_assertok(blkcache_configure(stats.max_blocks_per_entry,
+				       stats.max_entries, stats.readahead));
+	free(blkcache_test_disk);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+#endif
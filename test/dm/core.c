@@ -904,3 +904,161 @@ static int dm_test_inactive_child(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_inactive_child, DM_TESTF_SCAN_PDATA);
+
+/* Find devices in a uclass with thousands of devices */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	const int count = 4000;
+	struct udevice **devs, *found;
+	ulong start, bind_us, find_us;
+	ofnode backlight, supply;
+	char name[30];
+	char *str;
+	int i;
+
+	devs = calloc(count, sizeof(*devs));
+	ut_assertnonnull(devs);
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "index-test%d", i);
+		str = strdup(name);
+		ut_assertnonnull(str);
+		ut_assertok(device_bind_ofnode(dm_root(),
+					       DM_GET_DRIVER(test_drv), str, 0,
+					       ofnode_null(), &devs[i]));
+		device_set_name_alloced(devs[i]);
+	}
+	bind_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "index-test%d", i);
+		ut_assertok(uclass_find_device_by_name(UCLASS_TEST, name,
+						       &found));
+		ut_asserteq_ptr(devs[i], found);
+	}
+	find_us = timer_get_us() - start;
+	printf("%d devices: bind %lu us, find all by name %lu us\n", count,
+	       bind_us, find_us);
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST,
+							"index-missing",
+							&found));
+
+	/* A renamed device can only be found by its new name */
+	ut_assertok(device_set_name(devs[10], "index-renamed"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "index-renamed",
+					       &found));
+	ut_asserteq_ptr(devs[10], found);
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST,
+							"index-test10",
+							&found));
+
+	/* Give two devices nodes, one pointing to the other by phandle */
+	backlight = ofnode_path("/backlight");
+	ut_assert(ofnode_valid(backlight));
+	supply = ofnode_get_by_phandle(ofnode_read_u32_default(backlight,
+							"power-supply", 0));
+	ut_assert(ofnode_valid(supply));
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, supply,
+							  &found));
+	dev_set_ofnode(devs[count - 1], supply);
+	dev_set_ofnode(devs[count - 2], backlight);
+
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, supply, &found));
+	ut_asserteq_ptr(devs[count - 1], found);
+	ut_assertok(uclass_find_device_by_ofnode(UCLASS_TEST, backlight,
+						 &found));
+	ut_asserteq_ptr(devs[count - 2], found);
+	ut_assertok(uclass_find_device_by_phandle(UCLASS_TEST,
+						  devs[count - 2],
+						  "power-supply", &found));
+	ut_asserteq_ptr(devs[count - 1], found);
+
+	/* Unbound devices are no longer found */
+	ut_assertok(device_unbind(devs[count - 1]));
+	ut_asserteq(-ENODEV, uclass_find_device_by_ofnode(UCLASS_TEST, supply,
+							  &found));
+	ut_asserteq(-ENODEV, uclass_find_device_by_phandle(UCLASS_TEST,
+							   devs[count - 2],
+							   "power-supply",
+							   &found));
+	free(devs);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, DM_TESTF_SCAN_PDATA);
+
+#if CONFIG_IS_ENABLED(DM_LAZY_BIND)
+/* Count a device and all its descendants, without binding anything */
+static int dm_test_count_tree(struct udevice *dev)
+{
+	struct udevice *child;
+	int count = 1;
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		count += dm_test_count_tree(child);
+
+	return count;
+}
+
+/* Test that lazy binding binds device-tree nodes only when needed */
+static int dm_test_lazy_bind(struct unit_test_state *uts)
+{
+	struct udevice *root = dm_root();
+	struct udevice *dev, *next, *found;
+	struct uclass *uc;
+	ofnode node;
+	int count;
+
+	/*
+	 * Bind everything to see how many devices there should be. Probing
+	 * some-bus binds its children, as it does below.
+	 */
+	ut_assertok(dm_scan_fdt(gd->fdt_blob, false));
+	ut_assertok(uclass_get_device_by_name(UCLASS_TEST_BUS, "some-bus",
+					      &dev));
+	count = dm_test_count_tree(root);
+	ut_assertok(device_remove(root, DM_REMOVE_NORMAL));
+	list_for_each_entry_safe(dev, next, &root->child_head, sibling_node)
+		ut_assertok(device_unbind(dev));
+	ut_asserteq(1, dm_test_count_tree(root));
+
+	/* Scanning records the nodes but does not bind any of them */
+	ut_assertok(dm_lazy_init());
+	ut_assertok(dm_scan_fdt(gd->fdt_blob, false));
+	ut_asserteq(1, dm_test_count_tree(root));
+
+	/*
+	 * Looking in a uclass binds just the nodes which could provide it,
+	 * including some-bus, whose children are in UCLASS_TEST_FDT
+	 */
+	ut_assertok(uclass_get_device_by_name(UCLASS_TEST_FDT, "a-test",
+					      &dev));
+	uc = uclass_find(UCLASS_I2C);
+	ut_assert(!uc || list_empty(&uc->dev_head));
+	uc = uclass_find(UCLASS_PCI);
+	ut_assert(!uc || list_empty(&uc->dev_head));
+
+	/* Looking up a node binds it along with its parents */
+	node = ofnode_path("/i2c@0/eeprom@2c");
+	ut_assert(ofnode_valid(node));
+	ut_assertok(device_find_global_by_ofnode(node, &dev));
+	ut_asserteq_str("eeprom@2c", dev->name);
+	ut_asserteq(UCLASS_I2C, device_get_uclass_id(dev->parent));
+
+	/* Looking at a device's children binds them */
+	ut_assertok(uclass_get_device_by_name(UCLASS_TEST_BUS, "some-bus",
+					      &dev));
+	ut_assertok(device_find_child_by_name(dev, "c-test@1", &found));
+	ut_asserteq(3, device_get_child_count(dev));
+
+	/* Finally everything else is bound */
+	ut_assert(dm_test_count_tree(root) < count);
+	ut_assertok(dm_lazy_bind_all());
+	ut_asserteq(count, dm_test_count_tree(root));
+
+	return 0;
+}
+DM_TEST(dm_test_lazy_bind, 0);
+#endif
@@ -7,15 +7,18 @@
  */
 
 #include <common.h>
+#include <command.h>
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <test/ut.h>
 
 #define DM_TEST_ETH_NUM		4
@@ -429,3 +432,471 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, DM_TESTF_SCAN_FDT);
+
+/* Port the fake TFTP server sends data from, after the request on port 69 */
+#define SB_TFTP_PORT		1234
+#define SB_TFTP_BLKSIZE		512
+
+/**
+ * struct sb_tftp_server - state of the fake TFTP server
+ *
+ * @uts: Test state, used by the ut_assert macros
+ * @client_port: UDP port of the client
+ * @max_window: Largest window size the server accepts
+ * @window: Window size agreed with the client
+ * @size: Size of the file in bytes
+ * @ack: Last block acknowledged by the client
+ * @acks: Number of ACKs received
+ * @swap: true to send the first two blocks of each window in reverse order
+ * @drop: Block to drop the first time it is sent, 0 for none
+ */
+struct sb_tftp_server {
+	struct unit_test_state *uts;
+	int client_port;
+	uint max_window;
+	uint window;
+	uint size;
+	uint ack;
+	uint acks;
+	bool swap;
+	uint drop;
+};
+
+static u8 sb_tftp_byte(uint offset)
+{
+	return offset * 7 + offset / SB_TFTP_BLKSIZE;
+}
+
+/* Inject a UDP packet from the server in reply to the client's @packet */
+static void sb_udp_reply(struct udevice *dev, void *packet, int sport,
+			  const void *data, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+
+	/* Don't allow the buffer to overrun */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ipr, net_read_ip(&ip->ip_src),
+			  net_read_ip(&ip->ip_dst), IP_UDP_HDR_SIZE + len,
+			  IPPROTO_UDP);
+	ipr->udp_src = htons(sport);
+	ipr->udp_dst = ip->udp_src;
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+	memcpy((void *)ipr + IP_UDP_HDR_SIZE, data, len);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+/* Send block number @block, which counts from 1, unless it is to be dropped */
+static void sb_tftp_send_block(struct udevice *dev, void *packet,
+			       struct sb_tftp_server *srv, uint block)
+{
+	u8 buf[4 + SB_TFTP_BLKSIZE];
+	uint offset = (block - 1) * SB_TFTP_BLKSIZE;
+	uint len = min(srv->size - offset, (uint)SB_TFTP_BLKSIZE);
+	uint i;
+
+	if (block == srv->drop) {
+		srv->drop = 0;
+		return;
+	}
+	put_unaligned_be16(3, buf);	/* DATA */
+	put_unaligned_be16(block & 0xffff, buf + 2);
+	for (i = 0; i < len; i++)
+		buf[4 + i] = sb_tftp_byte(offset + i);
+	sb_udp_reply(dev, packet, SB_TFTP_PORT, buf, 4 + len);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *pkt = (uchar *)ip + IP_UDP_HDR_SIZE;
+	/* Used by all of the ut_assert macros */
+	struct unit_test_state *uts = srv->uts;
+	uint blocks = srv->size / SB_TFTP_BLKSIZE + 1;
+	uint block, last, i;
+	char oack[40];
+	uchar *end;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	if (ntohs(ip->udp_dst) == 69) {
+		/* RRQ: the options follow the file name and mode */
+		ut_asserteq(1, get_unaligned_be16(pkt));
+		end = (uchar *)ip + ntohs(ip->ip_len);
+		srv->window = 1;
+		for (pkt += 2; pkt < end; pkt += strlen((char *)pkt) + 1) {
+			if (!strcmp((char *)pkt, "windowsize")) {
+				pkt += strlen((char *)pkt) + 1;
+				block = simple_strtoul((char *)pkt, NULL, 10);
+				srv->window = min(srv->max_window, block);
+			}
+		}
+		srv->client_port = ntohs(ip->udp_src);
+		srv->ack = 0;
+		put_unaligned_be16(6, oack);	/* OACK */
+		len = 2 + sprintf(oack + 2, "blksize%c%d%c", 0,
+				  SB_TFTP_BLKSIZE, 0);
+		if (srv->window > 1)
+			len += sprintf(oack + len, "windowsize%c%d%c", 0,
+				       srv->window, 0);
+		sb_udp_reply(dev, packet, SB_TFTP_PORT, oack, len);
+	} else if (ntohs(ip->udp_dst) == SB_TFTP_PORT) {
+		/* ACK: send the next window */
+		ut_asserteq(srv->client_port, ntohs(ip->udp_src));
+		ut_asserteq(4, get_unaligned_be16(pkt));
+		srv->acks++;
+		/* The block number wraps at 64K */
+		srv->ack += (u16)(get_unaligned_be16(pkt + 2) - srv->ack);
+		if (srv->ack == blocks)
+			return 0;
+		last = min(srv->ack + srv->window, blocks);
+		for (i = 1; i <= last - srv->ack; i++) {
+			block = i;
+			if (srv->swap && last - srv->ack > 2 && i <= 2)
+				block = 3 - i;
+			sb_tftp_send_block(dev, packet, srv, srv->ack + block);
+		}
+	}
+
+	return 0;
+}
+
+static int sb_tftp_check(struct unit_test_state *uts,
+			 struct sb_tftp_server *srv, uint expect_acks)
+{
+	ulong addr = 0x1000000;
+	char cmd[40];
+	u8 *buf;
+	uint i;
+
+	srv->uts = uts;
+	srv->acks = 0;
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, srv);
+
+	buf = map_sysmem(addr, srv->size);
+	memset(buf, '\0', srv->size);
+	snprintf(cmd, sizeof(cmd), "tftpboot %lx test.bin", addr);
+	ut_assertok(run_command(cmd, 0));
+	ut_asserteq(srv->size, env_get_hex("filesize", 0));
+	for (i = 0; i < srv->size; i++)
+		ut_asserteq(sb_tftp_byte(i), buf[i]);
+	unmap_sysmem(buf);
+	ut_asserteq(expect_acks, srv->acks);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+
+static int _dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	/* 20 blocks, the last one short */
+	struct sb_tftp_server srv = {
+		.max_window = 3,
+		.size = 19 * SB_TFTP_BLKSIZE + 100,
+	};
+
+	/* One ACK per block, plus the OACK */
+	env_set("tftpwindowsize", "1");
+	ut_assertok(sb_tftp_check(uts, &srv, 21));
+	ut_asserteq(1, srv.window);
+
+	/* We ask for 8 blocks but the server only allows 3 */
+	env_set("tftpwindowsize", "8");
+	ut_assertok(sb_tftp_check(uts, &srv, 8));
+	ut_asserteq(3, srv.window);
+
+	/* Blocks arriving out of order within a window need no extra ACKs */
+	srv.swap = true;
+	ut_assertok(sb_tftp_check(uts, &srv, 8));
+
+	/* A lost block is acknowledged as soon as the window ends */
+	srv.swap = false;
+	srv.drop = 5;
+	ut_assertok(sb_tftp_check(uts, &srv, 9));
+
+	/* A file which is a multiple of the block size ends with no data */
+	srv.size = 6 * SB_TFTP_BLKSIZE;
+	ut_assertok(sb_tftp_check(uts, &srv, 4));
+
+	/* The block number wraps after 64K blocks */
+	srv.size = 0x10004 * SB_TFTP_BLKSIZE + 10;
+	ut_assertok(sb_tftp_check(uts, &srv, 21848));
+
+	return 0;
+}
+
+static int dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	int retval;
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+
+	retval = _dm_test_eth_tftp(uts);
+
+	/* Restore the env */
+	env_set("tftpwindowsize", NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return retval;
+}
+
+DM_TEST(dm_test_eth_tftp, DM_TESTF_SCAN_FDT);
+
+/* Port of the fake NFS server, for both the mount and NFS programs */
+#define SB_NFS_PORT		2049
+
+/* RPC programs and procedures used by the NFS client */
+#define SB_PROG_PORTMAP		100000
+#define SB_PROG_NFS		100003
+#define SB_PROG_MOUNT		100005
+#define SB_MOUNT_ADDENTRY	1
+#define SB_NFS_READ		6
+#define SB_NFS_FHSIZE		32
+#define SB_RPC_PROG_MISMATCH	2
+
+/**
+ * struct sb_nfs_server - state of the fake NFS server
+ *
+ * @uts: Test state, used by the ut_assert macros
+ * @v3_only: true to refuse NFSv2, so that the client uses NFSv3
+ * @size: Size of the file in bytes
+ * @max_read: Largest number of bytes to return for one READ
+ * @drop: READ to drop, counting from 1, 0 for none
+ * @reads: Number of READs received
+ * @max_xid: Highest transaction ID answered
+ * @drop_xid: Transaction ID of the READ dropped
+ * @resent: true if the dropped READ was sent again
+ */
+struct sb_nfs_server {
+	struct unit_test_state *uts;
+	bool v3_only;
+	uint size;
+	uint max_read;
+	uint drop;
+	uint reads;
+	uint max_xid;
+	uint drop_xid;
+	bool resent;
+};
+
+static u8 sb_nfs_byte(uint offset)
+{
+	return offset * 3 + offset / 1000;
+}
+
+/*
+ * Reply to the RPC call in @packet, given the accept status and the @count
+ * words of the result, followed by @len bytes of the file from @offset
+ */
+static void sb_nfs_reply(struct udevice *dev, void *packet, uint xid,
+			 uint astatus, const u32 *words, int count,
+			 uint offset, uint len)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 buf[(6 + 32) * 4 + 1024];
+	u8 *p = buf;
+	uint i;
+
+	put_unaligned_be32(xid, p);
+	put_unaligned_be32(1, p + 4);		/* MSG_REPLY */
+	put_unaligned_be32(0, p + 8);		/* MSG_ACCEPTED */
+	put_unaligned_be32(0, p + 12);		/* AUTH_NONE verifier */
+	put_unaligned_be32(0, p + 16);
+	put_unaligned_be32(astatus, p + 20);
+	for (i = 0, p += 24; i < count; i++, p += 4)
+		put_unaligned_be32(words[i], p);
+	for (i = 0; i < len; i++)
+		*p++ = sb_nfs_byte(offset + i);
+	for (; (p - buf) & 3; p++)
+		*p = 0;
+	sb_udp_reply(dev, packet, ntohs(ip->udp_dst), buf, p - buf);
+}
+
+static int sb_nfs_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 *call = (u8 *)ip + IP_UDP_HDR_SIZE;
+	/* Used by all of the ut_assert macros */
+	struct unit_test_state *uts = srv->uts;
+	uint xid, prog, vers, proc, offset, count;
+	u32 words[32] = { 0 };
+	u8 *args;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	ut_asserteq(0, get_unaligned_be32(call + 4));	/* MSG_CALL */
+	xid = get_unaligned_be32(call);
+	prog = get_unaligned_be32(call + 12);
+	vers = get_unaligned_be32(call + 16);
+	proc = get_unaligned_be32(call + 20);
+	/* The portmapper call has empty credentials, the others AUTH_UNIX */
+	args = call + (prog == SB_PROG_PORTMAP ? 40 : 60);
+
+	switch (prog) {
+	case SB_PROG_PORTMAP:
+		words[0] = SB_NFS_PORT;
+		sb_nfs_reply(dev, packet, xid, 0, words, 1, 0, 0);
+		break;
+	case SB_PROG_MOUNT:
+		/* A zero status and file handle, or nothing for UMOUNTALL */
+		sb_nfs_reply(dev, packet, xid, 0, words,
+			     proc == SB_MOUNT_ADDENTRY ? 9 : 0, 0, 0);
+		break;
+	case SB_PROG_NFS:
+		if (vers == 2 && srv->v3_only) {
+			words[0] = 3;
+			words[1] = 3;
+			sb_nfs_reply(dev, packet, xid, SB_RPC_PROG_MISMATCH,
+				     words, 2, 0, 0);
+		} else if (proc != SB_NFS_READ) {
+			/* LOOKUP: a zero status and file handle */
+			if (vers == 3)
+				words[1] = SB_NFS_FHSIZE;
+			sb_nfs_reply(dev, packet, xid, 0, words,
+				     vers == 3 ? 11 : 26, 0, 0);
+		} else {
+			/*
+			 * Ignore READs sent again which were answered already,
+			 * so the replies fit in the receive queue
+			 */
+			if (xid == srv->drop_xid)
+				srv->resent = true;
+			else if (xid <= srv->max_xid)
+				break;
+			srv->max_xid = max(srv->max_xid, xid);
+
+			/* Drop a reply, then skip ahead to its timeout */
+			if (++srv->reads == srv->drop) {
+				srv->drop_xid = xid;
+				sandbox_eth_skip_timeout();
+				break;
+			}
+			if (vers == 3)
+				args += 4 + SB_NFS_FHSIZE + 4;
+			else
+				args += SB_NFS_FHSIZE;
+			offset = get_unaligned_be32(args);
+			count = get_unaligned_be32(args + 4);
+			offset = min(offset, srv->size);
+			count = min3(count, srv->max_read, srv->size - offset);
+			if (vers == 3) {
+				/* No attributes, then count and EOF */
+				words[2] = count;
+				words[3] = offset + count == srv->size;
+				words[4] = count;
+				sb_nfs_reply(dev, packet, xid, 0, words, 5,
+					     offset, count);
+			} else {
+				/* Attributes, then count */
+				words[18] = count;
+				sb_nfs_reply(dev, packet, xid, 0, words, 19,
+					     offset, count);
+			}
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_nfs_check(struct unit_test_state *uts,
+			struct sb_nfs_server *srv)
+{
+	ulong addr = 0x1000000;
+	u8 *buf;
+	uint i;
+
+	srv->uts = uts;
+	srv->reads = 0;
+	srv->max_xid = 0;
+	srv->drop_xid = 0;
+	srv->resent = false;
+	sandbox_eth_set_tx_handler(0, sb_nfs_handler);
+	sandbox_eth_set_priv(0, srv);
+
+	buf = map_sysmem(addr, srv->size);
+	memset(buf, '\0', srv->size);
+	ut_assertok(run_command("nfs 1000000 1.1.2.2:/export/test.bin", 0));
+	ut_asserteq(srv->size, env_get_hex("filesize", 0));
+	for (i = 0; i < srv->size; i++)
+		ut_asserteq(sb_nfs_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+
+static int _dm_test_eth_nfs(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.size = 20 * 1024 + 100,
+		.max_read = 1024,
+	};
+
+	ut_assertok(sb_nfs_check(uts, &srv));
+
+	/* A lost reply is requested again, with the same ID, after a timeout */
+	srv.drop = 5;
+	ut_assertok(sb_nfs_check(uts, &srv));
+	ut_assert(srv.resent);
+
+	/* NFSv3, where the server sends less than we ask for */
+	srv.drop = 0;
+	srv.v3_only = true;
+	srv.max_read = 700;
+	ut_assertok(sb_nfs_check(uts, &srv));
+
+	/* A file which is a multiple of the read size */
+	srv.size = 8 * 700;
+	ut_assertok(sb_nfs_check(uts, &srv));
+
+	return 0;
+}
+
+static int dm_test_eth_nfs(struct unit_test_state *uts)
+{
+	int retval;
+
+	env_set("ethact", "eth@10002000");
+
+	retval = _dm_test_eth_nfs(uts);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return retval;
+}
+
+DM_TEST(dm_test_eth_nfs, DM_TESTF_SCAN_FDT);
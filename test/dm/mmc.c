@@ -5,7 +5,9 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -41,3 +43,77 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_CMDQ)
+/* Test block transfers using eMMC command queuing */
+static int dm_test_mmc_cmdq(struct unit_test_state *uts)
+{
+	uint tags[256], starts[256], seen[2048 / 16];
+	struct mmc_cmdq_stats *stats, old;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u32 *buf;
+	uint i, count;
+
+	ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, 3, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(16, mmc->cmdq_depth);
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &dev_desc));
+	ut_asserteq(2048, dev_desc->lba);
+
+	/* Ignore any reads made while probing, e.g. for the partition table */
+	stats = &mmc->cmdq_stats;
+	old = *stats;
+	sandbox_mmc_get_cqe_log(dev, tags, starts, ARRAY_SIZE(tags));
+
+	/* Each block holds its own block number */
+	buf = malloc(2048 * 512);
+	ut_assertnonnull(buf);
+	ut_asserteq(2048, blk_dread(dev_desc, 0, 2048, buf));
+	for (i = 0; i < 2048 * 512 / 4; i++)
+		ut_asserteq(i / 128, buf[i]);
+
+	ut_asserteq(2048 / 16, stats->tasks - old.tasks);
+	ut_asserteq(2048, stats->blocks - old.blocks);
+	ut_asserteq(16, stats->max_queued);
+
+	/* The device runs the newest task first, so they finish out of order */
+	count = sandbox_mmc_get_cqe_log(dev, tags, starts, ARRAY_SIZE(tags));
+	ut_asserteq(2048 / 16, count);
+	ut_asserteq(15, tags[0]);
+	ut_asserteq(15 * 16, starts[0]);
+	memset(seen, '\0', sizeof(seen));
+	for (i = 0; i < count; i++) {
+		ut_assert(tags[i] < 16);
+		ut_asserteq(0, starts[i] % 16);
+		seen[starts[i] / 16]++;
+	}
+	for (i = 0; i < ARRAY_SIZE(seen); i++)
+		ut_asserteq(1, seen[i]);
+
+	/* Write some blocks and read them back */
+	for (i = 0; i < 40 * 512 / 4; i++)
+		buf[i] = 0x12345678 + i;
+	ut_asserteq(40, blk_dwrite(dev_desc, 100, 40, buf));
+	memset(buf, '\0', 40 * 512);
+	ut_asserteq(40, blk_dread(dev_desc, 100, 40, buf));
+	for (i = 0; i < 40 * 512 / 4; i++)
+		ut_asserteq(0x12345678 + i, buf[i]);
+	count = sandbox_mmc_get_cqe_log(dev, tags, starts, ARRAY_SIZE(tags));
+	ut_asserteq(6, count);
+
+	/* Setting the device up again leaves command queuing until needed */
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_assert(!mmc->cmdq_en);
+	ut_asserteq(16, mmc->cmdq_depth);
+	ut_asserteq(1, blk_dread(dev_desc, 2047, 1, buf));
+	ut_asserteq(2047, buf[0]);
+	ut_assert(mmc->cmdq_en);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cmdq, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
@@ -2,10 +2,15 @@
 
 #include <common.h>
 #include <dm.h>
+#include <fdt_index.h>
+#include <malloc.h>
+#include <dm/of_access.h>
 #include <dm/of_extra.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static int dm_test_ofnode_compatible(struct unit_test_state *uts)
 {
 	ofnode root_node = ofnode_path("/");
@@ -58,3 +63,199 @@ static int dm_test_ofnode_fmap(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_ofnode_fmap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/*
+ * Phandles for the nodes in the tree built by the phandle test. Six nodes
+ * have a phandle, so the table has 16 slots. All but the first start their
+ * probe in a slot which is already used, the second wraps around to the
+ * start of the table and the last repeats the second's phandle.
+ */
+static const u32 ofnode_phandles[] = { 15, 31, 47, 1, 0x10002, 0, 31 };
+
+static int ofnode_phandle_check(struct unit_test_state *uts,
+				struct device_node *nodes)
+{
+	int count = ARRAY_SIZE(ofnode_phandles);
+	int i;
+
+	/* A root node with the others as its children */
+	for (i = 1; i <= count; i++) {
+		nodes[i].name = "node";
+		nodes[i].parent = nodes;
+		nodes[i].sibling = i < count ? &nodes[i + 1] : NULL;
+		nodes[i].phandle = ofnode_phandles[i - 1];
+	}
+	nodes[0].child = &nodes[1];
+	gd->of_root = nodes;
+
+	ut_assertok(of_phandle_cache_build(nodes));
+	for (i = 1; i <= 5; i++)
+		ut_asserteq_ptr(&nodes[i],
+				of_find_node_by_phandle(nodes[i].phandle));
+
+	/* The first node with a phandle wins, as with a walk of the tree */
+	ut_asserteq_ptr(&nodes[2], of_find_node_by_phandle(31));
+
+	/* Phandles which are not in the tree, with and without a probe */
+	ut_assertnull(of_find_node_by_phandle(0));
+	ut_assertnull(of_find_node_by_phandle(3));
+	ut_assertnull(of_find_node_by_phandle(8));
+	ut_assertnull(of_find_node_by_phandle(0x10000));
+
+	/* A node which gains a phandle is still found */
+	nodes[6].phandle = 0x23456789;
+	ut_asserteq_ptr(&nodes[6], of_find_node_by_phandle(0x23456789));
+
+	/* The table is not used for another tree */
+	gd->of_root = NULL;
+	ut_assertnull(of_find_node_by_phandle(15));
+	gd->of_root = nodes;
+
+	/* Without the table, the tree is searched */
+	ut_assertok(of_phandle_cache_build(NULL));
+	for (i = 1; i <= 6; i++)
+		ut_asserteq_ptr(&nodes[i],
+				of_find_node_by_phandle(nodes[i].phandle));
+	ut_asserteq_ptr(&nodes[2], of_find_node_by_phandle(31));
+
+	return 0;
+}
+
+static int dm_test_ofnode_phandle_cache(struct unit_test_state *uts)
+{
+	struct device_node *root = gd->of_root, *np, *nodes;
+	int ret;
+
+	/* Every node in the normal tree is found from its phandle */
+	for_each_of_allnodes(np) {
+		if (np->phandle)
+			ut_asserteq_ptr(np,
+					of_find_node_by_phandle(np->phandle));
+	}
+
+	nodes = calloc(ARRAY_SIZE(ofnode_phandles) + 1, sizeof(*nodes));
+	ut_assertnonnull(nodes);
+	ret = ofnode_phandle_check(uts, nodes);
+	gd->of_root = root;
+	ut_assertok(of_phandle_cache_build(root));
+	free(nodes);
+
+	return ret;
+}
+DM_TEST(dm_test_ofnode_phandle_cache, DM_TESTF_SCAN_FDT | DM_TESTF_LIVE_TREE);
+
+#if CONFIG_IS_ENABLED(OF_FLAT_INDEX)
+/* Check that the tables are rebuilt when the control FDT changes */
+static int ofnode_flat_index_change(struct unit_test_state *uts, void *copy)
+{
+	static const char compat[] = "u-boot,index-test\0u-boot,index-b";
+	static const char joined[] = "u-boot,index-test-u-boot,index-b";
+	u32 phandle;
+	int node;
+
+	/* The tables are built for a new control FDT */
+	gd->fdt_blob = copy;
+	node = fdt_path_offset(copy, "/cros-ec/flash");
+	ut_assert(node > 0);
+	ut_asserteq(node, fdt_index_path_offset(copy, "/cros-ec/flash"));
+
+	/* A new node is found once the tree has grown */
+	ut_assertok(fdt_find_max_phandle(copy, &phandle));
+	phandle++;
+	node = fdt_add_subnode(copy, 0, "index-test");
+	ut_assert(node > 0);
+	ut_assertok(fdt_setprop(copy, node, "compatible", compat,
+				sizeof(compat)));
+	ut_assertok(fdt_setprop_u32(copy, node, "phandle", phandle));
+	ut_asserteq(node, fdt_index_node_by_compatible(copy, -1,
+						       "u-boot,index-test"));
+	ut_asserteq(node, fdt_index_node_by_phandle(copy, phandle));
+
+	/* A phandle changed in place is not found at its old value */
+	ut_assertok(fdt_setprop_inplace_u32(copy, node, "phandle",
+					    phandle + 1));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_by_phandle(copy, phandle));
+	ut_asserteq(node, fdt_index_node_by_phandle(copy, phandle + 1));
+
+	/* A compatible string changed in place is not found at its old value */
+	ut_asserteq(node, fdt_index_node_by_compatible(copy, -1,
+						       "u-boot,index-b"));
+	ut_assertok(fdt_setprop_inplace(copy, node, "compatible", joined,
+					sizeof(joined)));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_by_compatible(copy, -1, "u-boot,index-b"));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_by_compatible(copy, -1,
+						 "u-boot,index-test"));
+
+	return 0;
+}
+
+/* Check that the flat-tree tables give the same answers as libfdt */
+static int dm_test_ofnode_flat_index(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	int node, prop, len, ret, count = 0;
+	const char *compat, *name;
+	u32 phandle;
+	ofnode onode;
+	void *copy;
+
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle) {
+			ut_asserteq(node,
+				    fdt_index_node_by_phandle(blob, phandle));
+			onode = ofnode_get_by_phandle(phandle);
+			ut_asserteq(node, ofnode_to_offset(onode));
+		}
+
+		/* Follow the chain for the node's first compatible string */
+		compat = fdt_getprop(blob, node, "compatible", &len);
+		if (!compat)
+			continue;
+		prop = -1;
+		do {
+			ret = fdt_node_offset_by_compatible(blob, prop, compat);
+			prop = fdt_index_node_by_compatible(blob, prop, compat);
+			ut_asserteq(ret, prop);
+			count++;
+		} while (prop >= 0);
+
+		ut_asserteq(fdt_node_offset_by_compatible(blob, node, compat),
+			    fdt_index_node_by_compatible(blob, node, compat));
+	}
+	ut_assert(count > 0);
+
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_index_node_by_phandle(blob, 0x7fff));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_by_compatible(blob, -1, "not,there"));
+
+	/* Aliases and the nodes which are kept */
+	node = fdt_path_offset(blob, "/aliases");
+	fdt_for_each_property_offset(prop, blob, node) {
+		fdt_getprop_by_offset(blob, prop, &name, NULL);
+		ut_asserteq(fdt_path_offset(blob, name),
+			    fdt_index_path_offset(blob, name));
+	}
+	ut_asserteq(-FDT_ERR_BADPATH, fdt_index_path_offset(blob, "nothere"));
+	ut_asserteq(node, fdt_index_path_offset(blob, "/aliases"));
+	ut_asserteq(fdt_path_offset(blob, "/chosen"),
+		    fdt_index_path_offset(blob, "/chosen"));
+	ut_asserteq(fdt_path_offset(blob, "/cros-ec/flash"),
+		    fdt_index_path_offset(blob, "/cros-ec/flash"));
+
+	len = fdt_totalsize(blob) + 0x100;
+	copy = malloc(len);
+	ut_assertnonnull(copy);
+	ut_assertok(fdt_open_into(blob, copy, len));
+	ret = ofnode_flat_index_change(uts, copy);
+	gd->fdt_blob = blob;
+	fdt_index_drop();
+	free(copy);
+
+	return ret;
+}
+DM_TEST(dm_test_ofnode_flat_index, DM_TESTF_SCAN_FDT | DM_TESTF_FLAT_TREE);
+#endif
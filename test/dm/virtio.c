@@ -4,10 +4,13 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <dm/root.h>
@@ -71,7 +74,8 @@ static int dm_test_virtio_all_ops(struct unit_test_state *uts)
 	ut_assertok(virtio_get_status(dev, &status));
 	ut_asserteq(0, status);
 	ut_assertok(virtio_get_features(dev, &features));
-	ut_asserteq(VIRTIO_F_VERSION_1, features);
+	ut_asserteq(VIRTIO_F_VERSION_1 | BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC),
+		    features);
 	ut_assertok(virtio_set_features(dev));
 	ut_assertok(virtio_find_vqs(dev, nvqs, vqs));
 	ut_assertok(virtio_del_vqs(dev));
@@ -120,3 +124,116 @@ static int dm_test_virtio_remove(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_virtio_remove, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#define VIRTIO_BLK_TEST_CHUNK	32
+#define VIRTIO_BLK_TEST_REQS	20
+
+/* Read @count chunks, one at a time or all at once */
+static int virtio_blk_test_read(struct udevice *dev, struct blk_req *req,
+				int count, char *buf, bool batch)
+{
+	int i;
+
+	blkcache_invalidate(IF_TYPE_VIRTIO, 0);
+	for (i = 0; i < count; i++) {
+		memset(&req[i], '\0', sizeof(req[i]));
+		req[i].dev = dev;
+		req[i].op = BLK_REQ_READ;
+		req[i].start = i * VIRTIO_BLK_TEST_CHUNK;
+		req[i].blkcnt = VIRTIO_BLK_TEST_CHUNK;
+		req[i].buffer = buf + i * VIRTIO_BLK_TEST_CHUNK * 512;
+		if (blk_submit(&req[i]))
+			return -EIO;
+		if (!batch && blk_wait(&req[i]) != VIRTIO_BLK_TEST_CHUNK)
+			return -EIO;
+	}
+	if (batch && blk_wait(&req[count - 1]) != VIRTIO_BLK_TEST_CHUNK)
+		return -EIO;
+
+	return 0;
+}
+
+/* Test block I/O with the emulated device, comparing batched and single I/O */
+static int dm_test_virtio_blk(struct unit_test_state *uts)
+{
+	uint base, notifies, reqs, indirect, count, i;
+	struct udevice *bus, *dev;
+	struct blk_desc *desc;
+	struct blk_req *req;
+	char *disk, *buf;
+
+	ut_assertok(uclass_first_device(UCLASS_VIRTIO, &bus));
+	ut_assertok(blk_get_device(IF_TYPE_VIRTIO, 0, &dev));
+	desc = dev_get_uclass_platdata(dev);
+	ut_asserteq(512, desc->blksz);
+	count = desc->lba / VIRTIO_BLK_TEST_CHUNK;
+	disk = malloc(desc->lba * 512);
+	ut_assertnonnull(disk);
+	buf = malloc(desc->lba * 512);
+	ut_assertnonnull(buf);
+	req = calloc(count, sizeof(*req));
+	ut_assertnonnull(req);
+
+	/* Each request takes one entry in the ring and one notification */
+	sandbox_virtio_blk_get_stats(bus, &base, &reqs, &indirect);
+	for (i = 0; i < desc->lba * 512; i++)
+		disk[i] = i / 512 + i;
+	ut_asserteq(desc->lba, blk_dwrite(desc, 0, desc->lba, disk));
+	blkcache_invalidate(IF_TYPE_VIRTIO, 0);
+	ut_asserteq(16, blk_dread(desc, 100, 16, buf));
+	ut_asserteq_mem(disk + 100 * 512, buf, 16 * 512);
+	sandbox_virtio_blk_get_stats(bus, &notifies, &reqs, &indirect);
+	ut_asserteq(base + 2, notifies);
+	ut_asserteq(base + 2, reqs);
+	ut_asserteq(base + 2, indirect);
+
+	/*
+	 * Requests are not sent until polled, then the ring is filled. Running
+	 * out of room sends what is there, so 20 requests need three
+	 * notifications.
+	 */
+	memset(buf, '\0', desc->lba * 512);
+	for (i = 0; i < VIRTIO_BLK_TEST_REQS; i++) {
+		req[i].dev = dev;
+		req[i].op = BLK_REQ_READ;
+		req[i].start = i * 3;
+		req[i].blkcnt = 3;
+		req[i].buffer = buf + i * 3 * 512;
+		ut_assertok(blk_submit(&req[i]));
+	}
+	sandbox_virtio_blk_get_stats(bus, &notifies, &reqs, &indirect);
+	ut_asserteq(base + 3, notifies);
+	ut_asserteq(base + 2 + 16, reqs);
+	ut_asserteq(3, blk_wait(&req[VIRTIO_BLK_TEST_REQS - 1]));
+	for (i = 0; i < VIRTIO_BLK_TEST_REQS; i++)
+		ut_asserteq(3, req[i].result);
+	ut_asserteq_mem(disk, buf, VIRTIO_BLK_TEST_REQS * 3 * 512);
+	sandbox_virtio_blk_get_stats(bus, &notifies, &reqs, &indirect);
+	ut_asserteq(base + 5, notifies);
+	ut_asserteq(base + 2 + VIRTIO_BLK_TEST_REQS, reqs);
+	ut_asserteq(reqs, indirect);
+
+	/* Read the whole device with one request at a time, then in batches */
+	ut_asserteq(128, count);
+	ut_assertok(virtio_blk_test_read(dev, req, count, buf, false));
+	ut_asserteq_mem(disk, buf, desc->lba * 512);
+	sandbox_virtio_blk_get_stats(bus, &notifies, &reqs, &indirect);
+	ut_asserteq(base + 5 + count, notifies);
+	ut_asserteq(base + 2 + VIRTIO_BLK_TEST_REQS + count, reqs);
+
+	memset(buf, '\0', desc->lba * 512);
+	ut_assertok(virtio_blk_test_read(dev, req, count, buf, true));
+	ut_asserteq_mem(disk, buf, desc->lba * 512);
+	sandbox_virtio_blk_get_stats(bus, &notifies, &reqs, &indirect);
+	/* The 128 requests need 15 notifications, rather than one each */
+	ut_asserteq(base + 5 + count + 15, notifies);
+	ut_asserteq(base + 2 + VIRTIO_BLK_TEST_REQS + count * 2, reqs);
+	ut_asserteq(reqs, indirect);
+
+	free(req);
+	free(buf);
+	free(disk);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -123,3 +123,134 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Grow the table well past its initial size and check the export order */
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	char key[20], *res = NULL, *p, *prev, *eq;
+	int i, idx, lines;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(SIZE, &htab));
+
+	/* Add keys in reverse order, deleting every third one */
+	for (i = ITERATIONS - 1; i >= 0; i--) {
+		sprintf(key, "var%d", i);
+		item.callback = NULL;
+		item.flags = 0;
+		item.data = key;
+		item.key = key;
+		ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+		if (!(i % 3))
+			ut_asserteq(1, hdelete_r(key, &htab, 0));
+	}
+	ut_asserteq(ITERATIONS - (ITERATIONS + 2) / 3, htab.filled);
+	ut_assert(htab.size > ITERATIONS - ITERATIONS / 3);
+
+	for (i = 0; i < ITERATIONS; i++) {
+		sprintf(key, "var%d", i);
+		item.key = key;
+		hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+		if (i % 3) {
+			ut_assertnonnull(ritem);
+			ut_asserteq_str(key, ritem->data);
+		} else {
+			ut_assertnull(ritem);
+		}
+	}
+
+	/* Each entry should be exported once, in order of key */
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	for (prev = NULL, p = res, lines = 0; *p; p = strchr(eq, '\n') + 1) {
+		eq = strchr(p, '=');
+		ut_assertnonnull(eq);
+		*eq++ = '\0';
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+		lines++;
+	}
+	ut_asserteq(htab.filled, lines);
+	free(res);
+
+	/* Walk through the entries in the order they were added */
+	for (idx = 0, lines = 0; (idx = hmatch_r("var", idx, &ritem, &htab));)
+		lines++;
+	ut_asserteq(htab.filled, lines);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_grow, 0);
+
+/* Report the time taken to add, look up and export many variables */
+static int env_test_htab_bench(struct unit_test_state *uts)
+{
+	static const int sizes[] = { 1000, 5000, 10000, 50000 };
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	ulong insert, lookup, export, reexport, start;
+	char key[20], *res;
+	int i, s, n;
+
+	printf("%8s %10s %10s %10s %10s\n", "vars", "insert us", "lookup us",
+	       "export us", "again us");
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		n = sizes[s];
+		memset(&htab, 0, sizeof(htab));
+		ut_asserteq(1, hcreate_r(SIZE, &htab));
+
+		item.callback = NULL;
+		item.flags = 0;
+		start = timer_get_us();
+		for (i = 0; i < n; i++) {
+			sprintf(key, "bootcount_%d", i);
+			item.data = key;
+			item.key = key;
+			ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab,
+						 0));
+		}
+		insert = timer_get_us() - start;
+
+		start = timer_get_us();
+		for (i = 0; i < n; i++) {
+			sprintf(key, "bootcount_%d", i);
+			item.key = key;
+			ut_assert(hsearch_r(item, ENV_FIND, &ritem, &htab, 0));
+		}
+		lookup = timer_get_us() - start;
+
+		res = NULL;
+		start = timer_get_us();
+		ut_assert(hexport_r(&htab, '\0', 0, &res, 0, 0, NULL) > 0);
+		export = timer_get_us() - start;
+		free(res);
+
+		/* Export again after a few changes, as saveenv might */
+		for (i = 0; i < 10; i++) {
+			sprintf(key, "counter_%d", i);
+			item.data = key;
+			item.key = key;
+			ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab,
+						 0));
+		}
+		res = NULL;
+		start = timer_get_us();
+		ut_assert(hexport_r(&htab, '\0', 0, &res, 0, 0, NULL) > 0);
+		reexport = timer_get_us() - start;
+		free(res);
+
+		printf("%8d %10lu %10lu %10lu %10lu\n", n, insert, lookup,
+		       export, reexport);
+		hdestroy_r(&htab);
+	}
+
+	return 0;
+}
+
+ENV_TEST(env_test_htab_bench, 0);
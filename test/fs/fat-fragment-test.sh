@@ -0,0 +1,121 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0+
+
+# This script measures how U-Boot's FAT filesystem code performs when reading
+# badly fragmented files.
+#
+# U-Boot keeps several pieces of the File Allocation Table in memory (see
+# CONFIG_FS_FAT_CACHE_SIZE) and reads each run of contiguous clusters with a
+# single request. This test creates two files whose clusters are interleaved
+# on the disk, so that following their cluster chains means jumping around the
+# disk and the FAT. It then loads one of them to an aligned and a misaligned
+# address, checks the CRCs and prints the number of reads made from the
+# backing file along with the time taken.
+#
+# To execute the test, simply run it from the U-Boot source root directory:
+#
+#    cd u-boot
+#    ./test/fs/fat-fragment-test.sh
+#
+# The important parts of the log are the two lines that contain either "PASS"
+# or "FAILURE", and the read counts printed by 'host info' after each load.
+# The second count includes the reads made by the first load.
+#
+# All temporary files used by this script are created in ./sandbox to avoid
+# polluting the source tree. test/fs/fs-test.sh also uses this directory for
+# the same purpose.
+
+odir=sandbox
+img=${odir}/fat-fragment.img
+mnt=${odir}/mnt
+fill=/dev/urandom
+testfn=fragment.img
+otherfn=other.img
+mnttestfn=${mnt}/${testfn}
+crcaddr=0
+loadaddr=1000
+
+for prereq in fallocate mkfs.fat dd crc32; do
+    if [ ! -x "`which $prereq`" ]; then
+        echo "Missing $prereq binary. Exiting!"
+        exit 1
+    fi
+done
+
+make O=${odir} -s sandbox_defconfig && make O=${odir} -s -j8
+
+mkdir -p ${mnt}
+if [ ! -f ${img} ]; then
+    fallocate -l 40M ${img}
+    if [ $? -ne 0 ]; then
+        echo fallocate failed - using dd instead
+        dd if=/dev/zero of=${img} bs=1024 count=$((40 * 1024))
+        if [ $? -ne 0 ]; then
+            echo Could not create empty disk image
+            exit $?
+        fi
+    fi
+    # Small clusters give long cluster chains and a large FAT
+    mkfs.fat -F 32 -s 1 ${img}
+    if [ $? -ne 0 ]; then
+        echo Could not create FAT filesystem
+        exit $?
+    fi
+
+    sudo mount -o loop,uid=$(id -u),sync ${img} ${mnt}
+    if [ $? -ne 0 ]; then
+        echo Could not mount test filesystem
+        exit $?
+    fi
+
+    # Grow both files a few sectors at a time, so that their clusters are
+    # interleaved. 'sync' makes sure each piece is allocated as it is written.
+    for ((i = 0; i < 2048; i++)); do
+        sects=$((1 + (i * 7) % 13))
+        dd if=${fill} of=${mnttestfn} bs=512 count=${sects} \
+            oflag=append conv=notrunc >/dev/null 2>&1
+        dd if=${fill} of=${mnt}/${otherfn} bs=512 count=$((14 - sects)) \
+            oflag=append conv=notrunc >/dev/null 2>&1
+    done
+
+    sudo umount ${mnt}
+    if [ $? -ne 0 ]; then
+        echo Could not unmount test filesystem
+        exit $?
+    fi
+fi
+
+sudo mount -o ro,loop,uid=$(id -u) ${img} ${mnt}
+if [ $? -ne 0 ]; then
+    echo Could not mount test filesystem
+    exit $?
+fi
+crc=0x`crc32 ${mnttestfn}`
+sudo umount ${mnt}
+if [ $? -ne 0 ]; then
+    echo Could not unmount test filesystem
+    exit $?
+fi
+
+crc=`printf %02x%02x%02x%02x \
+    $((${crc} & 0xff)) \
+    $(((${crc} >> 8) & 0xff)) \
+    $(((${crc} >> 16) & 0xff)) \
+    $((${crc} >> 24))`
+
+./sandbox/u-boot << EOF
+host bind 0 ${img}
+load host 0:0 ${loadaddr} ${testfn}
+crc32 ${loadaddr} \$filesize ${crcaddr}
+if itest.l *${crcaddr} != ${crc}; then echo FAILURE; else echo PASS; fi
+host info 0
+load host 0:0 $((loadaddr + 1)) ${testfn}
+crc32 $((loadaddr + 1)) \$filesize ${crcaddr}
+if itest.l *${crcaddr} != ${crc}; then echo FAILURE; else echo PASS; fi
+host info 0
+reset
+EOF
+if [ $? -ne 0 ]; then
+    echo U-Boot exit status indicates an error
+    exit $?
+fi
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the CRC32 and CRC32C implementations
+ *
+ * The slice-by-8 implementations process aligned 8-byte blocks and fall back
+ * to the byte-at-a-time versions for short buffers and for any unaligned
+ * head and tail. Both are checked against each other with varied alignment
+ * and length.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Bit-reflected CRC32C (Castagnoli) polynomial */
+#define CRC32C_POLY 0x82f63b78
+/* Number of different alignment values */
+#define SWEEP 8
+/* Longest buffer compared between implementations */
+#define MAXLEN 300
+/* Buffer size used for throughput measurement */
+#define PERF_LEN (1 << 20)
+/* Number of times the buffer is checksummed for throughput measurement */
+#define PERF_LOOPS 16
+
+static const char check_str[] = "123456789";
+
+/**
+ * init_buffer() - fill a buffer with a pseudo-random pattern
+ *
+ * @buf:	buffer
+ * @len:	length of buffer
+ */
+static void init_buffer(u8 *buf, int len)
+{
+	u32 seed = 0x12345678;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+}
+
+/**
+ * lib_crc32() - unit test for crc32()
+ *
+ * Check the standard check value and compare crc32_no_comp() with the
+ * byte-at-a-time version for varied alignment and length.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_crc32(struct unit_test_state *uts)
+{
+	u8 buf[MAXLEN + SWEEP];
+	int offset, len;
+
+	ut_asserteq(0xcbf43926, crc32(0, (u8 *)check_str, strlen(check_str)));
+
+	init_buffer(buf, sizeof(buf));
+	for (offset = 0; offset < SWEEP; offset++) {
+		for (len = 0; len <= MAXLEN; len++) {
+			ut_asserteq(crc32_no_comp_bytewise(~0, buf + offset,
+							   len),
+				    crc32_no_comp(~0, buf + offset, len));
+		}
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32, 0);
+
+#ifdef CONFIG_CRC32C
+/**
+ * lib_crc32c() - unit test for crc32c_cal()
+ *
+ * Check the standard check value and compare crc32c_cal() with the
+ * byte-at-a-time version for varied alignment and length.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_crc32c(struct unit_test_state *uts)
+{
+	u32 *table;
+	u8 buf[MAXLEN + SWEEP];
+	int offset, len;
+
+	table = malloc(CRC32C_TABLE_SIZE * sizeof(u32));
+	ut_assertnonnull(table);
+	crc32c_init(table, CRC32C_POLY);
+
+	ut_asserteq(0xe3069283, ~crc32c_cal(~0, check_str, strlen(check_str),
+					    table));
+
+	init_buffer(buf, sizeof(buf));
+	for (offset = 0; offset < SWEEP; offset++) {
+		for (len = 0; len <= MAXLEN; len++) {
+			ut_asserteq(crc32c_cal_bytewise(~0,
+							(char *)buf + offset,
+							len, table),
+				    crc32c_cal(~0, (char *)buf + offset, len,
+					       table));
+		}
+	}
+	free(table);
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32c, 0);
+#endif
+
+/**
+ * lib_crc32_perf() - throughput of the CRC32 implementations
+ *
+ * Report the throughput in MB/s of the byte-at-a-time and the selected
+ * CRC32 and CRC32C implementations.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_crc32_perf(struct unit_test_state *uts)
+{
+	ulong start, byte_us, sel_us;
+	u32 byte_crc, sel_crc;
+	u32 __maybe_unused *table;
+	u8 *buf;
+	int i;
+
+	buf = malloc(PERF_LEN);
+	ut_assertnonnull(buf);
+	init_buffer(buf, PERF_LEN);
+
+	byte_crc = 0;
+	start = timer_get_us();
+	for (i = 0; i < PERF_LOOPS; i++)
+		byte_crc = crc32_no_comp_bytewise(byte_crc, buf, PERF_LEN);
+	byte_us = max(timer_get_us() - start, 1UL);
+
+	sel_crc = 0;
+	start = timer_get_us();
+	for (i = 0; i < PERF_LOOPS; i++)
+		sel_crc = crc32_no_comp(sel_crc, buf, PERF_LEN);
+	sel_us = max(timer_get_us() - start, 1UL);
+
+	ut_asserteq(byte_crc, sel_crc);
+	printf("crc32:  byte-wise %lu MB/s, %d-slice %lu MB/s\n",
+	       (ulong)PERF_LOOPS * PERF_LEN / byte_us, CRC32_SLICES,
+	       (ulong)PERF_LOOPS * PERF_LEN / sel_us);
+
+#ifdef CONFIG_CRC32C
+	table = malloc(CRC32C_TABLE_SIZE * sizeof(u32));
+	ut_assertnonnull(table);
+	crc32c_init(table, CRC32C_POLY);
+
+	byte_crc = 0;
+	start = timer_get_us();
+	for (i = 0; i < PERF_LOOPS; i++)
+		byte_crc = crc32c_cal_bytewise(byte_crc, (char *)buf,
+					       PERF_LEN, table);
+	byte_us = max(timer_get_us() - start, 1UL);
+
+	sel_crc = 0;
+	start = timer_get_us();
+	for (i = 0; i < PERF_LOOPS; i++)
+		sel_crc = crc32c_cal(sel_crc, (char *)buf, PERF_LEN, table);
+	sel_us = max(timer_get_us() - start, 1UL);
+
+	ut_asserteq(byte_crc, sel_crc);
+	printf("crc32c: byte-wise %lu MB/s, %d-slice %lu MB/s\n",
+	       (ulong)PERF_LOOPS * PERF_LEN / byte_us, CRC32_SLICES,
+	       (ulong)PERF_LOOPS * PERF_LEN / sel_us);
+	free(table);
+#endif
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32_perf, 0);
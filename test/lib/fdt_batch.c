@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for making device-tree fixups in a batch
+ */
+
+#include <common.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FDT_BATCH_TEST_NODES	8
+#define FDT_BATCH_TEST_SIZE	SZ_64K
+
+/* A large tree, where a batch should take much less time than libfdt */
+#define FDT_BATCH_COST_NODES	2000
+#define FDT_BATCH_COST_SIZE	SZ_1M
+
+/*
+ * Nesting of the nodes under /deep. Their paths are over 1KiB long, so a batch
+ * must not limit the depth or path length of the nodes it changes.
+ */
+#define FDT_BATCH_TEST_DEPTH	50
+
+/* Create a tree with @nodes devices and a deep chain of nodes */
+static int fdt_batch_test_create(struct unit_test_state *uts, void *buf,
+				 int size, int nodes)
+{
+	char name[30];
+	int i;
+
+	ut_assertok(fdt_create(buf, size));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+	ut_assertok(fdt_property_u32(buf, "#address-cells", 1));
+	ut_assertok(fdt_property_u32(buf, "#size-cells", 1));
+	ut_assertok(fdt_begin_node(buf, "deep"));
+	for (i = 0; i < FDT_BATCH_TEST_DEPTH; i++) {
+		snprintf(name, sizeof(name), "node-with-a-long-name-%d", i);
+		ut_assertok(fdt_begin_node(buf, name));
+		ut_assertok(fdt_property_u32(buf, "level", i));
+	}
+	for (i = 0; i <= FDT_BATCH_TEST_DEPTH; i++)
+		ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_begin_node(buf, "soc"));
+	ut_assertok(fdt_property_u32(buf, "#address-cells", 1));
+	ut_assertok(fdt_property_u32(buf, "#size-cells", 1));
+	for (i = 0; i < nodes; i++) {
+		u32 reg[2] = { cpu_to_fdt32(i << 12), cpu_to_fdt32(0x1000) };
+		const char *compat = i & 1 ? "vendor,dev-b" : "vendor,dev-a";
+
+		snprintf(name, sizeof(name), "dev@%x", i << 12);
+		ut_assertok(fdt_begin_node(buf, name));
+		ut_assertok(fdt_property_string(buf, "compatible", compat));
+		ut_assertok(fdt_property(buf, "reg", reg, sizeof(reg)));
+		ut_assertok(fdt_property_string(buf, "status", "okay"));
+		snprintf(name, sizeof(name), "dev%d", i);
+		ut_assertok(fdt_property_string(buf, "label", name));
+		ut_assertok(fdt_end_node(buf));
+	}
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+
+	return 0;
+}
+
+/*
+ * Make the same fixups to the tree, either directly or in @batch. Besides the
+ * fdt_support fixups, this removes properties and adds one back again, and
+ * changes the deepest node before moving on to later ones.
+ */
+static int fdt_batch_test_fixups(struct unit_test_state *uts, void *blob,
+				 int nodes, struct fdt_batch *batch)
+{
+	u64 start[] = { 0x10000000, 0x80000000 };
+	u64 size[] = { 0x20000000, 0x40000000 };
+	const u32 reg[2] = { cpu_to_fdt32(0x5000), cpu_to_fdt32(0x2000) };
+	const void *val;
+	int soc, node, sub, i, len;
+
+	if (batch)
+		fdt_batch_begin(batch, blob);
+	node = fdt_path_offset(blob, "/deep");
+	ut_assert(node >= 0);
+	for (i = 0; (sub = fdt_first_subnode(blob, node)) >= 0; i++)
+		node = sub;
+	ut_asserteq(FDT_BATCH_TEST_DEPTH, i);
+	ut_assertok(fdt_set_node_status(blob, node, FDT_STATUS_DISABLED, 0));
+	do_fixup_by_compat_u32(blob, "vendor,dev-a", "clock-frequency",
+			       1000000, 1);
+	do_fixup_by_compat(blob, "vendor,dev-b", "status", "disabled",
+			   sizeof("disabled"), 0);
+	ut_assertok(fdt_find_and_setprop(blob, "/soc", "dma-coherent", NULL, 0,
+					 1));
+	ut_assertok(fdt_fixup_memory_banks(blob, start, size, 2));
+
+	soc = fdt_path_offset(blob, "/soc");
+	ut_assert(soc >= 0);
+	i = 0;
+	fdt_for_each_subnode(node, blob, soc) {
+		if (!(i % 3)) {
+			ut_assertok(batch ?
+				    fdt_batch_delprop(batch, node, "label") :
+				    fdt_delprop(blob, node, "label"));
+		}
+		if (i == 5) {
+			/* Removing and adding back moves it to the start */
+			ut_assertok(batch ?
+				    fdt_batch_delprop(batch, node, "reg") :
+				    fdt_delprop(blob, node, "reg"));
+			ut_assertok(batch ?
+				    fdt_batch_setprop(batch, node, "reg", reg,
+						      sizeof(reg)) :
+				    fdt_setprop(blob, node, "reg", reg,
+						sizeof(reg)));
+			ut_assertok(fdt_set_node_status(blob, node,
+							FDT_STATUS_FAIL, 0));
+		}
+		i++;
+	}
+	ut_asserteq(nodes, i);
+
+	if (batch) {
+		/* The changes can be read back before they are made */
+		node = fdt_path_offset(blob, "/soc/dev@5000");
+		val = fdt_batch_getprop(batch, node, "status", &len);
+		ut_asserteq_str("fail", val);
+		node = fdt_path_offset(blob, "/soc/dev@6000");
+		ut_asserteq(-FDT_ERR_NOTFOUND,
+			    fdt_batch_delprop(batch, node, "label"));
+		ut_assertnull(fdt_batch_getprop(batch, node, "label", &len));
+		ut_asserteq(-FDT_ERR_NOTFOUND, len);
+		ut_assertnonnull(fdt_getprop(blob, node, "label", NULL));
+		ut_assertok(fdt_batch_commit(batch));
+		ut_assertnull(fdt_batch_active(blob));
+	}
+
+	return 0;
+}
+
+/* Check that two trees have the same nodes and properties, in order */
+static int fdt_batch_test_compare(struct unit_test_state *uts,
+				  const void *expect, const void *blob)
+{
+	int enode, node, edepth = 0, depth = 0, eprop, prop, elen, len;
+	const char *ename, *name;
+	const void *eval, *val;
+
+	/* Stop at the end of the root node, where the depth goes negative */
+	for (enode = 0, node = 0; enode >= 0 && edepth >= 0;
+	     enode = fdt_next_node(expect, enode, &edepth),
+	     node = fdt_next_node(blob, node, &depth)) {
+		ut_asserteq(edepth, depth);
+		ut_asserteq_str(fdt_get_name(expect, enode, NULL),
+				fdt_get_name(blob, node, NULL));
+
+		prop = fdt_first_property_offset(blob, node);
+		fdt_for_each_property_offset(eprop, expect, enode) {
+			ut_assert(prop >= 0);
+			eval = fdt_getprop_by_offset(expect, eprop, &ename,
+						     &elen);
+			val = fdt_getprop_by_offset(blob, prop, &name, &len);
+			ut_asserteq_str(ename, name);
+			ut_asserteq(elen, len);
+			ut_assertok(memcmp(eval, val, len));
+			prop = fdt_next_property_offset(blob, prop);
+		}
+		ut_asserteq(-FDT_ERR_NOTFOUND, prop);
+	}
+	ut_asserteq(enode, node);
+	ut_asserteq(edepth, depth);
+
+	return 0;
+}
+
+/* Check that a batch makes the same changes as making them directly */
+static int lib_fdt_batch(struct unit_test_state *uts)
+{
+	struct fdt_batch batch;
+	void *buf, *expect, *blob;
+
+	buf = malloc(FDT_BATCH_TEST_SIZE);
+	expect = malloc(FDT_BATCH_TEST_SIZE);
+	blob = malloc(FDT_BATCH_TEST_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(expect);
+	ut_assertnonnull(blob);
+	ut_assertok(fdt_batch_test_create(uts, buf, FDT_BATCH_TEST_SIZE,
+					  FDT_BATCH_TEST_NODES));
+	ut_assertok(fdt_open_into(buf, expect, FDT_BATCH_TEST_SIZE));
+	ut_assertok(fdt_open_into(buf, blob, FDT_BATCH_TEST_SIZE));
+
+	ut_assertok(fdt_batch_test_fixups(uts, expect, FDT_BATCH_TEST_NODES,
+					  NULL));
+	ut_assertok(fdt_batch_test_fixups(uts, blob, FDT_BATCH_TEST_NODES,
+					  &batch));
+	ut_assertok(fdt_check_header(blob));
+	ut_assertok(fdt_batch_test_compare(uts, expect, blob));
+
+	/* A tree without room for the changes is left as it was */
+	ut_assertok(fdt_open_into(buf, blob, fdt_totalsize(buf)));
+	fdt_batch_begin(&batch, blob);
+	ut_assertok(fdt_find_and_setprop(blob, "/soc", "dma-coherent", NULL, 0,
+					 1));
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_batch_commit(&batch));
+	ut_assertok(memcmp(buf, blob, fdt_totalsize(buf)));
+
+	free(blob);
+	free(expect);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_fdt_batch, 0);
+
+/*
+ * Check that a batch is faster than making the same fixups directly on a large
+ * tree. Direct changes take time proportional to the number of changes times
+ * the size of the tree, so allow for a noisy timer by asking for half the time.
+ */
+static int lib_fdt_batch_cost(struct unit_test_state *uts)
+{
+	struct fdt_batch batch;
+	void *buf, *expect, *blob;
+	ulong start, direct, batched;
+
+	buf = malloc(FDT_BATCH_COST_SIZE);
+	expect = malloc(FDT_BATCH_COST_SIZE);
+	blob = malloc(FDT_BATCH_COST_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(expect);
+	ut_assertnonnull(blob);
+	ut_assertok(fdt_batch_test_create(uts, buf, FDT_BATCH_COST_SIZE,
+					  FDT_BATCH_COST_NODES));
+	ut_assertok(fdt_open_into(buf, expect, FDT_BATCH_COST_SIZE));
+	ut_assertok(fdt_open_into(buf, blob, FDT_BATCH_COST_SIZE));
+
+	start = timer_get_us();
+	ut_assertok(fdt_batch_test_fixups(uts, expect, FDT_BATCH_COST_NODES,
+					  NULL));
+	direct = timer_get_us() - start;
+
+	start = timer_get_us();
+	ut_assertok(fdt_batch_test_fixups(uts, blob, FDT_BATCH_COST_NODES,
+					  &batch));
+	batched = timer_get_us() - start;
+
+	ut_assertok(fdt_batch_test_compare(uts, expect, blob));
+	debug("%d nodes: %lu us batched, %lu us direct\n",
+	      FDT_BATCH_COST_NODES, batched, direct);
+	ut_assert(batched * 2 < direct);
+
+	free(blob);
+	free(expect);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_fdt_batch_cost, 0);
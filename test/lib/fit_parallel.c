@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for checking FIT image hashes in parallel
+ */
+
+#include <common.h>
+#include <image.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FIT_SIZE	(200 << 10)
+#define DATA_SIZE	(40 << 10)
+#define IMAGE_COUNT	3
+
+static const char *const algos[] = { "sha256", "crc32", "sha1", "md5" };
+
+static int add_image(void *fit, int parent, const char *name, const u8 *data)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	char hash_name[20];
+	int value_len;
+	int node, hash;
+	int i;
+
+	node = fdt_add_subnode(fit, parent, name);
+	if (node < 0)
+		return node;
+	if (fdt_setprop(fit, node, FIT_DATA_PROP, data, DATA_SIZE))
+		return -ENOSPC;
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		if (calculate_hash(data, DATA_SIZE, algos[i], value,
+				   &value_len))
+			return -EINVAL;
+		snprintf(hash_name, sizeof(hash_name), "hash-%d", i + 1);
+		hash = fdt_add_subnode(fit, node, hash_name);
+		if (hash < 0)
+			return hash;
+		if (fdt_setprop_string(fit, hash, FIT_ALGO_PROP, algos[i]) ||
+		    fdt_setprop(fit, hash, FIT_VALUE_PROP, value, value_len))
+			return -ENOSPC;
+	}
+
+	return 0;
+}
+
+/* Check that hashes calculated by the job queue are checked correctly */
+static int lib_fit_parallel(struct unit_test_state *uts)
+{
+	char name[20];
+	int parent, node;
+	const void *data;
+	size_t size;
+	void *fit;
+	u8 *buf;
+	int i;
+
+	fit = malloc(FIT_SIZE);
+	buf = malloc(DATA_SIZE);
+	ut_assertnonnull(fit);
+	ut_assertnonnull(buf);
+
+	ut_assertok(fdt_create_empty_tree(fit, FIT_SIZE));
+	parent = fdt_add_subnode(fit, 0, "images");
+	ut_assert(parent >= 0);
+	for (i = 0; i < IMAGE_COUNT; i++) {
+		memset(buf, 'a' + i, DATA_SIZE);
+		buf[i] = i;
+		snprintf(name, sizeof(name), "image-%d", i + 1);
+		ut_assertok(add_image(fit, parent, name, buf));
+	}
+
+	/* All images at once, then one image with several hashes */
+	ut_asserteq(1, fit_all_image_verify(fit));
+	node = fdt_path_offset(fit, "/images/image-2");
+	ut_assert(node >= 0);
+	ut_asserteq(1, fit_image_verify(fit, node));
+
+	/* A bad byte in any image is caught */
+	for (i = 0; i < IMAGE_COUNT; i++) {
+		snprintf(name, sizeof(name), "/images/image-%d", i + 1);
+		node = fdt_path_offset(fit, name);
+		ut_assert(node >= 0);
+		ut_assertok(fit_image_get_data_and_size(fit, node, &data,
+							&size));
+		ut_asserteq(DATA_SIZE, size);
+		((u8 *)data)[size - 1] ^= 1;
+		ut_asserteq(0, fit_all_image_verify(fit));
+		ut_asserteq(0, fit_image_verify(fit, node));
+		((u8 *)data)[size - 1] ^= 1;
+	}
+	ut_asserteq(1, fit_all_image_verify(fit));
+
+	free(buf);
+	free(fit);
+
+	return 0;
+}
+LIB_TEST(lib_fit_parallel, 0);
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for hashing FIT images while loading them
+ */
+
+#include <common.h>
+#include <image.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FIT_SIZE	4096
+#define DATA_SIZE	(100 << 10)
+/* Size of the pieces fed to the hash, deliberately not a power of two */
+#define PIECE_SIZE	1000
+
+static int add_hash(void *fit, int node, const char *name, const char *algo,
+		    const void *data)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	int hash;
+
+	if (calculate_hash(data, DATA_SIZE, algo, value, &value_len))
+		return -EINVAL;
+	hash = fdt_add_subnode(fit, node, name);
+	if (hash < 0)
+		return hash;
+	if (fdt_setprop_string(fit, hash, FIT_ALGO_PROP, algo))
+		return -ENOSPC;
+
+	return fdt_setprop(fit, hash, FIT_VALUE_PROP, value, value_len);
+}
+
+static void hash_pieces(struct fit_hash_stream *stream, const u8 *data)
+{
+	int pos, len;
+
+	for (pos = 0; pos < DATA_SIZE; pos += len) {
+		len = min(PIECE_SIZE, DATA_SIZE - pos);
+		fit_image_hash_stream_update(stream, data + pos, len);
+	}
+}
+
+/* Check hashing an image a piece at a time */
+static int lib_fit_stream(struct unit_test_state *uts)
+{
+	struct fit_hash_stream stream;
+	u8 *data, *other;
+	void *fit;
+	int node, i;
+
+	fit = malloc(FIT_SIZE);
+	data = malloc(DATA_SIZE);
+	other = malloc(DATA_SIZE);
+	ut_assertnonnull(fit);
+	ut_assertnonnull(data);
+	ut_assertnonnull(other);
+	for (i = 0; i < DATA_SIZE; i++) {
+		data[i] = i * 13 + (i >> 10);
+		other[i] = ~data[i];
+	}
+
+	ut_assertok(fdt_create_empty_tree(fit, FIT_SIZE));
+	node = fdt_add_subnode(fit, 0, "images");
+	ut_assert(node >= 0);
+	node = fdt_add_subnode(fit, node, "kernel");
+	ut_assert(node >= 0);
+	ut_assertok(add_hash(fit, node, "hash-1", "sha256", data));
+	ut_assertok(add_hash(fit, node, "hash-2", "crc32", data));
+	ut_assertok(add_hash(fit, node, "hash-3", "md5", data));
+
+	/* MD5 is not supported, so is calculated when verifying */
+	ut_asserteq(2, fit_image_hash_stream_start(&stream, fit, node));
+	hash_pieces(&stream, data);
+	ut_asserteq(1, fit_image_verify_stream(&stream, data, DATA_SIZE));
+
+	/* Check that the streamed hashes are used, not the data passed in */
+	ut_asserteq(2, fit_image_hash_stream_start(&stream, fit, node));
+	hash_pieces(&stream, other);
+	ut_asserteq(0, fit_image_verify_stream(&stream, data, DATA_SIZE));
+
+	/* If not all the data was hashed, it is hashed again */
+	ut_asserteq(2, fit_image_hash_stream_start(&stream, fit, node));
+	fit_image_hash_stream_update(&stream, other, PIECE_SIZE);
+	ut_asserteq(1, fit_image_verify_stream(&stream, data, DATA_SIZE));
+
+	/* A bad image is still caught */
+	ut_asserteq(2, fit_image_hash_stream_start(&stream, fit, node));
+	hash_pieces(&stream, other);
+	ut_asserteq(0, fit_image_verify_stream(&stream, other, DATA_SIZE));
+
+	free(other);
+	free(data);
+	free(fit);
+
+	return 0;
+}
+LIB_TEST(lib_fit_stream, 0);
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for hashing buffers a piece at a time
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <hash.h>
+#include <hexdump.h>
+#include <image.h>
+#include <malloc.h>
+#include <os.h>
+#include <time.h>
+#include <asm/state.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* A few pieces, with part of a piece at the end */
+#define HASH_TEST_SIZE	(3 * CONFIG_HASH_CHUNK_SIZE + 0x1234)
+
+/* Over 4GiB, so that truncating the length to 32 bits gives 0x1234 */
+#define HASH_BIG_SIZE	(0x100000000ULL + 0x1234)
+
+static const char *const hash_test_algos[] = {
+	"sha1", "sha256", "crc16-ccitt", "crc32",
+};
+
+/* Check that every algorithm gives the same result as hashing in one go */
+static int lib_hash_chunked(struct unit_test_state *uts)
+{
+	u8 expect[HASH_MAX_DIGEST_SIZE], digest[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	int i;
+	u8 *buf;
+
+	buf = memalign(ARCH_DMA_MINALIGN, HASH_TEST_SIZE + 1);
+	ut_assertnonnull(buf);
+	for (i = 0; i < HASH_TEST_SIZE + 1; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (i = 0; i < ARRAY_SIZE(hash_test_algos); i++) {
+		ut_assertok(hash_lookup_algo(hash_test_algos[i], &algo));
+		algo->hash_func_ws(buf, HASH_TEST_SIZE, expect,
+				   algo->chunk_size);
+
+		memset(digest, '\0', sizeof(digest));
+		ut_assertok(hash_chunked(algo, buf, HASH_TEST_SIZE, digest, 0));
+		ut_asserteq_mem(expect, digest, algo->digest_size);
+
+		memset(digest, '\0', sizeof(digest));
+		ut_assertok(hash_chunked(algo, buf, HASH_TEST_SIZE, digest,
+					 HASH_CHUNK_DMA));
+		ut_asserteq_mem(expect, digest, algo->digest_size);
+
+		/* DMA buffers must start on a cache line */
+		ut_asserteq(-EINVAL, hash_chunked(algo, buf + 1, HASH_TEST_SIZE,
+						  digest, HASH_CHUNK_DMA));
+
+		/* An empty buffer is fine too */
+		algo->hash_func_ws(buf, 0, expect, algo->chunk_size);
+		ut_assertok(hash_chunked(algo, buf, 0, digest, 0));
+		ut_asserteq_mem(expect, digest, algo->digest_size);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_hash_chunked, 0);
+
+#ifdef CONFIG_SANDBOX
+/* Check that a FIT hash over 4GiB uses the full length */
+static int lib_hash_chunked_4g(struct unit_test_state *uts)
+{
+	/* crc32 of HASH_BIG_SIZE and 0x1234 zero bytes */
+	const u8 expect[] = { 0x98, 0x39, 0x91, 0xbf };
+	const u8 truncated[] = { 0xe4, 0xdb, 0x73, 0x64 };
+	u8 value[FIT_MAX_HASH_LEN];
+	int value_len;
+	void *buf;
+
+	if (sizeof(ulong) < sizeof(u64)) {
+		printf("Skipping: needs a 64-bit host\n");
+		return 0;
+	}
+
+	/* The pages are never written, so this does not use up host memory */
+	buf = os_malloc(HASH_BIG_SIZE);
+	if (!buf) {
+		printf("Skipping: cannot map %llx bytes\n", HASH_BIG_SIZE);
+		return 0;
+	}
+	ut_assertok(calculate_hash(buf, HASH_BIG_SIZE, "crc32", value,
+				   &value_len));
+	ut_asserteq(sizeof(expect), value_len);
+	ut_asserteq_mem(expect, value, sizeof(expect));
+
+	ut_assertok(calculate_hash(buf, 0x1234, "crc32", value, &value_len));
+	ut_asserteq_mem(truncated, value, sizeof(truncated));
+	os_free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_hash_chunked_4g, 0);
+#endif
+
+#if defined(CONFIG_WATCHDOG) && defined(CONFIG_WDT_SANDBOX)
+/* Check that HASH_CHUNK_NO_WATCHDOG keeps the watchdog alone */
+static int lib_hash_chunked_watchdog(struct unit_test_state *uts)
+{
+	struct sandbox_state *state = state_get_current();
+	struct udevice *old_dev = gd->watchdog_dev;
+	ulong old_flags = gd->flags;
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	uint reset_count;
+	u8 *buf;
+
+	buf = calloc(1, HASH_TEST_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertok(hash_lookup_algo("sha256", &algo));
+	ut_assertok(uclass_first_device_err(UCLASS_WDT, &gd->watchdog_dev));
+	gd->flags |= GD_FLG_WDT_READY;
+
+	/* watchdog_reset() does nothing if it was called under a second ago */
+	reset_count = state->wdt.reset_count;
+	timer_test_add_offset(2000);
+	ut_assertok(hash_chunked(algo, buf, HASH_TEST_SIZE, digest,
+				 HASH_CHUNK_NO_WATCHDOG));
+	ut_asserteq(reset_count, state->wdt.reset_count);
+
+	ut_assertok(hash_chunked(algo, buf, HASH_TEST_SIZE, digest, 0));
+	ut_asserteq(reset_count + 1, state->wdt.reset_count);
+
+	gd->watchdog_dev = old_dev;
+	gd->flags = old_flags;
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_hash_chunked_watchdog, 0);
+#endif
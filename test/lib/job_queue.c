@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the job queue
+ */
+
+#include <common.h>
+#include <job_queue.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+#define JOB_COUNT	10
+#define JOB_BUF_SIZE	(64 << 10)
+
+struct job_test {
+	u8 *buf;
+	int size;
+	u32 crc;
+};
+
+static int job_test_run(struct job *job)
+{
+	struct job_test *test = job->priv;
+
+	if (!test->size)
+		return -EINVAL;
+	test->crc = crc32(0, test->buf, test->size);
+
+	return 0;
+}
+
+/* Check that all jobs run, with the results the same as running serially */
+static int lib_job_queue(struct unit_test_state *uts)
+{
+	struct job_test tests[JOB_COUNT];
+	struct job jobs[JOB_COUNT];
+	int cpus, i;
+	u8 *buf;
+
+	buf = malloc(JOB_BUF_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < JOB_BUF_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	memset(jobs, '\0', sizeof(jobs));
+	for (i = 0; i < JOB_COUNT; i++) {
+		tests[i].buf = buf + i * 64;
+		tests[i].size = JOB_BUF_SIZE >> (i % 4) & ~63;
+		if (tests[i].size > JOB_BUF_SIZE - i * 64)
+			tests[i].size -= 1024;
+		tests[i].crc = 0;
+		jobs[i].func = job_test_run;
+		jobs[i].priv = &tests[i];
+		jobs[i].cost = tests[i].size;
+	}
+
+	cpus = job_queue_cpus();
+	ut_assert(cpus >= 1);
+	ut_assert(cpus <= CONFIG_JOB_QUEUE_MAX_CPUS);
+
+	ut_assertok(job_queue_run(jobs, JOB_COUNT));
+	for (i = 0; i < JOB_COUNT; i++) {
+		ut_asserteq(0, jobs[i].ret);
+		ut_assert(jobs[i].cpu >= 0 && jobs[i].cpu < cpus);
+		ut_asserteq(crc32(0, tests[i].buf, tests[i].size),
+			    tests[i].crc);
+	}
+
+	/* The largest jobs are spread over different CPUs */
+	if (cpus > 1)
+		ut_assert(jobs[0].cpu != jobs[4].cpu);
+
+	/* The first failure is reported */
+	tests[3].size = 0;
+	tests[6].size = 0;
+	ut_asserteq(-EINVAL, job_queue_run(jobs, JOB_COUNT));
+	ut_asserteq(-EINVAL, jobs[3].ret);
+	ut_asserteq(0, jobs[5].ret);
+
+	/* Some jobs can be kept on the calling CPU */
+	tests[3].size = 1024;
+	tests[6].size = 1024;
+	jobs[0].flags = JOBF_BOOT_CPU;
+	jobs[1].flags = JOBF_BOOT_CPU;
+	ut_assertok(job_queue_run(jobs, JOB_COUNT));
+	ut_asserteq(0, jobs[0].cpu);
+	ut_asserteq(0, jobs[1].cpu);
+	if (cpus > 1)
+		ut_assert(jobs[4].cpu != 0);
+
+	/* Nothing to do */
+	ut_assertok(job_queue_run(jobs, 0));
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_job_queue, 0);
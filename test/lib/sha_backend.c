@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SHA-1 and SHA-256 backends
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <hexdump.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+
+#define SHA_TEST_SIZE	(16 << 10)
+
+/* Lengths to hash, covering the padding cases and several blocks at once */
+static const uint sha_test_lens[] = {
+	0, 1, 55, 56, 63, 64, 65, 200, 4095, SHA_TEST_SIZE - 1,
+};
+
+struct sha_test {
+	const char *name;
+	int digest_size;
+	int (*select)(int index, const char **namep);
+	/* Hash @len bytes, passing the first @split bytes separately */
+	void (*hash)(const u8 *buf, uint len, uint split, u8 *digest);
+	u8 abc[SHA256_SUM_LEN];
+};
+
+static void sha_test_sha1(const u8 *buf, uint len, uint split, u8 *digest)
+{
+	sha1_context ctx;
+
+	sha1_starts(&ctx);
+	sha1_update(&ctx, buf, split);
+	sha1_update(&ctx, buf + split, len - split);
+	sha1_finish(&ctx, digest);
+}
+
+static void sha_test_sha256(const u8 *buf, uint len, uint split, u8 *digest)
+{
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, buf, split);
+	sha256_update(&ctx, buf + split, len - split);
+	sha256_finish(&ctx, digest);
+}
+
+static const struct sha_test sha_tests[] = {
+	{
+		.name		= "sha1",
+		.digest_size	= SHA1_SUM_LEN,
+		.select		= sha1_select_backend,
+		.hash		= sha_test_sha1,
+		.abc = {
+			0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a,
+			0xba, 0x3e, 0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c,
+			0x9c, 0xd0, 0xd8, 0x9d,
+		},
+	},
+	{
+		.name		= "sha256",
+		.digest_size	= SHA256_SUM_LEN,
+		.select		= sha256_select_backend,
+		.hash		= sha_test_sha256,
+		.abc = {
+			0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+			0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+			0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+			0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+		},
+	},
+};
+
+/* Check one backend against digests made by the default backend */
+static int sha_test_backend(struct unit_test_state *uts,
+			    const struct sha_test *test, const u8 *buf,
+			    u8 (*expect)[SHA256_SUM_LEN])
+{
+	u8 digest[SHA256_SUM_LEN];
+	int i;
+
+	test->hash((const u8 *)"abc", 3, 0, digest);
+	ut_asserteq_mem(test->abc, digest, test->digest_size);
+	for (i = 0; i < ARRAY_SIZE(sha_test_lens); i++) {
+		uint len = sha_test_lens[i];
+
+		/* Unaligned data, with a partial block held over */
+		test->hash(buf + 1, len, len / 3, digest);
+		ut_asserteq_mem(expect[i], digest, test->digest_size);
+	}
+
+	return 0;
+}
+
+/* Check that every backend the CPU supports gives the same digests */
+static int lib_sha_backend(struct unit_test_state *uts)
+{
+	u8 expect[ARRAY_SIZE(sha_test_lens)][SHA256_SUM_LEN];
+	const struct sha_test *test;
+	const char *name;
+	int i, index, ret;
+	u8 *buf;
+
+	buf = malloc(SHA_TEST_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < SHA_TEST_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (test = sha_tests; test < sha_tests + ARRAY_SIZE(sha_tests);
+	     test++) {
+		ut_assertok(test->select(-1, &name));
+		for (i = 0; i < ARRAY_SIZE(sha_test_lens); i++)
+			test->hash(buf + 1, sha_test_lens[i], 0, expect[i]);
+
+		for (index = 0;; index++) {
+			ret = test->select(index, &name);
+			if (ret == -ENOENT)
+				break;
+			if (ret == -ENODEV)
+				continue;
+			ut_assertok(ret);
+			ret = sha_test_backend(uts, test, buf, expect);
+			test->select(-1, NULL);
+			if (ret) {
+				printf("%s backend %s failed\n", test->name,
+				       name);
+				return ret;
+			}
+		}
+		/* There is always the generic backend */
+		ut_assert(index > 0);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_sha_backend, 0);
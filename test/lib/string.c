@@ -11,6 +11,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -21,6 +22,10 @@
 #define SWEEP 16
 /* Allow for copying up to 32 bytes */
 #define BUFLEN (SWEEP + 33)
+/* Amount of data moved for each throughput measurement */
+#define PERF_TOTAL (16 << 20)
+/* Largest region copied when measuring throughput */
+#define PERF_MAXLEN (1 << 20)
 
 /**
  * init_buffer() - initialize buffer
@@ -192,3 +197,89 @@ static int lib_memmove(struct unit_test_state *uts)
 }
 
 LIB_TEST(lib_memmove, 0);
+
+/**
+ * perf_run() - measure the throughput of a memory function
+ *
+ * @func:	0 = memset(), 1 = memcpy(), 2 = memmove()
+ * @dst:	destination buffer
+ * @src:	source buffer (ignored for memset())
+ * @len:	length of region to set or copy
+ * Return:	throughput in MB/s
+ */
+static ulong perf_run(int func, u8 *dst, u8 *src, int len)
+{
+	ulong start, elapsed;
+	int i, loops;
+
+	loops = PERF_TOTAL / len;
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		switch (func) {
+		case 0:
+			memset(dst, i, len);
+			break;
+		case 1:
+			memcpy(dst, src, len);
+			break;
+		case 2:
+			memmove(dst, src, len);
+			break;
+		}
+	}
+	elapsed = timer_get_us() - start;
+
+	return (ulong)loops * len / max(elapsed, 1UL);
+}
+
+/**
+ * lib_string_perf() - throughput of memset(), memcpy() and memmove()
+ *
+ * Report the throughput in MB/s for different lengths and alignments of the
+ * regions set or copied, and check the copies are correct. This allows the
+ * generic and architecture-specific implementations to be compared.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_string_perf(struct unit_test_state *uts)
+{
+	static const char *const names[] = { "memset", "memcpy", "memmove" };
+	static const int lens[] = { 64, 4096, PERF_MAXLEN };
+	static const int offsets[][2] = {
+		{ 0, 0 }, { 0, 1 }, { 1, 0 }, { 3, 6 }, { 4, 0 },
+	};
+	int func, i, j, offset1, offset2, len;
+	u8 *buf1, *buf2, *src, *dst;
+
+	buf1 = malloc(PERF_MAXLEN + SWEEP);
+	buf2 = malloc(PERF_MAXLEN + SWEEP);
+	ut_assertnonnull(buf1);
+	ut_assertnonnull(buf2);
+	for (i = 0; i < PERF_MAXLEN + SWEEP; i++)
+		buf1[i] = i ^ MASK;
+
+	printf("%-8s %8s %4s %4s %8s\n", "func", "len", "src", "dst", "MB/s");
+	for (func = 0; func < ARRAY_SIZE(names); func++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			for (j = 0; j < ARRAY_SIZE(offsets); j++) {
+				offset1 = offsets[j][0];
+				offset2 = offsets[j][1];
+				len = lens[i];
+				src = buf1 + offset1;
+				dst = buf2 + offset2;
+				printf("%-8s %8d %4d %4d %8lu\n", names[func],
+				       len, offset1, offset2,
+				       perf_run(func, dst, src, len));
+				if (func)
+					ut_assertok(memcmp(dst, src, len));
+			}
+		}
+	}
+	free(buf2);
+	free(buf1);
+
+	return 0;
+}
+
+LIB_TEST(lib_string_perf, 0);
@@ -19,11 +19,23 @@
 /* 4k ought to be enough for anybody */
 #define FDT_COPY_SIZE	(4 * SZ_1K)
 
+/* Sizes for applying a stack of overlays to a tree which keeps moving */
+#define FDT_STACK_NODES		16
+#define FDT_STACK_OVERLAYS	(FDT_STACK_NODES / 2)
+#define FDT_STACK_SIZE		(16 * SZ_1K)
+
+/*
+ * Nesting of the node which an overlay is applied to, giving a path over 1KiB
+ * long, so a stack must not limit the depth or path length of the nodes
+ */
+#define FDT_STACK_DEPTH		50
+
 extern u32 __dtb_test_fdt_base_begin;
 extern u32 __dtb_test_fdt_overlay_begin;
 extern u32 __dtb_test_fdt_overlay_stacked_begin;
 
 static void *fdt;
+static void *fdt_stack;
 
 static int ut_fdt_getprop_u32_by_index(void *fdt, const char *path,
 				    const char *name, int index,
@@ -209,6 +221,319 @@ static int fdt_overlay_stacked(struct unit_test_state *uts)
 }
 OVERLAY_TEST(fdt_overlay_stacked, 0);
 
+/* Applying the overlays through a stack must give exactly the same tree */
+static int fdt_overlay_stack(struct unit_test_state *uts)
+{
+	ut_asserteq(fdt_totalsize(fdt), fdt_totalsize(fdt_stack));
+	ut_assertok(memcmp(fdt, fdt_stack, fdt_totalsize(fdt)));
+
+	return CMD_RET_SUCCESS;
+}
+OVERLAY_TEST(fdt_overlay_stack, 0);
+
+/* Create a tree with some labelled devices */
+static int fdt_overlay_stack_base(struct unit_test_state *uts, void *buf)
+{
+	char name[20], path[30];
+	int i;
+
+	ut_assertok(fdt_create(buf, FDT_STACK_SIZE));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+	ut_assertok(fdt_begin_node(buf, "soc"));
+	for (i = 0; i < FDT_STACK_NODES; i++) {
+		snprintf(name, sizeof(name), "dev@%x", i << 12);
+		ut_assertok(fdt_begin_node(buf, name));
+		ut_assertok(fdt_property_string(buf, "status", "okay"));
+		ut_assertok(fdt_property_u32(buf, "phandle", i + 1));
+		ut_assertok(fdt_end_node(buf));
+	}
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_begin_node(buf, "__symbols__"));
+	for (i = 0; i < FDT_STACK_NODES; i++) {
+		snprintf(name, sizeof(name), "dev%d", i);
+		snprintf(path, sizeof(path), "/soc/dev@%x", i << 12);
+		ut_assertok(fdt_property_string(buf, name, path));
+	}
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+	ut_assertok(fdt_open_into(buf, buf, FDT_STACK_SIZE));
+
+	return 0;
+}
+
+/*
+ * Create overlay @seq, which adds a node with a local phandle under one device
+ * and a property to the next. The node refers to the node added by the
+ * previous overlay, so each overlay needs the symbols of those before it.
+ */
+static int fdt_overlay_stack_overlay(struct unit_test_state *uts, void *buf,
+				     int seq)
+{
+	int dev = seq * 2;
+	char name[20], label[20], path[50];
+
+	ut_assertok(fdt_create(buf, FDT_COPY_SIZE));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+
+	snprintf(name, sizeof(name), "ov%d", seq);
+	ut_assertok(fdt_begin_node(buf, "fragment@0"));
+	ut_assertok(fdt_property_u32(buf, "target", 0xffffffff));
+	ut_assertok(fdt_begin_node(buf, "__overlay__"));
+	ut_assertok(fdt_begin_node(buf, name));
+	ut_assertok(fdt_property_u32(buf, "phandle", 1));
+	ut_assertok(fdt_property_u32(buf, "self", 1));
+	ut_assertok(fdt_property_u32(buf, "prev", 0xffffffff));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "fragment@1"));
+	ut_assertok(fdt_property_u32(buf, "target", 0xffffffff));
+	ut_assertok(fdt_begin_node(buf, "__overlay__"));
+	ut_assertok(fdt_property_u32(buf, name, seq));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "__symbols__"));
+	snprintf(path, sizeof(path), "/fragment@0/__overlay__/%s", name);
+	ut_assertok(fdt_property_string(buf, name, path));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "__fixups__"));
+	snprintf(label, sizeof(label), "dev%d", dev);
+	ut_assertok(fdt_property_string(buf, label, "/fragment@0:target:0"));
+	snprintf(label, sizeof(label), "dev%d", dev + 1);
+	ut_assertok(fdt_property_string(buf, label, "/fragment@1:target:0"));
+	if (seq)
+		snprintf(label, sizeof(label), "ov%d", seq - 1);
+	else
+		snprintf(label, sizeof(label), "dev%d", FDT_STACK_NODES - 1);
+	snprintf(path, sizeof(path), "/fragment@0/__overlay__/%s:prev:0",
+		 name);
+	ut_assertok(fdt_property_string(buf, label, path));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "__local_fixups__"));
+	ut_assertok(fdt_begin_node(buf, "fragment@0"));
+	ut_assertok(fdt_begin_node(buf, "__overlay__"));
+	ut_assertok(fdt_begin_node(buf, name));
+	ut_assertok(fdt_property_u32(buf, "self", 0));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+
+	return 0;
+}
+
+/*
+ * Apply a stack of overlays to a tree, moving it to another buffer after each
+ * one and packing it after every other one, as a caller may. This must give
+ * the same tree as applying the overlays directly.
+ */
+static int fdt_overlay_stack_moved(struct unit_test_state *uts)
+{
+	struct fdt_overlay_stack *stack;
+	void *expect, *blob, *other, *ov;
+	u32 phandle, val;
+	char path[50];
+	int i, node;
+
+	expect = malloc(FDT_STACK_SIZE);
+	blob = malloc(FDT_STACK_SIZE);
+	other = malloc(FDT_STACK_SIZE);
+	ov = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(expect);
+	ut_assertnonnull(blob);
+	ut_assertnonnull(other);
+	ut_assertnonnull(ov);
+	ut_assertok(fdt_overlay_stack_base(uts, expect));
+	memcpy(blob, expect, FDT_STACK_SIZE);
+
+	for (i = 0; i < FDT_STACK_OVERLAYS; i++) {
+		ut_assertok(fdt_overlay_stack_overlay(uts, ov, i));
+		ut_assertok(fdt_overlay_apply(expect, ov));
+	}
+
+	stack = fdt_overlay_stack_create(blob);
+	ut_assertnonnull(stack);
+	for (i = 0; i < FDT_STACK_OVERLAYS; i++) {
+		ut_assertok(fdt_overlay_stack_overlay(uts, ov, i));
+		ut_assertok(fdt_overlay_stack_apply(stack, blob, ov));
+		if (i & 1)
+			ut_assertok(fdt_pack(blob));
+		ut_assertok(fdt_open_into(blob, other, FDT_STACK_SIZE));
+		swap(blob, other);
+	}
+	fdt_overlay_stack_free(stack);
+
+	ut_assertok(fdt_pack(expect));
+	ut_assertok(fdt_pack(blob));
+	ut_asserteq(fdt_totalsize(expect), fdt_totalsize(blob));
+	ut_assertok(memcmp(expect, blob, fdt_totalsize(expect)));
+
+	/* The last overlay's node refers to the one added before it */
+	i = FDT_STACK_OVERLAYS - 1;
+	snprintf(path, sizeof(path), "/soc/dev@%x/ov%d", (i - 1) * 2 << 12,
+		 i - 1);
+	node = fdt_path_offset(blob, path);
+	ut_assert(node >= 0);
+	phandle = fdt_get_phandle(blob, node);
+	snprintf(path, sizeof(path), "/soc/dev@%x/ov%d", i * 2 << 12, i);
+	node = fdt_path_offset(blob, path);
+	ut_assert(node >= 0);
+	ut_assertok(ut_fdt_getprop_u32(blob, path, "prev", &val));
+	ut_asserteq(phandle, val);
+	ut_assertok(ut_fdt_getprop_u32(blob, path, "self", &val));
+	ut_asserteq(fdt_get_phandle(blob, node), val);
+
+	free(ov);
+	free(other);
+	free(blob);
+	free(expect);
+
+	return CMD_RET_SUCCESS;
+}
+OVERLAY_TEST(fdt_overlay_stack_moved, 0);
+
+/*
+ * Create a tree with a deep chain of nodes. The last has a phandle, an alias
+ * and a symbol, and its path is returned in @path
+ */
+static int fdt_overlay_stack_deep_base(struct unit_test_state *uts, void *buf,
+				       char *path, int size)
+{
+	char name[30];
+	int i, len;
+
+	for (i = 0, len = 0; i < FDT_STACK_DEPTH; i++) {
+		len += snprintf(path + len, size - len,
+				"/node-with-a-long-name-%d", i);
+		ut_assert(len < size);
+	}
+
+	ut_assertok(fdt_create(buf, FDT_STACK_SIZE));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+	ut_assertok(fdt_begin_node(buf, "aliases"));
+	ut_assertok(fdt_property_string(buf, "deep", path));
+	ut_assertok(fdt_end_node(buf));
+	for (i = 0; i < FDT_STACK_DEPTH; i++) {
+		snprintf(name, sizeof(name), "node-with-a-long-name-%d", i);
+		ut_assertok(fdt_begin_node(buf, name));
+	}
+	ut_assertok(fdt_property_u32(buf, "phandle", 1));
+	for (i = 0; i < FDT_STACK_DEPTH; i++)
+		ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_begin_node(buf, "__symbols__"));
+	ut_assertok(fdt_property_string(buf, "deep", path));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+	ut_assertok(fdt_open_into(buf, buf, FDT_STACK_SIZE));
+
+	return 0;
+}
+
+/*
+ * Create an overlay which adds a node with a phandle under the deepest node,
+ * found by its symbol, and a property to it, found by its alias
+ */
+static int fdt_overlay_stack_deep_overlay(struct unit_test_state *uts,
+					  void *buf)
+{
+	ut_assertok(fdt_create(buf, FDT_COPY_SIZE));
+	ut_assertok(fdt_finish_reservemap(buf));
+	ut_assertok(fdt_begin_node(buf, ""));
+
+	ut_assertok(fdt_begin_node(buf, "fragment@0"));
+	ut_assertok(fdt_property_u32(buf, "target", 0xffffffff));
+	ut_assertok(fdt_begin_node(buf, "__overlay__"));
+	ut_assertok(fdt_begin_node(buf, "extra"));
+	ut_assertok(fdt_property_u32(buf, "phandle", 1));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "fragment@1"));
+	ut_assertok(fdt_property_string(buf, "target-path", "deep"));
+	ut_assertok(fdt_begin_node(buf, "__overlay__"));
+	ut_assertok(fdt_property_u32(buf, "aliased", 1));
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "__symbols__"));
+	ut_assertok(fdt_property_string(buf, "extra",
+					"/fragment@0/__overlay__/extra"));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_begin_node(buf, "__fixups__"));
+	ut_assertok(fdt_property_string(buf, "deep", "/fragment@0:target:0"));
+	ut_assertok(fdt_end_node(buf));
+
+	ut_assertok(fdt_end_node(buf));
+	ut_assertok(fdt_finish(buf));
+
+	return 0;
+}
+
+/* Apply an overlay to a node whose path is long, through a stack */
+static int fdt_overlay_stack_deep(struct unit_test_state *uts)
+{
+	struct fdt_overlay_stack *stack;
+	char path[FDT_STACK_DEPTH * 30];
+	void *expect, *blob, *ov;
+	const char *sym;
+	int node;
+
+	expect = malloc(FDT_STACK_SIZE);
+	blob = malloc(FDT_STACK_SIZE);
+	ov = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(expect);
+	ut_assertnonnull(blob);
+	ut_assertnonnull(ov);
+	ut_assertok(fdt_overlay_stack_deep_base(uts, expect, path,
+						sizeof(path)));
+	ut_assert(strlen(path) > SZ_1K);
+	memcpy(blob, expect, FDT_STACK_SIZE);
+
+	ut_assertok(fdt_overlay_stack_deep_overlay(uts, ov));
+	ut_assertok(fdt_overlay_apply(expect, ov));
+
+	stack = fdt_overlay_stack_create(blob);
+	ut_assertnonnull(stack);
+	ut_assertok(fdt_overlay_stack_deep_overlay(uts, ov));
+	ut_assertok(fdt_overlay_stack_apply(stack, blob, ov));
+	fdt_overlay_stack_free(stack);
+
+	ut_assertok(fdt_pack(expect));
+	ut_assertok(fdt_pack(blob));
+	ut_asserteq(fdt_totalsize(expect), fdt_totalsize(blob));
+	ut_assertok(memcmp(expect, blob, fdt_totalsize(expect)));
+
+	strcat(path, "/extra");
+	node = fdt_path_offset(blob, path);
+	ut_assert(node >= 0);
+	ut_asserteq(2, fdt_get_phandle(blob, node));
+	sym = fdt_getprop(blob, fdt_path_offset(blob, "/__symbols__"), "extra",
+			  NULL);
+	ut_assertnonnull(sym);
+	ut_asserteq_str(path, sym);
+
+	free(ov);
+	free(blob);
+	free(expect);
+
+	return CMD_RET_SUCCESS;
+}
+OVERLAY_TEST(fdt_overlay_stack_deep, 0);
+
 int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
@@ -219,6 +544,7 @@ int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	void *fdt_overlay = &__dtb_test_fdt_overlay_begin;
 	void *fdt_overlay_stacked = &__dtb_test_fdt_overlay_stacked_begin;
 	void *fdt_overlay_copy, *fdt_overlay_stacked_copy;
+	struct fdt_overlay_stack *stack;
 	int ret = -ENOMEM;
 
 	uts = calloc(1, sizeof(*uts));
@@ -240,6 +566,10 @@ int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	if (!fdt_overlay_stacked_copy)
 		goto err3;
 
+	fdt_stack = malloc(FDT_COPY_SIZE);
+	if (!fdt_stack)
+		goto err4;
+
 	/*
 	 * Resize the FDT to 4k so that we have room to operate on
 	 *
@@ -248,6 +578,9 @@ int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	 */
 	ut_assertok(fdt_open_into(fdt_base, fdt, FDT_COPY_SIZE));
 
+	/* Copy all of it, so that the unused space matches too */
+	memcpy(fdt_stack, fdt, FDT_COPY_SIZE);
+
 	/*
 	 * Resize the overlay to 4k so that we have room to operate on
 	 *
@@ -272,8 +605,22 @@ int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	/* Apply the stacked overlay */
 	ut_assertok(fdt_overlay_apply(fdt, fdt_overlay_stacked_copy));
 
+	/* Apply both again to the other copy, through a stack this time */
+	ut_assertok(fdt_open_into(fdt_overlay, fdt_overlay_copy,
+				  FDT_COPY_SIZE));
+	ut_assertok(fdt_open_into(fdt_overlay_stacked, fdt_overlay_stacked_copy,
+				  FDT_COPY_SIZE));
+	stack = fdt_overlay_stack_create(fdt_stack);
+	ut_assertok(fdt_overlay_stack_apply(stack, fdt_stack,
+					    fdt_overlay_copy));
+	ut_assertok(fdt_overlay_stack_apply(stack, fdt_stack,
+					    fdt_overlay_stacked_copy));
+	fdt_overlay_stack_free(stack);
+
 	ret = cmd_ut_category("overlay", tests, n_ents, argc, argv);
 
+	free(fdt_stack);
+err4:
 	free(fdt_overlay_stacked_copy);
 err3:
 	free(fdt_overlay_copy);
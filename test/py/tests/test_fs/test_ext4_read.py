@@ -0,0 +1,128 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: ext4 read test
+
+"""
+This test verifies that ext4 files are read one run of contiguous blocks at a
+time, and that files with holes and deep extent trees read back correctly.
+"""
+
+import pytest
+import re
+from subprocess import call, check_call, check_output, CalledProcessError
+from fstest_defs import *
+
+# Size of the contiguous file, in MiB
+CONTIG_MB = 32
+# Size of each data area and each hole in the sparse file, in KiB
+SPARSE_KB = 256
+# Reads made by ext4load before reading any file data: it mounts the file
+# system and looks up the file once to check the size against reserved
+# memory, then again to read it
+LOAD_READS = 7
+
+def md5(fname, skip=0, count=None):
+    """Get the MD5 of part of a file, in units of 1KiB."""
+    cmd = 'dd if=%s bs=1K skip=%d' % (fname, skip)
+    if count is not None:
+        cmd += ' count=%d' % count
+    return check_output(cmd + ' 2> /dev/null | md5sum',
+                        shell=True).decode().split()[0]
+
+@pytest.fixture(scope='module')
+def fs_obj_ext4_read(u_boot_config):
+    """Set up an ext4 file system with a contiguous and a sparse file.
+
+    The image is filled by mkfs.ext4 so that no mount is needed. The sparse
+    file has enough extents to need an extent tree below the inode.
+
+    Return:
+        A triplet of the image file name, the source directory and a
+        dictionary of MD5 hashes.
+    """
+    if not u_boot_config.buildconfig.get('config_cmd_ext4', None):
+        pytest.skip('.config feature "CMD_EXT4" not enabled')
+
+    src_dir = u_boot_config.persistent_data_dir + '/ext4_read'
+    fs_img = u_boot_config.persistent_data_dir + '/ext4_read.img'
+    contig = src_dir + '/contig'
+    sparse = src_dir + '/sparse'
+
+    try:
+        check_call('rm -rf %s %s; mkdir -p %s' % (src_dir, fs_img, src_dir),
+                   shell=True)
+        check_call('dd if=/dev/urandom of=%s bs=1M count=%d 2> /dev/null'
+                   % (contig, CONTIG_MB), shell=True)
+        for i in range(0, 64, 2):
+            check_call('dd if=/dev/urandom of=%s bs=%dK count=1 seek=%d '
+                       'conv=notrunc 2> /dev/null' % (sparse, SPARSE_KB, i),
+                       shell=True)
+        check_call('dd if=/dev/zero of=%s bs=1M count=%d 2> /dev/null'
+                   % (fs_img, CONTIG_MB * 2), shell=True)
+        check_call('mkfs.ext4 -q -b 4096 -O ^metadata_csum -d %s %s'
+                   % (src_dir, fs_img), shell=True)
+
+        md5val = {
+            'contig': md5(contig),
+            'sparse': md5(sparse),
+            # Starts part-way through a data area, crossing several holes
+            'sparse_part': md5(sparse, SPARSE_KB + 100, SPARSE_KB * 5),
+        }
+    except CalledProcessError:
+        call('rm -rf %s %s' % (src_dir, fs_img), shell=True)
+        pytest.skip('Setup failed for ext4 read test')
+        return
+
+    yield [fs_img, src_dir, md5val]
+    call('rm -rf %s %s' % (src_dir, fs_img), shell=True)
+
+def host_reads(u_boot_console):
+    """Get the number of reads made from host device 0."""
+    output = u_boot_console.run_command('host info 0')
+    m = re.search(r'^\s*0\s+\d+\s+(\d+)\s', output, re.MULTILINE)
+    assert m, 'Cannot find read count in: %s' % output
+    return int(m.group(1))
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ext4')
+@pytest.mark.slow
+class TestFsExt4Read(object):
+    def test_ext4_read_contig(self, u_boot_console, fs_obj_ext4_read):
+        """Read a contiguous file and count the reads from the device."""
+        fs_img, src_dir, md5val = fs_obj_ext4_read
+        u_boot_console.run_command('host bind 0 %s' % fs_img)
+
+        # Mount and look up the file first, so only the load is counted
+        output = u_boot_console.run_command('ext4size host 0 /contig')
+        assert 'Error' not in output
+        before = host_reads(u_boot_console)
+        output = u_boot_console.run_command_list([
+            'ext4load host 0 %x /contig' % ADDR,
+            'md5sum %x $filesize' % ADDR,
+            'setenv filesize'])
+        assert md5val['contig'] in ''.join(output)
+        reads = host_reads(u_boot_console) - before
+
+        u_boot_console.log.info('ext4: %d reads for %d MiB (%.2f per MiB)' %
+                                (reads, CONTIG_MB, float(reads) / CONTIG_MB))
+        # mkfs.ext4 writes the file as one extent, which is read in one go
+        assert reads <= LOAD_READS + 1
+
+    def test_ext4_read_sparse(self, u_boot_console, fs_obj_ext4_read):
+        """Read a sparse file with an extent tree, in full and in part."""
+        fs_img, src_dir, md5val = fs_obj_ext4_read
+        output = u_boot_console.run_command_list([
+            'host bind 0 %s' % fs_img,
+            'mw.b %x ff %x' % (ADDR, 64 * SPARSE_KB * 1024),
+            'ext4load host 0 %x /sparse' % ADDR,
+            'md5sum %x $filesize' % ADDR,
+            'setenv filesize'])
+        assert md5val['sparse'] in ''.join(output)
+
+        output = u_boot_console.run_command_list([
+            'mw.b %x ff %x' % (ADDR, 64 * SPARSE_KB * 1024),
+            'ext4load host 0 %x /sparse %x %x' %
+                (ADDR, SPARSE_KB * 5 * 1024, (SPARSE_KB + 100) * 1024),
+            'md5sum %x $filesize' % ADDR,
+            'setenv filesize'])
+        assert md5val['sparse_part'] in ''.join(output)
@@ -0,0 +1,58 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test the gzwrite command, which inflates a gzip image while writing it to a
+# block device.
+
+import gzip
+import hashlib
+import os
+import pytest
+
+"""
+These tests write to a disk image which is created by the test and bound to a
+sandbox host device.
+"""
+
+# Size of the disk image
+DISK_SIZE = 8 << 20
+# Size of the uncompressed data, not a multiple of the write buffer size
+DATA_SIZE = (3 << 20) + 1234
+# Address at which to load the compressed data
+ADDR = 0x1000000
+
+def make_data():
+    """Make some data which compresses a little but not too much."""
+    words = [b'%d' % (i * 7919 % 10007) for i in range(DATA_SIZE // 4)]
+    data = b' '.join(words)[:DATA_SIZE]
+    return data
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_unzip')
+@pytest.mark.parametrize('offset', [0, 0x80000])
+def test_gzwrite(u_boot_console, offset):
+    """Inflate and write an image, then check what arrived on the disk."""
+    cons = u_boot_console
+    disk = cons.config.result_dir + '/gzwrite.img'
+    gz = cons.config.result_dir + '/gzwrite.gz'
+
+    data = make_data()
+    with open(gz, 'wb') as fd:
+        fd.write(gzip.compress(data))
+    with open(disk, 'wb') as fd:
+        fd.truncate(DISK_SIZE)
+
+    cons.run_command('host bind 0 %s' % disk)
+    output = cons.run_command('load hostfs - %x %s' % (ADDR, gz))
+    assert 'bytes read' in output
+    output = cons.run_command('gzwrite host 0 %x $filesize 40000 %x' %
+                              (ADDR, offset))
+    assert '%d bytes, crc' % DATA_SIZE in output
+
+    with open(disk, 'rb') as fd:
+        written = fd.read()
+    os.remove(disk)
+    os.remove(gz)
+    assert written[:offset] == bytes(offset)
+    assert (hashlib.md5(written[offset:offset + DATA_SIZE]).digest() ==
+            hashlib.md5(data).digest())
+    assert written[offset + DATA_SIZE:] == bytes(DISK_SIZE - offset - DATA_SIZE)